@@ -37,6 +37,8 @@
 #endif // Relative paths include ".."
 
 #include "../src/colors.h"
+#include "../src/surface.h"
+#include "mcl_control.h"
 
 #ifdef _MSC_VER
 # pragma warning(pop)
@@ -239,6 +241,245 @@ mcl {
 
     }
 
+#ifdef MCL_SSE2
+    // a channel of four colors as floats
+    static inline __m128
+    mcl_cvt_ch (__m128i v, int shift) {
+        return _mm_cvtepi32_ps (_mm_and_si128 (_mm_srli_epi32 (v, shift), _mm_set1_epi32 (0xff)));
+    }
+
+    // (m & a) | (~m & b)
+    static inline __m128
+    mcl_cvt_sel (__m128 m, __m128 a, __m128 b) {
+        return _mm_or_ps (_mm_and_ps (m, a), _mm_andnot_ps (m, b));
+    }
+
+    // MCL_FRGB of four colors
+    static inline __m128i
+    mcl_cvt_frgb (__m128 tor, __m128 tog, __m128 tob, __m128i fc) {
+        return _mm_or_si128 (_mm_or_si128 (_mm_slli_epi32 (_mm_cvttps_epi32 (tor), 16),
+            _mm_slli_epi32 (_mm_cvttps_epi32 (tog), 8)), _mm_or_si128 (_mm_cvttps_epi32 (tob),
+            _mm_and_si128 (fc, _mm_set1_epi32 (static_cast<int>(0xff000000)))));
+    }
+
+    // hue of cvtrgb2hsl and cvtrgb2hsv. del must not be 0
+    static inline __m128
+    mcl_cvt_hue (__m128 r, __m128 g, __m128 b, __m128 cmax, __m128 del) {
+        __m128 const k40 = _mm_set1_ps (40.f), half = _mm_set1_ps (.5f);
+        __m128 mr = _mm_cmpeq_ps (cmax, r), mg = _mm_cmpeq_ps (cmax, g);
+        __m128 hr = _mm_add_ps (_mm_div_ps (_mm_mul_ps (k40, _mm_sub_ps (g, b)), del), half);
+        __m128 hg = _mm_add_ps (_mm_div_ps (_mm_mul_ps (k40, _mm_sub_ps (b, r)), del), _mm_set1_ps (80.5f));
+        __m128 hb = _mm_add_ps (_mm_div_ps (_mm_mul_ps (k40, _mm_sub_ps (r, g)), del), _mm_set1_ps (160.5f));
+        __m128 h = mcl_cvt_sel (mr, hr, mcl_cvt_sel (mg, hg, hb));
+        return _mm_add_ps (h, _mm_and_ps (_mm_cmplt_ps (h, half), _mm_set1_ps (240.f)));
+    }
+#endif
+
+   /**
+    * @function cvtrgb2hsl <src/colors.h>
+    * @brief Convert count RGB colors to HSL colors, four at a time.
+    *     The results are the same as cvtrgb2hsl (color_t).
+    * @param {color_t const*} rgbcolors
+    * @param {color_t*} hslcolors: may be rgbcolors
+    * @param {size_t} count
+    */
+    void
+    cvtrgb2hsl (color_t const* rgbcolors, color_t* hslcolors, size_t count) {
+#ifdef MCL_SSE2
+        __m128 const k255 = _mm_set1_ps (255.f), k240 = _mm_set1_ps (240.f), k120 = _mm_set1_ps (120.f);
+        __m128 const one = _mm_set1_ps (1.f), half = _mm_set1_ps (.5f), zero = _mm_setzero_ps ();
+        for (size_t n = count >> 2; n; -- n, rgbcolors += 4, hslcolors += 4) {
+            __m128i v = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(rgbcolors));
+            __m128 r = _mm_div_ps (mcl_cvt_ch (v, 16), k255);
+            __m128 g = _mm_div_ps (mcl_cvt_ch (v, 8), k255);
+            __m128 b = _mm_div_ps (mcl_cvt_ch (v, 0), k255);
+            __m128 cmax = _mm_max_ps (_mm_max_ps (r, g), b), cmin = _mm_min_ps (_mm_min_ps (r, g), b);
+            __m128 del = _mm_sub_ps (cmax, cmin), gray = _mm_cmpeq_ps (del, zero);
+            __m128 tol = _mm_mul_ps (_mm_add_ps (cmax, cmin), k120);
+            // gray lanes divide by 1 and are cleared afterwards
+            __m128 dn = mcl_cvt_sel (_mm_cmplt_ps (tol, k120), _mm_add_ps (cmax, cmin),
+                _mm_sub_ps (_mm_sub_ps (_mm_set1_ps (2.f), cmax), cmin));
+            __m128 tos = _mm_add_ps (_mm_div_ps (_mm_mul_ps (del, k240), mcl_cvt_sel (gray, one, dn)), half);
+            __m128 toh = mcl_cvt_hue (r, g, b, cmax, mcl_cvt_sel (gray, one, del));
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(hslcolors), mcl_cvt_frgb (
+                _mm_andnot_ps (gray, toh), _mm_andnot_ps (gray, tos), _mm_add_ps (tol, half), v));
+        }
+        count &= 3;
+#endif
+        for (; count; -- count) *hslcolors ++ = cvtrgb2hsl (*rgbcolors ++);
+    }
+
+   /**
+    * @function cvthsl2hsv <src/colors.h>
+    * @brief Convert count HSL colors to HSV colors.
+    * @param {color_t const*} hslcolors
+    * @param {color_t*} hsvcolors: may be hslcolors
+    * @param {size_t} count
+    */
+    void
+    cvthsl2hsv (color_t const* hslcolors, color_t* hsvcolors, size_t count) {
+        for (; count; -- count) *hsvcolors ++ = cvthsl2hsv (*hslcolors ++);
+    }
+
+   /**
+    * @function cvthsv2rgb <src/colors.h>
+    * @brief Convert count HSV colors to RGB colors, four at a time.
+    *     The results are the same as cvthsv2rgb (color_t).
+    * @param {color_t const*} hsvcolors
+    * @param {color_t*} rgbcolors: may be hsvcolors
+    * @param {size_t} count
+    */
+    void
+    cvthsv2rgb (color_t const* hsvcolors, color_t* rgbcolors, size_t count) {
+#ifdef MCL_SSE2
+        __m128 const k40 = _mm_set1_ps (40.f), k240 = _mm_set1_ps (240.f), k255 = _mm_set1_ps (255.f);
+        __m128 const one = _mm_set1_ps (1.f), half = _mm_set1_ps (.5f);
+        for (size_t n = count >> 2; n; -- n, hsvcolors += 4, rgbcolors += 4) {
+            __m128i v = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(hsvcolors));
+            __m128  h = mcl_cvt_ch (v, 16);
+            __m128i sector = _mm_cvttps_epi32 (_mm_div_ps (h, k40)); // h / 40
+            __m128 frh = _mm_sub_ps (_mm_div_ps (h, k40), _mm_cvtepi32_ps (sector));
+            __m128 frs = _mm_div_ps (mcl_cvt_ch (v, 8), k240);
+            __m128 frv = _mm_mul_ps (_mm_div_ps (mcl_cvt_ch (v, 0), k240), k255);
+            __m128 cv1 = _mm_add_ps (frv, half);
+            __m128 cv2 = _mm_add_ps (_mm_mul_ps (frv, _mm_sub_ps (one, frs)), half);
+            __m128 cv3 = _mm_add_ps (_mm_mul_ps (frv, _mm_sub_ps (one, _mm_mul_ps (frh, frs))), half);
+            __m128 cv4 = _mm_add_ps (_mm_mul_ps (frv, _mm_sub_ps (one, _mm_mul_ps (_mm_sub_ps (one, frh), frs))), half);
+            __m128 m[6];
+            for (int i = 0; i != 6; ++ i)
+                m[i] = _mm_castsi128_ps (_mm_cmpeq_epi32 (sector, _mm_set1_epi32 (i)));
+            __m128 tor = _mm_or_ps (_mm_or_ps (_mm_and_ps (_mm_or_ps (m[0], m[5]), cv1), _mm_and_ps (m[1], cv3)),
+                _mm_or_ps (_mm_and_ps (_mm_or_ps (m[2], m[3]), cv2), _mm_and_ps (m[4], cv4)));
+            __m128 tog = _mm_or_ps (_mm_or_ps (_mm_and_ps (m[0], cv4), _mm_and_ps (_mm_or_ps (m[1], m[2]), cv1)),
+                _mm_or_ps (_mm_and_ps (m[3], cv3), _mm_and_ps (_mm_or_ps (m[4], m[5]), cv2)));
+            __m128 tob = _mm_or_ps (_mm_or_ps (_mm_and_ps (_mm_or_ps (m[0], m[1]), cv2), _mm_and_ps (m[2], cv4)),
+                _mm_or_ps (_mm_and_ps (_mm_or_ps (m[3], m[4]), cv1), _mm_and_ps (m[5], cv3)));
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(rgbcolors), mcl_cvt_frgb (tor, tog, tob, v));
+        }
+        count &= 3;
+#endif
+        for (; count; -- count) *rgbcolors ++ = cvthsv2rgb (*hsvcolors ++);
+    }
+
+   /**
+    * @function cvtrgb2hsv <src/colors.h>
+    * @brief Convert count RGB colors to HSV colors, four at a time.
+    *     The results are the same as cvtrgb2hsv (color_t).
+    * @param {color_t const*} rgbcolors
+    * @param {color_t*} hsvcolors: may be rgbcolors
+    * @param {size_t} count
+    */
+    void
+    cvtrgb2hsv (color_t const* rgbcolors, color_t* hsvcolors, size_t count) {
+#ifdef MCL_SSE2
+        __m128 const k255 = _mm_set1_ps (255.f), k240 = _mm_set1_ps (240.f);
+        __m128 const one = _mm_set1_ps (1.f), half = _mm_set1_ps (.5f), zero = _mm_setzero_ps ();
+        for (size_t n = count >> 2; n; -- n, rgbcolors += 4, hsvcolors += 4) {
+            __m128i v = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(rgbcolors));
+            __m128 r = _mm_div_ps (mcl_cvt_ch (v, 16), k255);
+            __m128 g = _mm_div_ps (mcl_cvt_ch (v, 8), k255);
+            __m128 b = _mm_div_ps (mcl_cvt_ch (v, 0), k255);
+            __m128 cmax = _mm_max_ps (_mm_max_ps (r, g), b), cmin = _mm_min_ps (_mm_min_ps (r, g), b);
+            __m128 del = _mm_sub_ps (cmax, cmin), gray = _mm_cmpeq_ps (del, zero);
+            // gray lanes divide by 1 and are cleared afterwards
+            __m128 tos = _mm_add_ps (_mm_div_ps (_mm_mul_ps (del, k240), mcl_cvt_sel (gray, one, cmax)), half);
+            __m128 toh = mcl_cvt_hue (r, g, b, cmax, mcl_cvt_sel (gray, one, del));
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(hsvcolors), mcl_cvt_frgb (
+                _mm_andnot_ps (gray, toh), _mm_andnot_ps (gray, tos), _mm_add_ps (_mm_mul_ps (cmax, k240), half), v));
+        }
+        count &= 3;
+#endif
+        for (; count; -- count) *hsvcolors ++ = cvtrgb2hsv (*rgbcolors ++);
+    }
+
+   /**
+    * @function cvthsv2hsl <src/colors.h>
+    * @brief Convert count HSV colors to HSL colors.
+    * @param {color_t const*} hsvcolors
+    * @param {color_t*} hslcolors: may be hsvcolors
+    * @param {size_t} count
+    */
+    void
+    cvthsv2hsl (color_t const* hsvcolors, color_t* hslcolors, size_t count) {
+        for (; count; -- count) *hslcolors ++ = cvthsv2hsl (*hsvcolors ++);
+    }
+
+   /**
+    * @function cvthsl2rgb <src/colors.h>
+    * @brief Convert count HSL colors to RGB colors, four at a time.
+    *     The results are the same as cvthsl2rgb (color_t).
+    * @param {color_t const*} hslcolors
+    * @param {color_t*} rgbcolors: may be hslcolors
+    * @param {size_t} count
+    */
+    void
+    cvthsl2rgb (color_t const* hslcolors, color_t* rgbcolors, size_t count) {
+#ifdef MCL_SSE2
+        __m128 const k240 = _mm_set1_ps (240.f), k255 = _mm_set1_ps (255.f);
+        __m128 const one = _mm_set1_ps (1.f), half = _mm_set1_ps (.5f), zero = _mm_setzero_ps ();
+        __m128 const k2 = _mm_set1_ps (2.f), k3 = _mm_set1_ps (3.f), k6 = _mm_set1_ps (6.f);
+        __m128 const third = _mm_set1_ps (1.f/3.f), two3 = _mm_set1_ps (2.f/3.f);
+        for (size_t n = count >> 2; n; -- n, hslcolors += 4, rgbcolors += 4) {
+            __m128i v = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(hslcolors));
+            __m128 frh = _mm_div_ps (mcl_cvt_ch (v, 16), k240);
+            __m128 frs = _mm_div_ps (mcl_cvt_ch (v, 8), k240);
+            __m128 frl = _mm_div_ps (mcl_cvt_ch (v, 0), k240);
+            __m128 q = mcl_cvt_sel (_mm_cmplt_ps (frl, half), _mm_mul_ps (frl, _mm_add_ps (one, frs)),
+                _mm_sub_ps (_mm_add_ps (frl, frs), _mm_mul_ps (frl, frs)));
+            __m128 p = _mm_sub_ps (_mm_mul_ps (k2, frl), q), qp = _mm_sub_ps (q, p);
+            __m128 color[3] = { _mm_add_ps (frh, third), frh, _mm_sub_ps (frh, third) };
+            for (int i = 0; i != 3; ++ i) {
+                __m128 t = color[i];
+                t = _mm_add_ps (t, _mm_and_ps (_mm_cmplt_ps (t, zero), one));
+                t = _mm_sub_ps (t, _mm_and_ps (_mm_cmpgt_ps (t, one), one));
+                __m128 c = mcl_cvt_sel (_mm_cmplt_ps (_mm_mul_ps (t, k6), one),
+                    _mm_add_ps (p, _mm_mul_ps (_mm_mul_ps (qp, k6), t)),
+                    mcl_cvt_sel (_mm_cmplt_ps (_mm_mul_ps (t, k2), one), q,
+                    mcl_cvt_sel (_mm_cmplt_ps (_mm_mul_ps (t, k3), k2),
+                        _mm_add_ps (p, _mm_mul_ps (_mm_mul_ps (qp, _mm_sub_ps (two3, t)), k6)), p)));
+                c = _mm_min_ps (c, one);
+                color[i] = _mm_add_ps (_mm_mul_ps (_mm_max_ps (c, zero), k255), half);
+            }
+            // without saturation, all channels are the lightness
+            __m128 gray = _mm_cmpeq_ps (frs, zero), l = _mm_add_ps (_mm_mul_ps (frl, k255), half);
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(rgbcolors), mcl_cvt_frgb (mcl_cvt_sel (gray, l, color[0]),
+                mcl_cvt_sel (gray, l, color[1]), mcl_cvt_sel (gray, l, color[2]), v));
+        }
+        count &= 3;
+#endif
+        for (; count; -- count) *rgbcolors ++ = cvthsl2rgb (*hslcolors ++);
+    }
+
+   /**
+    * @function mcl_cvt_surface <cpp/colors.cpp>
+    * @brief Convert every pixel of a surface in place with a span function.
+    * @return bool
+    */
+    static bool
+    mcl_cvt_surface (surface_t& surface, void (*fun)(color_t const*, color_t*, size_t), wchar_t const* name) {
+        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&surface);
+        if (!dataplus) return false;
+
+        // lock
+        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, name);
+        point1d_t w = dataplus -> m_width, h = dataplus -> m_height;
+        if (!w) return false;
+        dataplus -> touch ();
+        color_t* p = dataplus -> m_pbuffer;
+        mcl_parallel_obj.run (h, static_cast<size_t>(w) * static_cast<size_t>(h),
+        [=] (point1d_t ib, point1d_t ie) {
+            fun (p + ib * w, p + ib * w, static_cast<size_t>(ie - ib) * static_cast<size_t>(w));
+        });
+        return true;
+    }
+
+    bool cvtrgb2hsl (surface_t& surface) { return mcl_cvt_surface (surface, cvtrgb2hsl, L"cvtrgb2hsl"); }
+    bool cvthsl2hsv (surface_t& surface) { return mcl_cvt_surface (surface, cvthsl2hsv, L"cvthsl2hsv"); }
+    bool cvthsv2rgb (surface_t& surface) { return mcl_cvt_surface (surface, cvthsv2rgb, L"cvthsv2rgb"); }
+    bool cvtrgb2hsv (surface_t& surface) { return mcl_cvt_surface (surface, cvtrgb2hsv, L"cvtrgb2hsv"); }
+    bool cvthsv2hsl (surface_t& surface) { return mcl_cvt_surface (surface, cvthsv2hsl, L"cvthsv2hsl"); }
+    bool cvthsl2rgb (surface_t& surface) { return mcl_cvt_surface (surface, cvthsl2rgb, L"cvthsl2rgb"); }
+
 #undef MCL_FRGB
 
 }
@@ -40,6 +40,7 @@
 #include "mcl_control.h"
 
 #include "../src/clog4m.h"
+#include <cstring>    // for memset, memcpy
 
 #ifdef _MSC_VER
 # pragma warning(pop)
@@ -54,6 +55,433 @@ mcl {
     mcl_image_t::operator void* () const noexcept{ return const_cast<mcl_image_t*>(this); }
     bool mcl_image_t::operator! () const noexcept{ return false; }
 
+   /**
+    * @class mcl_bmp_t <cpp/image.cpp>
+    * @brief Layout of the pixels in a BMP file.
+    */
+    struct
+    mcl_bmp_t {
+        unsigned char const* bits = nullptr; // first stored row
+        size_t    pitch   = 0;
+        point1d_t width   = 0;
+        point1d_t height  = 0;
+        bool      b_topdown = false;
+        int       kind    = 0;  // see mcl_bmp_kind_t
+        int       bpp     = 0;
+        int       shift[4] = { 0, 0, 0, 0 };   // r, g, b, a
+        color_t   mask[4]  = { 0, 0, 0, 0 };   // after shifting
+        unsigned char scale[4][256];           // channel value to 8 bits
+        color_t   palette[256];
+    };
+
+    enum mcl_bmp_kind_t {
+        mcl_bmp_index = 0, // 1, 4 or 8 bits through the palette
+        mcl_bmp_bgr,       // 24 bits
+        mcl_bmp_bgrx,      // 32 bits without alpha
+        mcl_bmp_bgra,      // 32 bits stored as surfaces are
+        mcl_bmp_fields     // 16 or 32 bits with any bitfields
+    };
+
+    static inline color_t
+    mcl_bmp_rd16 (unsigned char const* p) noexcept {
+        return static_cast<color_t>(p[0]) | static_cast<color_t>(p[1]) << 8;
+    }
+    static inline color_t
+    mcl_bmp_rd32 (unsigned char const* p) noexcept {
+        return mcl_bmp_rd16 (p) | mcl_bmp_rd16 (p + 2) << 16;
+    }
+
+   /**
+    * @function mcl_bmp_parse <cpp/image.cpp>
+    * @brief Read the headers of a BMP file in memory.
+    *     Compressed files (RLE, JPEG, PNG) are not supported.
+    * @param {unsigned char const*} data: the whole file
+    * @param {size_t} size
+    * @param {mcl_bmp_t&} bmp
+    * @return bool: false if the file is not supported or broken
+    */
+    static bool
+    mcl_bmp_parse (unsigned char const* data, size_t size, mcl_bmp_t& bmp) noexcept {
+        if (!data || size < 26 || data[0] != 'B' || data[1] != 'M') return false;
+        size_t offbits = mcl_bmp_rd32 (data + 10), hsize = mcl_bmp_rd32 (data + 14);
+        if (hsize < 12 || hsize > size - 14) return false;
+
+        long long w = 0, h = 0;
+        color_t comp = BI_RGB, clrused = 0;
+        if (hsize == 12) { // BITMAPCOREHEADER
+            w = static_cast<long long>(mcl_bmp_rd16 (data + 18));
+            h = static_cast<long long>(mcl_bmp_rd16 (data + 20));
+            bmp.bpp = static_cast<int>(mcl_bmp_rd16 (data + 24));
+        } else if (hsize >= 40) {
+            w = static_cast<long long>(static_cast<int>(mcl_bmp_rd32 (data + 18)));
+            h = static_cast<long long>(static_cast<int>(mcl_bmp_rd32 (data + 22)));
+            bmp.bpp = static_cast<int>(mcl_bmp_rd16 (data + 28));
+            comp    = mcl_bmp_rd32 (data + 30);
+            clrused = mcl_bmp_rd32 (data + 46);
+        } else return false;
+        if (h < 0) { bmp.b_topdown = true; h = -h; }
+        if (w <= 0 || h <= 0 || w > 0x7fffffff || h > 0x7fffffff) return false;
+        bmp.width = static_cast<point1d_t>(w);
+        bmp.height = static_cast<point1d_t>(h);
+
+        // 6 is BI_ALPHABITFIELDS, which older headers lack
+        bool b_fields = (comp == BI_BITFIELDS || comp == 6);
+        if (!(comp == BI_RGB || b_fields)) return false;
+        switch (bmp.bpp) {
+            case 1: case 4: case 8: case 24: if (b_fields) return false; break;
+            case 16: case 32: break;
+            default: return false;
+        }
+
+        // every row but the last must be whole
+        unsigned long long pitch = ((static_cast<unsigned long long>(w) * bmp.bpp + 31) >> 5) << 2;
+        unsigned long long last = (static_cast<unsigned long long>(w) * bmp.bpp + 7) >> 3;
+        if (offbits > size) return false;
+        unsigned long long avail = size - offbits;
+        if (static_cast<unsigned long long>(h - 1) > avail / pitch || pitch * (h - 1) + last > avail)
+            return false;
+        bmp.pitch = static_cast<size_t>(pitch);
+        bmp.bits = data + offbits;
+
+        // the palette
+        if (bmp.bpp <= 8) {
+            size_t entry = hsize == 12 ? 3 : 4, cnt = static_cast<size_t>(1) << bmp.bpp;
+            if (clrused && clrused < cnt) cnt = clrused;
+            unsigned char const* pal = data + 14 + hsize;
+            if (cnt > (size - 14 - hsize) / entry) cnt = (size - 14 - hsize) / entry;
+            // read 3 bytes only, as core headers have no reserved byte after the last entry
+            for (size_t i = 0; i != 256; ++ i) {
+                unsigned char const* e = pal + i * entry;
+                bmp.palette[i] = i < cnt ? 0xff000000 | static_cast<color_t>(e[2]) << 16
+                    | static_cast<color_t>(e[1]) << 8 | e[0] : 0xff000000;
+            }
+            bmp.kind = mcl_bmp_index;
+            return true;
+        }
+        if (bmp.bpp == 24) { bmp.kind = mcl_bmp_bgr; return true; }
+
+        // the bitfields follow a BITMAPINFOHEADER, or are part of the newer headers
+        color_t masks[4] = { 0x7c00, 0x3e0, 0x1f, 0 };
+        if (bmp.bpp == 32) { masks[0] = 0xff0000; masks[1] = 0xff00; masks[2] = 0xff; }
+        if (b_fields) {
+            size_t cnt = (hsize >= 56 || comp == 6) ? 4 : 3;
+            if (size - 14 < 40 + cnt * 4) return false;
+            for (size_t i = 0; i != 4; ++ i)
+                masks[i] = i < cnt ? mcl_bmp_rd32 (data + 54 + i * 4) : 0;
+        }
+        if (bmp.bpp == 32 && masks[0] == 0xff0000 && masks[1] == 0xff00 && masks[2] == 0xff) {
+            if (masks[3] == 0xff000000) { bmp.kind = mcl_bmp_bgra; return true; }
+            if (masks[3] == 0) { bmp.kind = mcl_bmp_bgrx; return true; }
+        }
+
+        // the highest 8 bits of each field, scaled to [0, 255]
+        bmp.kind = mcl_bmp_fields;
+        for (int k = 0; k != 4; ++ k) {
+            color_t m = masks[k];
+            if (!m) {
+                bmp.shift[k] = 0; bmp.mask[k] = 0;
+                bmp.scale[k][0] = static_cast<unsigned char>(k == 3 ? 0xff : 0);
+                continue;
+            }
+            int sh = 0, bits = 0;
+            while (!(m & 1)) { m >>= 1; ++ sh; }
+            while (bits < 32 && (m >> bits)) ++ bits;
+            // a field is one run of bits inside the pixel
+            color_t run = bits < 32 ? (static_cast<color_t>(1) << bits) - 1 : static_cast<color_t>(0xffffffff);
+            if (m != run || sh + bits > bmp.bpp) return false;
+            if (bits > 8) { sh += bits - 8; bits = 8; }
+            color_t mx = (static_cast<color_t>(1) << bits) - 1;
+            bmp.shift[k] = sh; bmp.mask[k] = mx;
+            for (color_t v = 0; v <= mx; ++ v)
+                bmp.scale[k][v] = static_cast<unsigned char>((v * 255 + (mx >> 1)) / mx);
+        }
+        return true;
+    }
+
+   /**
+    * @function mcl_bmp_row <cpp/image.cpp>
+    * @brief Expand a row of a BMP file into colors.
+    * @param {mcl_bmp_t const&} bmp
+    * @param {point1d_t} y: row from the top
+    * @param {color_t*} dst: bmp.width colors
+    * @return void
+    */
+    static void
+    mcl_bmp_row (mcl_bmp_t const& bmp, point1d_t y, color_t* dst) noexcept {
+        point1d_t w = bmp.width;
+        unsigned char const* src = bmp.bits + static_cast<size_t>(bmp.b_topdown ? y : bmp.height - 1 - y) * bmp.pitch;
+        switch (bmp.kind) {
+        case mcl_bmp_index:
+            if (bmp.bpp == 8) {
+                for (point1d_t x = 0; x != w; ++ x) dst[x] = bmp.palette[src[x]];
+            } else if (bmp.bpp == 4) {
+                for (point1d_t x = 0; x != w; ++ x)
+                    dst[x] = bmp.palette[(src[x >> 1] >> ((~x & 1) << 2)) & 0xf];
+            } else {
+                for (point1d_t x = 0; x != w; ++ x)
+                    dst[x] = bmp.palette[(src[x >> 3] >> (~x & 7)) & 1];
+            }
+            break;
+        case mcl_bmp_bgr: {
+            // four pixels as three words at a time
+            point1d_t n = w >> 2;
+            for (; n; -- n, src += 12, dst += 4) {
+                DWORD wd[3];
+                ::memcpy (wd, src, 12);
+                dst[0] = (wd[0] & 0xffffff) | 0xff000000;
+                dst[1] = (wd[0] >> 24 | (wd[1] & 0xffff) << 8) | 0xff000000;
+                dst[2] = (wd[1] >> 16 | (wd[2] & 0xff) << 16) | 0xff000000;
+                dst[3] = (wd[2] >> 8) | 0xff000000;
+            }
+            for (n = w & 3; n; -- n, src += 3)
+                *dst ++ = static_cast<color_t>(src[0]) | static_cast<color_t>(src[1]) << 8
+                    | static_cast<color_t>(src[2]) << 16 | 0xff000000;
+            break;
+        }
+        case mcl_bmp_bgrx: {
+            ::memcpy (dst, src, static_cast<size_t>(w) * 4u);
+            point1d_t x = 0;
+#ifdef MCL_SSE2
+            __m128i const opaque = _mm_set1_epi32 (static_cast<int>(0xff000000));
+            for (point1d_t n = w >> 2; n; -- n, x += 4) {
+                __m128i* p = reinterpret_cast<__m128i*>(dst + x);
+                _mm_storeu_si128 (p, _mm_or_si128 (_mm_loadu_si128 (p), opaque));
+            }
+#endif
+            for (; x != w; ++ x) dst[x] |= 0xff000000;
+            break;
+        }
+        case mcl_bmp_bgra:
+            ::memcpy (dst, src, static_cast<size_t>(w) * 4u);
+            break;
+        default: { // mcl_bmp_fields
+            bool b16 = bmp.bpp == 16;
+            for (point1d_t x = 0; x != w; ++ x) {
+                color_t px = b16 ? mcl_bmp_rd16 (src + x * 2) : mcl_bmp_rd32 (src + x * 4);
+                dst[x] = static_cast<color_t>(bmp.scale[0][(px >> bmp.shift[0]) & bmp.mask[0]]) << 16
+                       | static_cast<color_t>(bmp.scale[1][(px >> bmp.shift[1]) & bmp.mask[1]]) << 8
+                       | static_cast<color_t>(bmp.scale[2][(px >> bmp.shift[2]) & bmp.mask[2]])
+                       | static_cast<color_t>(bmp.scale[3][(px >> bmp.shift[3]) & bmp.mask[3]]) << 24;
+            }
+            break;
+        }
+        }
+    }
+
+    /**
+     * @function mcl_load_size <cpp/mcl_control.h>
+     * @brief get the size an image is loaded at
+     * @param src: size of the image in the file.
+     * @param size: size asked for. 0 keeps the width or height of the file.
+     * @return point2d_t
+     */
+    point2d_t
+    mcl_load_size (point2d_t src, point2d_t size) noexcept {
+        return point2d_t{ size.x > 0 ? size.x : src.x, size.y > 0 ? size.y : src.y };
+    }
+
+    /**
+     * @function mcl_rowscale_t::mcl_rowscale_t <cpp/mcl_control.h>
+     * @brief constructor. each pixel of the surface covers the columns
+     *    from x * src.x / dst.x to (x + 1) * src.x / dst.x, and at least
+     *    one, so integer ratios average whole blocks. nothing is
+     *    allocated for an empty size
+     * @param src: size of the image.
+     * @param pixels: the surface, dst.x * dst.y pixels.
+     * @param dst: size of the surface.
+     */
+    mcl_rowscale_t::
+    mcl_rowscale_t (point2d_t src, color_t* pixels, point2d_t dst) noexcept
+      : m_src (src), m_dst (dst), m_pixels (pixels), m_sums (nullptr), m_cols (nullptr) {
+        if (src.x <= 0 || src.y <= 0 || dst.x <= 0 || dst.y <= 0) return;
+        m_sums = new (std::nothrow) unsigned long long[static_cast<size_t>(dst.x) * 4];
+        m_cols = new (std::nothrow) point1d_t[static_cast<size_t>(dst.x) + 1];
+        if (!m_sums || !m_cols) return;
+        ::memset (m_sums, 0, static_cast<size_t>(dst.x) * 4 * sizeof (unsigned long long));
+        for (point1d_t x = 0; x <= dst.x; ++ x)
+            m_cols[x] = static_cast<point1d_t>(static_cast<long long>(x) * src.x / dst.x);
+    }
+
+    mcl_rowscale_t::
+    ~mcl_rowscale_t () noexcept {
+        delete[] m_sums;
+        delete[] m_cols;
+    }
+
+    /**
+     * @function mcl_rowscale_t::feed <cpp/mcl_control.h>
+     * @brief add the next row of the image. the rows of the
+     *    surface that end at it are written out
+     * @param row: src.x pixels.
+     * @return none
+     */
+    void mcl_rowscale_t::
+    feed (color_t const* row) noexcept {
+        if (m_dy == m_dst.y) return;
+        unsigned long long* s = m_sums;
+        for (point1d_t x = 0; x != m_dst.x; ++ x, s += 4) {
+            point1d_t i = m_cols[x], e = m_cols[x + 1] > i ? m_cols[x + 1] : i + 1;
+            unsigned long long b = 0, g = 0, r = 0, a = 0;
+            for (; i != e; ++ i) {
+                color_t c = row[i];
+                b += c & 0xff; g += (c >> 8) & 0xff; r += (c >> 16) & 0xff; a += c >> 24;
+            }
+            s[0] += b; s[1] += g; s[2] += r; s[3] += a;
+        }
+
+        // the rows of the surface are split like the columns
+        bool b_written = false;
+        for (; m_dy != m_dst.y; ++ m_dy) {
+            long long y0 = static_cast<long long>(m_dy) * m_src.y / m_dst.y;
+            long long y1 = static_cast<long long>(m_dy + 1) * m_src.y / m_dst.y;
+            if (y1 <= y0) y1 = y0 + 1;
+            if (y1 - 1 != m_sy) break;
+            color_t* dst = m_pixels + static_cast<size_t>(m_dy) * static_cast<size_t>(m_dst.x);
+            s = m_sums;
+            for (point1d_t x = 0; x != m_dst.x; ++ x, s += 4) {
+                point1d_t cw = m_cols[x + 1] > m_cols[x] ? m_cols[x + 1] - m_cols[x] : 1;
+                unsigned long long n = static_cast<unsigned long long>(cw) * static_cast<unsigned long long>(y1 - y0);
+                dst[x] = static_cast<color_t>((s[0] + n / 2) / n) | static_cast<color_t>((s[1] + n / 2) / n) << 8
+                       | static_cast<color_t>((s[2] + n / 2) / n) << 16 | static_cast<color_t>((s[3] + n / 2) / n) << 24;
+            }
+            b_written = true;
+        }
+        if (b_written)
+            ::memset (m_sums, 0, static_cast<size_t>(m_dst.x) * 4 * sizeof (unsigned long long));
+        ++ m_sy;
+    }
+
+   /**
+    * @function mcl_bmp_decode <cpp/image.cpp>
+    * @brief Decode a BMP file in memory into a new surface.
+    *     Colors without alpha are opaque.
+    * @param {unsigned char const*} data: the whole file
+    * @param {size_t} size
+    * @param {point2d_t} dst: size to scale to while decoding, see mcl_load_size
+    * @return surface_t: sf_nullptr if the file is not supported
+    */
+    static surface_t
+    mcl_bmp_decode (unsigned char const* data, size_t size, point2d_t dst = point2d_t{ 0, 0 }) noexcept {
+        mcl_bmp_t bmp;
+        if (!mcl_bmp_parse (data, size, bmp))
+            return sf_nullptr;
+        dst = mcl_load_size (point2d_t{ bmp.width, bmp.height }, dst);
+        surface_t surf (dst);
+        mcl_imagebuf_t* ibuf = mcl_get_surface_dataplus (&surf);
+        if (!ibuf || ibuf -> m_width != dst.x || ibuf -> m_height != dst.y)
+            return sf_nullptr;
+
+        if (dst.x != bmp.width || dst.y != bmp.height) {
+            // one row of the file at a time
+            mcl_rowscale_t scale (point2d_t{ bmp.width, bmp.height }, ibuf -> m_pbuffer, dst);
+            mcl_simpletls_ns::mcl_auto_ptr_t<color_t> line (static_cast<size_t>(bmp.width));
+            if (!scale || !line) return sf_nullptr;
+            for (point1d_t y = 0; y != bmp.height; ++ y) {
+                mcl_bmp_row (bmp, y, line);
+                scale.feed (line);
+            }
+            return surf;
+        }
+
+        // top-down 32-bit rows are copied as they are
+        mcl_bmp_t const* pb = &bmp;
+        color_t* pbuf = ibuf -> m_pbuffer;
+        point1d_t w = bmp.width;
+        mcl_parallel_obj.run (bmp.height, static_cast<size_t>(w) * static_cast<size_t>(bmp.height),
+        [=] (point1d_t ib, point1d_t ie) {
+            if (pb -> kind == mcl_bmp_bgra && pb -> b_topdown)
+                ::memcpy (pbuf + ib * w, pb -> bits + static_cast<size_t>(ib) * pb -> pitch,
+                    static_cast<size_t>(ie - ib) * pb -> pitch);
+            else for (point1d_t y = ib; y != ie; ++ y)
+                mcl_bmp_row (*pb, y, pbuf + y * w);
+        });
+        return surf;
+    }
+
+   /**
+    * @function mcl_qoi_decode <cpp/image.cpp>
+    * @brief Decode a QOI file in memory straight into a new
+    *     surface, in a single pass over the ops.
+    * @param {unsigned char const*} data: the whole file
+    * @param {size_t} size
+    * @param {point2d_t} dst: size to scale to while decoding, see mcl_load_size
+    * @return surface_t: sf_nullptr if the file is broken
+    */
+    static surface_t
+    mcl_qoi_decode (unsigned char const* data, size_t size, point2d_t dst = point2d_t{ 0, 0 }) noexcept {
+        if (size < 14 + 8 || ::memcmp (data, "qoif", 4) || (data[12] != 3 && data[12] != 4))
+            return sf_nullptr;
+        unsigned long long w = static_cast<unsigned long long>(data[4]) << 24 | static_cast<unsigned long long>(data[5]) << 16
+                             | static_cast<unsigned long long>(data[6]) << 8  | data[7];
+        unsigned long long h = static_cast<unsigned long long>(data[8]) << 24 | static_cast<unsigned long long>(data[9]) << 16
+                             | static_cast<unsigned long long>(data[10]) << 8 | data[11];
+        // a byte holds at most 62 pixels, so a short file cannot ask for a huge surface
+        if (!w || !h || w > 0x7fffffff || h > 0x7fffffff || w * h / 62 > size)
+            return sf_nullptr;
+        point2d_t src{ static_cast<point1d_t>(w), static_cast<point1d_t>(h) };
+        dst = mcl_load_size (src, dst);
+        surface_t surf (dst, data[12] == 4 ? surface_t::SrcAlpha : 0);
+        mcl_imagebuf_t* ibuf = mcl_get_surface_dataplus (&surf);
+        if (!ibuf || ibuf -> m_width != dst.x || ibuf -> m_height != dst.y)
+            return sf_nullptr;
+
+        // a scaled image is decoded a row at a time, otherwise all at once
+        bool b_scale = dst.x != src.x || dst.y != src.y;
+        mcl_rowscale_t scale (src, ibuf -> m_pbuffer, b_scale ? dst : point2d_t{ 0, 0 });
+        mcl_simpletls_ns::mcl_auto_ptr_t<color_t> line (b_scale ? static_cast<size_t>(w) : 0);
+        if (b_scale && (!scale || !line)) return sf_nullptr;
+        color_t* out = b_scale ? line : ibuf -> m_pbuffer;
+        size_t seg = b_scale ? static_cast<size_t>(w) : static_cast<size_t>(w * h);
+
+        // the ops read at most 5 bytes, and the file ends with 8 bytes of padding
+        unsigned char const* p = data + 14, *end = data + size - 8;
+        color_t index[64];
+        ::memset (index, 0, sizeof (index));
+        unsigned r = 0, g = 0, b = 0, a = 255;
+        color_t px = 0xff000000;
+        size_t run = 0;
+        for (point1d_t y = b_scale ? src.y : 1; y; -- y) {
+            color_t* pdst = out, *pdst_end = out + seg;
+            while (pdst != pdst_end) {
+                if (run) { // QOI_OP_RUN, which may go on into the next row
+                    size_t n = run < static_cast<size_t>(pdst_end - pdst) ? run : static_cast<size_t>(pdst_end - pdst);
+                    for (run -= n; n; -- n) *pdst ++ = px;
+                    continue;
+                }
+                if (p >= end) return sf_nullptr;
+                unsigned op = *p ++;
+                if (op < 0x40) { // QOI_OP_INDEX
+                    px = index[op];
+                    r = (px >> 16) & 0xff; g = (px >> 8) & 0xff; b = px & 0xff; a = px >> 24;
+                    *pdst ++ = px;
+                    continue;
+                }
+                if (op >= 0xc0 && op < 0xfe) {
+                    run = op - 0xbf;
+                    continue;
+                }
+                if (op == 0xfe) { r = p[0]; g = p[1]; b = p[2]; p += 3; }
+                else if (op == 0xff) { r = p[0]; g = p[1]; b = p[2]; a = p[3]; p += 4; }
+                else if (op < 0x80) { // QOI_OP_DIFF
+                    r = (r + ((op >> 4) & 3) - 2) & 0xff;
+                    g = (g + ((op >> 2) & 3) - 2) & 0xff;
+                    b = (b + (op & 3) - 2) & 0xff;
+                } else { // QOI_OP_LUMA
+                    unsigned dg = (op & 0x3f) - 32, rb = *p ++;
+                    r = (r + dg + (rb >> 4) - 8) & 0xff;
+                    g = (g + dg) & 0xff;
+                    b = (b + dg + (rb & 15) - 8) & 0xff;
+                }
+                px = static_cast<color_t>(a) << 24 | static_cast<color_t>(r) << 16 | static_cast<color_t>(g) << 8 | b;
+                index[(r * 3 + g * 5 + b * 7 + a * 11) & 63] = px;
+                *pdst ++ = px;
+            }
+            if (b_scale) scale.feed (out);
+        }
+        // a run must not go past the last pixel
+        return run ? sf_nullptr : surf;
+    }
+
     /**
      * @function mcl_image_t::load <src/surface.cpp>
      * @brief load new image from a file.
@@ -116,6 +544,30 @@ mcl {
             else if (lpFileExt[1] == 'C' || lpFileExt[1] == 'c') type = IMAGE_CURSOR;
         }
 
+        // Decode PNG, QOI and bitmaps from a view of the file, scaled
+        // while decoding, and leave compressed or broken bitmaps to LoadImageW
+        if (type == IMAGE_BITMAP) {
+            mcl_simpletls_ns::mcl_mapfile_t file (filename);
+            if (!!file) {
+                if (file.size () >= 8 && !::memcmp (file.data (), "\x89PNG\r\n\x1a\n", 8)) {
+                    surface_t surf = mcl_png_decode (file.data (), file.size (), size);
+                    if (!surf)
+                        clog4m[cll4m.Info] << L"info:  Failed to decode png file \'"
+                            << filename << L"\' [-WImage-loadpng]\n";
+                    return surf;
+                }
+                if (file.size () >= 4 && !::memcmp (file.data (), "qoif", 4)) {
+                    surface_t surf = mcl_qoi_decode (file.data (), file.size (), size);
+                    if (!surf)
+                        clog4m[cll4m.Info] << L"info:  Failed to decode qoi file \'"
+                            << filename << L"\' [-WImage-loadqoi]\n";
+                    return surf;
+                }
+                surface_t surf = mcl_bmp_decode (file.data (), file.size (), size);
+                if (surf) return surf;
+            }
+        }
+
         // Load the image from file
         HANDLE hhandle = ::LoadImageW (nullptr, filename,
             type, size.x, size.y, LR_LOADFROMFILE);
@@ -209,14 +661,15 @@ mcl {
      * @brief save an image to file.
      * @param surface: surface to save.
      * @param filename: name to the image file.
+     * @param b_bgra: write 32-bit pixels as they are stored.
      * @return bool
      */
     bool mcl_image_t::
-    save (surface_t const& surface, char const* filename) noexcept{
+    save (surface_t const& surface, char const* filename, bool b_bgra) noexcept{
         if (!filename)
             return false;
         mcl_simpletls_ns::mcl_m2w_str_t wstr(filename);
-        return save (surface, static_cast<wchar_t*>(wstr));
+        return save (surface, static_cast<wchar_t*>(wstr), b_bgra);
     }
 
     /**
@@ -224,26 +677,66 @@ mcl {
      * @brief save an image to file.
      * @param surface: surface to save.
      * @param filename: name to the image file.
+     * @param b_bgra: write 32-bit pixels as they are stored.
      * @return bool
      */
     bool mcl_image_t::
-    save (surface_t const& surface, wchar_t const* filename) noexcept{
+    save (surface_t const& surface, wchar_t const* filename, bool b_bgra) noexcept{
+        if (!filename)
+            return false;
+
+        // Files named *.png and *.qoi are written in those formats
+        wchar_t lpFileExt[_MAX_EXT];
+        if (!MCL_WGETFILEEXT(filename, lpFileExt) && lpFileExt[0] && lpFileExt[1]
+            && lpFileExt[2] && lpFileExt[3] && !lpFileExt[4]) {
+            wchar_t ext[3] = { static_cast<wchar_t>(lpFileExt[1] | 0x20),
+                static_cast<wchar_t>(lpFileExt[2] | 0x20), static_cast<wchar_t>(lpFileExt[3] | 0x20) };
+            if (ext[0] == 'p' && ext[1] == 'n' && ext[2] == 'g') return save_png (surface, filename);
+            if (ext[0] == 'q' && ext[1] == 'o' && ext[2] == 'i') return save_qoi (surface, filename);
+        }
+
         FILE* fp = nullptr;
         MCL_WFOPEN (fp, filename, L"wb");
-        bool ret = save (surface, fp);
+        bool ret = save (surface, fp, b_bgra);
         if (fp) fclose (fp);
         return ret;
     }
 
+   /**
+    * @function mcl_bgr_row <cpp/image.cpp>
+    * @brief Pack a row of colors into 24-bit BGR bytes,
+    *     four pixels as three words at a time.
+    * @return void
+    */
+    static void
+    mcl_bgr_row (unsigned char* dst, color_t const* src, point1d_t w) noexcept{
+        for (point1d_t n = w >> 2; n; -- n, src += 4, dst += 12) {
+            DWORD c0 = static_cast<DWORD>(src[0]), c1 = static_cast<DWORD>(src[1]),
+                  c2 = static_cast<DWORD>(src[2]), c3 = static_cast<DWORD>(src[3]);
+            DWORD wd[3] = {
+                (c0 & 0xffffff) | (c1 << 24),
+                ((c1 >> 8) & 0xffff) | (c2 << 16),
+                ((c2 >> 16) & 0xff) | (c3 << 8)
+            };
+            ::memcpy (dst, wd, 12);
+        }
+        for (point1d_t n = w & 3; n; -- n, ++ src, dst += 3) {
+            dst[0] = static_cast<unsigned char>(*src);
+            dst[1] = static_cast<unsigned char>(*src >> 8);
+            dst[2] = static_cast<unsigned char>(*src >> 16);
+        }
+    }
+
     /**
      * @function mcl_image_t::save <src/surface.cpp>
      * @brief save an image to file.
      * @param surface: surface to save.
      * @param fileobj: cpp file-like object.
+     * @param b_bgra: write 32-bit pixels as they are stored.
      * @return bool
      */
     bool mcl_image_t::
-    save (surface_t const& surface, FILE* fileobj) noexcept{
+    save (surface_t const& surface, FILE* fileobj, bool b_bgra) noexcept{
         if (!(fileobj && &surface)) return false;
 
         // Get image data
@@ -253,46 +746,436 @@ mcl {
 
         mcl_simpletls_ns::mcl_spinlock_t lk(ibuf -> m_nrtlock, L"mcl_image_t::save");
         if (!ibuf -> m_width) return false;
+        point1d_t w = ibuf -> m_width, h = ibuf -> m_height;
 
         // Write bmp header
         BITMAPFILEHEADER bmpfHead = { 0, 0, 0, 0, 0 };
         BITMAPINFOHEADER bmpinfo = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-        size_t pitch = static_cast<size_t>(ibuf -> m_width) * 3;
-        size_t addbit = 4 - (pitch & 3), zero = 0;
-        if (pitch & 3) pitch = ((pitch + 4) & ~3);
-        else addbit = 0;
+        BITMAPV4HEADER bmpv4;
+        ::memset (&bmpv4, 0, sizeof (bmpv4));
+        size_t pitch = static_cast<size_t>(w) * (b_bgra ? 4 : 3);
+        pitch = (pitch + 3) & ~static_cast<size_t>(3);
+        DWORD infosize = b_bgra ? sizeof (BITMAPV4HEADER) : sizeof (BITMAPINFOHEADER);
 
         char bmpfHead_str[3] = { 'B', 'M', 0 };
         bmpfHead.bfType = *reinterpret_cast<WORD*>(bmpfHead_str);
-        bmpfHead.bfOffBits = sizeof (BITMAPFILEHEADER) + sizeof (BITMAPINFOHEADER);
-        bmpfHead.bfSize = static_cast<DWORD>(sizeof (BITMAPFILEHEADER)
-            + sizeof (BITMAPINFOHEADER))+ static_cast<DWORD>(pitch) * ibuf -> m_height;
-        bmpinfo.biSize = sizeof (BITMAPINFOHEADER);
-        bmpinfo.biBitCount = 24;
-        bmpinfo.biHeight = ibuf -> m_height;
-        bmpinfo.biWidth = ibuf -> m_width;
-        bmpinfo.biPlanes = 1;
-        bmpinfo.biSizeImage = static_cast<DWORD>(pitch) * ibuf -> m_height;
+        bmpfHead.bfOffBits = sizeof (BITMAPFILEHEADER) + infosize;
+        bmpfHead.bfSize = static_cast<DWORD>(sizeof (BITMAPFILEHEADER) + infosize)
+            + static_cast<DWORD>(pitch) * h;
+        if (b_bgra) {
+            // bitfields keep the alpha channel only if the surface has one
+            bmpv4.bV4Size = sizeof (BITMAPV4HEADER);
+            bmpv4.bV4BitCount = 32;
+            bmpv4.bV4Height = h;
+            bmpv4.bV4Width = w;
+            bmpv4.bV4Planes = 1;
+            bmpv4.bV4V4Compression = BI_BITFIELDS;
+            bmpv4.bV4SizeImage = static_cast<DWORD>(pitch) * h;
+            bmpv4.bV4RedMask = 0xff0000;
+            bmpv4.bV4GreenMask = 0xff00;
+            bmpv4.bV4BlueMask = 0xff;
+            if (mcl_get_surface_data (&const_cast<surface_t&>(surface))[0] & surface_t::SrcAlpha)
+                bmpv4.bV4AlphaMask = 0xff000000;
+            bmpv4.bV4CSType = LCS_sRGB;
+        } else {
+            bmpinfo.biSize = sizeof (BITMAPINFOHEADER);
+            bmpinfo.biBitCount = 24;
+            bmpinfo.biHeight = h;
+            bmpinfo.biWidth = w;
+            bmpinfo.biPlanes = 1;
+            bmpinfo.biSizeImage = static_cast<DWORD>(pitch) * h;
+        }
 
         // Create a file
-        ::fwrite (&bmpfHead, sizeof(bmpfHead), 1, fileobj);
-        ::fwrite (&bmpinfo, sizeof(bmpinfo), 1, fileobj);
-
-        // Write image data
-        point1d_t x = 0, y = 0;
-        for (y = ibuf -> m_height - 1; y >= 0; -- y) {
-            for (x = 0; x < ibuf -> m_width; ++ x) {
-                DWORD col = ibuf -> m_pbuffer[y * ibuf -> m_width + x];
-                size_t ret = ::fwrite (&col, 3, 1, fileobj);
-                if (!ret) {
-                    ::fclose (fileobj);
+        if (!::fwrite (&bmpfHead, sizeof(bmpfHead), 1, fileobj))
+            return false;
+        if (!(b_bgra ? ::fwrite (&bmpv4, sizeof(bmpv4), 1, fileobj)
+            : ::fwrite (&bmpinfo, sizeof(bmpinfo), 1, fileobj)))
+            return false;
+
+        // Write image data, bottom-up. 32-bit rows need no conversion
+        if (b_bgra) {
+            for (point1d_t y = h - 1; y >= 0; -- y)
+                if (!::fwrite (ibuf -> m_pbuffer + y * w, pitch, 1, fileobj))
                     return false;
+            return true;
+        }
+
+        // Pack a band of rows at a time and write it at once
+        size_t band = (static_cast<size_t>(1) << 18) / pitch;
+        if (!band) band = 1;
+        if (band > static_cast<size_t>(h)) band = static_cast<size_t>(h);
+        mcl_simpletls_ns::mcl_auto_ptr_t<unsigned char> rows (band * pitch);
+        if (!rows) return false;
+        for (size_t i = 0; i != band; ++ i) // the padding stays zero
+            ::memset (rows + i * pitch + pitch - 4, 0, 4);
+        for (point1d_t y = h - 1; y >= 0; ) {
+            size_t n = 0;
+            for (; n != band && y >= 0; ++ n, -- y)
+                mcl_bgr_row (rows + n * pitch, ibuf -> m_pbuffer + y * w, w);
+            if (::fwrite (rows, pitch, n, fileobj) != n)
+                return false;
+        }
+        return true;
+    }
+
+    /**
+     * @function mcl_image_t::save_png <src/surface.cpp>
+     * @brief save an image to a PNG file.
+     * @param surface: surface to save.
+     * @param filename: name to the image file.
+     * @param level: compression level, 0 (none) to 9 (smallest).
+     * @return bool
+     */
+    bool mcl_image_t::
+    save_png (surface_t const& surface, char const* filename, int level) noexcept{
+        if (!filename)
+            return false;
+        mcl_simpletls_ns::mcl_m2w_str_t wstr(filename);
+        return save_png (surface, static_cast<wchar_t*>(wstr), level);
+    }
+
+    /**
+     * @function mcl_image_t::save_png <src/surface.cpp>
+     * @brief save an image to a PNG file.
+     * @param surface: surface to save.
+     * @param filename: name to the image file.
+     * @param level: compression level, 0 (none) to 9 (smallest).
+     * @return bool
+     */
+    bool mcl_image_t::
+    save_png (surface_t const& surface, wchar_t const* filename, int level) noexcept{
+        FILE* fp = nullptr;
+        MCL_WFOPEN (fp, filename, L"wb");
+        bool ret = save_png (surface, fp, level);
+        if (fp) fclose (fp);
+        return ret;
+    }
+
+    /**
+     * @function mcl_image_t::save_png <src/surface.cpp>
+     * @brief save an image to a PNG file. surfaces with
+     *    SrcAlpha are written as RGBA, others as RGB.
+     * @param surface: surface to save.
+     * @param fileobj: cpp file-like object.
+     * @param level: compression level, 0 (none) to 9 (smallest).
+     * @return bool
+     */
+    bool mcl_image_t::
+    save_png (surface_t const& surface, FILE* fileobj, int level) noexcept{
+        return mcl_png_encode (surface, fileobj, level);
+    }
+
+    /**
+     * @function mcl_image_t::save_qoi <src/surface.cpp>
+     * @brief save an image to a QOI file.
+     * @param surface: surface to save.
+     * @param filename: name to the image file.
+     * @return bool
+     */
+    bool mcl_image_t::
+    save_qoi (surface_t const& surface, char const* filename) noexcept{
+        if (!filename)
+            return false;
+        mcl_simpletls_ns::mcl_m2w_str_t wstr(filename);
+        return save_qoi (surface, static_cast<wchar_t*>(wstr));
+    }
+
+    /**
+     * @function mcl_image_t::save_qoi <src/surface.cpp>
+     * @brief save an image to a QOI file.
+     * @param surface: surface to save.
+     * @param filename: name to the image file.
+     * @return bool
+     */
+    bool mcl_image_t::
+    save_qoi (surface_t const& surface, wchar_t const* filename) noexcept{
+        FILE* fp = nullptr;
+        MCL_WFOPEN (fp, filename, L"wb");
+        bool ret = save_qoi (surface, fp);
+        if (fp) fclose (fp);
+        return ret;
+    }
+
+    /**
+     * @function mcl_image_t::save_qoi <src/surface.cpp>
+     * @brief save an image to a QOI file. surfaces with SrcAlpha
+     *    or a colorkey are written with 4 channels, others with 3.
+     * @param surface: surface to save.
+     * @param fileobj: cpp file-like object.
+     * @return bool
+     */
+    bool mcl_image_t::
+    save_qoi (surface_t const& surface, FILE* fileobj) noexcept{
+        if (!fileobj) return false;
+        mcl_imagebuf_t* ibuf =
+            mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        if (!ibuf) return false;
+        char flags = mcl_get_surface_data (&const_cast<surface_t&>(surface))[0];
+
+        mcl_simpletls_ns::mcl_spinlock_t lk(ibuf -> m_nrtlock, L"mcl_image_t::save_qoi");
+        if (!ibuf -> m_width) return false;
+        point1d_t w = ibuf -> m_width, h = ibuf -> m_height;
+        bool b_alpha = (flags & surface_t::SrcAlpha) != 0;
+        bool b_key = !b_alpha && (flags & surface_t::SrcColorKey);
+        color_t key = ibuf -> m_colorkey & 0xffffff;
+
+        // Ops are gathered in a buffer and written 64 KB at a time
+        size_t const bufsize = 65536;
+        mcl_simpletls_ns::mcl_auto_ptr_t<unsigned char> outbuf (bufsize);
+        if (!outbuf) return false;
+        unsigned char* out = outbuf, *o = out, *o_end = out + bufsize - 8;
+        unsigned char hdr[14] = { 'q', 'o', 'i', 'f',
+            static_cast<unsigned char>(w >> 24), static_cast<unsigned char>(w >> 16),
+            static_cast<unsigned char>(w >> 8), static_cast<unsigned char>(w),
+            static_cast<unsigned char>(h >> 24), static_cast<unsigned char>(h >> 16),
+            static_cast<unsigned char>(h >> 8), static_cast<unsigned char>(h),
+            static_cast<unsigned char>(b_alpha || b_key ? 4 : 3), 0 };
+        ::memcpy (o, hdr, 14); o += 14;
+
+        color_t index[64];
+        ::memset (index, 0, sizeof (index));
+        color_t prev = 0xff000000;
+        unsigned run = 0;
+        for (color_t const* src = ibuf -> m_pbuffer, *src_end = src + static_cast<size_t>(w) * static_cast<size_t>(h);
+            src != src_end; ++ src) {
+            // colors without alpha are opaque, and the colorkey is clear
+            color_t px = *src;
+            if (b_key) px = (px & 0xffffff) == key ? key : (px | 0xff000000);
+            else if (!b_alpha) px |= 0xff000000;
+
+            if (px == prev) {
+                if (++ run == 62) { *o ++ = 0xfd; run = 0; }
+                if (o >= o_end) {
+                    if (!::fwrite (out, static_cast<size_t>(o - out), 1, fileobj)) return false;
+                    o = out;
+                }
+                continue;
+            }
+            if (run) { *o ++ = static_cast<unsigned char>(0xbf + run); run = 0; }
+
+            unsigned r = (px >> 16) & 0xff, g = (px >> 8) & 0xff, b = px & 0xff, a = px >> 24;
+            unsigned hash = (r * 3 + g * 5 + b * 7 + a * 11) & 63;
+            if (index[hash] == px) *o ++ = static_cast<unsigned char>(hash);
+            else {
+                index[hash] = px;
+                if ((px ^ prev) >> 24) {
+                    o[0] = 0xff; o[1] = static_cast<unsigned char>(r); o[2] = static_cast<unsigned char>(g);
+                    o[3] = static_cast<unsigned char>(b); o[4] = static_cast<unsigned char>(a);
+                    o += 5;
+                } else {
+                    int dr = static_cast<signed char>(static_cast<unsigned char>(r - ((prev >> 16) & 0xff)));
+                    int dg = static_cast<signed char>(static_cast<unsigned char>(g - ((prev >> 8) & 0xff)));
+                    int db = static_cast<signed char>(static_cast<unsigned char>(b - (prev & 0xff)));
+                    int dr_dg = dr - dg, db_dg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                        *o ++ = static_cast<unsigned char>(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                        o[0] = static_cast<unsigned char>(0x80 | (dg + 32));
+                        o[1] = static_cast<unsigned char>((dr_dg + 8) << 4 | (db_dg + 8));
+                        o += 2;
+                    } else {
+                        o[0] = 0xfe; o[1] = static_cast<unsigned char>(r);
+                        o[2] = static_cast<unsigned char>(g); o[3] = static_cast<unsigned char>(b);
+                        o += 4;
+                    }
                 }
             }
-            if (addbit)
-                ::fwrite (&zero, addbit, 1, fileobj);
+            prev = px;
+            if (o >= o_end) {
+                if (!::fwrite (out, static_cast<size_t>(o - out), 1, fileobj)) return false;
+                o = out;
+            }
         }
-        return true;
+        if (run) *o ++ = static_cast<unsigned char>(0xbf + run);
+
+        // End marker
+        static unsigned char const padding[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+        ::memcpy (o, padding, 8); o += 8;
+        return ::fwrite (out, static_cast<size_t>(o - out), 1, fileobj) == 1;
+    }
+
+   /**
+    * @function mcl_swizzle32 <cpp/image.cpp>
+    * @brief Move pixels between the native layout and another 4-byte
+    *     layout: mode 0 copies, 1 swaps red and blue, 2 reverses the
+    *     bytes. Each is its own inverse. alpha is or-ed into the result.
+    * @return void
+    */
+    static void
+    mcl_swizzle32 (unsigned char* dst, unsigned char const* src, point1d_t n, int mode, DWORD alpha) noexcept{
+        point1d_t i = 0;
+#ifdef MCL_SSE2
+        __m128i const a  = _mm_set1_epi32 (static_cast<int>(alpha));
+        __m128i const rb = _mm_set1_epi32 (0x00ff00ff);
+        for (point1d_t k = n >> 2; k; -- k, i += 4) {
+            __m128i x = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(src + i * 4));
+            if (mode == 1) {
+                // 00RR00BB -> 00BB00RR by swapping the 16-bit halves
+                __m128i t = _mm_and_si128 (x, rb);
+                t = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (t, 0xb1), 0xb1);
+                x = _mm_or_si128 (_mm_andnot_si128 (rb, x), t);
+            } else if (mode == 2) {
+                x = _mm_or_si128 (_mm_slli_epi16 (x, 8), _mm_srli_epi16 (x, 8));
+                x = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (x, 0xb1), 0xb1);
+            }
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(dst + i * 4), _mm_or_si128 (x, a));
+        }
+#endif
+        for (; i != n; ++ i) {
+            DWORD x;
+            ::memcpy (&x, src + i * 4, 4);
+            if (mode == 1) x = (x & 0xff00ff00) | ((x >> 16) & 0xff) | ((x & 0xff) << 16);
+            else if (mode == 2) x = (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24);
+            x |= alpha;
+            ::memcpy (dst + i * 4, &x, 4);
+        }
+    }
+
+   /**
+    * @function mcl_rgb_row <cpp/image.cpp>
+    * @brief Pack a row of colors into 24-bit RGB bytes,
+    *     four pixels as three words at a time.
+    * @return void
+    */
+    static void
+    mcl_rgb_row (unsigned char* dst, color_t const* src, point1d_t w) noexcept{
+        DWORD c[4];
+        for (point1d_t n = w >> 2; n; -- n, src += 4, dst += 12) {
+            for (int k = 0; k != 4; ++ k) {
+                DWORD x = static_cast<DWORD>(src[k]);
+                c[k] = ((x >> 16) & 0xff) | (x & 0xff00) | ((x & 0xff) << 16);
+            }
+            DWORD wd[3] = {
+                (c[0] & 0xffffff) | (c[1] << 24),
+                ((c[1] >> 8) & 0xffff) | (c[2] << 16),
+                ((c[2] >> 16) & 0xff) | (c[3] << 8)
+            };
+            ::memcpy (dst, wd, 12);
+        }
+        for (point1d_t n = w & 3; n; -- n, ++ src, dst += 3) {
+            dst[0] = static_cast<unsigned char>(*src >> 16);
+            dst[1] = static_cast<unsigned char>(*src >> 8);
+            dst[2] = static_cast<unsigned char>(*src);
+        }
+    }
+
+   /**
+    * @function mcl_rgb_unpack <cpp/image.cpp>
+    * @brief Unpack a row of 24-bit RGB bytes into opaque colors,
+    *     three words into four pixels at a time.
+    * @return void
+    */
+    static void
+    mcl_rgb_unpack (color_t* dst, unsigned char const* src, point1d_t w) noexcept{
+        for (point1d_t n = w >> 2; n; -- n, src += 12, dst += 4) {
+            DWORD wd[3];
+            ::memcpy (wd, src, 12);
+            DWORD c[4] = {
+                wd[0] & 0xffffff,
+                (wd[0] >> 24) | ((wd[1] & 0xffff) << 8),
+                (wd[1] >> 16) | ((wd[2] & 0xff) << 16),
+                wd[2] >> 8
+            };
+            for (int k = 0; k != 4; ++ k)
+                dst[k] = 0xff000000 | ((c[k] & 0xff) << 16) | (c[k] & 0xff00) | ((c[k] >> 16) & 0xff);
+        }
+        for (point1d_t n = w & 3; n; -- n, ++ dst, src += 3)
+            *dst = 0xff000000 | static_cast<color_t>(src[0]) << 16
+                 | static_cast<color_t>(src[1]) << 8 | src[2];
+    }
+
+    /**
+     * @function mcl_image_t::tobytes <src/image.h>
+     * @brief get the pixels of a surface in a byte layout.
+     * @param surface: surface to read.
+     * @param format: mcl_bytefmt_t, with Flipped for bottom-up rows.
+     * @param bytes: buffer of width * height * 3 (RGB) or 4 bytes.
+     * @return void const*: the surface memory for BGRA that is not
+     *    flipped, bytes otherwise. nullptr on failure. alpha is 255
+     *    in bytes for surfaces without SrcAlpha, but undefined in
+     *    the surface memory.
+     */
+    void const* mcl_image_t::
+    tobytes (surface_t const& surface, bytefmt_t format, void* bytes) noexcept{
+        mcl_imagebuf_t* ibuf =
+            mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        bytefmt_t layout = format & ~mcl_bytefmt_t::Flipped;
+        if (!ibuf || layout > mcl_bytefmt_t::ARGB) return nullptr;
+
+        mcl_simpletls_ns::mcl_spinlock_t lk(ibuf -> m_nrtlock, L"mcl_image_t::tobytes");
+        if (!ibuf -> m_width) return nullptr;
+        if (format == mcl_bytefmt_t::BGRA) return ibuf -> m_pbuffer;
+        if (!bytes) return nullptr;
+
+        point1d_t w = ibuf -> m_width, h = ibuf -> m_height;
+        color_t const* pbuf = ibuf -> m_pbuffer;
+        unsigned char* out = static_cast<unsigned char*>(bytes);
+        size_t pitch = static_cast<size_t>(w) * (layout == mcl_bytefmt_t::RGB ? 3 : 4);
+        bool b_flip = (format & mcl_bytefmt_t::Flipped) != 0;
+        int mode = layout == mcl_bytefmt_t::ARGB ? 2 : layout == mcl_bytefmt_t::BGRA ? 0 : 1;
+        // the top byte is only alpha with SrcAlpha. ARGB has it in the first byte
+        bool b_alpha = (mcl_get_surface_data (&const_cast<surface_t&>(surface))[0] & surface_t::SrcAlpha)
+            && layout != mcl_bytefmt_t::RGBX;
+        DWORD alpha = b_alpha ? 0 : layout == mcl_bytefmt_t::ARGB ? 0xff : 0xff000000;
+        mcl_parallel_obj.run (h, static_cast<size_t>(w) * static_cast<size_t>(h),
+        [=] (point1d_t ib, point1d_t ie) {
+            for (point1d_t y = ib; y != ie; ++ y) {
+                color_t const* src = pbuf + (b_flip ? h - 1 - y : y) * w;
+                if (layout == mcl_bytefmt_t::RGB)
+                    mcl_rgb_row (out + static_cast<size_t>(y) * pitch, src, w);
+                else
+                    mcl_swizzle32 (out + static_cast<size_t>(y) * pitch,
+                        reinterpret_cast<unsigned char const*>(src), w, mode, alpha);
+            }
+        });
+        return bytes;
+    }
+
+    /**
+     * @function mcl_image_t::frombytes <src/image.h>
+     * @brief create a new surface from pixels in a byte layout.
+     *    layouts with alpha give a surface with SrcAlpha.
+     * @param bytes: width * height * 3 (RGB) or 4 bytes.
+     * @param size: size of the surface.
+     * @param format: mcl_bytefmt_t, with Flipped for bottom-up rows.
+     * @return surface_t
+     */
+    surface_t mcl_image_t::
+    frombytes (void const* bytes, point2d_t size, bytefmt_t format) noexcept{
+        bytefmt_t layout = format & ~mcl_bytefmt_t::Flipped;
+        if (!bytes || size.x <= 0 || size.y <= 0 || layout > mcl_bytefmt_t::ARGB)
+            return sf_nullptr;
+        bool b_alpha = layout != mcl_bytefmt_t::RGB && layout != mcl_bytefmt_t::RGBX;
+        surface_t surf (size, b_alpha ? surface_t::SrcAlpha : 0);
+        mcl_imagebuf_t* ibuf = mcl_get_surface_dataplus (&surf);
+        if (!ibuf || ibuf -> m_width != size.x || ibuf -> m_height != size.y)
+            return sf_nullptr;
+
+        point1d_t w = size.x, h = size.y;
+        color_t* pbuf = ibuf -> m_pbuffer;
+        unsigned char const* in = static_cast<unsigned char const*>(bytes);
+        size_t pitch = static_cast<size_t>(w) * (layout == mcl_bytefmt_t::RGB ? 3 : 4);
+        bool b_flip = (format & mcl_bytefmt_t::Flipped) != 0;
+        int mode = layout == mcl_bytefmt_t::ARGB ? 2 : layout == mcl_bytefmt_t::BGRA ? 0 : 1;
+        DWORD alpha = layout == mcl_bytefmt_t::RGBX ? 0xff000000 : 0;
+        mcl_parallel_obj.run (h, static_cast<size_t>(w) * static_cast<size_t>(h),
+        [=] (point1d_t ib, point1d_t ie) {
+            if (layout == mcl_bytefmt_t::BGRA && !b_flip) {
+                ::memcpy (pbuf + ib * w, in + static_cast<size_t>(ib) * pitch,
+                    static_cast<size_t>(ie - ib) * pitch);
+                return ;
+            }
+            for (point1d_t y = ib; y != ie; ++ y) {
+                color_t* dst = pbuf + (b_flip ? h - 1 - y : y) * w;
+                if (layout == mcl_bytefmt_t::RGB)
+                    mcl_rgb_unpack (dst, in + static_cast<size_t>(y) * pitch, w);
+                else
+                    mcl_swizzle32 (reinterpret_cast<unsigned char*>(dst),
+                        in + static_cast<size_t>(y) * pitch, w, mode, alpha);
+            }
+        });
+        return surf;
     }
 
     /**
@@ -350,5 +1233,1467 @@ mcl {
         if (refdc) ::ReleaseDC (mcl_control_obj.hwnd, refdc);
         return surf;
     }
-    
+
+   /**
+    * @class mcl_loadtask_t <cpp/image.cpp>
+    * @brief An image loaded by image.load_async. It is shared
+    *     by the loadtask_t and the worker until both let go.
+    */
+    struct
+    mcl_loadtask_t {
+        LONG volatile   m_refs      = 2;
+        LONG volatile   m_done      = 0;
+        HANDLE          m_event     = nullptr;  // manual-reset, set when done
+        mcl_loadtask_t* m_next      = nullptr;
+        wchar_t*        m_filename  = nullptr;
+        eventtype_t     m_eventtype = 0;
+        void*           m_code      = nullptr;
+        surface_t       m_surface;
+
+        ~mcl_loadtask_t () noexcept{
+            if (m_event) ::CloseHandle (m_event);
+            delete[] m_filename;
+        }
+        void release () noexcept{
+            if (!::InterlockedDecrement (&m_refs)) delete this;
+        }
+    };
+
+   /**
+    * @class mcl_loader_t <cpp/image.cpp>
+    * @brief A few worker threads that load images for
+    *     image.load_async, in the order they were asked for.
+    */
+    class
+    mcl_loader_t {
+    public:
+        mcl_loader_t () noexcept = default;
+        ~mcl_loader_t () noexcept;
+        mcl_loader_t (mcl_loader_t const&) = delete;
+        mcl_loader_t& operator= (mcl_loader_t const&) = delete;
+
+        // queue a task and make sure a worker will take it
+        bool push (mcl_loadtask_t* task) noexcept;
+
+    private:
+        static unsigned __stdcall worker_proc (void* param);
+        mcl_loadtask_t* pop () noexcept;
+
+    private:
+        // decoding is mostly memory bound, so a few threads are enough
+        static unsigned long constexpr max_workers = 4ul;
+        HANDLE               workers_[max_workers] = {};
+        HANDLE               wake_ = nullptr; // semaphore, a count per task
+        mcl_loadtask_t*      head_ = nullptr;
+        mcl_loadtask_t*      tail_ = nullptr;
+        typename mcl_simpletls_ns::
+            mcl_spinlock_t::lock_t lock_ = 0ul;
+        unsigned long        nworkers_ = 0ul;
+        LONG volatile        idle_ = 0;
+        bool volatile        stop_ = false;
+        char : 8; char : 8; char : 8;
+    };
+    static mcl_loader_t mcl_loader_obj;
+
+   /**
+    * @function mcl_loader_t::~mcl_loader_t <cpp/image.cpp>
+    * @brief Destructor. Wakes the workers and waits for them to exit,
+    *     then finishes the tasks nobody has started as failed.
+    * @return nothing
+    */
+    mcl_loader_t::~mcl_loader_t () noexcept{
+        stop_ = true;
+        if (wake_ && nworkers_) {
+            ::ReleaseSemaphore (wake_, static_cast<LONG>(nworkers_), nullptr);
+            ::WaitForMultipleObjects (nworkers_, workers_, TRUE, INFINITE);
+        }
+        for (unsigned long i = 0; i != nworkers_; ++ i)
+            ::CloseHandle (workers_[i]);
+        if (wake_) ::CloseHandle (wake_);
+        for (mcl_loadtask_t* task = pop (); task; task = pop ()) {
+            ::InterlockedExchange (&task -> m_done, 1);
+            ::SetEvent (task -> m_event);
+            task -> release ();
+        }
+    }
+
+    mcl_loadtask_t* mcl_loader_t::
+    pop () noexcept{
+        mcl_simpletls_ns::mcl_spinlock_t lk(lock_, L"mcl_loader_t::pop");
+        mcl_loadtask_t* task = head_;
+        if (task) {
+            head_ = task -> m_next;
+            if (!head_) tail_ = nullptr;
+        }
+        return task;
+    }
+
+   /**
+    * @function mcl_loader_t::push <cpp/image.cpp>
+    * @brief queue a task. a new worker is started while
+    *     none is idle and the pool is not full.
+    * @param[in] task: the task
+    * @return bool: whether any worker will take it
+    */
+    bool mcl_loader_t::
+    push (mcl_loadtask_t* task) noexcept{
+        {
+            mcl_simpletls_ns::mcl_spinlock_t lk(lock_, L"mcl_loader_t::push");
+            if (!wake_) wake_ = ::CreateSemaphoreW (nullptr, 0, 0x7fffffff, nullptr);
+            if (!wake_) return false;
+            // leave a processor to the caller, but keep one worker at least
+            unsigned long limit = mcl_parallel_obj.get_threads () - 1;
+            if (limit > max_workers) limit = max_workers;
+            if (!limit) limit = 1;
+            if (!::InterlockedCompareExchange (&idle_, 0, 0) && nworkers_ < limit) {
+#               ifdef _MSC_VER
+#                   pragma warning(push)
+#                   pragma warning(disable: 5039)
+#               endif // never throw an exception passed to extern C function
+                workers_[nworkers_] = HANDLE(::_beginthreadex (nullptr, 0, worker_proc, this, 0, nullptr));
+#               ifdef _MSC_VER
+#                   pragma warning(pop)
+#               endif
+                if (workers_[nworkers_]) ++ nworkers_;
+            }
+            if (!nworkers_) return false;
+            if (tail_) tail_ -> m_next = task;
+            else head_ = task;
+            tail_ = task;
+        }
+        ::ReleaseSemaphore (wake_, 1, nullptr);
+        return true;
+    }
+
+   /**
+    * @function mcl_loader_t::worker_proc <cpp/image.cpp>
+    * @brief thread function of workers
+    * @param[in] param: the pool
+    * @return unsigned
+    */
+    unsigned __stdcall mcl_loader_t::
+    worker_proc (void* param) {
+        mcl_loader_t* pool = static_cast<mcl_loader_t*>(param);
+        for (;;) {
+            ::InterlockedIncrement (&pool -> idle_);
+            ::WaitForSingleObject (pool -> wake_, INFINITE);
+            ::InterlockedDecrement (&pool -> idle_);
+            if (pool -> stop_) break;
+            mcl_loadtask_t* task = pool -> pop ();
+            if (!task) continue;
+
+            // nobody is waiting for it any more
+            if (::InterlockedCompareExchange (&task -> m_refs, 0, 0) != 1)
+                task -> m_surface = image.load (task -> m_filename);
+            ::InterlockedExchange (&task -> m_done, 1);
+            ::SetEvent (task -> m_event);
+            if (task -> m_eventtype) {
+                event_t ev{ task -> m_eventtype, {{0, 0}} };
+                ev.code = task -> m_code;
+                event.post (ev);
+            }
+            task -> release ();
+        }
+        return 0;
+    }
+
+    /**
+     * @function mcl_image_t::load_async <src/image.h>
+     * @brief load new image from a file on a worker thread.
+     * @param filename: path to the image file.
+     * @param eventtype: event posted when the image is ready, or 0.
+     * @param code: the code of the event.
+     * @return loadtask_t
+     */
+    loadtask_t mcl_image_t::
+    load_async (char const* filename, eventtype_t eventtype, void* code) noexcept{
+        if (!filename)
+            return loadtask_t ();
+        mcl_simpletls_ns::mcl_m2w_str_t wstr(filename);
+        return load_async (static_cast<wchar_t*>(wstr), eventtype, code);
+    }
+
+    /**
+     * @function mcl_image_t::load_async <src/image.h>
+     * @brief load new image from a file on a worker thread.
+     * @param filename: path to the image file.
+     * @param eventtype: event posted when the image is ready, or 0.
+     * @param code: the code of the event.
+     * @return loadtask_t
+     */
+    loadtask_t mcl_image_t::
+    load_async (wchar_t const* filename, eventtype_t eventtype, void* code) noexcept{
+        if (!filename)
+            return loadtask_t ();
+        mcl_loadtask_t* task = new (std::nothrow) mcl_loadtask_t ();
+        if (!task) return loadtask_t ();
+        size_t len = ::wcslen (filename) + 1;
+        task -> m_filename = new (std::nothrow) wchar_t[len];
+        task -> m_event = ::CreateEventW (nullptr, TRUE, FALSE, nullptr);
+        if (!task -> m_filename || !task -> m_event) {
+            delete task;
+            return loadtask_t ();
+        }
+        ::memcpy (task -> m_filename, filename, len * sizeof (wchar_t));
+        task -> m_eventtype = eventtype;
+        task -> m_code = code;
+        if (!mcl_loader_obj.push (task)) {
+            delete task;
+            return loadtask_t ();
+        }
+        return loadtask_t (task);
+    }
+
+    /**
+     * @function loadtask_t::loadtask_t <src/image.h>
+     * @brief constructor of an empty handle
+     */
+    loadtask_t::
+    loadtask_t () noexcept
+      : m_dataplus_ (nullptr) { }
+
+    loadtask_t::
+    loadtask_t (void* task) noexcept
+      : m_dataplus_ (task) { }
+
+    loadtask_t::
+    loadtask_t (loadtask_t&& rhs) noexcept
+      : m_dataplus_ (rhs.m_dataplus_) {
+        rhs.m_dataplus_ = nullptr;
+    }
+
+    /**
+     * @function loadtask_t::~loadtask_t <src/image.h>
+     * @brief destructor. a task still queued is skipped,
+     *    and one being loaded is dropped when it is ready
+     */
+    loadtask_t::
+    ~loadtask_t () noexcept{
+        if (m_dataplus_)
+            static_cast<mcl_loadtask_t*>(m_dataplus_) -> release ();
+    }
+
+    loadtask_t& loadtask_t::
+    operator= (loadtask_t&& rhs) noexcept{
+        if (this != &rhs) {
+            if (m_dataplus_)
+                static_cast<mcl_loadtask_t*>(m_dataplus_) -> release ();
+            m_dataplus_ = rhs.m_dataplus_;
+            rhs.m_dataplus_ = nullptr;
+        }
+        return *this;
+    }
+
+    loadtask_t::
+    operator void* () const noexcept{
+        return m_dataplus_ ? const_cast<loadtask_t*>(this) : nullptr;
+    }
+
+    bool loadtask_t::
+    operator! () const noexcept{
+        return !m_dataplus_;
+    }
+
+    /**
+     * @function loadtask_t::ready <src/image.h>
+     * @brief test if the image is ready, without blocking
+     * @return bool
+     */
+    bool loadtask_t::
+    ready () const noexcept{
+        mcl_loadtask_t* task = static_cast<mcl_loadtask_t*>(m_dataplus_);
+        return task && ::InterlockedCompareExchange (&task -> m_done, 1, 1);
+    }
+
+    /**
+     * @function loadtask_t::wait <src/image.h>
+     * @brief wait until the image is ready
+     * @param[in] timeout: in milliseconds, or -1 to wait for ever
+     * @return bool: whether it is ready
+     */
+    bool loadtask_t::
+    wait (long timeout) const noexcept{
+        mcl_loadtask_t* task = static_cast<mcl_loadtask_t*>(m_dataplus_);
+        if (!task) return false;
+        if (ready ()) return true;
+        DWORD ms = timeout < 0 ? INFINITE : static_cast<DWORD>(timeout);
+        return ::WaitForSingleObject (task -> m_event, ms) == WAIT_OBJECT_0;
+    }
+
+    /**
+     * @function loadtask_t::get <src/image.h>
+     * @brief wait for the image and take it. the handle
+     *    is empty afterwards
+     * @return surface_t: sf_nullptr if loading failed
+     */
+    surface_t loadtask_t::
+    get () noexcept{
+        mcl_loadtask_t* task = static_cast<mcl_loadtask_t*>(m_dataplus_);
+        if (!task || !wait ()) return sf_nullptr;
+        surface_t surf (std::move (task -> m_surface));
+        m_dataplus_ = nullptr;
+        task -> release ();
+        return surf;
+    }
+
+
+   /**
+    * @enum mcl_pack_format_t <cpp/image.cpp>
+    * @brief Layout of an asset pack. all numbers are little-endian.
+    *     header   "MCLP", u32 version, u32 count, u32 bytes of names
+    *     index    count * { u64 offset, u64 size, u32 name offset,
+    *                        u32 name length, u32 format, u32 width,
+    *                        u32 height, u32 reserved }, sorted by name
+    *     names    UTF-16 names, not terminated
+    *     data     the entries, each on a 16-byte boundary
+    */
+    enum mcl_pack_format_t {
+        mcl_pack_bmp = 1,
+        mcl_pack_png = 2,
+        mcl_pack_qoi = 3,
+        mcl_pack_header = 16,
+        mcl_pack_entry = 40,
+        mcl_pack_version = 1
+    };
+
+    static inline unsigned long long
+    mcl_pack_rd64 (unsigned char const* p) noexcept {
+        return static_cast<unsigned long long>(mcl_bmp_rd32 (p + 4)) << 32 | mcl_bmp_rd32 (p);
+    }
+
+    static inline void
+    mcl_pack_wr32 (unsigned char* p, unsigned long long v) noexcept {
+        for (int i = 0; i != 4; ++ i) p[i] = static_cast<unsigned char>(v >> (i * 8));
+    }
+
+    static inline unsigned long
+    mcl_pack_rdbe32 (unsigned char const* p) noexcept {
+        return static_cast<unsigned long>(p[0]) << 24 | static_cast<unsigned long>(p[1]) << 16
+             | static_cast<unsigned long>(p[2]) << 8 | p[3];
+    }
+
+   /**
+    * @function mcl_pack_sniff <cpp/image.cpp>
+    * @brief Find the format and the size of an image file
+    *     that the pack can decode, without decoding it.
+    * @param {unsigned char const*} data: the whole file
+    * @param {size_t} size
+    * @param[out] {point2d_t&} dims: width and height
+    * @return int: mcl_pack_format_t, or 0 if not supported
+    */
+    static int
+    mcl_pack_sniff (unsigned char const* data, size_t size, point2d_t& dims) noexcept {
+        unsigned long w = 0, h = 0;
+        int format = 0;
+        if (size >= 24 && !::memcmp (data, "\x89PNG\r\n\x1a\n", 8) && !::memcmp (data + 12, "IHDR", 4)) {
+            w = mcl_pack_rdbe32 (data + 16); h = mcl_pack_rdbe32 (data + 20);
+            format = mcl_pack_png;
+        } else if (size >= 14 + 8 && !::memcmp (data, "qoif", 4)) {
+            w = mcl_pack_rdbe32 (data + 4); h = mcl_pack_rdbe32 (data + 8);
+            format = mcl_pack_qoi;
+        } else {
+            mcl_bmp_t bmp;
+            if (!mcl_bmp_parse (data, size, bmp)) return 0;
+            w = static_cast<unsigned long>(bmp.width); h = static_cast<unsigned long>(bmp.height);
+            format = mcl_pack_bmp;
+        }
+        if (!w || !h || w > 0x7fffffff || h > 0x7fffffff) return 0;
+        dims = point2d_t{ static_cast<point1d_t>(w), static_cast<point1d_t>(h) };
+        return format;
+    }
+
+    static surface_t
+    mcl_pack_decode (int format, unsigned char const* data, size_t size) noexcept {
+        switch (format) {
+        case mcl_pack_png: return mcl_png_decode (data, size);
+        case mcl_pack_qoi: return mcl_qoi_decode (data, size);
+        default:           return mcl_bmp_decode (data, size);
+        }
+    }
+
+   /**
+    * @function mcl_pack_cmp <cpp/image.cpp>
+    * @brief Compare a name in the pack with a wide string,
+    *     by UTF-16 code units.
+    * @return int: < 0, 0 or > 0 like wcscmp
+    */
+    static int
+    mcl_pack_cmp (unsigned char const* name, size_t len, wchar_t const* str) noexcept {
+        for (size_t i = 0; i != len; ++ i) {
+            unsigned a = static_cast<unsigned>(name[i * 2] | name[i * 2 + 1] << 8);
+            unsigned b = static_cast<unsigned>(str[i]) & 0xffff;
+            if (!str[i]) return 1;
+            if (a != b) return a < b ? -1 : 1;
+        }
+        return str[len] ? -1 : 0;
+    }
+
+   /**
+    * @class mcl_assetpack_t <cpp/image.cpp>
+    * @brief An opened asset pack: a view of the file, the index in
+    *     it, and the surfaces decoded by assetpack_t::get.
+    */
+    struct
+    mcl_assetpack_t {
+        mcl_simpletls_ns::mcl_mapfile_t m_file;
+        unsigned char const* m_index = nullptr;
+        unsigned char const* m_names = nullptr;
+        size_t          m_count      = 0;
+        size_t          m_names_size = 0;
+        surface_t*      m_cache      = nullptr;
+        typename mcl_simpletls_ns::
+            mcl_spinlock_t::lock_t m_lock = 0ul;
+
+        explicit mcl_assetpack_t (wchar_t const* filename) noexcept
+          : m_file (filename) { }
+        ~mcl_assetpack_t () noexcept{ delete[] m_cache; }
+
+        // check the header and every entry once, so that lookups can trust them
+        bool open () noexcept{
+            unsigned char const* data = m_file.data ();
+            size_t size = m_file.size ();
+            if (!data || size < mcl_pack_header || ::memcmp (data, "MCLP", 4)
+                || mcl_bmp_rd32 (data + 4) != mcl_pack_version)
+                return false;
+            unsigned long long count = mcl_bmp_rd32 (data + 8), names = mcl_bmp_rd32 (data + 12);
+            if (count * mcl_pack_entry + names > size - mcl_pack_header)
+                return false;
+            m_count = static_cast<size_t>(count);
+            m_names_size = static_cast<size_t>(names);
+            m_index = data + mcl_pack_header;
+            m_names = m_index + m_count * mcl_pack_entry;
+            for (size_t i = 0; i != m_count; ++ i) {
+                unsigned char const* e = m_index + i * mcl_pack_entry;
+                unsigned long long off = mcl_pack_rd64 (e), len = mcl_pack_rd64 (e + 8);
+                unsigned long long name_off = mcl_bmp_rd32 (e + 16), name_len = mcl_bmp_rd32 (e + 20);
+                unsigned long format = mcl_bmp_rd32 (e + 24);
+                if (off > size || len > size - off || name_off + name_len * 2 > m_names_size
+                    || format < mcl_pack_bmp || format > mcl_pack_qoi)
+                    return false;
+            }
+            if (m_count) m_cache = new (std::nothrow) surface_t[m_count];
+            return !m_count || m_cache;
+        }
+
+        // binary search, as the index is sorted by name
+        unsigned char const* find (wchar_t const* name, size_t* pos = nullptr) const noexcept{
+            if (!name) return nullptr;
+            size_t lo = 0, hi = m_count;
+            while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                unsigned char const* e = m_index + mid * mcl_pack_entry;
+                int cmp = mcl_pack_cmp (m_names + mcl_bmp_rd32 (e + 16), mcl_bmp_rd32 (e + 20), name);
+                if (!cmp) {
+                    if (pos) *pos = mid;
+                    return e;
+                }
+                if (cmp < 0) lo = mid + 1;
+                else hi = mid;
+            }
+            return nullptr;
+        }
+
+        surface_t decode (unsigned char const* e) const noexcept{
+            return mcl_pack_decode (static_cast<int>(mcl_bmp_rd32 (e + 24)), m_file.data () + mcl_pack_rd64 (e),
+                static_cast<size_t>(mcl_pack_rd64 (e + 8)));
+        }
+    };
+
+    /**
+     * @function assetpack_t::assetpack_t <src/image.h>
+     * @brief constructor of a closed pack
+     */
+    assetpack_t::
+    assetpack_t () noexcept
+      : m_dataplus_ (nullptr) { }
+
+    /**
+     * @function assetpack_t::assetpack_t <src/image.h>
+     * @brief open an asset pack. only the index is read, and
+     *    the entries are paged in when they are decoded
+     * @param filename: path to the pack file.
+     */
+    assetpack_t::
+    assetpack_t (char const* filename) noexcept
+      : m_dataplus_ (nullptr) {
+        if (!filename) return;
+        mcl_simpletls_ns::mcl_m2w_str_t wstr(filename);
+        assetpack_t pack (static_cast<wchar_t*>(wstr));
+        m_dataplus_ = pack.m_dataplus_;
+        pack.m_dataplus_ = nullptr;
+    }
+
+    /**
+     * @function assetpack_t::assetpack_t <src/image.h>
+     * @brief open an asset pack. only the index is read, and
+     *    the entries are paged in when they are decoded
+     * @param filename: path to the pack file.
+     */
+    assetpack_t::
+    assetpack_t (wchar_t const* filename) noexcept
+      : m_dataplus_ (nullptr) {
+        if (!filename) return;
+        mcl_assetpack_t* pack = new (std::nothrow) mcl_assetpack_t (filename);
+        if (!pack) return;
+        if (!pack -> open ()) {
+            clog4m[cll4m.Info] << L"info:  Failed to open asset pack \'"
+                << filename << L"\' [-WImage-openpack]\n";
+            delete pack;
+            return;
+        }
+        m_dataplus_ = pack;
+    }
+
+    /**
+     * @function assetpack_t::~assetpack_t <src/image.h>
+     * @brief destructor. surfaces got from the pack are gone
+     */
+    assetpack_t::
+    ~assetpack_t () noexcept{
+        delete static_cast<mcl_assetpack_t*>(m_dataplus_);
+    }
+
+    assetpack_t::
+    operator void* () const noexcept{
+        return m_dataplus_ ? const_cast<assetpack_t*>(this) : nullptr;
+    }
+
+    bool assetpack_t::
+    operator! () const noexcept{
+        return !m_dataplus_;
+    }
+
+    /**
+     * @function assetpack_t::size <src/image.h>
+     * @brief get the number of entries
+     * @return size_t
+     */
+    size_t assetpack_t::
+    size () const noexcept{
+        mcl_assetpack_t* pack = static_cast<mcl_assetpack_t*>(m_dataplus_);
+        return pack ? pack -> m_count : 0;
+    }
+
+    /**
+     * @function assetpack_t::contains <src/image.h>
+     * @brief test if an entry is in the pack
+     * @param name: name of the entry.
+     * @return bool
+     */
+    bool assetpack_t::
+    contains (char const* name) const noexcept{
+        if (!name) return false;
+        mcl_simpletls_ns::mcl_m2w_str_t wstr(name);
+        return contains (static_cast<wchar_t*>(wstr));
+    }
+
+    /**
+     * @function assetpack_t::contains <src/image.h>
+     * @brief test if an entry is in the pack
+     * @param name: name of the entry.
+     * @return bool
+     */
+    bool assetpack_t::
+    contains (wchar_t const* name) const noexcept{
+        mcl_assetpack_t* pack = static_cast<mcl_assetpack_t*>(m_dataplus_);
+        return pack && pack -> find (name);
+    }
+
+    /**
+     * @function assetpack_t::get_size <src/image.h>
+     * @brief get the size of an entry from the index
+     * @param name: name of the entry.
+     * @return point2d_t: {0, 0} if not found
+     */
+    point2d_t assetpack_t::
+    get_size (char const* name) const noexcept{
+        if (!name) return point2d_t{ 0, 0 };
+        mcl_simpletls_ns::mcl_m2w_str_t wstr(name);
+        return get_size (static_cast<wchar_t*>(wstr));
+    }
+
+    /**
+     * @function assetpack_t::get_size <src/image.h>
+     * @brief get the size of an entry from the index
+     * @param name: name of the entry.
+     * @return point2d_t: {0, 0} if not found
+     */
+    point2d_t assetpack_t::
+    get_size (wchar_t const* name) const noexcept{
+        mcl_assetpack_t* pack = static_cast<mcl_assetpack_t*>(m_dataplus_);
+        unsigned char const* e = pack ? pack -> find (name) : nullptr;
+        if (!e) return point2d_t{ 0, 0 };
+        return point2d_t{ static_cast<point1d_t>(mcl_bmp_rd32 (e + 28)),
+                          static_cast<point1d_t>(mcl_bmp_rd32 (e + 32)) };
+    }
+
+    /**
+     * @function assetpack_t::load <src/image.h>
+     * @brief decode an entry into a new surface
+     * @param name: name of the entry.
+     * @return surface_t: sf_nullptr if not found or broken
+     */
+    surface_t assetpack_t::
+    load (char const* name) noexcept{
+        if (!name) return sf_nullptr;
+        mcl_simpletls_ns::mcl_m2w_str_t wstr(name);
+        return load (static_cast<wchar_t*>(wstr));
+    }
+
+    /**
+     * @function assetpack_t::load <src/image.h>
+     * @brief decode an entry into a new surface
+     * @param name: name of the entry.
+     * @return surface_t: sf_nullptr if not found or broken
+     */
+    surface_t assetpack_t::
+    load (wchar_t const* name) noexcept{
+        mcl_assetpack_t* pack = static_cast<mcl_assetpack_t*>(m_dataplus_);
+        unsigned char const* e = pack ? pack -> find (name) : nullptr;
+        if (!e) return sf_nullptr;
+        surface_t surf = pack -> decode (e);
+        if (!surf)
+            clog4m[cll4m.Info] << L"info:  Failed to decode \'"
+                << name << L"\' in asset pack [-WImage-loadpack]\n";
+        return surf;
+    }
+
+    /**
+     * @function assetpack_t::get <src/image.h>
+     * @brief get the cached surface of an entry, decoding it
+     *    the first time. it lives until clear_cache is called
+     * @param name: name of the entry.
+     * @return surface_t const&: sf_nullptr if not found or broken
+     */
+    surface_t const& assetpack_t::
+    get (char const* name) noexcept{
+        if (!name) return sf_nullptr;
+        mcl_simpletls_ns::mcl_m2w_str_t wstr(name);
+        return get (static_cast<wchar_t*>(wstr));
+    }
+
+    /**
+     * @function assetpack_t::get <src/image.h>
+     * @brief get the cached surface of an entry, decoding it
+     *    the first time. it lives until clear_cache is called
+     * @param name: name of the entry.
+     * @return surface_t const&: sf_nullptr if not found or broken
+     */
+    surface_t const& assetpack_t::
+    get (wchar_t const* name) noexcept{
+        mcl_assetpack_t* pack = static_cast<mcl_assetpack_t*>(m_dataplus_);
+        size_t pos = 0;
+        if (!pack || !pack -> find (name, &pos)) return sf_nullptr;
+        {
+            mcl_simpletls_ns::mcl_spinlock_t lk(pack -> m_lock, L"assetpack_t::get");
+            if (pack -> m_cache[pos]) return pack -> m_cache[pos];
+        }
+        // decode without the lock. if two threads race, the first one wins
+        surface_t surf = load (name);
+        if (!surf) return sf_nullptr;
+        mcl_simpletls_ns::mcl_spinlock_t lk(pack -> m_lock, L"assetpack_t::get");
+        if (!pack -> m_cache[pos]) pack -> m_cache[pos] = std::move (surf);
+        return pack -> m_cache[pos];
+    }
+
+    /**
+     * @function assetpack_t::clear_cache <src/image.h>
+     * @brief drop all cached surfaces
+     * @return none
+     */
+    void assetpack_t::
+    clear_cache () noexcept{
+        mcl_assetpack_t* pack = static_cast<mcl_assetpack_t*>(m_dataplus_);
+        if (!pack) return;
+        mcl_simpletls_ns::mcl_spinlock_t lk(pack -> m_lock, L"assetpack_t::clear_cache");
+        for (size_t i = 0; i != pack -> m_count; ++ i)
+            pack -> m_cache[i] = surface_t ();
+    }
+
+   /**
+    * @class mcl_packitem_t <cpp/image.cpp>
+    * @brief An entry of an assetpacker_t. the entries form a
+    *     list sorted by name.
+    */
+    struct
+    mcl_packitem_t {
+        mcl_packitem_t* m_next     = nullptr;
+        wchar_t*        m_name     = nullptr;
+        wchar_t*        m_filename = nullptr;  // a file stored as it is, or
+        surface_t       m_surface;             // a surface stored as QOI
+
+        ~mcl_packitem_t () noexcept{
+            delete[] m_name;
+            delete[] m_filename;
+        }
+    };
+
+    static wchar_t*
+    mcl_pack_strdup (wchar_t const* str) noexcept {
+        size_t len = ::wcslen (str) + 1;
+        wchar_t* dst = new (std::nothrow) wchar_t[len];
+        if (dst) ::memcpy (dst, str, len * sizeof (wchar_t));
+        return dst;
+    }
+
+   /**
+    * @function mcl_pack_insert <cpp/image.cpp>
+    * @brief Put an item into the sorted list of a packer.
+    * @return bool: false if the name is taken
+    */
+    static bool
+    mcl_pack_insert (void*& head, mcl_packitem_t* item) noexcept {
+        mcl_packitem_t** pp = reinterpret_cast<mcl_packitem_t**>(&head);
+        for (; *pp; pp = &(*pp) -> m_next) {
+            wchar_t const* a = (*pp) -> m_name, *b = item -> m_name;
+            for (; *a && *a == *b; ++ a, ++ b);
+            if ((static_cast<unsigned>(*a) & 0xffff) >= (static_cast<unsigned>(*b) & 0xffff)) {
+                if (*a == *b) return false;
+                break;
+            }
+        }
+        item -> m_next = *pp;
+        *pp = item;
+        return true;
+    }
+
+    /**
+     * @function assetpacker_t::assetpacker_t <src/image.h>
+     * @brief constructor of an empty packer
+     */
+    assetpacker_t::
+    assetpacker_t () noexcept
+      : m_dataplus_ (nullptr) { }
+
+    assetpacker_t::
+    ~assetpacker_t () noexcept{
+        mcl_packitem_t* item = static_cast<mcl_packitem_t*>(m_dataplus_);
+        while (item) {
+            mcl_packitem_t* next = item -> m_next;
+            delete item;
+            item = next;
+        }
+    }
+
+    /**
+     * @function assetpacker_t::add <src/image.h>
+     * @brief add an image file. it must be PNG, QOI or a BMP
+     *    that image.load decodes by itself
+     * @param name: name of the entry.
+     * @param filename: path to the image file.
+     * @return bool: false if the name is taken or the file is not supported
+     */
+    bool assetpacker_t::
+    add (char const* name, char const* filename) noexcept{
+        if (!name || !filename) return false;
+        mcl_simpletls_ns::mcl_m2w_str_t wname(name), wfile(filename);
+        return add (static_cast<wchar_t*>(wname), static_cast<wchar_t*>(wfile));
+    }
+
+    /**
+     * @function assetpacker_t::add <src/image.h>
+     * @brief add an image file. it must be PNG, QOI or a BMP
+     *    that image.load decodes by itself
+     * @param name: name of the entry.
+     * @param filename: path to the image file.
+     * @return bool: false if the name is taken or the file is not supported
+     */
+    bool assetpacker_t::
+    add (wchar_t const* name, wchar_t const* filename) noexcept{
+        if (!name || !*name || !filename) return false;
+        {
+            mcl_simpletls_ns::mcl_mapfile_t file (filename);
+            // decode it once, so that a broken file is found now rather than in the game
+            point2d_t dims{ 0, 0 };
+            int format = !file ? 0 : mcl_pack_sniff (file.data (), file.size (), dims);
+            if (!format || !mcl_pack_decode (format, file.data (), file.size ())) {
+                clog4m[cll4m.Info] << L"info:  Cannot pack image file \'"
+                    << filename << L"\' [-WImage-addpack]\n";
+                return false;
+            }
+        }
+        mcl_packitem_t* item = new (std::nothrow) mcl_packitem_t ();
+        if (!item) return false;
+        item -> m_name = mcl_pack_strdup (name);
+        item -> m_filename = mcl_pack_strdup (filename);
+        if (!item -> m_name || !item -> m_filename || !mcl_pack_insert (m_dataplus_, item)) {
+            delete item;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @function assetpacker_t::add <src/image.h>
+     * @brief add a copy of a surface. it is stored as QOI
+     * @param name: name of the entry.
+     * @param surface: surface to add.
+     * @return bool: false if the name is taken
+     */
+    bool assetpacker_t::
+    add (char const* name, surface_t const& surface) noexcept{
+        if (!name) return false;
+        mcl_simpletls_ns::mcl_m2w_str_t wname(name);
+        return add (static_cast<wchar_t*>(wname), surface);
+    }
+
+    /**
+     * @function assetpacker_t::add <src/image.h>
+     * @brief add a copy of a surface. it is stored as QOI
+     * @param name: name of the entry.
+     * @param surface: surface to add.
+     * @return bool: false if the name is taken
+     */
+    bool assetpacker_t::
+    add (wchar_t const* name, surface_t const& surface) noexcept{
+        if (!name || !*name || !surface) return false;
+        mcl_packitem_t* item = new (std::nothrow) mcl_packitem_t ();
+        if (!item) return false;
+        item -> m_name = mcl_pack_strdup (name);
+        item -> m_surface = surface;
+        if (!item -> m_name || !item -> m_surface || !mcl_pack_insert (m_dataplus_, item)) {
+            delete item;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @function assetpacker_t::size <src/image.h>
+     * @brief get the number of entries
+     * @return size_t
+     */
+    size_t assetpacker_t::
+    size () const noexcept{
+        size_t n = 0;
+        for (mcl_packitem_t* item = static_cast<mcl_packitem_t*>(m_dataplus_); item; item = item -> m_next)
+            ++ n;
+        return n;
+    }
+
+    /**
+     * @function assetpacker_t::save <src/image.h>
+     * @brief write the pack file
+     * @param filename: path to the pack file.
+     * @return bool
+     */
+    bool assetpacker_t::
+    save (char const* filename) const noexcept{
+        if (!filename) return false;
+        mcl_simpletls_ns::mcl_m2w_str_t wstr(filename);
+        return save (static_cast<wchar_t*>(wstr));
+    }
+
+    /**
+     * @function assetpacker_t::save <src/image.h>
+     * @brief write the pack file. the index is written last,
+     *    once the offsets of the entries are known
+     * @param filename: path to the pack file.
+     * @return bool
+     */
+    bool assetpacker_t::
+    save (wchar_t const* filename) const noexcept{
+        if (!filename) return false;
+        mcl_packitem_t* head = static_cast<mcl_packitem_t*>(m_dataplus_);
+        size_t count = 0, names = 0;
+        for (mcl_packitem_t* item = head; item; item = item -> m_next, ++ count)
+            names += ::wcslen (item -> m_name) * 2;
+        size_t index_size = mcl_pack_header + count * mcl_pack_entry + names;
+        mcl_simpletls_ns::mcl_auto_ptr_t<unsigned char> index_ptr(index_size);
+        unsigned char* index = index_ptr;
+        if (!index) return false;
+        ::memset (index, 0, index_size);
+        ::memcpy (index, "MCLP", 4);
+        mcl_pack_wr32 (index + 4, mcl_pack_version);
+        mcl_pack_wr32 (index + 8, count);
+        mcl_pack_wr32 (index + 12, names);
+
+        FILE* fp = nullptr;
+        MCL_WFOPEN (fp, filename, L"wb");
+        if (!fp) return false;
+        bool ret = ::fwrite (index, 1, index_size, fp) == index_size;
+        unsigned char* e = index + mcl_pack_header;
+        unsigned char* name = e + count * mcl_pack_entry;
+        size_t name_off = 0;
+        static unsigned char const zeros[16] = {};
+        for (mcl_packitem_t* item = head; ret && item; item = item -> m_next, e += mcl_pack_entry) {
+            // 64-bit positions, as packs may pass 2 GB
+            long long pos = ::_ftelli64 (fp);
+            size_t pad = static_cast<size_t>(-pos) & 15;
+            ret = pos >= 0 && ::fwrite (zeros, 1, pad, fp) == pad;
+            if (!ret) break;
+            unsigned long long off = static_cast<unsigned long long>(pos) + pad, len = 0;
+
+            point2d_t dims{ 0, 0 };
+            int format = mcl_pack_qoi;
+            if (item -> m_filename) {
+                // the file may have changed since it was added
+                mcl_simpletls_ns::mcl_mapfile_t file (item -> m_filename);
+                format = !file ? 0 : mcl_pack_sniff (file.data (), file.size (), dims);
+                ret = format && ::fwrite (file.data (), 1, file.size (), fp) == file.size ();
+                len = file.size ();
+            } else {
+                mcl_imagebuf_t* ibuf = mcl_get_surface_dataplus (&item -> m_surface);
+                dims = point2d_t{ ibuf -> m_width, ibuf -> m_height };
+                ret = image.save_qoi (item -> m_surface, fp);
+                long long end = ::_ftelli64 (fp);
+                ret = ret && end >= 0;
+                len = static_cast<unsigned long long>(end) - off;
+            }
+            if (!ret) break;
+
+            size_t name_len = ::wcslen (item -> m_name);
+            for (size_t i = 0; i != name_len; ++ i) {
+                name[i * 2] = static_cast<unsigned char>(item -> m_name[i]);
+                name[i * 2 + 1] = static_cast<unsigned char>(item -> m_name[i] >> 8);
+            }
+            mcl_pack_wr32 (e, off);
+            mcl_pack_wr32 (e + 4, off >> 32);
+            mcl_pack_wr32 (e + 8, len);
+            mcl_pack_wr32 (e + 12, len >> 32);
+            mcl_pack_wr32 (e + 16, name_off);
+            mcl_pack_wr32 (e + 20, name_len);
+            mcl_pack_wr32 (e + 24, static_cast<unsigned long long>(format));
+            mcl_pack_wr32 (e + 28, static_cast<unsigned long long>(dims.x));
+            mcl_pack_wr32 (e + 32, static_cast<unsigned long long>(dims.y));
+            name += name_len * 2;
+            name_off += name_len * 2;
+        }
+        ret = ret && !::_fseeki64 (fp, 0, SEEK_SET) && ::fwrite (index, 1, index_size, fp) == index_size;
+        if (::fclose (fp)) ret = false;
+        if (!ret)
+            clog4m[cll4m.Info] << L"info:  Failed to write asset pack \'"
+                << filename << L"\' [-WImage-savepack]\n";
+        return ret;
+    }
+
+
+   /**
+    * @enum mcl_rec_format_t <cpp/image.cpp>
+    * @brief Layout of a Raw or Delta recording. all numbers are little-endian.
+    *     header   "MCLR", u32 version, u32 width, u32 height, u32 fps,
+    *              u32 frames, u64 offset of the index
+    *     frames   a key frame is width * height BGRA pixels. a delta frame
+    *              is spans of { u32 pixels skipped, u32 n, n BGRA pixels }
+    *              over the frame before it
+    *     index    frames * { u64 offset, u32 size, with the top bit set
+    *              for delta frames, u32 ms since the first frame }
+    */
+    enum mcl_rec_format_t {
+        mcl_rec_header = 32,
+        mcl_rec_entry = 16,
+        mcl_rec_version = 1,
+        mcl_rec_keyframes = 60  // a key frame at least every 60 frames
+    };
+
+   /**
+    * @class mcl_recorder_t <cpp/image.cpp>
+    * @brief A recording: a ring of frames filled by add_frame and
+    *     emptied by a thread that writes them to the file.
+    */
+    struct
+    mcl_recorder_t {
+        FILE*           m_fp       = nullptr;
+        HANDLE          m_thread   = nullptr;
+        HANDLE          m_filled   = nullptr;  // semaphore, a count per queued frame
+        point2d_t       m_size     = { 0, 0 };
+        recfmt_t        m_format   = 0;
+        long            m_fps      = 30;
+        size_t          m_nbufs    = 0;
+        color_t*        m_ring     = nullptr;  // m_nbufs frames
+        DWORD*          m_times    = nullptr;  // when each frame was added
+        DWORD           m_start    = 0;
+        size_t          m_head     = 0;        // next buffer to fill, by add_frame
+        size_t          m_tail     = 0;        // next buffer to write, by the thread
+        LONG volatile   m_queued   = 0;
+        LONG volatile   m_written  = 0;
+        LONG volatile   m_dropped  = 0;
+        LONG volatile   m_stop     = 0;
+        LONG volatile   m_error    = 0;
+
+        // used by the thread only
+        color_t*        m_prev     = nullptr;  // the frame written last, for deltas
+        unsigned char*  m_yuv      = nullptr;  // planes of a Y4M frame
+        unsigned char*  m_index    = nullptr;  // entries of the frames written
+        size_t          m_index_cap = 0;
+        unsigned long long m_pos   = 0;        // offset in the file
+
+        ~mcl_recorder_t () noexcept{
+            if (m_filled) ::CloseHandle (m_filled);
+            if (m_fp) ::fclose (m_fp);
+            delete[] m_ring;
+            delete[] m_times;
+            delete[] m_prev;
+            delete[] m_yuv;
+            delete[] m_index;
+        }
+        bool write (void const* p, size_t n) noexcept{
+            if (::fwrite (p, 1, n, m_fp) != n) return false;
+            m_pos += n;
+            return true;
+        }
+        bool frame (color_t const* px, DWORD time) noexcept;
+        bool frame_y4m (color_t const* px) noexcept;
+        size_t frame_delta (color_t const* px) noexcept;
+        bool finish () noexcept;
+    };
+
+   /**
+    * @function mcl_recorder_t::frame_y4m <cpp/image.cpp>
+    * @brief Write a frame as full-range BT.601 YUV, with the
+    *     chroma averaged over 2 x 2 pixels.
+    * @return bool
+    */
+    bool mcl_recorder_t::
+    frame_y4m (color_t const* px) noexcept {
+        point1d_t w = m_size.x, h = m_size.y, cw = (w + 1) / 2, ch = (h + 1) / 2;
+        unsigned char* py = m_yuv;
+        unsigned char* pu = py + static_cast<size_t>(w) * static_cast<size_t>(h);
+        unsigned char* pv = pu + static_cast<size_t>(cw) * static_cast<size_t>(ch);
+        for (point1d_t y = 0; y != h; ++ y) {
+            color_t const* row = px + static_cast<size_t>(y) * static_cast<size_t>(w);
+            for (point1d_t x = 0; x != w; ++ x) {
+                int r = static_cast<int>((row[x] >> 16) & 0xff), g = static_cast<int>((row[x] >> 8) & 0xff);
+                int b = static_cast<int>(row[x] & 0xff);
+                *py ++ = static_cast<unsigned char>((77 * r + 150 * g + 29 * b + 128) >> 8);
+            }
+        }
+        for (point1d_t y = 0; y != ch; ++ y) {
+            color_t const* r0 = px + static_cast<size_t>(y * 2) * static_cast<size_t>(w);
+            color_t const* r1 = y * 2 + 1 < h ? r0 + w : r0;
+            for (point1d_t x = 0; x != cw; ++ x) {
+                point1d_t x0 = x * 2, x1 = x0 + 1 < w ? x0 + 1 : x0;
+                color_t c[4] = { r0[x0], r0[x1], r1[x0], r1[x1] };
+                int r = 0, g = 0, b = 0;
+                for (int k = 0; k != 4; ++ k) {
+                    r += static_cast<int>((c[k] >> 16) & 0xff);
+                    g += static_cast<int>((c[k] >> 8) & 0xff);
+                    b += static_cast<int>(c[k] & 0xff);
+                }
+                // sums of 4 pixels, so shift by 2 more. pure blue and
+                // red reach 256, which must not wrap to 0
+                int u = ((-43 * r - 85 * g + 128 * b + 512) >> 10) + 128;
+                int v = ((128 * r - 107 * g - 21 * b + 512) >> 10) + 128;
+                *pu ++ = static_cast<unsigned char>(u < 0 ? 0 : u > 255 ? 255 : u);
+                *pv ++ = static_cast<unsigned char>(v < 0 ? 0 : v > 255 ? 255 : v);
+            }
+        }
+        return write ("FRAME\n", 6) && write (m_yuv, static_cast<size_t>(pv - m_yuv));
+    }
+
+   /**
+    * @function mcl_recorder_t::frame_delta <cpp/image.cpp>
+    * @brief Write the spans of pixels that changed since the
+    *     last frame. gaps of 2 pixels or less are written too,
+    *     as a new span costs as much.
+    * @return size_t: bytes written, or 0 on failure
+    */
+    size_t mcl_recorder_t::
+    frame_delta (color_t const* px) noexcept {
+        size_t n = static_cast<size_t>(m_size.x) * static_cast<size_t>(m_size.y), i = 0, last = 0;
+        unsigned long long begin = m_pos;
+        for (;;) {
+            while (i != n && px[i] == m_prev[i]) ++ i;
+            if (i == n) break;
+            size_t j = i + 1;
+            for (;;) {
+                while (j != n && px[j] != m_prev[j]) ++ j;
+                size_t k = j;
+                while (k != n && k - j < 3 && px[k] == m_prev[k]) ++ k;
+                if (k == n || k - j >= 3) break;
+                j = k;
+            }
+            unsigned char head[8];
+            mcl_pack_wr32 (head, i - last);
+            mcl_pack_wr32 (head + 4, j - i);
+            if (!write (head, 8) || !write (px + i, (j - i) * 4)) return 0;
+            i = last = j;
+        }
+        // an unchanged frame still needs a span to be told from a failure
+        if (m_pos == begin) {
+            unsigned char head[8];
+            mcl_pack_wr32 (head, n);
+            mcl_pack_wr32 (head + 4, 0);
+            if (!write (head, 8)) return 0;
+        }
+        return static_cast<size_t>(m_pos - begin);
+    }
+
+   /**
+    * @function mcl_recorder_t::frame <cpp/image.cpp>
+    * @brief Write a frame and add it to the index.
+    * @return bool
+    */
+    bool mcl_recorder_t::
+    frame (color_t const* px, DWORD time) noexcept {
+        size_t n = static_cast<size_t>(m_size.x) * static_cast<size_t>(m_size.y);
+        if (m_format == mcl_recfmt_t::Y4M)
+            return frame_y4m (px);
+
+        size_t count = static_cast<size_t>(m_written);
+        if ((count + 1) * mcl_rec_entry > m_index_cap) {
+            size_t cap = m_index_cap ? m_index_cap * 2 : mcl_rec_entry * 256;
+            unsigned char* index = new (std::nothrow) unsigned char[cap];
+            if (!index) return false;
+            if (m_index) ::memcpy (index, m_index, m_index_cap);
+            delete[] m_index;
+            m_index = index;
+            m_index_cap = cap;
+        }
+        unsigned long long off = m_pos;
+        unsigned long long size = 0;
+        bool b_delta = m_format == mcl_recfmt_t::Delta && count % mcl_rec_keyframes;
+        if (b_delta) {
+            size = frame_delta (px);
+            if (!size) return false;
+        } else {
+            size = n * 4;
+            if (!write (px, n * 4)) return false;
+        }
+        if (m_format == mcl_recfmt_t::Delta)
+            ::memcpy (m_prev, px, n * 4);
+
+        unsigned char* e = m_index + count * mcl_rec_entry;
+        mcl_pack_wr32 (e, off);
+        mcl_pack_wr32 (e + 4, off >> 32);
+        mcl_pack_wr32 (e + 8, size | (b_delta ? 0x80000000ull : 0));
+        mcl_pack_wr32 (e + 12, time);
+        return true;
+    }
+
+   /**
+    * @function mcl_recorder_t::finish <cpp/image.cpp>
+    * @brief Write the index of a Raw or Delta file, and fill
+    *     in the header written when it was opened.
+    * @return bool
+    */
+    bool mcl_recorder_t::
+    finish () noexcept {
+        if (m_format == mcl_recfmt_t::Y4M) return true;
+        size_t count = static_cast<size_t>(m_written);
+        unsigned long long off = m_pos;
+        if (count && !write (m_index, count * mcl_rec_entry)) return false;
+        unsigned char head[mcl_rec_header];
+        ::memcpy (head, "MCLR", 4);
+        mcl_pack_wr32 (head + 4, mcl_rec_version);
+        mcl_pack_wr32 (head + 8, static_cast<unsigned long long>(m_size.x));
+        mcl_pack_wr32 (head + 12, static_cast<unsigned long long>(m_size.y));
+        mcl_pack_wr32 (head + 16, static_cast<unsigned long long>(m_fps));
+        mcl_pack_wr32 (head + 20, count);
+        mcl_pack_wr32 (head + 24, off);
+        mcl_pack_wr32 (head + 28, off >> 32);
+        return !::fseek (m_fp, 0, SEEK_SET) && ::fwrite (head, 1, mcl_rec_header, m_fp) == mcl_rec_header;
+    }
+
+   /**
+    * @function mcl_recorder_proc <cpp/image.cpp>
+    * @brief thread function of a recorder. it writes the frames in
+    *     the order they were added until it is told to stop and the
+    *     ring is empty
+    * @param[in] param: the recording
+    * @return unsigned
+    */
+    static unsigned __stdcall
+    mcl_recorder_proc (void* param) {
+        mcl_recorder_t* rec = static_cast<mcl_recorder_t*>(param);
+        size_t n = static_cast<size_t>(rec -> m_size.x) * static_cast<size_t>(rec -> m_size.y);
+        for (;;) {
+            ::WaitForSingleObject (rec -> m_filled, INFINITE);
+            if (!::InterlockedCompareExchange (&rec -> m_queued, 0, 0)) {
+                if (::InterlockedCompareExchange (&rec -> m_stop, 0, 0)) break;
+                continue;
+            }
+            size_t i = rec -> m_tail;
+            if (!::InterlockedCompareExchange (&rec -> m_error, 0, 0)) {
+                if (rec -> frame (rec -> m_ring + i * n, rec -> m_times[i]))
+                    ::InterlockedIncrement (&rec -> m_written);
+                else {
+                    ::InterlockedExchange (&rec -> m_error, 1);
+                    ::InterlockedIncrement (&rec -> m_dropped);
+                }
+            } else ::InterlockedIncrement (&rec -> m_dropped);
+            rec -> m_tail = (i + 1) % rec -> m_nbufs;
+            ::InterlockedDecrement (&rec -> m_queued);
+        }
+        return 0;
+    }
+
+    /**
+     * @function recorder_t::recorder_t <src/image.h>
+     * @brief constructor of a closed recorder
+     */
+    recorder_t::
+    recorder_t () noexcept
+      : m_dataplus_ (nullptr) { }
+
+    /**
+     * @function recorder_t::recorder_t <src/image.h>
+     * @brief start a recording. all the buffers are allocated here
+     * @param filename: path to the video file.
+     * @param size: size of the frames.
+     * @param format: Raw, Delta or Y4M.
+     * @param fps: frames per second written into the file.
+     * @param buffers: number of frames that may wait for the disk.
+     */
+    recorder_t::
+    recorder_t (char const* filename, point2d_t size, recfmt_t format, long fps, size_t buffers) noexcept
+      : m_dataplus_ (nullptr) {
+        if (!filename) return;
+        mcl_simpletls_ns::mcl_m2w_str_t wstr(filename);
+        recorder_t rec (static_cast<wchar_t*>(wstr), size, format, fps, buffers);
+        m_dataplus_ = rec.m_dataplus_;
+        rec.m_dataplus_ = nullptr;
+    }
+
+    /**
+     * @function recorder_t::recorder_t <src/image.h>
+     * @brief start a recording. all the buffers are allocated here
+     * @param filename: path to the video file.
+     * @param size: size of the frames.
+     * @param format: Raw, Delta or Y4M.
+     * @param fps: frames per second written into the file.
+     * @param buffers: number of frames that may wait for the disk.
+     */
+    recorder_t::
+    recorder_t (wchar_t const* filename, point2d_t size, recfmt_t format, long fps, size_t buffers) noexcept
+      : m_dataplus_ (nullptr) {
+        if (!filename || size.x <= 0 || size.y <= 0 || fps <= 0 || !buffers || format > mcl_recfmt_t::Y4M)
+            return;
+        // the index keeps 31 bits for the size of a frame, and a delta frame
+        // takes at most 6 bytes a pixel
+        if (static_cast<unsigned long long>(size.x) * static_cast<unsigned long long>(size.y) > 0x7fffffff / 6)
+            return;
+        // nor may the ring of frames wrap on 32-bit builds
+        size_t n = static_cast<size_t>(size.x) * static_cast<size_t>(size.y);
+        if (buffers > static_cast<size_t>(-1) / sizeof (color_t) / n)
+            return;
+        mcl_recorder_t* rec = new (std::nothrow) mcl_recorder_t ();
+        if (!rec) return;
+        rec -> m_size = size;
+        rec -> m_format = format;
+        rec -> m_fps = fps;
+        rec -> m_nbufs = buffers;
+        rec -> m_ring = new (std::nothrow) color_t[n * buffers];
+        rec -> m_times = new (std::nothrow) DWORD[buffers];
+        if (format == mcl_recfmt_t::Delta)
+            rec -> m_prev = new (std::nothrow) color_t[n];
+        if (format == mcl_recfmt_t::Y4M)
+            rec -> m_yuv = new (std::nothrow) unsigned char[n + static_cast<size_t>((size.x + 1) / 2)
+                * static_cast<size_t>((size.y + 1) / 2) * 2];
+        rec -> m_filled = ::CreateSemaphoreW (nullptr, 0, 0x7fffffff, nullptr);
+        MCL_WFOPEN (rec -> m_fp, filename, L"wb");
+        bool ret = rec -> m_ring && rec -> m_times && rec -> m_filled && rec -> m_fp
+            && (format != mcl_recfmt_t::Delta || rec -> m_prev) && (format != mcl_recfmt_t::Y4M || rec -> m_yuv);
+        if (ret) {
+            // larger writes than the default keep the thread ahead of the disk
+            ::setvbuf (rec -> m_fp, nullptr, _IOFBF, 1 << 20);
+            if (format == mcl_recfmt_t::Y4M) {
+                char head[96];
+                int len = ::snprintf (head, sizeof (head), "YUV4MPEG2 W%ld H%ld F%ld:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n",
+                    size.x, size.y, fps);
+                ret = len > 0 && rec -> write (head, static_cast<size_t>(len));
+            } else {
+                // filled in when the recording is closed
+                unsigned char head[mcl_rec_header] = {};
+                ret = rec -> write (head, mcl_rec_header);
+            }
+        }
+        if (ret) {
+#           ifdef _MSC_VER
+#               pragma warning(push)
+#               pragma warning(disable: 5039)
+#           endif // never throw an exception passed to extern C function
+            rec -> m_thread = HANDLE(::_beginthreadex (nullptr, 0, mcl_recorder_proc, rec, 0, nullptr));
+#           ifdef _MSC_VER
+#               pragma warning(pop)
+#           endif
+            ret = rec -> m_thread != nullptr;
+        }
+        if (!ret) {
+            clog4m[cll4m.Info] << L"info:  Failed to start recording \'"
+                << filename << L"\' [-WImage-record]\n";
+            delete rec;
+            return;
+        }
+        rec -> m_start = ::GetTickCount ();
+        m_dataplus_ = rec;
+    }
+
+    /**
+     * @function recorder_t::~recorder_t <src/image.h>
+     * @brief destructor. waits for the frames queued
+     */
+    recorder_t::
+    ~recorder_t () noexcept{
+        close ();
+    }
+
+    recorder_t::
+    operator void* () const noexcept{
+        return m_dataplus_ ? const_cast<recorder_t*>(this) : nullptr;
+    }
+
+    bool recorder_t::
+    operator! () const noexcept{
+        return !m_dataplus_;
+    }
+
+    /**
+     * @function recorder_t::add_frame <src/image.h>
+     * @brief copy a surface into a free buffer and queue it.
+     *    it never waits for the disk
+     * @param surface: the frame.
+     * @return bool: false if the frame is dropped
+     */
+    bool recorder_t::
+    add_frame (surface_t const& surface) noexcept{
+        mcl_recorder_t* rec = static_cast<mcl_recorder_t*>(m_dataplus_);
+        if (!rec) return false;
+        mcl_imagebuf_t* ibuf = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        if (!ibuf || static_cast<size_t>(::InterlockedCompareExchange (&rec -> m_queued, 0, 0)) == rec -> m_nbufs
+            || ::InterlockedCompareExchange (&rec -> m_error, 0, 0)) {
+            ::InterlockedIncrement (&rec -> m_dropped);
+            return false;
+        }
+
+        point1d_t w = rec -> m_size.x, h = rec -> m_size.y;
+        color_t* dst = rec -> m_ring + rec -> m_head * static_cast<size_t>(w) * static_cast<size_t>(h);
+        {
+            mcl_simpletls_ns::mcl_spinlock_t lk(ibuf -> m_nrtlock, L"recorder_t::add_frame");
+            point1d_t cw = ibuf -> m_width < w ? ibuf -> m_width : w;
+            point1d_t ch = ibuf -> m_height < h ? ibuf -> m_height : h;
+            color_t const* src = ibuf -> m_pbuffer;
+            for (point1d_t y = 0; y != h; ++ y, dst += w) {
+                point1d_t n = y < ch ? cw : 0;
+                if (n) ::memcpy (dst, src + static_cast<size_t>(y) * static_cast<size_t>(ibuf -> m_width),
+                    static_cast<size_t>(n) * 4);
+                if (n != w) ::memset (dst + n, 0, static_cast<size_t>(w - n) * 4);
+            }
+        }
+        rec -> m_times[rec -> m_head] = ::GetTickCount () - rec -> m_start;
+        rec -> m_head = (rec -> m_head + 1) % rec -> m_nbufs;
+        ::InterlockedIncrement (&rec -> m_queued);
+        ::ReleaseSemaphore (rec -> m_filled, 1, nullptr);
+        return true;
+    }
+
+    /**
+     * @function recorder_t::close <src/image.h>
+     * @brief write the frames left, then the index, and close the file
+     * @return bool: false if any frame could not be written
+     */
+    bool recorder_t::
+    close () noexcept{
+        mcl_recorder_t* rec = static_cast<mcl_recorder_t*>(m_dataplus_);
+        if (!rec) return false;
+        m_dataplus_ = nullptr;
+        ::InterlockedExchange (&rec -> m_stop, 1);
+        ::ReleaseSemaphore (rec -> m_filled, 1, nullptr);
+        ::WaitForSingleObject (rec -> m_thread, INFINITE);
+        ::CloseHandle (rec -> m_thread);
+        bool ret = !rec -> m_error && rec -> finish ();
+        if (::fclose (rec -> m_fp)) ret = false;
+        rec -> m_fp = nullptr;
+        delete rec;
+        return ret;
+    }
+
+    /**
+     * @function recorder_t::get_frames <src/image.h>
+     * @brief get the number of frames written so far
+     * @return size_t
+     */
+    size_t recorder_t::
+    get_frames () const noexcept{
+        mcl_recorder_t* rec = static_cast<mcl_recorder_t*>(m_dataplus_);
+        return rec ? static_cast<size_t>(::InterlockedCompareExchange (&rec -> m_written, 0, 0)) : 0;
+    }
+
+    /**
+     * @function recorder_t::get_dropped <src/image.h>
+     * @brief get the number of frames dropped so far
+     * @return size_t
+     */
+    size_t recorder_t::
+    get_dropped () const noexcept{
+        mcl_recorder_t* rec = static_cast<mcl_recorder_t*>(m_dataplus_);
+        return rec ? static_cast<size_t>(::InterlockedCompareExchange (&rec -> m_dropped, 0, 0)) : 0;
+    }
+
+    /**
+     * @function recorder_t::load_frame <src/image.h>
+     * @brief read a frame of a Raw or Delta file
+     * @param filename: path to the video file.
+     * @param index: the frame, from 0.
+     * @return surface_t: sf_nullptr if not found or broken
+     */
+    surface_t recorder_t::
+    load_frame (char const* filename, size_t index) noexcept{
+        if (!filename) return sf_nullptr;
+        mcl_simpletls_ns::mcl_m2w_str_t wstr(filename);
+        return load_frame (static_cast<wchar_t*>(wstr), index);
+    }
+
+    /**
+     * @function recorder_t::load_frame <src/image.h>
+     * @brief read a frame of a Raw or Delta file. a delta frame
+     *    is built up from the key frame before it
+     * @param filename: path to the video file.
+     * @param index: the frame, from 0.
+     * @return surface_t: sf_nullptr if not found or broken
+     */
+    surface_t recorder_t::
+    load_frame (wchar_t const* filename, size_t index) noexcept{
+        if (!filename) return sf_nullptr;
+        mcl_simpletls_ns::mcl_mapfile_t file (filename);
+        unsigned char const* data = file.data ();
+        size_t size = file.size ();
+        if (!data || size < mcl_rec_header || ::memcmp (data, "MCLR", 4)
+            || mcl_bmp_rd32 (data + 4) != mcl_rec_version)
+            return sf_nullptr;
+        unsigned long long w = mcl_bmp_rd32 (data + 8), h = mcl_bmp_rd32 (data + 12);
+        unsigned long long count = mcl_bmp_rd32 (data + 20), off = mcl_pack_rd64 (data + 24);
+        if (!w || !h || w > 0x7fffffff || h > 0x7fffffff || index >= count
+            || off > size || count * mcl_rec_entry > size - off)
+            return sf_nullptr;
+        unsigned char const* entries = data + off;
+
+        // find the key frame, then apply the deltas after it
+        size_t key = index;
+        while (mcl_bmp_rd32 (entries + key * mcl_rec_entry + 8) & 0x80000000) {
+            if (!key) return sf_nullptr;
+            -- key;
+        }
+        surface_t surf (point2d_t{ static_cast<point1d_t>(w), static_cast<point1d_t>(h) });
+        mcl_imagebuf_t* ibuf = mcl_get_surface_dataplus (&surf);
+        if (!ibuf || static_cast<unsigned long long>(ibuf -> m_width) != w
+            || static_cast<unsigned long long>(ibuf -> m_height) != h)
+            return sf_nullptr;
+        unsigned long long n = w * h;
+        for (size_t i = key; i <= index; ++ i) {
+            unsigned char const* e = entries + i * mcl_rec_entry;
+            unsigned long long foff = mcl_pack_rd64 (e), fsize = mcl_bmp_rd32 (e + 8) & 0x7fffffff;
+            if (foff > size || fsize > size - foff) return sf_nullptr;
+            unsigned char const* p = data + foff, *end = p + fsize;
+            if (i == key) {
+                if (fsize != n * 4) return sf_nullptr;
+                ::memcpy (ibuf -> m_pbuffer, p, static_cast<size_t>(fsize));
+                continue;
+            }
+            unsigned long long pos = 0;
+            while (p != end) {
+                if (end - p < 8) return sf_nullptr;
+                unsigned long long skip = mcl_bmp_rd32 (p), len = mcl_bmp_rd32 (p + 4);
+                p += 8;
+                if (skip > n - pos || len > n - pos - skip || len * 4 > static_cast<size_t>(end - p))
+                    return sf_nullptr;
+                pos += skip;
+                ::memcpy (ibuf -> m_pbuffer + pos, p, static_cast<size_t>(len) * 4);
+                pos += len;
+                p += len * 4;
+            }
+        }
+        return surf;
+    }
+
 }
@@ -0,0 +1,972 @@
+/*
+    mclib (Multi-Canvas Library)
+    Copyright (C) 2021-2022  Yukino Amamiya
+
+    This file is part of the mclib Library. This library is
+    a graphics library for desktop applications only and it's
+    only for windows.
+
+    This library is free software; you can redistribute it
+    and/or modify it under the terms of the GNU Lesser General
+    Public License as published by the Free Software Foundation;
+    either version 2.1 of the License, or (at your option) any
+    later version.
+
+    This library is distributed in the hope that it will be
+    useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE.  See the GNU Lesser General Public License for
+    more details.
+
+    You should have received a copy of the GNU Lesser General
+    Public License along with this library; if not, write to
+    the Free Software Foundation,
+    Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+
+    Yukino Amamiya
+    iamyukino[at outlook.com]
+
+
+    @file cpp/mask.cpp
+    This is a C++11 implementation file for image masks.
+*/
+
+#ifdef _MSC_VER
+# pragma warning(push)
+# pragma warning(disable: 4464)
+#endif // Relative paths include ".."
+
+#include "../src/mask.h"
+#include "../src/surface.h"
+#include "mcl_control.h"
+#include <cstring>    // for memset, memcpy
+#include <vector>
+
+#ifdef _MSC_VER
+# pragma warning(pop)
+#endif
+
+namespace
+mcl {
+
+    // Module for image masks.
+    mcl_mask_t mask;
+    
+    mcl_mask_t::operator void* () const noexcept{ return const_cast<mcl_mask_t*>(this); }
+    bool mcl_mask_t::operator! () const noexcept{ return false; }
+
+    using mcl_word_t = unsigned long long;
+
+   /**
+    * @class mcl_maskbuf_t <cpp/mask.cpp>
+    * @brief The buffer for mask_t. pixel x of a row is bit (x & 63)
+    *     of word (x >> 6). bits past the width are always 0.
+    */
+    struct mcl_maskbuf_t {
+        point1d_t   m_width  = 0;
+        point1d_t   m_height = 0;
+        point1d_t   m_stride = 0; // words per row
+        mcl_word_t* m_bits   = nullptr;
+    };
+
+    inline mcl_maskbuf_t* mcl_get_mask_dataplus (mask_t* m) {
+        return *reinterpret_cast<mcl_maskbuf_t**>(m);
+    }
+
+    static inline size_t
+    mcl_popcount64 (mcl_word_t x) noexcept{
+#   ifdef __GNUC__
+        return static_cast<size_t>(__builtin_popcountll (x));
+#   else
+        x = x - ((x >> 1) & 0x5555555555555555ull);
+        x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+        x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+        return static_cast<size_t>((x * 0x0101010101010101ull) >> 56);
+#   endif
+    }
+
+    // index of the lowest set bit. x must not be 0
+    static inline point1d_t
+    mcl_lsb64 (mcl_word_t x) noexcept{
+#   ifdef __GNUC__
+        return static_cast<point1d_t>(__builtin_ctzll (x));
+#   else
+        point1d_t n = 0;
+        if (!(x & 0xffffffffull)) n += 32, x >>= 32;
+        if (!(x & 0xffffull))     n += 16, x >>= 16;
+        if (!(x & 0xffull))       n += 8,  x >>= 8;
+        if (!(x & 0xfull))        n += 4,  x >>= 4;
+        if (!(x & 0x3ull))        n += 2,  x >>= 2;
+        return n + static_cast<point1d_t>(!(x & 1ull));
+#   endif
+    }
+
+    // index of the highest set bit. x must not be 0
+    static inline point1d_t
+    mcl_msb64 (mcl_word_t x) noexcept{
+#   ifdef __GNUC__
+        return 63 - static_cast<point1d_t>(__builtin_clzll (x));
+#   else
+        point1d_t n = 0;
+        if (x >> 32) n += 32, x >>= 32;
+        if (x >> 16) n += 16, x >>= 16;
+        if (x >> 8)  n += 8,  x >>= 8;
+        if (x >> 4)  n += 4,  x >>= 4;
+        if (x >> 2)  n += 2,  x >>= 2;
+        return n + static_cast<point1d_t>(x >> 1);
+#   endif
+    }
+
+    // valid bits of the last word of each row
+    static inline mcl_word_t
+    mcl_mask_tail (point1d_t width) noexcept{
+        return (width & 63) ? (1ull << (width & 63)) - 1ull : ~0ull;
+    }
+
+    static mcl_maskbuf_t*
+    mcl_mask_alloc (point1d_t width, point1d_t height) noexcept{
+        mcl_maskbuf_t* buf = new (std::nothrow) mcl_maskbuf_t ();
+        if (!buf) return nullptr;
+        if (width <= 0 || height <= 0) return buf;
+        buf -> m_stride = (width + 63) >> 6;
+        buf -> m_bits = new (std::nothrow) mcl_word_t[static_cast<size_t>(buf -> m_stride) * static_cast<size_t>(height)];
+        if (!buf -> m_bits) { delete buf; return nullptr; }
+        ::memset (buf -> m_bits, 0, static_cast<size_t>(buf -> m_stride) * static_cast<size_t>(height) * sizeof (mcl_word_t));
+        buf -> m_width = width;
+        buf -> m_height = height;
+        return buf;
+    }
+
+    static void
+    mcl_mask_free (mcl_maskbuf_t* buf) noexcept{
+        if (!buf) return ;
+        delete[] buf -> m_bits;
+        delete buf;
+    }
+
+    // 64 bits of a row starting at bit p. bits out of the row are 0
+    static inline mcl_word_t
+    mcl_mask_fetch (mcl_word_t const* row, point1d_t nwords, point1d_t p) noexcept{
+        point1d_t  k = p >= 0 ? p / 64 : -((63 - p) / 64);
+        int        s = static_cast<int>(p - k * 64);
+        point1d_t  k1 = k + 1;
+        mcl_word_t lo = (k >= 0 && k < nwords) ? row[k] : 0ull;
+        if (!s) return lo;
+        mcl_word_t hi = (k1 >= 0 && k1 < nwords) ? row[k1] : 0ull;
+        return (lo >> s) | (hi << (64 - s));
+    }
+
+    /**
+     * @function mcl_mask_each <cpp/mask.cpp>
+     * @brief walks the words of a where b placed at offset overlaps it,
+     *     row by row. fun (word of a, y, word index, bits of b aligned
+     *     to the word of a) returns false to stop.
+     * @return bool: false if stopped
+     */
+    template <typename fun_t>
+    static bool
+    mcl_mask_each (mcl_maskbuf_t const* a, mcl_maskbuf_t const* b, point2d_t offset, fun_t fun) noexcept{
+        point1d_t x0 = offset.x > 0 ? offset.x : 0;
+        point1d_t y0 = offset.y > 0 ? offset.y : 0;
+        point1d_t x1 = offset.x + b -> m_width,  y1 = offset.y + b -> m_height;
+        if (x1 > a -> m_width)  x1 = a -> m_width;
+        if (y1 > a -> m_height) y1 = a -> m_height;
+        if (x0 >= x1 || y0 >= y1) return true;
+
+        point1d_t i0 = x0 >> 6, i1 = (x1 - 1) >> 6;
+        for (point1d_t y = y0; y != y1; ++ y) {
+            mcl_word_t*       arow = a -> m_bits + y * a -> m_stride;
+            mcl_word_t const* brow = b -> m_bits + (y - offset.y) * b -> m_stride;
+            for (point1d_t i = i0; i <= i1; ++ i)
+                if (!fun (arow + i, y, i, mcl_mask_fetch (brow, b -> m_stride, i * 64 - offset.x)))
+                    return false;
+        }
+        return true;
+    }
+
+    /**
+     * @function mcl_mask_t::from_surface <src/mask.h>
+     * @brief creates a mask from the given surface
+     * @param[in] surface
+     * @param[in] threshold: pixels with alpha greater than it are set (SrcAlpha)
+     * @return mask_t
+     */
+    mask_t mcl_mask_t::
+    from_surface (surface_t const& surface, color_t threshold) noexcept{
+        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        char*           data     = mcl_get_surface_data (&const_cast<surface_t&>(surface));
+        if (!dataplus) return mask_t ();
+
+        // lock
+        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_mask_t::from_surface");
+        point1d_t w = dataplus -> m_width, h = dataplus -> m_height;
+        bool    b_sa = data[0] & surface_t::SrcAlpha;
+        bool    b_ck = data[0] & surface_t::SrcColorKey;
+        color_t m_ck = dataplus -> m_colorkey;
+        if (threshold > 255) threshold = 255;
+
+        mask_t res ({w, h}, !b_sa && !b_ck);
+        mcl_maskbuf_t* buf = mcl_get_mask_dataplus (&res);
+        if (!buf || !buf -> m_bits || (!b_sa && !b_ck)) return res;
+
+        color_t const* src = dataplus -> m_pbuffer;
+        mcl_parallel_obj.run (h, static_cast<size_t>(w) * static_cast<size_t>(h),
+        [=] (point1d_t ib, point1d_t ie) {
+            for (point1d_t y = ib; y != ie; ++ y) {
+                color_t const* s = src + y * w;
+                mcl_word_t*    d = buf -> m_bits + y * buf -> m_stride;
+                for (point1d_t x = 0; x < w; x += 64, s += 64, ++ d) {
+                    point1d_t  n = w - x < 64 ? w - x : 64, j = 0;
+                    mcl_word_t bits = 0;
+#   ifdef MCL_SSE2
+                    // 4 pixels to 4 bits at a time
+                    __m128i const vthr = _mm_set1_epi32 (static_cast<int>(threshold));
+                    __m128i const vrgb = _mm_set1_epi32 (0xffffff);
+                    __m128i const vkey = _mm_set1_epi32 (static_cast<int>(m_ck));
+                    __m128i v;
+                    int     m = 0;
+                    for (; n - j >= 4; j += 4) {
+                        v = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(s + j));
+                        if (b_sa) m = _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpgt_epi32 (_mm_srli_epi32 (v, 24), vthr)));
+                        else      m = _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (_mm_and_si128 (v, vrgb), vkey))) ^ 0xf;
+                        bits |= static_cast<mcl_word_t>(m) << j;
+                    }
+#   endif
+                    for (; j != n; ++ j)
+                        if (b_sa ? (s[j] >> 24) > threshold : (s[j] & 0xffffff) != m_ck)
+                            bits |= 1ull << j;
+                    *d = bits;
+                }
+            }
+        });
+        return res;
+    }
+
+    /**
+     * @function mask_t::mask_t <src/mask.h>
+     * @brief constructor
+     * @param[in] size: dimensions of the mask
+     * @param[in] fill: whether to set all bits
+     */
+    mask_t::
+    mask_t (point2d_t size, bool fill) noexcept
+      : m_dataplus_ (mcl_mask_alloc (size.x, size.y)), m_data_ {0} {
+        if (fill) this -> fill ();
+    }
+
+    mask_t::
+    ~mask_t () noexcept{
+        mcl_mask_free (static_cast<mcl_maskbuf_t*>(m_dataplus_));
+        m_dataplus_ = nullptr;
+    }
+
+    mask_t::
+    mask_t (mask_t const& rhs) noexcept
+      : m_dataplus_ (nullptr), m_data_ {0} {
+        *this = rhs;
+    }
+
+    mask_t::
+    mask_t (mask_t&& rhs) noexcept
+      : m_dataplus_ (rhs.m_dataplus_), m_data_ {0} {
+        rhs.m_dataplus_ = nullptr;
+    }
+
+    mask_t& mask_t::
+    operator= (mask_t const& rhs) noexcept{
+        if (m_dataplus_ == rhs.m_dataplus_) return *this;
+        mcl_maskbuf_t* src = static_cast<mcl_maskbuf_t*>(rhs.m_dataplus_);
+        mcl_maskbuf_t* cpy = src ? mcl_mask_alloc (src -> m_width, src -> m_height) : nullptr;
+        if (cpy && cpy -> m_bits)
+            ::memcpy (cpy -> m_bits, src -> m_bits, static_cast<size_t>(src -> m_stride)
+                * static_cast<size_t>(src -> m_height) * sizeof (mcl_word_t));
+        mcl_mask_free (static_cast<mcl_maskbuf_t*>(m_dataplus_));
+        m_dataplus_ = cpy;
+        return *this;
+    }
+
+    mask_t& mask_t::
+    operator= (mask_t&& rhs) noexcept{
+        if (m_dataplus_ == rhs.m_dataplus_) return *this;
+        mcl_mask_free (static_cast<mcl_maskbuf_t*>(m_dataplus_));
+        m_dataplus_ = rhs.m_dataplus_;
+        rhs.m_dataplus_ = nullptr;
+        return *this;
+    }
+
+    mask_t::
+    operator void* () const noexcept{
+        return m_dataplus_ ? const_cast<mask_t*>(this) : nullptr;
+    }
+
+    bool mask_t::
+    operator! () const noexcept{
+        return !m_dataplus_;
+    }
+
+    /**
+     * @function mask_t::get_size <src/mask.h>
+     * @brief get the dimensions of the mask
+     * @return point2d_t
+     */
+    point2d_t mask_t::
+    get_size () const noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf) return {0, 0};
+        return {buf -> m_width, buf -> m_height};
+    }
+
+    /**
+     * @function mask_t::get_rect <src/mask.h>
+     * @brief get the rectangular area of the mask
+     * @return rect_t
+     */
+    rect_t mask_t::
+    get_rect () const noexcept{
+        point2d_t size = get_size ();
+        return {0, 0, size.x, size.y};
+    }
+
+    /**
+     * @function mask_t::get_at <src/mask.h>
+     * @brief gets the bit at the given position
+     * @param[in] pos
+     * @return bool: false if pos is out of the mask
+     */
+    bool mask_t::
+    get_at (point2d_t pos) const noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf || pos.x < 0 || pos.y < 0 || pos.x >= buf -> m_width || pos.y >= buf -> m_height)
+            return false;
+        return (buf -> m_bits[pos.y * buf -> m_stride + (pos.x >> 6)] >> (pos.x & 63)) & 1ull;
+    }
+
+    /**
+     * @function mask_t::set_at <src/mask.h>
+     * @brief sets the bit at the given position
+     * @param[in] pos
+     * @param[in] value
+     * @return void
+     */
+    void mask_t::
+    set_at (point2d_t pos, bool value) noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf || pos.x < 0 || pos.y < 0 || pos.x >= buf -> m_width || pos.y >= buf -> m_height)
+            return ;
+        mcl_word_t& word = buf -> m_bits[pos.y * buf -> m_stride + (pos.x >> 6)];
+        if (value) word |= 1ull << (pos.x & 63);
+        else word &= ~(1ull << (pos.x & 63));
+    }
+
+    /**
+     * @function mask_t::overlap <src/mask.h>
+     * @brief checks if other placed at offset overlaps this one
+     * @param[in] other
+     * @param[in] offset: position of other relative to this mask
+     * @param[out] pos: the first overlapping point, row by row
+     * @return bool
+     */
+    bool mask_t::
+    overlap (mask_t const& other, point2d_t offset, point2d_t* pos) const noexcept{
+        mcl_maskbuf_t* a = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        mcl_maskbuf_t* b = static_cast<mcl_maskbuf_t*>(other.m_dataplus_);
+        if (!a || !b) return false;
+        return !mcl_mask_each (a, b, offset,
+        [pos] (mcl_word_t* pa, point1d_t y, point1d_t i, mcl_word_t wb) -> bool {
+            mcl_word_t both = *pa & wb;
+            if (!both) return true;
+            if (pos) *pos = {i * 64 + mcl_lsb64 (both), y};
+            return false;
+        });
+    }
+
+    /**
+     * @function mask_t::overlap_area <src/mask.h>
+     * @brief gets the number of overlapping set bits
+     * @param[in] other
+     * @param[in] offset: position of other relative to this mask
+     * @return size_t
+     */
+    size_t mask_t::
+    overlap_area (mask_t const& other, point2d_t offset) const noexcept{
+        mcl_maskbuf_t* a = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        mcl_maskbuf_t* b = static_cast<mcl_maskbuf_t*>(other.m_dataplus_);
+        if (!a || !b) return 0;
+        size_t n = 0;
+        mcl_mask_each (a, b, offset,
+        [&n] (mcl_word_t* pa, point1d_t, point1d_t, mcl_word_t wb) -> bool {
+            n += mcl_popcount64 (*pa & wb);
+            return true;
+        });
+        return n;
+    }
+
+    /**
+     * @function mask_t::overlap_mask <src/mask.h>
+     * @brief gets a mask of the overlapping set bits
+     * @param[in] other
+     * @param[in] offset: position of other relative to this mask
+     * @return mask_t: the size of this mask
+     */
+    mask_t mask_t::
+    overlap_mask (mask_t const& other, point2d_t offset) const noexcept{
+        mcl_maskbuf_t* a = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        mcl_maskbuf_t* b = static_cast<mcl_maskbuf_t*>(other.m_dataplus_);
+        if (!a || !b) return mask_t ();
+        mask_t res ({a -> m_width, a -> m_height});
+        mcl_maskbuf_t* r = static_cast<mcl_maskbuf_t*>(res.m_dataplus_);
+        if (!r) return res;
+        mcl_mask_each (a, b, offset,
+        [a, r] (mcl_word_t* pa, point1d_t, point1d_t, mcl_word_t wb) -> bool {
+            r -> m_bits[pa - a -> m_bits] = *pa & wb;
+            return true;
+        });
+        return res;
+    }
+
+    /**
+     * @function mask_t::fill <src/mask.h>
+     * @brief sets all bits to 1
+     * @return void
+     */
+    void mask_t::
+    fill () noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf || !buf -> m_bits) return ;
+        mcl_word_t tail = mcl_mask_tail (buf -> m_width);
+        for (point1d_t y = 0; y != buf -> m_height; ++ y) {
+            mcl_word_t* row = buf -> m_bits + y * buf -> m_stride;
+            for (point1d_t i = 0; i != buf -> m_stride; ++ i) row[i] = ~0ull;
+            row[buf -> m_stride - 1] = tail;
+        }
+    }
+
+    /**
+     * @function mask_t::clear <src/mask.h>
+     * @brief sets all bits to 0
+     * @return void
+     */
+    void mask_t::
+    clear () noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf || !buf -> m_bits) return ;
+        ::memset (buf -> m_bits, 0, static_cast<size_t>(buf -> m_stride)
+            * static_cast<size_t>(buf -> m_height) * sizeof (mcl_word_t));
+    }
+
+    /**
+     * @function mask_t::invert <src/mask.h>
+     * @brief flips all the bits
+     * @return void
+     */
+    void mask_t::
+    invert () noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf || !buf -> m_bits) return ;
+        mcl_word_t tail = mcl_mask_tail (buf -> m_width);
+        for (point1d_t y = 0; y != buf -> m_height; ++ y) {
+            mcl_word_t* row = buf -> m_bits + y * buf -> m_stride;
+            for (point1d_t i = 0; i != buf -> m_stride; ++ i) row[i] = ~row[i];
+            row[buf -> m_stride - 1] &= tail;
+        }
+    }
+
+    /**
+     * @function mask_t::draw <src/mask.h>
+     * @brief sets the bits set in other placed at offset
+     * @param[in] other
+     * @param[in] offset: position of other relative to this mask
+     * @return void
+     */
+    void mask_t::
+    draw (mask_t const& other, point2d_t offset) noexcept{
+        mcl_maskbuf_t* a = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        mcl_maskbuf_t* b = static_cast<mcl_maskbuf_t*>(other.m_dataplus_);
+        if (!a || !b) return ;
+        if (a == b) {
+            mask_t cpy (other);
+            draw (cpy, offset);
+            return ;
+        }
+        point1d_t  last = a -> m_stride - 1;
+        mcl_word_t tail = mcl_mask_tail (a -> m_width);
+        mcl_mask_each (a, b, offset,
+        [last, tail] (mcl_word_t* pa, point1d_t, point1d_t i, mcl_word_t wb) -> bool {
+            *pa |= i == last ? wb & tail : wb;
+            return true;
+        });
+    }
+
+    /**
+     * @function mask_t::erase <src/mask.h>
+     * @brief clears the bits set in other placed at offset
+     * @param[in] other
+     * @param[in] offset: position of other relative to this mask
+     * @return void
+     */
+    void mask_t::
+    erase (mask_t const& other, point2d_t offset) noexcept{
+        mcl_maskbuf_t* a = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        mcl_maskbuf_t* b = static_cast<mcl_maskbuf_t*>(other.m_dataplus_);
+        if (!a || !b) return ;
+        if (a == b) {
+            mask_t cpy (other);
+            erase (cpy, offset);
+            return ;
+        }
+        mcl_mask_each (a, b, offset,
+        [] (mcl_word_t* pa, point1d_t, point1d_t, mcl_word_t wb) -> bool {
+            *pa &= ~wb;
+            return true;
+        });
+    }
+
+    /**
+     * @function mask_t::count <src/mask.h>
+     * @brief gets the number of set bits
+     * @return size_t
+     */
+    size_t mask_t::
+    count () const noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf) return 0;
+        size_t     n = 0;
+        point1d_t  words = buf -> m_stride * buf -> m_height;
+        for (point1d_t i = 0; i != words; ++ i)
+            n += mcl_popcount64 (buf -> m_bits[i]);
+        return n;
+    }
+
+    /**
+     * @function mask_t::centroid <src/mask.h>
+     * @brief gets the centroid of the set bits
+     * @return point2d_t: (0, 0) if no bit is set
+     */
+    point2d_t mask_t::
+    centroid () const noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf) return {0, 0};
+
+        // bit k of the positions of set bits, summed by counting the bits
+        // in the positions where bit k is 1
+        static mcl_word_t const planes[6] = {
+            0xaaaaaaaaaaaaaaaaull, 0xccccccccccccccccull, 0xf0f0f0f0f0f0f0f0ull,
+            0xff00ff00ff00ff00ull, 0xffff0000ffff0000ull, 0xffffffff00000000ull
+        };
+        unsigned long long n = 0, sx = 0, sy = 0, nrow = 0, nw = 0;
+        for (point1d_t y = 0; y != buf -> m_height; ++ y) {
+            mcl_word_t const* row = buf -> m_bits + y * buf -> m_stride;
+            nrow = 0;
+            for (point1d_t i = 0; i != buf -> m_stride; ++ i) {
+                if (!row[i]) continue;
+                nw = mcl_popcount64 (row[i]);
+                nrow += nw;
+                sx += nw * static_cast<unsigned long long>(i) * 64ull;
+                for (int k = 0; k != 6; ++ k)
+                    sx += mcl_popcount64 (row[i] & planes[k]) << k;
+            }
+            n += nrow;
+            sy += nrow * static_cast<unsigned long long>(y);
+        }
+        if (!n) return {0, 0};
+        return {static_cast<point1d_t>(sx / n), static_cast<point1d_t>(sy / n)};
+    }
+
+    /**
+     * @function mask_t::get_bounding_rect <src/mask.h>
+     * @brief gets the smallest rect containing all set bits
+     * @return rect_t: (0, 0, 0, 0) if no bit is set
+     */
+    rect_t mask_t::
+    get_bounding_rect () const noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf || !buf -> m_bits) return {0, 0, 0, 0};
+        mcl_simpletls_ns::mcl_auto_ptr_t<mcl_word_t> cols (static_cast<size_t>(buf -> m_stride));
+        mcl_word_t* pcols = cols;
+        if (!pcols) return {0, 0, 0, 0};
+
+        // or all rows together for the columns
+        point1d_t y0 = -1, y1 = -1;
+        ::memset (pcols, 0, static_cast<size_t>(buf -> m_stride) * sizeof (mcl_word_t));
+        for (point1d_t y = 0; y != buf -> m_height; ++ y) {
+            mcl_word_t const* row = buf -> m_bits + y * buf -> m_stride;
+            mcl_word_t any = 0;
+            for (point1d_t i = 0; i != buf -> m_stride; ++ i)
+                any |= row[i], pcols[i] |= row[i];
+            if (!any) continue;
+            if (y0 < 0) y0 = y;
+            y1 = y;
+        }
+        if (y0 < 0) return {0, 0, 0, 0};
+        point1d_t i0 = 0, i1 = buf -> m_stride - 1;
+        while (!pcols[i0]) ++ i0;
+        while (!pcols[i1]) -- i1;
+        point1d_t x0 = i0 * 64 + mcl_lsb64 (pcols[i0]);
+        point1d_t x1 = i1 * 64 + mcl_msb64 (pcols[i1]);
+        return {x0, y0, x1 - x0 + 1, y1 - y0 + 1};
+    }
+
+    // next bit at or after from that is set (or unset). width if none
+    static inline point1d_t
+    mcl_mask_next (mcl_word_t const* row, point1d_t stride, point1d_t width,
+      point1d_t from, bool set) noexcept{
+        if (from >= width) return width;
+        point1d_t  i = from >> 6;
+        mcl_word_t w = (set ? row[i] : ~row[i]) & (~0ull << (from & 63));
+        while (!w) {
+            if (++ i == stride) return width;
+            w = set ? row[i] : ~row[i];
+        }
+        point1d_t x = i * 64 + mcl_lsb64 (w);
+        return x < width ? x : width;
+    }
+
+   /**
+    * @class mcl_maskrun_t <cpp/mask.cpp>
+    * @brief a run of set bits [x0, x1) in row y. label is the
+    *     union-find parent, then the component.
+    */
+    struct mcl_maskrun_t {
+        point1d_t y, x0, x1;
+        size_t    label;
+    };
+
+    static size_t
+    mcl_mask_find (std::vector<mcl_maskrun_t>& runs, size_t i) noexcept{
+        while (runs[i].label != i) {
+            runs[i].label = runs[runs[i].label].label; // path halving
+            i = runs[i].label;
+        }
+        return i;
+    }
+
+    /**
+     * @function mcl_mask_label <cpp/mask.cpp>
+     * @brief labels the 8-connected components, as a two-pass union-find
+     *     over the runs of set bits. components are numbered by their
+     *     first run, row by row.
+     * @param[out] runs: runs of set bits, labeled with their component
+     * @return size_t: number of components
+     */
+    static size_t
+    mcl_mask_label (mcl_maskbuf_t const* buf, std::vector<mcl_maskrun_t>& runs) noexcept{
+        runs.clear ();
+        if (!buf || !buf -> m_bits) return 0;
+        point1d_t w = buf -> m_width;
+
+        // first pass: find runs, and union those touching runs in the row above
+        size_t prev = 0, cur = 0;
+        for (point1d_t y = 0; y != buf -> m_height; ++ y) {
+            mcl_word_t const* row = buf -> m_bits + y * buf -> m_stride;
+            cur = runs.size ();
+            size_t j = prev;
+            for (point1d_t x = mcl_mask_next (row, buf -> m_stride, w, 0, true); x != w;
+              x = mcl_mask_next (row, buf -> m_stride, w, x, true)) {
+                mcl_maskrun_t run;
+                run.y = y, run.x0 = x, run.label = runs.size ();
+                x = run.x1 = mcl_mask_next (row, buf -> m_stride, w, x, false);
+                runs.push_back (run);
+
+                // runs above touch this one if they reach [x0 - 1, x1]
+                while (j != cur && runs[j].x1 < run.x0) ++ j;
+                for (size_t k = j; k != cur && runs[k].x0 <= run.x1; ++ k) {
+                    size_t ra = mcl_mask_find (runs, k), rb = mcl_mask_find (runs, run.label);
+                    if (ra < rb) runs[rb].label = ra;
+                    else if (rb < ra) runs[ra].label = rb;
+                }
+            }
+            prev = cur;
+        }
+
+        // second pass: number the roots in order. parents always come first
+        size_t n = 0;
+        for (size_t i = 0; i != runs.size (); ++ i)
+            runs[i].label = (runs[i].label == i) ? n ++ : runs[runs[i].label].label;
+        return n;
+    }
+
+    // draws the runs of component label into a cleared mask
+    static void
+    mcl_mask_draw_runs (mcl_maskbuf_t* buf, std::vector<mcl_maskrun_t> const& runs, size_t label) noexcept{
+        for (mcl_maskrun_t const& run : runs) {
+            if (run.label != label) continue;
+            mcl_word_t* row = buf -> m_bits + run.y * buf -> m_stride;
+            for (point1d_t x = run.x0; x < run.x1; ) {
+                point1d_t  n = 64 - (x & 63);
+                if (n > run.x1 - x) n = run.x1 - x;
+                row[x >> 6] |= (n == 64 ? ~0ull : ((1ull << n) - 1ull)) << (x & 63);
+                x += n;
+            }
+        }
+    }
+
+    /**
+     * @function mask_t::outline <src/mask.h>
+     * @brief gets the outline of the first connected component, row by row,
+     *     traced clockwise from its top left point
+     * @param[in] every: keep every n-th point
+     * @return std::vector<point2d_t>
+     */
+    std::vector<point2d_t> mask_t::
+    outline (point1d_t every) const noexcept{
+        std::vector<point2d_t> res;
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf || !buf -> m_bits) return res;
+        if (every < 1) every = 1;
+
+        // the first set bit
+        point2d_t start = {-1, 0};
+        for (point1d_t y = 0; y != buf -> m_height && start.x < 0; ++ y) {
+            point1d_t x = mcl_mask_next (buf -> m_bits + y * buf -> m_stride,
+                buf -> m_stride, buf -> m_width, 0, true);
+            if (x != buf -> m_width) start = {x, y};
+        }
+        if (start.x < 0) return res;
+
+        // moore-neighbor tracing. neighbors clockwise from the west
+        static point1d_t const dx[8] = { -1, -1,  0,  1,  1,  1,  0, -1 };
+        static point1d_t const dy[8] = {  0, -1, -1, -1,  0,  1,  1,  1 };
+        point2d_t p = start, q = start, second = start;
+        int       back = 0;  // direction from p to the last unset neighbor
+        size_t    n = 0, limit = count () * 4u + 8u;
+        res.push_back (start);
+        for (size_t step = 0; step != limit; ++ step) {
+            int d = back, k = 1;
+            for (; k != 8; ++ k) {
+                d = (back + k) & 7;
+                q = {p.x + dx[d], p.y + dy[d]};
+                if (get_at (q)) break;
+            }
+            if (k == 8) break; // a lonely point
+
+            // stop before taking the first step again
+            if (step && p.x == start.x && p.y == start.y && q.x == second.x && q.y == second.y)
+                break;
+            if (!step) second = q;
+
+            // the neighbor before q, seen from q
+            point2d_t b = {p.x + dx[(d + 7) & 7], p.y + dy[(d + 7) & 7]};
+            for (back = 0; back != 8; ++ back)
+                if (q.x + dx[back] == b.x && q.y + dy[back] == b.y) break;
+            p = q;
+            if (++ n % static_cast<size_t>(every) == 0) res.push_back (p);
+        }
+        // the path ends where it starts
+        if (res.size () > 1 && res.back ().x == start.x && res.back ().y == start.y)
+            res.pop_back ();
+        return res;
+    }
+
+    /**
+     * @function mask_t::connected_component <src/mask.h>
+     * @brief gets the largest connected component (8-connected)
+     * @return mask_t: the size of this mask
+     */
+    mask_t mask_t::
+    connected_component () const noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf) return mask_t ();
+        mask_t res ({buf -> m_width, buf -> m_height});
+        mcl_maskbuf_t* r = static_cast<mcl_maskbuf_t*>(res.m_dataplus_);
+        std::vector<mcl_maskrun_t> runs;
+        size_t n = mcl_mask_label (buf, runs);
+        if (!r || !n) return res;
+
+        std::vector<size_t> sizes (n, 0);
+        size_t best = 0;
+        for (mcl_maskrun_t const& run : runs)
+            sizes[run.label] += static_cast<size_t>(run.x1 - run.x0);
+        for (size_t i = 1; i != n; ++ i)
+            if (sizes[i] > sizes[best]) best = i;
+        mcl_mask_draw_runs (r, runs, best);
+        return res;
+    }
+
+    /**
+     * @function mask_t::connected_component <src/mask.h>
+     * @brief gets the connected component containing pos
+     * @param[in] pos
+     * @return mask_t: empty if the bit at pos is not set
+     */
+    mask_t mask_t::
+    connected_component (point2d_t pos) const noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf) return mask_t ();
+        mask_t res ({buf -> m_width, buf -> m_height});
+        mcl_maskbuf_t* r = static_cast<mcl_maskbuf_t*>(res.m_dataplus_);
+        if (!r || !get_at (pos)) return res;
+
+        std::vector<mcl_maskrun_t> runs;
+        mcl_mask_label (buf, runs);
+        for (mcl_maskrun_t const& run : runs)
+            if (run.y == pos.y && run.x0 <= pos.x && pos.x < run.x1) {
+                mcl_mask_draw_runs (r, runs, run.label);
+                break;
+            }
+        return res;
+    }
+
+    /**
+     * @function mask_t::connected_components <src/mask.h>
+     * @brief gets the connected components, in the order of their first
+     *     set bit row by row
+     * @param[in] minimum: least set bits of a component
+     * @return std::vector<mask_t>: masks the size of this mask
+     */
+    std::vector<mask_t> mask_t::
+    connected_components (size_t minimum) const noexcept{
+        std::vector<mask_t> res;
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        std::vector<mcl_maskrun_t> runs;
+        size_t n = mcl_mask_label (buf, runs);
+        if (!n) return res;
+
+        std::vector<size_t> sizes (n, 0);
+        for (mcl_maskrun_t const& run : runs)
+            sizes[run.label] += static_cast<size_t>(run.x1 - run.x0);
+        for (size_t i = 0; i != n; ++ i) {
+            if (sizes[i] < minimum) continue;
+            res.push_back (mask_t ({buf -> m_width, buf -> m_height}));
+            mcl_maskbuf_t* r = static_cast<mcl_maskbuf_t*>(res.back ().m_dataplus_);
+            if (r) mcl_mask_draw_runs (r, runs, i);
+        }
+        return res;
+    }
+
+    /**
+     * @function mask_t::get_bounding_rects <src/mask.h>
+     * @brief gets the bounding rects of the connected components
+     * @return std::vector<rect_t>
+     */
+    std::vector<rect_t> mask_t::
+    get_bounding_rects () const noexcept{
+        std::vector<rect_t> res;
+        std::vector<mcl_maskrun_t> runs;
+        size_t n = mcl_mask_label (static_cast<mcl_maskbuf_t*>(m_dataplus_), runs);
+        if (!n) return res;
+
+        // x1, y1 are kept in w, h until the end
+        res.assign (n, rect_t{0, 0, -1, -1});
+        for (mcl_maskrun_t const& run : runs) {
+            rect_t& rc = res[run.label];
+            if (rc.w < 0) { rc = {run.x0, run.y, run.x1, run.y + 1}; continue; }
+            if (run.x0 < rc.x) rc.x = run.x0;
+            if (run.x1 > rc.w) rc.w = run.x1;
+            rc.h = run.y + 1;
+        }
+        for (rect_t& rc : res)
+            rc.w -= rc.x, rc.h -= rc.y;
+        return res;
+    }
+
+    /**
+     * @function mcl_mask_morph <cpp/mask.cpp>
+     * @brief ors (dilate) or ands (erode) each bit with its neighbors in
+     *     a square of the given radius. bits outside count as unset.
+     *     each half of a window is built by doubling, so a radius costs
+     *     O(log radius) word passes.
+     * @return mask_t
+     */
+    static mask_t
+    mcl_mask_morph (mask_t const& src, mcl_maskbuf_t const* buf, point1d_t radius, bool b_or) noexcept{
+        if (!buf || radius <= 0 || !buf -> m_bits) return src;
+        point1d_t w = buf -> m_width, h = buf -> m_height, stride = buf -> m_stride;
+        if (radius > w + h) radius = w + h;
+        size_t    words = static_cast<size_t>(stride) * static_cast<size_t>(h);
+        mask_t res ({w, h});
+        mcl_maskbuf_t* r = mcl_get_mask_dataplus (&res);
+        mcl_simpletls_ns::mcl_auto_ptr_t<mcl_word_t> tmp (words * 3u), zero (static_cast<size_t>(stride));
+        mcl_word_t* pf = tmp, *pz = zero;
+        if (!r || !pf || !pz) return mask_t ();
+        mcl_word_t* pb = pf + words, *pt = pb + words;
+        ::memset (pz, 0, static_cast<size_t>(stride) * sizeof (mcl_word_t));
+        mcl_word_t tail = mcl_mask_tail (w);
+
+        // row y of out covers rows [y, y + sign * radius] (b_rows),
+        // or bit x covers bits [x, x + sign * radius]
+        auto fhalf = [=] (mcl_word_t const* in, mcl_word_t* out, point1d_t sign, bool b_rows) {
+            mcl_word_t const* s = in;
+            mcl_word_t*       d = out != in ? out : pt;
+            for (point1d_t covered = 1, step = 0; covered <= radius; covered += step) {
+                step = covered <= radius + 1 - covered ? covered : radius + 1 - covered;
+                for (point1d_t y = 0; y != h; ++ y) {
+                    mcl_word_t const* s0 = s + y * stride, *s1 = pz;
+                    mcl_word_t*       d0 = d + y * stride;
+                    point1d_t         ys = y + sign * step;
+                    if (b_rows && ys >= 0 && ys < h) s1 = s + ys * stride;
+                    for (point1d_t i = 0; i != stride; ++ i) {
+                        mcl_word_t v = b_rows ? s1[i] : mcl_mask_fetch (s0, stride, i * 64 + sign * step);
+                        d0[i] = b_or ? s0[i] | v : s0[i] & v;
+                    }
+                    d0[stride - 1] &= tail;
+                }
+                s = d, d = (d == out) ? pt : out;
+            }
+            if (s != out) ::memcpy (out, s, words * sizeof (mcl_word_t));
+        };
+        // both halves of rows, then both halves of columns
+        auto fboth = [=] (mcl_word_t const* in, mcl_word_t* out, bool b_rows) {
+            fhalf (in, pf, 1, b_rows);
+            fhalf (in, pb, -1, b_rows);
+            for (size_t i = 0; i != words; ++ i)
+                out[i] = b_or ? pf[i] | pb[i] : pf[i] & pb[i];
+        };
+        fboth (buf -> m_bits, r -> m_bits, false);
+        fboth (r -> m_bits, r -> m_bits, true);
+        return res;
+    }
+
+    /**
+     * @function mask_t::erode <src/mask.h>
+     * @brief clears bits with an unset bit in the square of the given radius.
+     *     bits outside the mask count as unset
+     * @param[in] radius
+     * @return mask_t
+     */
+    mask_t mask_t::
+    erode (point1d_t radius) const noexcept{
+        return mcl_mask_morph (*this, static_cast<mcl_maskbuf_t*>(m_dataplus_), radius, false);
+    }
+
+    /**
+     * @function mask_t::dilate <src/mask.h>
+     * @brief sets bits with a set bit in the square of the given radius
+     * @param[in] radius
+     * @return mask_t
+     */
+    mask_t mask_t::
+    dilate (point1d_t radius) const noexcept{
+        return mcl_mask_morph (*this, static_cast<mcl_maskbuf_t*>(m_dataplus_), radius, true);
+    }
+
+    /**
+     * @function mask_t::to_surface <src/mask.h>
+     * @brief returns a surface with set bits drawn in setcolor
+     *     and unset bits in unsetcolor
+     * @param[in] setcolor
+     * @param[in] unsetcolor
+     * @return surface_t
+     */
+    surface_t mask_t::
+    to_surface (color_t setcolor, color_t unsetcolor) const noexcept{
+        mcl_maskbuf_t* buf = static_cast<mcl_maskbuf_t*>(m_dataplus_);
+        if (!buf || !buf -> m_bits) return sf_nullptr;
+        surface_t res ({buf -> m_width, buf -> m_height});
+        mcl_imagebuf_t* res_dataplus = mcl_get_surface_dataplus (&res);
+        if (!res_dataplus || !res_dataplus -> m_width) return sf_nullptr;
+
+        color_t*  dst = res_dataplus -> m_pbuffer;
+        point1d_t w = buf -> m_width;
+        mcl_parallel_obj.run (buf -> m_height, static_cast<size_t>(w) * static_cast<size_t>(buf -> m_height),
+        [=] (point1d_t ib, point1d_t ie) {
+            for (point1d_t y = ib; y != ie; ++ y) {
+                mcl_word_t const* row = buf -> m_bits + y * buf -> m_stride;
+                color_t*          d = dst + y * w;
+                for (point1d_t x = 0; x != w; ++ x)
+                    d[x] = ((row[x >> 6] >> (x & 63)) & 1ull) ? setcolor : unsetcolor;
+            }
+        });
+        return res;
+    }
+
+} // namespace
@@ -97,6 +97,145 @@ namespace mcl
         frequency = tickCount.QuadPart;
     }
     
+
+    mcl_parallel_t mcl_parallel_obj;
+
+   /**
+    * @function mcl_parallel_t::~mcl_parallel_t <cpp/mcl_base.h>
+    * @brief Destructor. Wakes idle workers and waits for them
+    *     to exit before the pool goes away.
+    * @return nothing
+    */
+    mcl_parallel_t::~mcl_parallel_t () noexcept{
+        stop_ = true;
+        if (wake_ && nworkers_) {
+            ::ReleaseSemaphore (wake_, static_cast<LONG>(nworkers_), nullptr);
+            ::WaitForMultipleObjects (nworkers_, workers_, TRUE, INFINITE);
+        }
+        for (unsigned long i = 0; i != nworkers_; ++ i)
+            ::CloseHandle (workers_[i]);
+        if (wake_) ::CloseHandle (wake_);
+        if (done_) ::CloseHandle (done_);
+    }
+
+   /**
+    * @function mcl_parallel_t::get_threads <cpp/mcl_base.h>
+    * @brief number of threads a job may use, including the caller
+    * @return unsigned long
+    */
+    unsigned long mcl_parallel_t::
+    get_threads () noexcept{
+        unsigned long cnt = threads;
+        if (!cnt) {
+            SYSTEM_INFO si;
+            ::GetSystemInfo (&si);
+            cnt = si.dwNumberOfProcessors;
+        }
+        if (cnt > max_workers + 1) cnt = max_workers + 1;
+        return cnt ? cnt : 1;
+    }
+
+   /**
+    * @function mcl_parallel_t::worker_proc <cpp/mcl_base.h>
+    * @brief thread function of workers
+    * @param[in] param: the pool
+    * @return unsigned
+    */
+    unsigned __stdcall mcl_parallel_t::
+    worker_proc (void* param) {
+        mcl_parallel_t* pool = static_cast<mcl_parallel_t*>(param);
+        for (;;) {
+            ::WaitForSingleObject (pool -> wake_, INFINITE);
+            if (pool -> stop_) break;
+            pool -> run_bands ();
+            if (!::InterlockedDecrement (&pool -> pending_))
+                ::SetEvent (pool -> done_);
+        }
+        return 0;
+    }
+
+   /**
+    * @function mcl_parallel_t::run_bands <cpp/mcl_base.h>
+    * @brief takes bands of the current job until there are none left
+    * @return void
+    */
+    void mcl_parallel_t::
+    run_bands () noexcept{
+        for (;;) {
+            long begin = static_cast<long>(::InterlockedIncrement (&next_) - 1) * band_;
+            if (begin >= rows_) break;
+            long end = begin + band_;
+            (*job_) (begin, end < rows_ ? end : rows_);
+        }
+    }
+
+   /**
+    * @function mcl_parallel_t::start_workers <cpp/mcl_base.h>
+    * @brief makes sure that at least cnt workers are waiting
+    * @param[in] cnt: number of workers
+    * @return bool: whether any worker is available
+    */
+    bool mcl_parallel_t::
+    start_workers (unsigned long cnt) noexcept{
+        if (!wake_) wake_ = ::CreateSemaphoreW (nullptr, 0, static_cast<LONG>(max_workers), nullptr);
+        if (!done_) done_ = ::CreateEventW (nullptr, FALSE, FALSE, nullptr);
+        if (!wake_ || !done_) return false;
+#       ifdef _MSC_VER
+#           pragma warning(push)
+#           pragma warning(disable: 5039)
+#       endif // never throw an exception passed to extern C function
+        for (; nworkers_ < cnt; ++ nworkers_) {
+            workers_[nworkers_] = HANDLE(::_beginthreadex (nullptr, 0, worker_proc, this, 0, nullptr));
+            if (!workers_[nworkers_]) break;
+        }
+#       ifdef _MSC_VER
+#           pragma warning(pop)
+#       endif
+        return nworkers_ != 0;
+    }
+
+   /**
+    * @function mcl_parallel_t::run <cpp/mcl_base.h>
+    * @brief calls fun (begin, end) over bands of [0, rows) and waits for all of them.
+    *     A job from inside another job, or from another thread while the pool is
+    *     busy, runs on the calling thread.
+    * @param[in] rows: number of rows
+    * @param[in] work: number of pixels written
+    * @param[in] fun: band function
+    * @return void
+    */
+    void mcl_parallel_t::
+    run (long rows, size_t work, band_fun_t const& fun) noexcept{
+        if (rows <= 0) return ;
+        unsigned long cnt = (rows > 1 && work >= min_work) ? get_threads () : 1;
+        if (cnt > static_cast<unsigned long>(rows)) cnt = static_cast<unsigned long>(rows);
+        if (cnt < 2 || ::InterlockedCompareExchange (&busy_, 1, 0)) {
+            fun (0, rows);
+            return ;
+        }
+        if (!start_workers (cnt - 1)) {
+            ::InterlockedExchange (&busy_, 0);
+            fun (0, rows);
+            return ;
+        }
+        if (cnt > nworkers_ + 1) cnt = nworkers_ + 1;
+
+        // a few bands per thread keeps uneven rows balanced
+        long bands = static_cast<long>(cnt) << 2;
+        if (bands > rows) bands = rows;
+        job_  = &fun;
+        rows_ = rows;
+        band_ = (rows + bands - 1) / bands;
+        ::InterlockedExchange (&next_, 0);
+        ::InterlockedExchange (&pending_, static_cast<LONG>(cnt - 1));
+        ::ReleaseSemaphore (wake_, static_cast<LONG>(cnt - 1), nullptr);
+
+        run_bands ();
+        ::WaitForSingleObject (done_, INFINITE);
+        job_ = nullptr;
+        ::InterlockedExchange (&busy_, 0);
+    }
+
     
     namespace mcl_simpletls_ns
     {
@@ -208,5 +347,31 @@ namespace mcl
         }
         
         
+       /**
+        * @class mcl_mapfile_t <cpp/mcl_base.h>
+        * @brief read-only view of a whole file. empty files fail
+        */
+        mcl_mapfile_t::mcl_mapfile_t (wchar_t const* filename) noexcept {
+            if (!filename) return ;
+            m_file = ::CreateFileW (filename, GENERIC_READ, FILE_SHARE_READ,
+                nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (m_file == INVALID_HANDLE_VALUE) return ;
+            LARGE_INTEGER li;
+            if (!::GetFileSizeEx (m_file, &li) || li.QuadPart <= 0
+                || static_cast<unsigned long long>(li.QuadPart) > static_cast<size_t>(-1))
+                return ;
+            m_map = ::CreateFileMappingW (m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!m_map) return ;
+            m_view = static_cast<unsigned char const*>(
+                ::MapViewOfFile (m_map, FILE_MAP_READ, 0, 0, 0));
+            if (m_view) m_size = static_cast<size_t>(li.QuadPart);
+        }
+        mcl_mapfile_t::~mcl_mapfile_t () noexcept {
+            if (m_view) ::UnmapViewOfFile (m_view);
+            if (m_map) ::CloseHandle (m_map);
+            if (m_file != INVALID_HANDLE_VALUE) ::CloseHandle (m_file);
+        }
+        
+        
     }
 }
@@ -56,6 +56,10 @@
 # include <process.h>
 # include <shellapi.h>
 # undef WIN32_LEAN_AND_MEAN
+# if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define MCL_SSE2
+#  include <emmintrin.h>
+# endif
 
 # ifdef _MSC_VER
 #  pragma warning(pop)
@@ -214,6 +218,26 @@ namespace mcl
         inline operator char* () const noexcept{ return auto_ptr_; }
         inline size_t len () const noexcept { return len_; }
     };
+
+   /**
+    * @class mcl_mapfile_t <cpp/mcl_base.h>
+    * @brief read-only view of a whole file
+    */
+    class
+    mcl_mapfile_t {
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        HANDLE m_map  = nullptr;
+        unsigned char const* m_view = nullptr;
+        size_t m_size = 0;
+    public:
+        explicit mcl_mapfile_t (wchar_t const* filename) noexcept;
+        ~mcl_mapfile_t () noexcept;
+        mcl_mapfile_t (mcl_mapfile_t const&) = delete;
+        mcl_mapfile_t& operator= (mcl_mapfile_t const&) = delete;
+        inline bool operator! () const noexcept{ return !m_view; }
+        inline unsigned char const* data () const noexcept{ return m_view; }
+        inline size_t size () const noexcept{ return m_size; }
+    };
     
     
    /**
@@ -293,7 +317,52 @@ namespace mcl
         char : 8; char : 8; char : 8; char : 8;
     };
     extern mcl_base_t mcl_base_obj;
-    
+
+
+   /**
+    * @class mcl_parallel_t <cpp/mcl_base.h>
+    * @brief worker pool running rows of an image in bands
+    */
+    class mcl_parallel_t {
+    public:
+        using band_fun_t = std::function<void(long, long)>;
+        mcl_parallel_t () noexcept = default;
+        ~mcl_parallel_t () noexcept;
+        mcl_parallel_t (mcl_parallel_t const&) = delete;
+        mcl_parallel_t& operator= (mcl_parallel_t const&) = delete;
+
+        // calls fun (begin, end) over bands of [0, rows) and waits for all of them.
+        // work is the number of pixels written; small jobs stay on this thread
+        void run (long rows, size_t work, band_fun_t const& fun) noexcept;
+        // number of threads a job may use, including the caller
+        unsigned long get_threads () noexcept;
+
+    private:
+        static unsigned __stdcall worker_proc (void* param);
+        void run_bands () noexcept;
+        bool start_workers (unsigned long cnt) noexcept;
+
+    public:
+        size_t               min_work = 65536u; // pixels
+    private:
+        static unsigned long constexpr max_workers = 63ul;
+        HANDLE               workers_[max_workers] = {};
+        HANDLE               wake_ = nullptr; // semaphore
+        HANDLE               done_ = nullptr; // auto-reset event
+        band_fun_t const*    job_  = nullptr;
+        long                 rows_ = 0, band_ = 0;
+        LONG volatile        next_ = 0, pending_ = 0;
+        typename mcl_simpletls_ns::
+            mcl_spinlock_t::lock_t busy_ = 0ul;
+        unsigned long        nworkers_ = 0ul;
+    public:
+        unsigned long        threads  = 0ul;    // 0: one per processor
+    private:
+        bool volatile        stop_ = false;
+        char : 8; char : 8; char : 8;
+    };
+    extern mcl_parallel_t mcl_parallel_obj;
+
 }
 
 #endif
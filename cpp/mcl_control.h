@@ -224,6 +224,53 @@ mcl {
     extern mcl_eventqueue_t mcl_event_obj;
     
 
+    // get a new surface write generation
+    unsigned long long mcl_new_generation () noexcept;
+
+   /**
+    * @class mcl_srgb_t <src/surface.cpp>
+    * @brief Tables between sRGB and linear light.
+    */
+    struct mcl_srgb_t {
+        unsigned short to_linear[256];  // sRGB to linear light in 12 bits
+        unsigned char  to_srgb[4096];   // 12-bit linear light to sRGB, rounded
+    };
+    // get the sRGB tables, built on first use
+    mcl_srgb_t const& mcl_get_srgb () noexcept;
+
+   /**
+    * @class mcl_rowscale_t <cpp/image.cpp>
+    * @brief Shrinks an image into a surface while it is decoded,
+    *     averaging the area under each pixel. Only the sums of one
+    *     row of the surface are kept, so decoders hand over the rows
+    *     one at a time and never hold the image at full size.
+    */
+    class mcl_rowscale_t {
+    public:
+        mcl_rowscale_t (point2d_t src, color_t* pixels, point2d_t dst) noexcept;
+        ~mcl_rowscale_t () noexcept;
+        mcl_rowscale_t (mcl_rowscale_t const&) = delete;
+        mcl_rowscale_t& operator= (mcl_rowscale_t const&) = delete;
+        bool operator! () const noexcept{ return !m_sums || !m_cols; }
+        // add the next row of the image, from top to bottom
+        void feed (color_t const* row) noexcept;
+    private:
+        point2d_t           m_src, m_dst;
+        color_t*            m_pixels;
+        unsigned long long* m_sums;    // b, g, r, a of each pixel in the row
+        point1d_t*          m_cols;    // first column under each pixel
+        point1d_t           m_sy = 0;  // next row of the image
+        point1d_t           m_dy = 0;  // next row of the surface
+    };
+    // get the size an image is loaded at. 0 keeps the width or height of the file
+    point2d_t mcl_load_size (point2d_t src, point2d_t size) noexcept;
+
+    // decode a PNG file in memory into a new surface (sf_nullptr if it is broken).
+    // size scales it while decoding, see mcl_load_size
+    surface_t mcl_png_decode (unsigned char const* data, size_t size, point2d_t dst = point2d_t{ 0, 0 }) noexcept;
+    // write a surface as a PNG file. level: 0 (stored) to 9 (smallest)
+    bool mcl_png_encode (surface_t const& surface, FILE* fileobj, int level) noexcept;
+
    /**
     * @class mcl_imagebuf_t <src/surface.cpp>
     * @brief The buffer for surface_t.
@@ -235,6 +282,11 @@ mcl {
                 ~mcl_imagebuf_t () noexcept;
         bool     init           () noexcept;
         void     uninit         () noexcept;
+        // mark the pixels or alpha info as written
+        void     touch          () noexcept;
+        // get the smallest mip level not smaller than size (nullptr for the surface itself).
+        // flags are the surface flags, with 0x40 to average in linear light. m_nrtlock must be held
+        color_t* mip_level      (point2d_t size, char flags, point2d_t* level_size) noexcept;
 
     public:
         color_t*  m_pbuffer  = nullptr;
@@ -246,6 +298,14 @@ mcl {
         color_t m_colorkey   = 0;
         color_t m_alpha;
 
+        // changes on every write, unique among all buffers
+        unsigned long long m_generation = mcl_new_generation ();
+        // mip chain (levels 1 to n), and the generation it was built for
+        color_t*  m_mipbuf   = nullptr;
+        unsigned long long m_mipgen = 0;
+        char      m_mipflags = 0;
+        bool      m_mipmap   = false;
+
     public:
         typename mcl_simpletls_ns::mcl_spinlock_t::lock_t m_nrtlock = 0ul;
         unsigned m_nrt_count = 0u;
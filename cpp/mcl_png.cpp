@@ -0,0 +1,1145 @@
+/*
+    mclib (Multi-Canvas Library)
+    Copyright (C) 2021-2022  Yukino Amamiya
+
+    This file is part of the mclib Library. This library is
+    a graphics library for desktop applications only and it's
+    only for windows.
+
+    This library is free software; you can redistribute it
+    and/or modify it under the terms of the GNU Lesser General
+    Public License as published by the Free Software Foundation;
+    either version 2.1 of the License, or (at your option) any
+    later version.
+
+    This library is distributed in the hope that it will be
+    useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE.  See the GNU Lesser General Public License for
+    more details.
+
+    You should have received a copy of the GNU Lesser General
+    Public License along with this library; if not, write to
+    the Free Software Foundation,
+    Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+
+    Yukino Amamiya
+    iamyukino[at outlook.com]
+
+    @file cpp/mcl_png.cpp
+    This is a C++11 implementation file for reading and
+    writing PNG images, with its own inflate and deflate.
+*/
+
+#ifdef _MSC_VER
+# pragma warning(push)
+# pragma warning(disable: 4464)
+#endif // Relative paths include ".."
+
+#include "../src/surface.h"
+#include "mcl_control.h"
+#include <algorithm>  // for sort
+#include <cstring>    // for memset, memcpy, memcmp
+
+#ifdef _MSC_VER
+# pragma warning(pop)
+#endif
+
+namespace
+mcl {
+
+    static unsigned char const mcl_png_sig[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    // base and extra bits of the deflate length codes 257..285
+    static unsigned short const mcl_zlen_base[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13,
+        15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+    static unsigned char const mcl_zlen_extra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+        1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+    // base and extra bits of the deflate distance codes
+    static unsigned short const mcl_zdist_base[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25,
+        33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+        6145, 8193, 12289, 16385, 24577 };
+    static unsigned char const mcl_zdist_extra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3,
+        4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+    // order of the code length code lengths
+    static unsigned char const mcl_zcl_order[19] = {
+        16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    static inline unsigned long
+    mcl_png_rd32 (unsigned char const* p) noexcept {
+        return static_cast<unsigned long>(p[0]) << 24 | static_cast<unsigned long>(p[1]) << 16
+             | static_cast<unsigned long>(p[2]) << 8  | static_cast<unsigned long>(p[3]);
+    }
+    static inline void
+    mcl_png_wr32 (unsigned char* p, unsigned long v) noexcept {
+        p[0] = static_cast<unsigned char>(v >> 24); p[1] = static_cast<unsigned char>(v >> 16);
+        p[2] = static_cast<unsigned char>(v >> 8);  p[3] = static_cast<unsigned char>(v);
+    }
+
+   /**
+    * @function mcl_png_crc <cpp/mcl_png.cpp>
+    * @brief Update the CRC-32 of a chunk.
+    * @return unsigned long
+    */
+    static unsigned long
+    mcl_png_crc (unsigned long crc, unsigned char const* p, size_t n) noexcept {
+        static unsigned long const* table = [] () noexcept {
+            static unsigned long t[256];
+            for (unsigned long i = 0; i != 256; ++ i) {
+                unsigned long c = i;
+                for (int k = 0; k != 8; ++ k) c = (c & 1) ? 0xedb88320ul ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        } ();
+        crc = ~crc & 0xfffffffful;
+        for (; n; -- n, ++ p) crc = table[(crc ^ *p) & 0xff] ^ (crc >> 8);
+        return ~crc & 0xfffffffful;
+    }
+
+   /**
+    * @function mcl_png_adler <cpp/mcl_png.cpp>
+    * @brief Update the Adler-32 of a zlib stream.
+    * @return unsigned long
+    */
+    static unsigned long
+    mcl_png_adler (unsigned long adler, unsigned char const* p, size_t n) noexcept {
+        unsigned long a = adler & 0xffff, b = adler >> 16;
+        while (n) {
+            size_t k = n < 5552 ? n : 5552; // the sums cannot overflow
+            n -= k;
+            for (; k; -- k) { a += *p ++; b += a; }
+            a %= 65521ul; b %= 65521ul;
+        }
+        return b << 16 | a;
+    }
+
+    static inline unsigned
+    mcl_bit_reverse (unsigned code, int len) noexcept {
+        unsigned r = 0;
+        for (int i = 0; i != len; ++ i, code >>= 1) r = (r << 1) | (code & 1);
+        return r;
+    }
+
+   /**
+    * @class mcl_huff_t <cpp/mcl_png.cpp>
+    * @brief Canonical Huffman code for inflating, with a 9-bit table for short codes.
+    */
+    struct
+    mcl_huff_t {
+        unsigned short fast[512];   // len << 9 | symbol, 0 if the code is longer
+        unsigned short count[16];   // codes of each length
+        unsigned short symbol[288]; // symbols in code order
+
+        // false if the lengths are over-subscribed. incomplete codes are allowed
+        bool build (unsigned char const* lens, int n) noexcept {
+            ::memset (count, 0, sizeof (count));
+            ::memset (fast, 0, sizeof (fast));
+            for (int i = 0; i != n; ++ i) ++ count[lens[i]];
+            count[0] = 0;
+            int left = 1;
+            for (int len = 1; len != 16; ++ len) {
+                left = (left << 1) - count[len];
+                if (left < 0) return false;
+            }
+            unsigned short offs[16];
+            unsigned next[16];
+            unsigned code = 0;
+            offs[0] = offs[1] = 0; next[0] = 0;
+            for (int len = 1; len != 16; ++ len) {
+                code = (code + count[len - 1]) << 1;
+                next[len] = code;
+                if (len != 15) offs[len + 1] = static_cast<unsigned short>(offs[len] + count[len]);
+            }
+            for (int i = 0; i != n; ++ i) {
+                int len = lens[i];
+                if (!len) continue;
+                symbol[offs[len] ++] = static_cast<unsigned short>(i);
+                if (len <= 9) {
+                    unsigned r = mcl_bit_reverse (next[len], len);
+                    for (; r < 512; r += 1u << len)
+                        fast[r] = static_cast<unsigned short>(len << 9 | i);
+                }
+                ++ next[len];
+            }
+            return true;
+        }
+    };
+
+   /**
+    * @class mcl_png_dec_t <cpp/mcl_png.cpp>
+    * @brief Inflates the IDAT chunks and unfilters the
+    *     rows into the surface as soon as they are complete.
+    */
+    struct
+    mcl_png_dec_t {
+        // compressed input, read across IDAT chunks
+        unsigned char const* in       = nullptr;
+        unsigned char const* in_end   = nullptr;
+        unsigned char const* chunk    = nullptr; // next chunk header
+        unsigned char const* file_end = nullptr;
+        unsigned long long   bits     = 0;
+        int                  nbits    = 0;
+        int                  overrun  = 0;       // bytes read past the data
+        bool                 b_error  = false;
+        unsigned long        adler    = 1;       // of the output, checked against the zlib trailer
+
+        // image
+        point1d_t width = 0, height = 0;
+        int       depth = 0, ctype = 0, channels = 0;
+        bool      b_interlace = false;
+        bool      b_key = false;
+        unsigned  key[3] = { 0, 0, 0 };         // tRNS of gray and truecolor images
+        color_t   palette[256];
+        color_t*  pixels = nullptr;
+
+        // rows of the current pass
+        int       pass = 0;                     // Adam7 pass, 7 when done
+        point1d_t pw = 0, ph = 0, py = 0;
+        size_t    rowbytes = 0, fill = 0;
+        int       fbpp = 1;                     // bytes per pixel for the filters
+        unsigned char* cur = nullptr;
+        unsigned char* prev = nullptr;
+        color_t*  line = nullptr;               // a row of an interlaced pass or a scaled image
+        mcl_rowscale_t* scale = nullptr;        // takes the rows if they are not interlaced
+
+        // the last 64 KB of output. 32 KB are handed to
+        // the rows at a time, so the history stays whole
+        size_t    pos = 0, flushed = 0;
+        unsigned char window[65536];
+        mcl_huff_t lit, dist;
+
+        unsigned char next_byte () noexcept;
+        inline void need (int n) noexcept {
+            while (nbits < n) {
+                bits |= static_cast<unsigned long long>(next_byte ()) << nbits;
+                nbits += 8;
+            }
+        }
+        inline unsigned getbits (int n) noexcept {
+            need (n);
+            unsigned v = static_cast<unsigned>(bits & ((1ull << n) - 1));
+            bits >>= n; nbits -= n;
+            return v;
+        }
+        inline int decode (mcl_huff_t const& h) noexcept;
+        inline void put (unsigned char c) noexcept {
+            window[pos & 0xffff] = c;
+            if (!(++ pos & 0x7fff)) flush ();
+        }
+        inline void flush () noexcept {
+            adler = mcl_png_adler (adler, window + (flushed & 0xffff), pos - flushed);
+            rows (window + (flushed & 0xffff), pos - flushed);
+            flushed = pos;
+        }
+        bool inflate () noexcept;
+        bool dynamic () noexcept;
+
+        void start_pass () noexcept;
+        void rows (unsigned char const* p, size_t n) noexcept;
+        void unfilter () noexcept;
+        void expand (unsigned char const* raw, color_t* out, point1d_t n) const noexcept;
+    };
+
+    unsigned char mcl_png_dec_t::
+    next_byte () noexcept {
+        while (in == in_end) {
+            if (chunk && file_end - chunk >= 12 && !::memcmp (chunk + 4, "IDAT", 4)
+                && mcl_png_rd32 (chunk) <= static_cast<size_t>(file_end - chunk - 12)) {
+                in = chunk + 8;
+                in_end = in + mcl_png_rd32 (chunk);
+                // a damaged chunk stops the stream
+                if (mcl_png_crc (0, chunk + 4, mcl_png_rd32 (chunk) + 4) != mcl_png_rd32 (in_end)) {
+                    in = in_end = nullptr;
+                    chunk = nullptr;
+                    b_error = true;
+                    return 0;
+                }
+                chunk = in_end + 4;
+                continue;
+            }
+            // zeros past the end. a valid stream never uses them
+            chunk = nullptr;
+            if (++ overrun > 16) b_error = true;
+            return 0;
+        }
+        return *in ++;
+    }
+
+    inline int mcl_png_dec_t::
+    decode (mcl_huff_t const& h) noexcept {
+        need (16);
+        unsigned e = h.fast[bits & 511];
+        if (e) {
+            int len = static_cast<int>(e >> 9);
+            bits >>= len; nbits -= len;
+            return static_cast<int>(e & 511);
+        }
+        // longer codes, one bit at a time
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len != 16; ++ len) {
+            code |= static_cast<int>(bits & 1);
+            bits >>= 1; -- nbits;
+            int cnt = h.count[len];
+            if (code - cnt < first) return h.symbol[index + (code - first)];
+            index += cnt; first += cnt;
+            first <<= 1; code <<= 1;
+        }
+        b_error = true;
+        return -1;
+    }
+
+    bool mcl_png_dec_t::
+    dynamic () noexcept {
+        int hlit = static_cast<int>(getbits (5)) + 257;
+        int hdist = static_cast<int>(getbits (5)) + 1;
+        int hclen = static_cast<int>(getbits (4)) + 4;
+        if (hlit > 286 || hdist > 30) return false;
+        unsigned char lens[286 + 30];
+        ::memset (lens, 0, 19);
+        for (int i = 0; i != hclen; ++ i)
+            lens[mcl_zcl_order[i]] = static_cast<unsigned char>(getbits (3));
+        if (!lit.build (lens, 19)) return false;
+        for (int i = 0; i < hlit + hdist; ) {
+            int s = decode (lit);
+            if (s < 0 || b_error) return false;
+            if (s < 16) { lens[i ++] = static_cast<unsigned char>(s); continue; }
+            int rep = 0;
+            unsigned char val = 0;
+            if (s == 16) {
+                if (!i) return false;
+                val = lens[i - 1];
+                rep = 3 + static_cast<int>(getbits (2));
+            }
+            else if (s == 17) rep = 3 + static_cast<int>(getbits (3));
+            else              rep = 11 + static_cast<int>(getbits (7));
+            if (rep > hlit + hdist - i) return false;
+            for (; rep; -- rep) lens[i ++] = val;
+        }
+        return lens[256] && lit.build (lens, hlit) && dist.build (lens + hlit, hdist);
+    }
+
+    bool mcl_png_dec_t::
+    inflate () noexcept {
+        static mcl_huff_t const* fixed = [] () noexcept {
+            static mcl_huff_t t[2];
+            unsigned char lens[288];
+            ::memset (lens, 8, 144);
+            ::memset (lens + 144, 9, 112);
+            ::memset (lens + 256, 7, 24);
+            ::memset (lens + 280, 8, 8);
+            t[0].build (lens, 288);
+            ::memset (lens, 5, 30);
+            t[1].build (lens, 30);
+            return t;
+        } ();
+
+        // zlib header, without a preset dictionary
+        unsigned cmf = getbits (8), flg = getbits (8);
+        if ((cmf & 15) != 8 || (cmf >> 4) > 7 || ((cmf << 8) | flg) % 31 || (flg & 32))
+            return false;
+
+        unsigned final_block = 0;
+        while (!final_block) {
+            final_block = getbits (1);
+            unsigned type = getbits (2);
+            if (type == 0) {
+                getbits (nbits & 7); // to a byte boundary
+                unsigned len = getbits (16), nlen = getbits (16);
+                if ((len ^ 0xffff) != nlen) return false;
+                for (; len && !b_error; -- len)
+                    put (static_cast<unsigned char>(getbits (8)));
+            } else if (type == 3) {
+                return false;
+            } else {
+                mcl_huff_t const* pl = fixed, *pd = fixed + 1;
+                if (type == 2) {
+                    if (!dynamic ()) return false;
+                    pl = &lit; pd = &dist;
+                }
+                for (;;) {
+                    int s = decode (*pl);
+                    if (b_error) return false;
+                    if (s < 256) { put (static_cast<unsigned char>(s)); continue; }
+                    if (s == 256) break;
+                    s -= 257;
+                    if (s >= 29) return false;
+                    unsigned len = mcl_zlen_base[s] + getbits (mcl_zlen_extra[s]);
+                    int d = decode (*pd);
+                    if (d < 0 || d >= 30) return false;
+                    size_t back = mcl_zdist_base[d] + getbits (mcl_zdist_extra[d]);
+                    if (back > pos || b_error) return false;
+                    for (; len; -- len) put (window[(pos - back) & 0xffff]);
+                }
+            }
+            if (b_error) return false;
+        }
+        flush ();
+        // the Adler-32 of the output follows the last block
+        getbits (nbits & 7);
+        unsigned long sum = 0;
+        for (int k = 0; k != 4; ++ k) sum = sum << 8 | getbits (8);
+        // the stream must not have used the zeros past the data
+        return !b_error && overrun * 8 <= nbits && sum == adler;
+    }
+
+    void mcl_png_dec_t::
+    start_pass () noexcept {
+        static point1d_t const x0[7] = { 0, 4, 0, 2, 0, 1, 0 }, dx[7] = { 8, 8, 4, 4, 2, 2, 1 };
+        static point1d_t const y0[7] = { 0, 0, 4, 0, 2, 0, 1 }, dy[7] = { 8, 8, 8, 4, 4, 2, 2 };
+        for (; pass != 7; ++ pass) {
+            if (!b_interlace) { pw = width; ph = height; }
+            else {
+                pw = width > x0[pass] ? (width - x0[pass] + dx[pass] - 1) / dx[pass] : 0;
+                ph = height > y0[pass] ? (height - y0[pass] + dy[pass] - 1) / dy[pass] : 0;
+            }
+            if (pw && ph) break;
+        }
+        py = 0; fill = 0;
+        if (pass == 7) return ;
+        rowbytes = 1 + (static_cast<size_t>(pw) * static_cast<size_t>(channels * depth) + 7) / 8;
+        ::memset (prev, 0, rowbytes);
+    }
+
+    void mcl_png_dec_t::
+    unfilter () noexcept {
+        unsigned char* c = cur + 1;
+        unsigned char const* p = prev + 1;
+        size_t n = rowbytes - 1, b = static_cast<size_t>(fbpp), i = 0;
+        switch (cur[0]) {
+        case 0: break;
+        case 1:
+            for (i = b; i < n; ++ i) c[i] = static_cast<unsigned char>(c[i] + c[i - b]);
+            break;
+        case 2:
+            for (i = 0; i < n; ++ i) c[i] = static_cast<unsigned char>(c[i] + p[i]);
+            break;
+        case 3:
+            for (i = 0; i < b && i < n; ++ i) c[i] = static_cast<unsigned char>(c[i] + (p[i] >> 1));
+            for (; i < n; ++ i) c[i] = static_cast<unsigned char>(c[i] + ((c[i - b] + p[i]) >> 1));
+            break;
+        case 4:
+            for (i = 0; i < b && i < n; ++ i) c[i] = static_cast<unsigned char>(c[i] + p[i]);
+            for (; i < n; ++ i) {
+                int a = c[i - b], up = p[i], ul = p[i - b];
+                int pa = up - ul, pb = a - ul, pc = pa + pb;
+                pa = pa < 0 ? -pa : pa; pb = pb < 0 ? -pb : pb; pc = pc < 0 ? -pc : pc;
+                c[i] = static_cast<unsigned char>(c[i] + (pa <= pb && pa <= pc ? a : pb <= pc ? up : ul));
+            }
+            break;
+        default:
+            b_error = true;
+        }
+    }
+
+   /**
+    * @function mcl_png_dec_t::expand <cpp/mcl_png.cpp>
+    * @brief Convert n unfiltered samples into colors.
+    *     16-bit samples keep their high byte.
+    */
+    void mcl_png_dec_t::
+    expand (unsigned char const* raw, color_t* out, point1d_t n) const noexcept {
+        point1d_t i = 0;
+        if (ctype == 3 || (ctype == 0 && depth < 8)) {
+            // packed samples, high bits first
+            unsigned mx = (1u << depth) - 1, mul = ctype ? 1u : 255u / mx;
+            for (; i != n; ++ i) {
+                size_t bit = static_cast<size_t>(i) * static_cast<size_t>(depth);
+                unsigned v = (raw[bit >> 3] >> (8 - depth - static_cast<int>(bit & 7))) & mx;
+                if (ctype == 3) out[i] = palette[v];
+                else {
+                    color_t g = v * mul;
+                    out[i] = (b_key && v == key[0] ? 0 : 0xff000000) | g << 16 | g << 8 | g;
+                }
+            }
+            return ;
+        }
+        if (depth == 8) switch (ctype) {
+        case 0:
+            for (; i != n; ++ i) {
+                color_t g = raw[i];
+                out[i] = (b_key && g == key[0] ? 0 : 0xff000000) | g << 16 | g << 8 | g;
+            }
+            return ;
+        case 2:
+            for (; i != n; ++ i, raw += 3) {
+                color_t c = static_cast<color_t>(raw[0]) << 16 | static_cast<color_t>(raw[1]) << 8 | raw[2];
+                out[i] = c | (b_key && raw[0] == key[0] && raw[1] == key[1] && raw[2] == key[2] ? 0 : 0xff000000);
+            }
+            return ;
+        case 4:
+            for (; i != n; ++ i, raw += 2)
+                out[i] = static_cast<color_t>(raw[1]) << 24 | static_cast<color_t>(raw[0]) * 0x010101u;
+            return ;
+        default:
+            for (; i != n; ++ i, raw += 4)
+                out[i] = static_cast<color_t>(raw[3]) << 24 | static_cast<color_t>(raw[0]) << 16
+                       | static_cast<color_t>(raw[1]) << 8 | raw[2];
+            return ;
+        }
+        // 16 bits, big-endian
+        for (; i != n; ++ i, raw += channels * 2) {
+            unsigned s0 = static_cast<unsigned>(raw[0]) << 8 | raw[1];
+            switch (ctype) {
+            case 0:
+                out[i] = (b_key && s0 == key[0] ? 0 : 0xff000000) | static_cast<color_t>(raw[0]) * 0x010101u;
+                break;
+            case 2: {
+                unsigned s1 = static_cast<unsigned>(raw[2]) << 8 | raw[3], s2 = static_cast<unsigned>(raw[4]) << 8 | raw[5];
+                out[i] = (b_key && s0 == key[0] && s1 == key[1] && s2 == key[2] ? 0 : 0xff000000)
+                       | static_cast<color_t>(raw[0]) << 16 | static_cast<color_t>(raw[2]) << 8 | raw[4];
+                break;
+            }
+            case 4:
+                out[i] = static_cast<color_t>(raw[2]) << 24 | static_cast<color_t>(raw[0]) * 0x010101u;
+                break;
+            default:
+                out[i] = static_cast<color_t>(raw[6]) << 24 | static_cast<color_t>(raw[0]) << 16
+                       | static_cast<color_t>(raw[2]) << 8 | raw[4];
+            }
+        }
+    }
+
+    void mcl_png_dec_t::
+    rows (unsigned char const* p, size_t n) noexcept {
+        static point1d_t const x0[7] = { 0, 4, 0, 2, 0, 1, 0 }, dx[7] = { 8, 8, 4, 4, 2, 2, 1 };
+        static point1d_t const y0[7] = { 0, 0, 4, 0, 2, 0, 1 }, dy[7] = { 8, 8, 8, 4, 4, 2, 2 };
+        while (n && pass != 7 && !b_error) {
+            size_t k = rowbytes - fill < n ? rowbytes - fill : n;
+            ::memcpy (cur + fill, p, k);
+            fill += k; p += k; n -= k;
+            if (fill != rowbytes) break;
+
+            unfilter ();
+            if (scale) {
+                expand (cur + 1, line, width);
+                scale -> feed (line);
+            } else if (!b_interlace) expand (cur + 1, pixels + py * width, width);
+            else {
+                expand (cur + 1, line, pw);
+                color_t* dst = pixels + (y0[pass] + py * dy[pass]) * width + x0[pass];
+                for (point1d_t i = 0; i != pw; ++ i) dst[i * dx[pass]] = line[i];
+            }
+            unsigned char* t = cur; cur = prev; prev = t;
+            fill = 0;
+            if (++ py == ph) { pass = b_interlace ? pass + 1 : 7; start_pass (); }
+        }
+    }
+
+   /**
+    * @function mcl_png_decode <cpp/mcl_control.h>
+    * @brief Decode a PNG file in memory into a new surface.
+    *     Alpha, including tRNS, is kept in the pixels.
+    * @param {unsigned char const*} data: the whole file
+    * @param {size_t} size
+    * @param {point2d_t} dst: size to scale to while decoding, see mcl_load_size.
+    *     interlaced images are decoded whole and scaled afterwards
+    * @return surface_t: sf_nullptr if the file is broken
+    */
+    surface_t
+    mcl_png_decode (unsigned char const* data, size_t size, point2d_t dst) noexcept {
+        if (!data || size < 8 + 25 || ::memcmp (data, mcl_png_sig, 8))
+            return sf_nullptr;
+        mcl_simpletls_ns::mcl_auto_ptr_t<mcl_png_dec_t> dec_ptr (1);
+        mcl_png_dec_t* dec = dec_ptr;
+        if (!dec) return sf_nullptr;
+
+        // Read the chunks before the first IDAT
+        unsigned char const* p = data + 8, *end = data + size;
+        bool b_header = false, b_trns = false;
+        int npal = 0;
+        for (int i = 0; i != 256; ++ i) dec -> palette[i] = 0xff000000;
+        for (;;) {
+            if (end - p < 12) return sf_nullptr;
+            unsigned long len = mcl_png_rd32 (p);
+            if (len > static_cast<size_t>(end - p - 12)) return sf_nullptr;
+            unsigned char const* body = p + 8;
+            if (mcl_png_crc (0, p + 4, len + 4) != mcl_png_rd32 (body + len))
+                return sf_nullptr;
+            if (!::memcmp (p + 4, "IHDR", 4)) {
+                if (len != 13) return sf_nullptr;
+                unsigned long w = mcl_png_rd32 (body), h = mcl_png_rd32 (body + 4);
+                if (!w || !h || w > 0x7fffffff || h > 0x7fffffff) return sf_nullptr;
+                dec -> width = static_cast<point1d_t>(w);
+                dec -> height = static_cast<point1d_t>(h);
+                dec -> depth = body[8]; dec -> ctype = body[9];
+                if (body[10] || body[11] || body[12] > 1) return sf_nullptr;
+                dec -> b_interlace = body[12] == 1;
+                b_header = true;
+            } else if (!::memcmp (p + 4, "PLTE", 4)) {
+                if (len % 3 || len > 768) return sf_nullptr;
+                npal = static_cast<int>(len / 3);
+                for (int i = 0; i != npal; ++ i)
+                    dec -> palette[i] = 0xff000000 | static_cast<color_t>(body[i * 3]) << 16
+                        | static_cast<color_t>(body[i * 3 + 1]) << 8 | body[i * 3 + 2];
+            } else if (!::memcmp (p + 4, "tRNS", 4)) {
+                b_trns = true;
+                if (dec -> ctype == 3) {
+                    for (unsigned long i = 0; i < len && i < 256; ++ i)
+                        dec -> palette[i] = (dec -> palette[i] & 0xffffff) | static_cast<color_t>(body[i]) << 24;
+                } else if (dec -> ctype == 0 && len >= 2) {
+                    dec -> b_key = true;
+                    dec -> key[0] = static_cast<unsigned>(body[0]) << 8 | body[1];
+                } else if (dec -> ctype == 2 && len >= 6) {
+                    dec -> b_key = true;
+                    for (int k = 0; k != 3; ++ k)
+                        dec -> key[k] = static_cast<unsigned>(body[k * 2]) << 8 | body[k * 2 + 1];
+                }
+            } else if (!::memcmp (p + 4, "IDAT", 4)) {
+                break;
+            } else if (!::memcmp (p + 4, "IEND", 4)) {
+                return sf_nullptr;
+            }
+            p = body + len + 4;
+        }
+
+        // Check the header
+        int const ct = dec -> ctype, dp = dec -> depth;
+        bool b_valid = b_header && (
+            (ct == 0 && (dp == 1 || dp == 2 || dp == 4 || dp == 8 || dp == 16)) ||
+            (ct == 3 && (dp == 1 || dp == 2 || dp == 4 || dp == 8) && npal) ||
+            ((ct == 2 || ct == 4 || ct == 6) && (dp == 8 || dp == 16)) );
+        if (!b_valid) return sf_nullptr;
+        if (dec -> b_key && dp < 16) {
+            // keys are compared with the samples as they are stored
+            for (int k = 0; k != 3; ++ k) if (dec -> key[k] >> dp) dec -> b_key = false;
+        }
+        dec -> channels = ct == 2 ? 3 : ct == 4 ? 2 : ct == 6 ? 4 : 1;
+        dec -> fbpp = (dec -> channels * dp + 7) / 8;
+
+        // Create the surface and the row buffers
+        point2d_t src{ dec -> width, dec -> height };
+        dst = mcl_load_size (src, dst);
+        bool b_scale = dst.x != src.x || dst.y != src.y;
+        // images with alpha or tRNS keep it, as frombytes does
+        surface_t::type flags = ct == 4 || ct == 6 || b_trns ? surface_t::SrcAlpha : 0;
+        surface_t surf (dst, flags);
+        mcl_imagebuf_t* ibuf = mcl_get_surface_dataplus (&surf);
+        if (!ibuf || ibuf -> m_width != dst.x || ibuf -> m_height != dst.y)
+            return sf_nullptr;
+        mcl_rowscale_t scale (src, ibuf -> m_pbuffer, b_scale ? dst : point2d_t{ 0, 0 });
+        if (b_scale && !scale) return sf_nullptr;
+        // the passes of interlaced images fill the whole image before it is scaled
+        surface_t whole;
+        mcl_imagebuf_t* wbuf = ibuf;
+        if (b_scale && dec -> b_interlace) {
+            whole = surface_t (src, flags);
+            wbuf = mcl_get_surface_dataplus (&whole);
+            if (!wbuf || wbuf -> m_width != src.x || wbuf -> m_height != src.y)
+                return sf_nullptr;
+        }
+        size_t maxrow = 1 + (static_cast<size_t>(dec -> width) * static_cast<size_t>(dec -> channels * dp) + 7) / 8;
+        mcl_simpletls_ns::mcl_auto_ptr_t<unsigned char> rowbuf (maxrow * 2);
+        mcl_simpletls_ns::mcl_auto_ptr_t<color_t> line (dec -> b_interlace || b_scale ? static_cast<size_t>(dec -> width) : 1);
+        if (!rowbuf || !line) return sf_nullptr;
+        dec -> cur = rowbuf;
+        dec -> prev = rowbuf + maxrow;
+        dec -> line = line;
+        dec -> pixels = wbuf -> m_pbuffer;
+        if (b_scale && !dec -> b_interlace) dec -> scale = &scale;
+        dec -> start_pass ();
+
+        // Inflate the IDAT chunks
+        dec -> chunk = p;
+        dec -> file_end = end;
+        if (!dec -> inflate () || dec -> pass != 7)
+            return sf_nullptr;
+        if (wbuf != ibuf)
+            for (point1d_t y = 0; y != src.y; ++ y)
+                scale.feed (wbuf -> m_pbuffer + static_cast<size_t>(y) * static_cast<size_t>(src.x));
+        return surf;
+    }
+
+   /**
+    * @class mcl_png_enc_t <cpp/mcl_png.cpp>
+    * @brief Deflates filtered rows into IDAT chunks, with hash
+    *     chains over a 32 KB window and dynamic Huffman blocks.
+    */
+    struct
+    mcl_png_enc_t {
+        static size_t constexpr wsize = 32768;
+        static size_t constexpr lookahead = 258 + 3 + 1;
+        static size_t constexpr maxsym = 16384;
+
+        FILE*  fp      = nullptr;
+        bool   b_error = false;
+        int    level   = 6;
+        int    chain   = 128;   // matches tried per position
+        size_t nice    = 128;   // length that stops the search
+        unsigned long adler = 1;
+
+        // bits and the IDAT chunk being filled
+        unsigned long long bits = 0;
+        int    nbits = 0;
+        size_t nout = 8;        // after the chunk header
+        unsigned char out[8 + 65536];
+
+        // input: the last 32 KB and what comes next
+        size_t have = 0, cur = 0;
+        unsigned char win[2 * wsize];
+        int    head[1 << 15];
+        int    prev[wsize];
+
+        // the symbols of the current block: literals have dist 0
+        size_t nsym = 0;
+        unsigned short sym_len[maxsym];
+        unsigned short sym_dist[maxsym];
+
+        void chunk (char const* type, unsigned char* buf, size_t n) noexcept;
+        inline void put_byte (unsigned char c) noexcept {
+            out[nout ++] = c;
+            if (nout == sizeof (out)) { chunk ("IDAT", out, nout - 8); nout = 8; }
+        }
+        inline void put_bits (unsigned v, int n) noexcept {
+            bits |= static_cast<unsigned long long>(v) << nbits;
+            nbits += n;
+            while (nbits >= 8) {
+                put_byte (static_cast<unsigned char>(bits));
+                bits >>= 8; nbits -= 8;
+            }
+        }
+        void feed (unsigned char const* p, size_t n) noexcept;
+        void deflate (size_t limit) noexcept;
+        void stored (bool b_final) noexcept;
+        void block (bool b_final) noexcept;
+        void finish () noexcept;
+    };
+
+    constexpr size_t mcl_png_enc_t::wsize;
+    constexpr size_t mcl_png_enc_t::lookahead;
+    constexpr size_t mcl_png_enc_t::maxsym;
+
+   /**
+    * @function mcl_png_enc_t::chunk <cpp/mcl_png.cpp>
+    * @brief Write a chunk whose data starts at buf + 8.
+    *     The 8 bytes before it are filled with the header.
+    */
+    void mcl_png_enc_t::
+    chunk (char const* type, unsigned char* buf, size_t n) noexcept {
+        unsigned char crc[4];
+        mcl_png_wr32 (buf, static_cast<unsigned long>(n));
+        ::memcpy (buf + 4, type, 4);
+        mcl_png_wr32 (crc, mcl_png_crc (0, buf + 4, n + 4));
+        if (::fwrite (buf, 1, n + 8, fp) != n + 8 || ::fwrite (crc, 1, 4, fp) != 4)
+            b_error = true;
+    }
+
+   /**
+    * @function mcl_huff_lengths <cpp/mcl_png.cpp>
+    * @brief Huffman code lengths of at most limit bits for the frequencies.
+    * @return void
+    */
+    static void
+    mcl_huff_lengths (unsigned const* freq, int n, int limit, unsigned char* lens) noexcept {
+        int idx[286], m = 0;
+        for (int i = 0; i != n; ++ i) {
+            lens[i] = 0;
+            if (freq[i]) idx[m ++] = i;
+        }
+        if (m < 2) {
+            // a code must have two symbols for every decoder
+            lens[m ? idx[0] : 0] = 1;
+            lens[m && !idx[0] ? 1 : 0] = 1;
+            return ;
+        }
+        std::sort (idx, idx + m, [freq] (int a, int b) { return freq[a] < freq[b]; });
+
+        // two queues: sorted leaves, and internal nodes in the order they are made
+        unsigned long w[2 * 286];
+        int parent[2 * 286], depth[2 * 286];
+        for (int i = 0; i != m; ++ i) w[i] = freq[idx[i]];
+        int li = 0, ni = m, nend = m;
+        for (int k = 0; k != m - 1; ++ k, ++ nend) {
+            int pick[2];
+            for (int& c : pick) c = (li < m && (ni == nend || w[li] <= w[ni])) ? li ++ : ni ++;
+            w[nend] = w[pick[0]] + w[pick[1]];
+            parent[pick[0]] = parent[pick[1]] = nend;
+        }
+        depth[nend - 1] = 0;
+        for (int i = nend - 2; i >= 0; -- i) depth[i] = depth[parent[i]] + 1;
+
+        // clamp to the limit, then repair the Kraft sum
+        int bl[32];
+        ::memset (bl, 0, sizeof (bl));
+        for (int i = 0; i != m; ++ i) ++ bl[depth[i] < limit ? depth[i] : limit];
+        unsigned long total = 0;
+        for (int len = 1; len <= limit; ++ len) total += static_cast<unsigned long>(bl[len]) << (limit - len);
+        while (total != 1ul << limit) {
+            -- bl[limit];
+            for (int len = limit - 1; len; -- len)
+                if (bl[len]) { -- bl[len]; bl[len + 1] += 2; break; }
+            -- total;
+        }
+        // the most frequent symbols get the shortest codes
+        int k = m - 1;
+        for (int len = 1; len <= limit; ++ len)
+            for (int c = bl[len]; c; -- c) lens[idx[k --]] = static_cast<unsigned char>(len);
+    }
+
+    // bit-reversed canonical codes of the lengths
+    static void
+    mcl_huff_codes (unsigned char const* lens, int n, unsigned short* codes) noexcept {
+        unsigned short cnt[16], next[16];
+        ::memset (cnt, 0, sizeof (cnt));
+        for (int i = 0; i != n; ++ i) ++ cnt[lens[i]];
+        cnt[0] = 0;
+        unsigned code = 0;
+        for (int len = 1; len != 16; ++ len) {
+            code = (code + cnt[len - 1]) << 1;
+            next[len] = static_cast<unsigned short>(code);
+        }
+        for (int i = 0; i != n; ++ i)
+            codes[i] = lens[i] ? static_cast<unsigned short>(mcl_bit_reverse (next[lens[i]] ++, lens[i])) : 0;
+    }
+
+    // length code (0..28) of a match length
+    static inline int
+    mcl_zlen_code (unsigned len) noexcept {
+        static unsigned char const* table = [] () noexcept {
+            static unsigned char t[259];
+            for (int c = 0; c != 29; ++ c)
+                for (unsigned l = mcl_zlen_base[c]; l < mcl_zlen_base[c] + (1u << mcl_zlen_extra[c]) && l < 259; ++ l)
+                    t[l] = static_cast<unsigned char>(c);
+            return t;
+        } ();
+        return table[len];
+    }
+
+    // distance code (0..29) of a match distance
+    static inline int
+    mcl_zdist_code (unsigned d) noexcept {
+        static unsigned char const* table = [] () noexcept {
+            static unsigned char t[512];
+            for (int c = 0; c != 30; ++ c)
+                for (unsigned v = mcl_zdist_base[c]; v < mcl_zdist_base[c] + (1u << mcl_zdist_extra[c]); ++ v)
+                    t[v - 1 < 256 ? v - 1 : 256 + ((v - 1) >> 7)] = static_cast<unsigned char>(c);
+            return t;
+        } ();
+        return table[d - 1 < 256 ? d - 1 : 256 + ((d - 1) >> 7)];
+    }
+
+   /**
+    * @function mcl_png_enc_t::block <cpp/mcl_png.cpp>
+    * @brief Write the symbols as a fixed or a dynamic Huffman block,
+    *     whichever is smaller.
+    */
+    void mcl_png_enc_t::
+    block (bool b_final) noexcept {
+        unsigned lf[286], df[30];
+        ::memset (lf, 0, sizeof (lf));
+        ::memset (df, 0, sizeof (df));
+        for (size_t i = 0; i != nsym; ++ i) {
+            if (!sym_dist[i]) ++ lf[sym_len[i]];
+            else {
+                ++ lf[257 + mcl_zlen_code (sym_len[i])];
+                ++ df[mcl_zdist_code (sym_dist[i])];
+            }
+        }
+        lf[256] = 1;
+
+        // dynamic code lengths, and the code length code
+        unsigned char ll[286 + 30], dl[30];
+        mcl_huff_lengths (lf, 286, 15, ll);
+        mcl_huff_lengths (df, 30, 15, dl);
+        int hlit = 286, hdist = 30;
+        while (hlit > 257 && !ll[hlit - 1]) -- hlit;
+        while (hdist > 1 && !dl[hdist - 1]) -- hdist;
+        ::memcpy (ll + hlit, dl, static_cast<size_t>(hdist));
+
+        unsigned char rle[286 + 30], rle_extra[286 + 30];
+        int nrle = 0, total = hlit + hdist;
+        unsigned cf[19];
+        ::memset (cf, 0, sizeof (cf));
+        for (int i = 0; i != total; ) {
+            unsigned char v = ll[i];
+            int run = 1;
+            while (i + run != total && ll[i + run] == v) ++ run;
+            i += run;
+            if (!v) {
+                for (; run >= 11; ) { int r = run < 138 ? run : 138; rle[nrle] = 18; rle_extra[nrle ++] = static_cast<unsigned char>(r - 11); run -= r; }
+                if (run >= 3) { rle[nrle] = 17; rle_extra[nrle ++] = static_cast<unsigned char>(run - 3); run = 0; }
+            } else {
+                rle[nrle] = v; rle_extra[nrle ++] = 0; -- run;
+                for (; run >= 3; ) { int r = run < 6 ? run : 6; rle[nrle] = 16; rle_extra[nrle ++] = static_cast<unsigned char>(r - 3); run -= r; }
+            }
+            for (; run; -- run) { rle[nrle] = v; rle_extra[nrle ++] = 0; }
+        }
+        for (int i = 0; i != nrle; ++ i) ++ cf[rle[i]];
+        unsigned char cl[19];
+        mcl_huff_lengths (cf, 19, 7, cl);
+        int hclen = 19;
+        while (hclen > 4 && !cl[mcl_zcl_order[hclen - 1]]) -- hclen;
+
+        // sizes of both kinds in bits, without the extra bits they share
+        unsigned long long dyn = 14 + 3 * static_cast<unsigned>(hclen), fix = 0;
+        for (int i = 0; i != nrle; ++ i) dyn += cl[rle[i]] + (rle[i] == 16 ? 2u : rle[i] == 17 ? 3u : rle[i] == 18 ? 7u : 0u);
+        for (int i = 0; i != 286; ++ i) {
+            dyn += static_cast<unsigned long long>(lf[i]) * (i < hlit ? ll[i] : 0u);
+            fix += static_cast<unsigned long long>(lf[i]) * (i < 144 ? 8u : i < 256 ? 9u : i < 280 ? 7u : 8u);
+        }
+        for (int i = 0; i != 30; ++ i) {
+            dyn += static_cast<unsigned long long>(df[i]) * dl[i];
+            fix += static_cast<unsigned long long>(df[i]) * 5u;
+        }
+
+        unsigned char const* pll = ll, *pdl = dl;
+        unsigned char fl[288];
+        if (fix <= dyn) {
+            ::memset (fl, 8, 144);
+            ::memset (fl + 144, 9, 112);
+            ::memset (fl + 256, 7, 24);
+            ::memset (fl + 280, 8, 8);
+            ::memset (dl, 5, 30);
+            pll = fl;
+            put_bits (b_final ? 3u : 2u, 3);
+        } else {
+            unsigned short cc[19];
+            mcl_huff_codes (cl, 19, cc);
+            put_bits (b_final ? 5u : 4u, 3);
+            put_bits (static_cast<unsigned>(hlit - 257), 5);
+            put_bits (static_cast<unsigned>(hdist - 1), 5);
+            put_bits (static_cast<unsigned>(hclen - 4), 4);
+            for (int i = 0; i != hclen; ++ i) put_bits (cl[mcl_zcl_order[i]], 3);
+            for (int i = 0; i != nrle; ++ i) {
+                put_bits (cc[rle[i]], cl[rle[i]]);
+                if (rle[i] >= 16) put_bits (rle_extra[i], rle[i] == 16 ? 2 : rle[i] == 17 ? 3 : 7);
+            }
+            ::memset (ll + hlit, 0, static_cast<size_t>(286 - hlit));
+        }
+        unsigned short lc[288], dc[30];
+        mcl_huff_codes (pll, pll == fl ? 288 : 286, lc); // all 288 count in the fixed code
+        mcl_huff_codes (pdl, 30, dc);
+
+        // the symbols
+        for (size_t i = 0; i != nsym; ++ i) {
+            unsigned len = sym_len[i], d = sym_dist[i];
+            if (!d) { put_bits (lc[len], pll[len]); continue; }
+            int c = mcl_zlen_code (len);
+            put_bits (lc[257 + c], pll[257 + c]);
+            put_bits (len - mcl_zlen_base[c], mcl_zlen_extra[c]);
+            c = mcl_zdist_code (d);
+            put_bits (dc[c], pdl[c]);
+            put_bits (d - mcl_zdist_base[c], mcl_zdist_extra[c]);
+        }
+        put_bits (lc[256], pll[256]);
+        nsym = 0;
+    }
+
+   /**
+    * @function mcl_png_enc_t::stored <cpp/mcl_png.cpp>
+    * @brief Write the buffered input as a stored block (level 0).
+    */
+    void mcl_png_enc_t::
+    stored (bool b_final) noexcept {
+        put_bits (b_final ? 1u : 0u, 3);
+        put_bits (0, (8 - nbits) & 7);
+        put_bits (static_cast<unsigned>(have), 16);
+        put_bits (static_cast<unsigned>(have) ^ 0xffff, 16);
+        for (size_t i = 0; i != have; ++ i) put_byte (win[i]);
+        have = 0;
+    }
+
+   /**
+    * @function mcl_png_enc_t::deflate <cpp/mcl_png.cpp>
+    * @brief Find matches for the input before limit.
+    */
+    void mcl_png_enc_t::
+    deflate (size_t limit) noexcept {
+        for (; cur < limit; ) {
+            size_t best = 0, best_dist = 0;
+            if (cur + 3 <= have) {
+                unsigned h = ((static_cast<unsigned>(win[cur]) << 10) ^ (static_cast<unsigned>(win[cur + 1]) << 5)
+                    ^ win[cur + 2]) & 0x7fff;
+                int cand = head[h];
+                size_t maxlen = have - cur < 258 ? have - cur : 258;
+                for (int n = chain; n && cand >= 0 && cur - static_cast<size_t>(cand) < wsize; -- n) {
+                    unsigned char const* a = win + cand, *b = win + cur;
+                    if (a[best] == b[best] && a[0] == b[0]) {
+                        size_t len = 1;
+                        while (len != maxlen && a[len] == b[len]) ++ len;
+                        if (len > best) {
+                            best = len; best_dist = cur - static_cast<size_t>(cand);
+                            if (len >= nice || len == maxlen) break;
+                        }
+                    }
+                    int next = prev[cand & (wsize - 1)];
+                    if (next >= cand) break;
+                    cand = next;
+                }
+                prev[cur & (wsize - 1)] = head[h];
+                head[h] = static_cast<int>(cur);
+            }
+            if (best < 3) {
+                sym_len[nsym] = win[cur]; sym_dist[nsym ++] = 0;
+                ++ cur;
+            } else {
+                sym_len[nsym] = static_cast<unsigned short>(best);
+                sym_dist[nsym ++] = static_cast<unsigned short>(best_dist);
+                // the positions inside the match join the chains too
+                for (size_t e = cur + best, i = cur + 1; i != e; ++ i) {
+                    if (i + 3 > have) break;
+                    unsigned h = ((static_cast<unsigned>(win[i]) << 10) ^ (static_cast<unsigned>(win[i + 1]) << 5)
+                        ^ win[i + 2]) & 0x7fff;
+                    prev[i & (wsize - 1)] = head[h];
+                    head[h] = static_cast<int>(i);
+                }
+                cur += best;
+            }
+            if (nsym == maxsym) block (false);
+        }
+    }
+
+   /**
+    * @function mcl_png_enc_t::feed <cpp/mcl_png.cpp>
+    * @brief Compress the next bytes of the filtered image.
+    */
+    void mcl_png_enc_t::
+    feed (unsigned char const* p, size_t n) noexcept {
+        adler = mcl_png_adler (adler, p, n);
+        while (n) {
+            size_t room = (level ? 2 * wsize : 65535) - have, k = n < room ? n : room;
+            ::memcpy (win + have, p, k);
+            have += k; p += k; n -= k;
+            if (have != (level ? 2 * wsize : 65535)) break;
+            if (!level) { stored (false); continue; }
+
+            // compress all but the lookahead, then slide the window by 32 KB
+            deflate (have - lookahead);
+            ::memmove (win, win + wsize, have - wsize);
+            have -= wsize; cur -= wsize;
+            for (int& v : head) v = v >= static_cast<int>(wsize) ? v - static_cast<int>(wsize) : -1;
+            for (int& v : prev) v = v >= static_cast<int>(wsize) ? v - static_cast<int>(wsize) : -1;
+        }
+    }
+
+    void mcl_png_enc_t::
+    finish () noexcept {
+        if (!level) stored (true);
+        else {
+            deflate (have);
+            block (true);
+        }
+        put_bits (0, (8 - nbits) & 7);
+        for (int k = 24; k >= 0; k -= 8)
+            put_byte (static_cast<unsigned char>(adler >> k));
+        if (nout > 8) chunk ("IDAT", out, nout - 8);
+        nout = 8;
+    }
+
+   /**
+    * @function mcl_png_encode <cpp/mcl_control.h>
+    * @brief Write a surface as a PNG file: RGBA with SrcAlpha, otherwise
+    *     RGB, with the colorkey as tRNS. Rows use the filter with the
+    *     smallest sum of absolute differences.
+    * @param {surface_t const&} surface
+    * @param {FILE*} fileobj
+    * @param {int} level: 0 (stored) to 9 (smallest)
+    * @return bool
+    */
+    bool
+    mcl_png_encode (surface_t const& surface, FILE* fileobj, int level) noexcept {
+        if (!fileobj) return false;
+        mcl_imagebuf_t* ibuf = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        if (!ibuf) return false;
+        char flags = mcl_get_surface_data (&const_cast<surface_t&>(surface))[0];
+
+        mcl_simpletls_ns::mcl_spinlock_t lk(ibuf -> m_nrtlock, L"mcl_png_encode");
+        point1d_t w = ibuf -> m_width, h = ibuf -> m_height;
+        if (!w) return false;
+
+        mcl_simpletls_ns::mcl_auto_ptr_t<mcl_png_enc_t> enc_ptr (1);
+        mcl_png_enc_t* enc = enc_ptr;
+        if (!enc) return false;
+        bool b_alpha = (flags & surface_t::SrcAlpha) != 0;
+        bool b_key = !b_alpha && (flags & surface_t::SrcColorKey);
+        size_t bpp = b_alpha ? 4 : 3, rowbytes = static_cast<size_t>(w) * bpp;
+        mcl_simpletls_ns::mcl_auto_ptr_t<unsigned char> rows ((rowbytes + 1) * 3);
+        if (!rows) return false;
+        unsigned char* raw = rows, *up = rows + rowbytes, *flt = rows + rowbytes * 2;
+        ::memset (up, 0, rowbytes);
+
+        static int const chains[10] = { 0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096 };
+        static size_t const nices[10] = { 0, 8, 16, 32, 32, 64, 128, 128, 258, 258 };
+        enc -> level = level < 0 ? 6 : level > 9 ? 9 : level;
+        enc -> chain = chains[enc -> level];
+        enc -> nice = nices[enc -> level];
+        enc -> fp = fileobj;
+        for (int& v : enc -> head) v = -1;
+
+        // Signature, header and tRNS
+        unsigned char hdr[8 + 13];
+        if (::fwrite (mcl_png_sig, 1, 8, fileobj) != 8) return false;
+        mcl_png_wr32 (hdr + 8, static_cast<unsigned long>(w));
+        mcl_png_wr32 (hdr + 12, static_cast<unsigned long>(h));
+        hdr[16] = 8; hdr[17] = b_alpha ? 6 : 2;
+        hdr[18] = hdr[19] = hdr[20] = 0;
+        enc -> chunk ("IHDR", hdr, 13);
+        if (b_key) {
+            unsigned char trns[8 + 6];
+            for (int k = 0; k != 3; ++ k) {
+                trns[8 + k * 2] = 0;
+                trns[9 + k * 2] = static_cast<unsigned char>(ibuf -> m_colorkey >> (16 - k * 8));
+            }
+            enc -> chunk ("tRNS", trns, 6);
+        }
+
+        // zlib header
+        enc -> put_byte (0x78);
+        enc -> put_byte (enc -> level == 0 ? 0x01 : enc -> level < 6 ? 0x5e : enc -> level == 6 ? 0x9c : 0xda);
+
+        for (point1d_t y = 0; y != h && !enc -> b_error; ++ y) {
+            color_t const* src = ibuf -> m_pbuffer + y * w;
+            unsigned char* d = raw;
+            for (point1d_t x = 0; x != w; ++ x, d += bpp) {
+                color_t c = src[x];
+                d[0] = static_cast<unsigned char>(c >> 16);
+                d[1] = static_cast<unsigned char>(c >> 8);
+                d[2] = static_cast<unsigned char>(c);
+                if (b_alpha) d[3] = static_cast<unsigned char>(c >> 24);
+            }
+
+            // pick the filter with the smallest sum of absolute values
+            int best = 0;
+            if (enc -> level) {
+                unsigned long sum[5] = { 0, 0, 0, 0, 0 };
+                for (size_t i = 0; i != rowbytes; ++ i) {
+                    int a = i >= bpp ? raw[i - bpp] : 0, b = up[i], c = i >= bpp ? up[i - bpp] : 0, x = raw[i];
+                    int pa = b - c, pb = a - c, pc = pa + pb;
+                    pa = pa < 0 ? -pa : pa; pb = pb < 0 ? -pb : pb; pc = pc < 0 ? -pc : pc;
+                    int pr = pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+                    int v[5] = { x, x - a, x - b, x - ((a + b) >> 1), x - pr };
+                    for (int k = 0; k != 5; ++ k) {
+                        int s = static_cast<signed char>(static_cast<unsigned char>(v[k]));
+                        sum[k] += static_cast<unsigned long>(s < 0 ? -s : s);
+                    }
+                }
+                for (int k = 1; k != 5; ++ k) if (sum[k] < sum[best]) best = k;
+            }
+            flt[0] = static_cast<unsigned char>(best);
+            for (size_t i = 0; i != rowbytes; ++ i) {
+                int a = i >= bpp ? raw[i - bpp] : 0, b = up[i], c = i >= bpp ? up[i - bpp] : 0, x = raw[i];
+                switch (best) {
+                case 1: x -= a; break;
+                case 2: x -= b; break;
+                case 3: x -= (a + b) >> 1; break;
+                case 4: {
+                    int pa = b - c, pb = a - c, pc = pa + pb;
+                    pa = pa < 0 ? -pa : pa; pb = pb < 0 ? -pb : pb; pc = pc < 0 ? -pc : pc;
+                    x -= pa <= pb && pa <= pc ? a : pb <= pc ? b : c;
+                    break;
+                }
+                default: break;
+                }
+                flt[i + 1] = static_cast<unsigned char>(x);
+            }
+            enc -> feed (flt, rowbytes + 1);
+            unsigned char* t = raw; raw = up; up = t;
+        }
+        enc -> finish ();
+
+        unsigned char iend[8];
+        enc -> chunk ("IEND", iend, 0);
+        return !enc -> b_error;
+    }
+
+}
@@ -40,6 +40,7 @@
 #include "../src/clog4m.h"
 #include "../src/colors.h"
 #include "mcl_control.h"
+#include <cmath>
 
 #ifdef _MSC_VER
 # pragma warning(pop)
@@ -63,6 +64,7 @@ mcl {
     blend_t constexpr mcl_blend_t::Alpha;
 
     blend_t constexpr mcl_blend_t::PreMultiplied;
+    blend_t constexpr mcl_blend_t::Linear;
 
     blend_t constexpr mcl_blend_t::Copy_rgb;
     blend_t constexpr mcl_blend_t::Add_rgb;
@@ -117,8 +119,45 @@ mcl {
     mcl_release_imgbuf (mcl_imagebuf_t* imgbuf) {
         ::DeleteDC (imgbuf -> m_hdc);
         ::DeleteObject (imgbuf -> m_hbmp);
+        delete[] imgbuf -> m_mipbuf;
+        imgbuf -> m_mipbuf = nullptr;
+    }
+
+    /**
+     * @function mcl_new_generation <cpp/mcl_control.h>
+     * @brief get a new surface write generation.
+     * @return unsigned long long
+     */
+    unsigned long long
+    mcl_new_generation () noexcept {
+        static LONGLONG volatile generation = 0;
+        return static_cast<unsigned long long>(::InterlockedIncrement64 (&generation));
     }
     
+    /**
+     * @function mcl_get_srgb <cpp/mcl_control.h>
+     * @brief get the tables between sRGB and linear light.
+     * @return mcl_srgb_t const&
+     */
+    mcl_srgb_t const&
+    mcl_get_srgb () noexcept {
+        static mcl_srgb_t const tables = [] () -> mcl_srgb_t {
+            mcl_srgb_t t;
+            for (int i = 0; i != 256; ++ i) {
+                double s = double(i) / 255.;
+                double l = s <= .04045 ? s / 12.92 : std::pow ((s + .055) / 1.055, 2.4);
+                t.to_linear[i] = static_cast<unsigned short>(l * 4095. + .5);
+            }
+            for (int i = 0; i != 4096; ++ i) {
+                double l = double(i) / 4095.;
+                double s = l <= .0031308 ? l * 12.92 : 1.055 * std::pow (l, 1. / 2.4) - .055;
+                t.to_srgb[i] = static_cast<unsigned char>(s * 255. + .5);
+            }
+            return t;
+        } ();
+        return tables;
+    }
+
     /**
      * @function mcl_imagebuf_t::init <src/surface.cpp>
      * @brief initialize buffer for surface.
@@ -188,6 +227,209 @@ mcl {
     mcl_imagebuf_t::~mcl_imagebuf_t() noexcept {
         this -> uninit ();
     }
+
+    /**
+     * @function mcl_imagebuf_t::touch <src/surface.cpp>
+     * @brief Mark the pixels or alpha info as written.
+     * @return none
+     */
+    void mcl_imagebuf_t::
+    touch () noexcept {
+        m_generation = mcl_new_generation ();
+    }
+
+    /**
+     * @function mcl_mip_unpremul <cpp/surface.cpp>
+     * @brief unpremultiply the average of a 2x2 block.
+     * @param[in] c: premultiplied average
+     * @param[in] mode: 1 per-pixel alpha, 2 colorkey
+     * @return color_t
+     */
+    static inline color_t
+    mcl_mip_unpremul (color_t c, int mode, color_t key) noexcept {
+        color_t a = c >> 24, r = 0;
+        if (mode == 2 && a < 128) return key; // less than half covered
+        if (!a) return 0;
+        for (int k = 0; k != 24; k += 8) {
+            color_t v = (((c >> k) & 0xff) * 255u + (a >> 1)) / a;
+            r |= (v < 255 ? v : 255) << k;
+        }
+        if (mode == 1) return r | a << 24;
+        return (r == key ? r ^ 1 : r) | 0xff000000; // never make up the colorkey
+    }
+
+    /**
+     * @function mcl_mip_box <cpp/surface.cpp>
+     * @brief average a 2x2 block. with alpha (mode 1) or a colorkey (mode 2),
+     *     the colors are weighted by coverage.
+     * @return color_t
+     */
+    static inline color_t
+    mcl_mip_box (color_t c0, color_t c1, color_t c2, color_t c3, int mode, color_t key) noexcept {
+        color_t const c[4] = { c0, c1, c2, c3 };
+        color_t s[4] = { 0, 0, 0, 0 }, res = 0;
+        for (int i = 0; i != 4; ++ i) {
+            color_t a = c[i] >> 24;
+            if (mode == 2) a = (c[i] & 0xffffff) == key ? 0 : 255;
+            for (int k = 0; k != 3; ++ k) {
+                color_t v = (c[i] >> (k * 8)) & 0xff;
+                if (mode) v = v * a + 128, v = (v + (v >> 8)) >> 8;
+                s[k] += v;
+            }
+            s[3] += a;
+        }
+        for (int k = 0; k != 4; ++ k)
+            res |= ((s[k] + 2) >> 2) << (k * 8);
+        return mode ? mcl_mip_unpremul (res, mode, key) : res;
+    }
+
+    /**
+     * @function mcl_mip_box_linear <cpp/surface.cpp>
+     * @brief mcl_mip_box, averaging the colors in linear light.
+     * @return color_t
+     */
+    static inline color_t
+    mcl_mip_box_linear (mcl_srgb_t const& lin, color_t c0, color_t c1, color_t c2, color_t c3,
+        int mode, color_t key) noexcept {
+        color_t const c[4] = { c0, c1, c2, c3 };
+        color_t s[4] = { 0, 0, 0, 0 }, res = 0;
+        for (int i = 0; i != 4; ++ i) {
+            color_t a = mode ? c[i] >> 24 : 1;
+            if (mode == 2) a = (c[i] & 0xffffff) == key ? 0 : 255;
+            for (int k = 0; k != 3; ++ k)
+                s[k] += lin.to_linear[(c[i] >> (k * 8)) & 0xff] * a;
+            s[3] += mode ? a : c[i] >> 24;
+        }
+        color_t a = (s[3] + 2) >> 2;
+        if (mode == 2 && a < 128) return key;
+        if (mode && !s[3]) return 0;
+        color_t n = mode ? s[3] : 4;
+        for (int k = 0; k != 3; ++ k)
+            res |= color_t(lin.to_srgb[(s[k] + (n >> 1)) / n]) << (k * 8);
+        if (mode == 2) return (res == key ? res ^ 1 : res) | 0xff000000;
+        return res | a << 24;
+    }
+
+    /**
+     * @function mcl_mip_reduce <cpp/surface.cpp>
+     * @brief halve a level with a 2x2 box filter.
+     * @param[in] mode: 0 plain, 1 per-pixel alpha, 2 colorkey
+     * @param[in] b_linear: average in linear light
+     * @return none
+     */
+    static void
+    mcl_mip_reduce (color_t* dst0, point1d_t dw, point1d_t dh, color_t const* src,
+        point1d_t sw, point1d_t sh, int mode, color_t key, bool b_linear) noexcept {
+        mcl_srgb_t const& lin = mcl_get_srgb ();
+        mcl_parallel_obj.run (dh, static_cast<size_t>(dw) * static_cast<size_t>(dh) * 4u,
+        [=, &lin] (point1d_t ib, point1d_t ie) {
+            for (point1d_t y = ib; y != ie; ++ y) {
+                color_t const* r0 = src + (sh > 1 ? y * 2 : 0) * sw;
+                color_t const* r1 = r0 + (sh > 1 ? sw : 0);
+                color_t*       dst = dst0 + y * dw;
+                point1d_t      x = 0;
+                if (b_linear) {
+                    point1d_t dx = sw > 1 ? 1 : 0;
+                    for (; x != dw; ++ x)
+                        dst[x] = mcl_mip_box_linear (lin, r0[x * 2], r0[x * 2 + dx],
+                            r1[x * 2], r1[x * 2 + dx], mode, key);
+                    continue;
+                }
+                if (sw == 1) {
+                    dst[0] = mcl_mip_box (r0[0], r0[0], r1[0], r1[0], mode, key);
+                    continue;
+                }
+#ifdef MCL_SSE2
+                __m128i const zero  = _mm_setzero_si128 ();
+                __m128i const two   = _mm_set1_epi16 (2);
+                __m128i const half  = _mm_set1_epi16 (128);
+                __m128i const amask = _mm_set_epi16 (255, 0, 0, 0, 255, 0, 0, 0);
+                __m128i const rgb   = _mm_set1_epi32 (0xffffff);
+                __m128i const vkey  = _mm_set1_epi32 (static_cast<int>(key));
+                __m128i const opaque = _mm_slli_epi32 (_mm_set1_epi32 (0xff), 24);
+                auto fpremul = [=] (__m128i v) -> __m128i {
+                    if (!mode) return v;
+                    __m128i f = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (v, 0xff), 0xff);
+                    f = _mm_or_si128 (_mm_andnot_si128 (amask, f), amask);
+                    v = _mm_add_epi16 (_mm_mullo_epi16 (v, f), half);
+                    return _mm_srli_epi16 (_mm_add_epi16 (v, _mm_srli_epi16 (v, 8)), 8);
+                };
+                auto fload = [=] (color_t const* p) -> __m128i {
+                    __m128i v = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(p));
+                    if (mode != 2) return v;
+                    __m128i k = _mm_cmpeq_epi32 (_mm_and_si128 (v, rgb), vkey);
+                    return _mm_andnot_si128 (k, _mm_or_si128 (v, opaque)); // keyed pixels become 0
+                };
+                for (; x + 1 < dw; x += 2) {
+                    __m128i a = fload (r0 + x * 2), b = fload (r1 + x * 2);
+                    __m128i s = _mm_add_epi16 (fpremul (_mm_unpacklo_epi8 (a, zero)), fpremul (_mm_unpacklo_epi8 (b, zero)));
+                    __m128i t = _mm_add_epi16 (fpremul (_mm_unpackhi_epi8 (a, zero)), fpremul (_mm_unpackhi_epi8 (b, zero)));
+                    s = _mm_add_epi16 (s, _mm_srli_si128 (s, 8));
+                    t = _mm_add_epi16 (t, _mm_srli_si128 (t, 8));
+                    s = _mm_srli_epi16 (_mm_add_epi16 (_mm_unpacklo_epi64 (s, t), two), 2);
+                    _mm_storel_epi64 (reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16 (s, s));
+                    if (mode) {
+                        dst[x]     = mcl_mip_unpremul (dst[x], mode, key);
+                        dst[x + 1] = mcl_mip_unpremul (dst[x + 1], mode, key);
+                    }
+                }
+#endif
+                for (; x != dw; ++ x)
+                    dst[x] = mcl_mip_box (r0[x * 2], r0[x * 2 + 1], r1[x * 2], r1[x * 2 + 1], mode, key);
+            }
+        });
+    }
+
+    /**
+     * @function mcl_imagebuf_t::mip_level <src/surface.cpp>
+     * @brief Get the smallest mip level not smaller than size. The chain
+     *     is rebuilt when the buffer was written since it was built.
+     * @param[in] size: the size that will be sampled to
+     * @param[in] flags: surface flags
+     * @param[out] level_size: size of the level
+     * @return color_t*: nullptr if level 0 (the buffer itself) is the one to use
+     */
+    color_t* mcl_imagebuf_t::
+    mip_level (point2d_t size, char flags, point2d_t* level_size) noexcept {
+        if (!m_mipmap || !m_width || !level_size || size.x <= 0 || size.y <= 0) return nullptr;
+        if (size.x > (m_width >> 1) || size.y > (m_height >> 1))
+            return nullptr;
+
+        // (re)build the chain
+        if (!m_mipbuf || m_mipgen != m_generation || m_mipflags != flags) {
+            int mode = (flags & surface_t::SrcAlpha) ? 1 : ((flags & surface_t::SrcColorKey) ? 2 : 0);
+            size_t total = 0;
+            for (point1d_t w = m_width, h = m_height; w > 1 || h > 1; ) {
+                w = w > 1 ? w >> 1 : 1, h = h > 1 ? h >> 1 : 1;
+                total += static_cast<size_t>(w) * static_cast<size_t>(h);
+            }
+            delete[] m_mipbuf;
+            m_mipbuf = new (std::nothrow) color_t[total];
+            if (!m_mipbuf) return nullptr;
+
+            color_t const* src = m_pbuffer;
+            color_t*       dst = m_mipbuf;
+            for (point1d_t w = m_width, h = m_height; w > 1 || h > 1; ) {
+                point1d_t dw = w > 1 ? w >> 1 : 1, dh = h > 1 ? h >> 1 : 1;
+                mcl_mip_reduce (dst, dw, dh, src, w, h, mode, m_colorkey, flags & 0x40);
+                src = dst, dst += static_cast<size_t>(dw) * static_cast<size_t>(dh);
+                w = dw, h = dh;
+            }
+            m_mipgen = m_generation, m_mipflags = flags;
+        }
+
+        // walk down to the level
+        color_t*  level = m_mipbuf;
+        point1d_t w = m_width >> 1, h = m_height >> 1;
+        for (;;) {
+            point1d_t dw = w > 1 ? w >> 1 : 1, dh = h > 1 ? h >> 1 : 1;
+            if ((dw == w && dh == h) || dw < size.x || dh < size.y) break;
+            level += static_cast<size_t>(w) * static_cast<size_t>(h);
+            w = dw, h = dh;
+        }
+        level_size -> x = w, level_size -> y = h;
+        return level;
+    }
     
 
 
@@ -266,6 +508,7 @@ mcl {
             dsrc -> m_hdc, 0, 0, SRCCOPY);
         
         ddst -> m_alpha = dsrc -> m_alpha;
+        ddst -> m_mipmap = dsrc -> m_mipmap;
         if (!(m_data_[0] & SrcAlpha))
             ddst -> m_colorkey = dsrc -> m_colorkey;
     }
@@ -340,6 +583,7 @@ mcl {
         }
         if (m_dataplus_) {
             mcl_simpletls_ns::mcl_spinlock_t lk(old_dp -> m_nrtlock, L"surface_t::operator=");
+            old_dp -> touch ();
             
             // create compatible surface
             mcl_imagebuf_t* dsrc = static_cast<mcl_imagebuf_t*>(rhs.m_dataplus_);
@@ -360,6 +604,7 @@ mcl {
             old_dp -> m_width   = new_dp.m_width;
 
             old_dp -> m_alpha = dsrc -> m_alpha;
+            old_dp -> m_mipmap = dsrc -> m_mipmap;
             if (!(m_data_[0] & SrcAlpha))
                 old_dp -> m_colorkey = dsrc -> m_colorkey;
 
@@ -380,6 +625,7 @@ mcl {
         m_dataplus_ = new_dp;
 
         new_dp -> m_alpha = dsrc -> m_alpha;
+        new_dp -> m_mipmap = dsrc -> m_mipmap;
         if (!(m_data_[0] & SrcAlpha))
             new_dp -> m_colorkey = dsrc -> m_colorkey;
         return *this;
@@ -461,6 +707,7 @@ mcl {
         mcl_imagebuf_t* dataplus = reinterpret_cast<mcl_imagebuf_t*>(m_dataplus_);
         if (!dataplus) return ;
         mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"surface_t::set_colorkey");
+        dataplus -> touch ();
         if (!dataplus -> m_width) return ;
         m_data_[0] &= ~SrcColorKey;
     }
@@ -469,6 +716,7 @@ mcl {
         mcl_imagebuf_t* dataplus = reinterpret_cast<mcl_imagebuf_t*>(m_dataplus_);
         if (!dataplus) return ;
         mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"surface_t::set_colorkey");
+        dataplus -> touch ();
         if (!dataplus -> m_width || (m_data_[0] & SrcAlpha)) return ;
         m_data_[0] |= SrcColorKey;
         dataplus -> m_colorkey = colorkey & 0xffffff;
@@ -491,6 +739,7 @@ mcl {
         mcl_imagebuf_t* dataplus = reinterpret_cast<mcl_imagebuf_t*>(m_dataplus_);
         if (!dataplus) return ;
         mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"surface_t::set_alpha");
+        dataplus -> touch ();
         if (!dataplus -> m_width) return ;
         m_data_[0] &= ~SrcAlpha;
         m_data_[0] &= ~SrcColorKey;
@@ -501,6 +750,7 @@ mcl {
         mcl_imagebuf_t* dataplus = reinterpret_cast<mcl_imagebuf_t*>(m_dataplus_);
         if (!dataplus) return ;
         mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"surface_t::set_alpha");
+        dataplus -> touch ();
         if (!dataplus -> m_width) return ;
         dataplus -> m_alpha = (alpha <= 0xff ? alpha : 0xff);
     }
@@ -511,6 +761,31 @@ mcl {
         return dataplus -> m_alpha;
     }
 
+    /**
+     * @function surface_t::set_mipmap <src/surface.h>
+     * @brief Keep a mip chain that transform.scale and
+     *     transform.rotozoom sample from when shrinking.
+     * @return none
+     */
+    void surface_t::
+    set_mipmap (bool b_mipmap) noexcept{
+        mcl_imagebuf_t* dataplus = reinterpret_cast<mcl_imagebuf_t*>(m_dataplus_);
+        if (!dataplus) return ;
+        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"surface_t::set_mipmap");
+        if (!dataplus -> m_width) return ;
+        // scale and rotozoom cache their results by the write generation
+        if (dataplus -> m_mipmap != b_mipmap) dataplus -> touch ();
+        dataplus -> m_mipmap = b_mipmap;
+        if (b_mipmap) return ;
+        delete[] dataplus -> m_mipbuf;
+        dataplus -> m_mipbuf = nullptr;
+    }
+    bool surface_t::
+    get_mipmap () const noexcept{
+        mcl_imagebuf_t* dataplus = reinterpret_cast<mcl_imagebuf_t*>(m_dataplus_);
+        return dataplus && dataplus -> m_width && dataplus -> m_mipmap;
+    }
+
     /**
      * @function surface_t::lock <src/surface.h>
      * @return surface_t&
@@ -531,6 +806,7 @@ mcl {
     unlock () noexcept {
         mcl_imagebuf_t* dataplus = reinterpret_cast<mcl_imagebuf_t*>(m_dataplus_);
         if (!dataplus) return *this; // display surface quit
+        dataplus -> touch (); // the pixels may have been written while locked
         mcl_simpletls_ns::mcl_unlock (dataplus -> m_nrtlock, dataplus -> m_nrt_count);
         return *this;
     }
@@ -577,6 +853,7 @@ mcl {
         if (!dataplus) return opaque; // display surface quit
         if (pos.x < 0 || pos.y < 0) return opaque;
         mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"surface_t::set_at");
+        dataplus -> touch ();
         if (pos.x >= dataplus -> m_width || pos.y >= dataplus -> m_height)
             return opaque; // out of clip area
 
@@ -651,9 +928,10 @@ mcl {
      */
     color_t* surface_t::
     _pixels_address () noexcept{
-        return m_dataplus_ ?
-            reinterpret_cast<mcl_imagebuf_t*>(m_dataplus_) -> m_pbuffer
-            : nullptr;
+        mcl_imagebuf_t* dataplus = reinterpret_cast<mcl_imagebuf_t*>(m_dataplus_);
+        if (!dataplus) return nullptr;
+        dataplus -> touch (); // the caller may write through the address
+        return dataplus -> m_pbuffer;
     }
 
 
@@ -685,9 +963,10 @@ mcl {
         
         // flags info
         bool b_premult = (special_flags & blend.PreMultiplied) && rhs_sa && rhs_alpha == 0xff000000;
+        mcl_srgb_t const* lin = (special_flags & blend.Linear) ? &mcl_get_srgb () : nullptr;
         if (!(special_flags & 0x300)) special_flags |= 0x200;
         if ((special_flags & 0x300) == 0x300) special_flags &= ~0x100;
-        special_flags &= ~blend.PreMultiplied;
+        special_flags &= ~(blend.PreMultiplied | blend.Linear);
         
         if (special_flags == mcl_blend_t::Alpha_rgba && !rhs_sa && rhs_alpha == 0xff000000)
             special_flags = (special_flags & 0xff) | 0x100;
@@ -802,7 +1081,7 @@ mcl {
                     break;
                 }
                 blend_fun = [m_dataplus_rhs, lhs_sa, lhs_b_useck,
-                    lhs_ck, rhs_sa, rhs_b_useck, rhs_ck]
+                    lhs_ck, rhs_sa, rhs_b_useck, rhs_ck, lin]
                 (color_t& dst, color_t src) {
                     // calc the alpha of src
                     color_t sa = 0;
@@ -831,6 +1110,15 @@ mcl {
                     color_t da = (dst >> 24) * psa / 255;
                     color_t t = sa + da;
                     if (!t) { dst = 0; return ; }
+                    if (lin) { // weight the colors in linear light
+                        unsigned short const* pl = lin -> to_linear;
+                        unsigned char const* ps = lin -> to_srgb;
+                        color_t r = ps[(pl[getr4rgb(dst)] * da + pl[getr4rgb(src)] * sa) / t];
+                        color_t g = ps[(pl[getg4rgb(dst)] * da + pl[getg4rgb(src)] * sa) / t];
+                        color_t b = ps[(pl[getb4rgb(dst)] * da + pl[getb4rgb(src)] * sa) / t];
+                        dst = (t << 24) | (r << 16) | (g << 8) | b;
+                        return ;
+                    }
                     color_t r = (getr4rgb(dst) * da + srsa) / t;
                     color_t g = (getg4rgb(dst) * da + sgsa) / t;
                     color_t b = (getb4rgb(dst) * da + sbsa) / t;
@@ -1134,6 +1422,7 @@ mcl {
         // lock
         std::function<void(color_t& dst, color_t src)> blend_fun;
         mcl_simpletls_ns::mcl_spinlock_t lk(dst -> m_nrtlock, L"surface_t::blit");
+        dst -> touch ();
         if (!(dst -> m_width && source.m_dataplus_ && src -> m_width))
             return { 0, 0, 0, 0 };
         
@@ -1194,6 +1483,7 @@ mcl {
         
         // lock
         mcl_simpletls_ns::mcl_spinlock_t lk(dst -> m_nrtlock, L"surface_t::blit");
+        dst -> touch ();
         if (!(dst -> m_width && src && src -> m_width))
             return { dest.x, dest.y, 0, 0 };
         
@@ -1266,6 +1556,7 @@ mcl {
         
         // lock
         mcl_simpletls_ns::mcl_spinlock_t lk(dst -> m_nrtlock, L"surface_t::blit");
+        dst -> touch ();
         if (!(dst -> m_width && source.m_dataplus_ && src -> m_width))
             return { 0, 0, 0, 0 };
         
@@ -1333,6 +1624,7 @@ mcl {
         
         // lock
         mcl_simpletls_ns::mcl_spinlock_t lk(dst -> m_nrtlock, L"surface_t::blit");
+        dst -> touch ();
         if (!(dst -> m_width && source.m_dataplus_ && src -> m_width))
             return { dest.x, dest.y, 0, 0 };
         
@@ -1396,6 +1688,7 @@ mcl {
         }
         
         mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"surface_t::resize");
+        dataplus -> touch ();
         if (size.x == dataplus -> m_width && size.y == dataplus -> m_height || !size.x)
             return { 0, 0 }; // no change
         
@@ -1463,7 +1756,7 @@ mcl {
         bool b_premult = special_flags & blend.PreMultiplied;
         if (!(special_flags & 0x300)) special_flags |= 0x200;
         if ((special_flags & 0x300) == 0x300) special_flags &= ~0x100;
-        special_flags &= ~blend.PreMultiplied;
+        special_flags &= ~(blend.PreMultiplied | blend.Linear);
         
         if (b_premult) {
             if (special_flags == mcl_blend_t::Copy_rgba || special_flags == mcl_blend_t::Min_rgba
@@ -1759,6 +2052,7 @@ mcl {
             return { 0, 0, 0, 0 };
 
         mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"surface_t::fill");
+        dataplus -> touch ();
         if (!dataplus -> m_width)
             return { 0, 0, 0, 0 };
 
@@ -1806,6 +2100,7 @@ mcl {
 
         // prepare for blending
         mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"surface_t::fill");
+        dataplus -> touch ();
         if (!dataplus -> m_width)
             return { recta.x, recta.y, 0, 0 }; 
         
@@ -39,6 +39,9 @@
 #include "../src/surface.h"
 #include "mcl_control.h"
 #include <cmath>
+#include <cstring>    // for memset
+#include <list>
+#include <map>
 
 #ifdef _MSC_VER
 # pragma warning(pop)
@@ -49,10 +52,133 @@ mcl {
 
     // Module for surface transfer.
     mcl_transform_t transform;
+    // Flags for convolution.
+    mcl_conv_t conv;
+
+#if __cplusplus < 201703L
+    conv_t constexpr mcl_conv_t::Clamp;
+    conv_t constexpr mcl_conv_t::Wrap;
+    conv_t constexpr mcl_conv_t::Zero;
+    conv_t constexpr mcl_conv_t::Float;
+    conv_t constexpr mcl_conv_t::Abs;
+    conv_t constexpr mcl_conv_t::Gray;
+#endif
     
+   /**
+    * @class mcl_tcache_t <cpp/transform.cpp>
+    * @brief LRU cache of transform results, keyed by the source
+    *     buffer, its write generation, the operation and its arguments.
+    */
+    struct mcl_tcache_key_t {
+        void const*        src;
+        unsigned long long gen;
+        int                op;
+        char               flags;
+        double             args[3];
+
+        bool operator< (mcl_tcache_key_t const& rhs) const noexcept {
+            if (gen != rhs.gen) return gen < rhs.gen;
+            if (src != rhs.src) return std::less<void const*>() (src, rhs.src);
+            if (op != rhs.op) return op < rhs.op;
+            if (flags != rhs.flags) return flags < rhs.flags;
+            for (int i = 0; i != 3; ++ i)
+                if (args[i] != rhs.args[i]) return args[i] < rhs.args[i];
+            return false;
+        }
+    };
+    class mcl_tcache_t {
+    public:
+        struct entry_t { mcl_tcache_key_t key; surface_t res; point2d_t offset; size_t bytes; };
+        using list_t = std::list<entry_t>;
+
+        // copy a cached result out. false on a miss
+        bool get (mcl_tcache_key_t const& key, surface_t& res, point2d_t* offset) noexcept {
+            mcl_simpletls_ns::mcl_spinlock_t lk(m_lock, L"mcl_tcache_t::get");
+            if (!m_budget) return false;
+            auto it = m_index.find (key);
+            if (it == m_index.end ()) { ++ m_misses; return false; }
+            ++ m_hits;
+            m_lru.splice (m_lru.begin (), m_lru, it -> second);
+            res = it -> second -> res;
+            if (offset) *offset = it -> second -> offset;
+            return true;
+        }
+        // keep a result, evicting the least recently used ones over budget
+        void put (mcl_tcache_key_t const& key, surface_t const& res, point2d_t const* offset) noexcept {
+            size_t bytes = static_cast<size_t>(res.get_width ()) * static_cast<size_t>(res.get_height ()) * 4u;
+            mcl_simpletls_ns::mcl_spinlock_t lk(m_lock, L"mcl_tcache_t::put");
+            if (!res || !bytes || bytes > m_budget || m_index.count (key)) return ;
+            try { m_lru.push_front (entry_t { key, res, offset ? *offset : point2d_t{ 0, 0 }, bytes }); }
+            catch (...) { return ; }
+            if (!m_lru.front ().res) { m_lru.pop_front (); return ; }
+            try { m_index[key] = m_lru.begin (); }
+            catch (...) { m_lru.pop_front (); return ; }
+            m_bytes += bytes;
+            this -> shrink (m_budget);
+        }
+        // evict until at most budget bytes are used. each result holds
+        // a gdi bitmap, so the number of results is bounded as well
+        void shrink (size_t budget) noexcept {
+            while ((m_bytes > budget || m_lru.size () > MaxEntries) && !m_lru.empty ()) {
+                m_bytes -= m_lru.back ().bytes;
+                m_index.erase (m_lru.back ().key);
+                m_lru.pop_back ();
+            }
+        }
+
+    public:
+        typename mcl_simpletls_ns::mcl_spinlock_t::lock_t m_lock = 0ul;
+        size_t m_budget = 0, m_bytes = 0;
+        size_t m_hits = 0, m_misses = 0;
+        enum : size_t { MaxEntries = 1024 };
+        list_t m_lru;
+        std::map<mcl_tcache_key_t, list_t::iterator> m_index;
+    };
+    static mcl_tcache_t mcl_tcache_obj;
+
+    // transform.set_linear
+    static bool volatile mcl_transform_linear = false;
+
+    // a channel of c, or its 12-bit linear light if lin is set
+    static inline double
+    mcl_lin_dec (mcl_srgb_t const* lin, color_t c) noexcept{
+        return lin ? double(lin -> to_linear[c & 0xff]) : double(c & 0xff);
+    }
+
+    // back from mcl_lin_dec, rounded and clamped
+    static inline color_t
+    mcl_lin_enc (mcl_srgb_t const* lin, double f) noexcept{
+        color_t c = f > 0. ? color_t(f + .5f) : 0;
+        if (lin) return lin -> to_srgb[c < 4095 ? c : 4095];
+        return c < 255 ? c : 255;
+    }
+
     mcl_transform_t::operator void* () const noexcept{ return const_cast<mcl_transform_t*>(this); }
     bool mcl_transform_t::operator! () const noexcept{ return false; }
 
+    // writes the w pixels of src to dst in reverse order
+    static inline void
+    mcl_reverse_row (color_t* dst, color_t const* src, point1d_t w) noexcept{
+        color_t const* s = src + w;
+        point1d_t i = 0;
+#ifdef MCL_SSE2
+        for (point1d_t n4 = w & ~point1d_t(3); i != n4; i += 4) {
+            s -= 4;
+            __m128i v = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(s));
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi32 (v, 0x1b));
+        }
+#endif
+        for (; i != w; ++ i) dst[i] = *-- s;
+    }
+
+    // sets n pixels to c
+    static inline void
+    mcl_fill_row (color_t* dst, point1d_t n, color_t c) noexcept{
+        if (n <= 0) return ;
+        if (!c) { ::memset (dst, 0, static_cast<size_t>(n) * sizeof (color_t)); return ; }
+        for (color_t* e = dst + n; dst != e; ++ dst) *dst = c;
+    }
+
     /**
      * @function mcl_transform_t::flip <src/transform.cpp>
      * @brief flip vertically and horizontally
@@ -62,45 +188,38 @@ mcl {
      */
     surface_t mcl_transform_t::
     flip (surface_t const& surface, bool flip_x, bool flip_y) noexcept{
-        surface_t res (surface); // no lock required
-        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&res);
-        if (!dataplus || !dataplus -> m_width) return sf_nullptr;
-        
-        if (dataplus -> m_width  == 1) flip_x = false;
-        if (dataplus -> m_height == 1) flip_y = false;
-        if (!(flip_x || flip_y)) return res;
-        
-        point1d_t sdx = 1, sdy = 0, ddx = -1, ddy = 0;
-        color_t *src = dataplus -> m_pbuffer, *dst = dataplus -> m_pbuffer;
-        color_t *ex  = dataplus -> m_pbuffer, *ey  = dataplus -> m_pbuffer;
-        
-        // map direction
-        if (flip_x && flip_y) {
-            ey += (dataplus -> m_height >> 1) * dataplus -> m_width;
-            dst += dataplus -> m_height * dataplus -> m_width - 1;
-        } else if (flip_x) {
-            sdy = dataplus -> m_width - (dataplus -> m_width >> 1);
-            ddy = dataplus -> m_width + (dataplus -> m_width >> 1);
-            ex -= sdy;
-            ey += dataplus -> m_height * dataplus -> m_width;
-            dst += dataplus -> m_width - 1;
-        } else {
-            ddx = 1;
-            ddy = -(dataplus -> m_width << 1);
-            ey += (dataplus -> m_height >> 1) * dataplus -> m_width;
-            dst += (dataplus -> m_height - 1) * dataplus -> m_width;
+        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        char*           data     = mcl_get_surface_data (&const_cast<surface_t&>(surface));
+        if (!dataplus) return sf_nullptr;
+
+        // lock
+        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::flip");
+        point1d_t w = dataplus -> m_width, h = dataplus -> m_height;
+        if (!w) return sf_nullptr;
+
+        // create compatible surface
+        surface_t res ({ w, h }, data[0]);
+        mcl_imagebuf_t* res_dataplus = mcl_get_surface_dataplus (&res);
+        char*           res_data     = mcl_get_surface_data (&res);
+        if (!(res_dataplus && res_dataplus -> m_width)) return sf_nullptr;
+
+        // copy alpha info
+        res_data[0] = data[0];
+        res_dataplus -> m_colorkey = dataplus -> m_colorkey;
+        res_dataplus -> m_alpha = dataplus -> m_alpha;
+
+        // whole rows are copied, reversed if flip_x
+        color_t const* src = dataplus -> m_pbuffer;
+        color_t*       dst = res_dataplus -> m_pbuffer;
+        if (!flip_x && !flip_y) {
+            ::memcpy (dst, src, static_cast<size_t>(w) * static_cast<size_t>(h) * sizeof (color_t));
+            return res;
+        }
+        for (point1d_t y = 0; y != h; ++ y, dst += w) {
+            color_t const* s = src + static_cast<size_t>(flip_y ? h - 1 - y : y) * static_cast<size_t>(w);
+            if (flip_x) mcl_reverse_row (dst, s, w);
+            else ::memcpy (dst, s, static_cast<size_t>(w) * sizeof (color_t));
         }
-        
-        // flip surface
-        color_t temp = 0;
-        for (; src != ey; src += sdy, dst += ddy)
-            for (ex += dataplus -> m_width; src != ex; src += sdx, dst += ddx)
-                temp = *dst, *dst = *src, *src = temp;
-        
-        // middle line
-        if (flip_x && flip_y && (dataplus -> m_height & 1))
-            for (ex += dataplus -> m_width >> 1; src != ex; ++ src, -- dst)
-                temp = *dst, *dst = *src, *src = temp;
         return res;
     }
 
@@ -121,6 +240,14 @@ mcl {
         // lock
         mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::scale");
         if (!dataplus -> m_width) return sf_nullptr;
+
+        // cached result. 0x40 marks linear light
+        mcl_srgb_t const* lin = mcl_transform_linear ? &mcl_get_srgb () : nullptr;
+        char lflags = char(data[0] | (lin ? 0x40 : 0));
+        mcl_tcache_key_t key = { dataplus, dataplus -> m_generation, 1, lflags,
+            { double(size.x), double(size.y), double(smooth_ipt) } };
+        surface_t cached;
+        if (mcl_tcache_obj.get (key, cached, offset)) return cached;
         
         // create compatible surface
         surface_t res (size, data[0]);
@@ -136,10 +263,15 @@ mcl {
         bool b_ck = res_data[0] & surface_t::SrcColorKey;
         color_t m_ck = res_dataplus -> m_colorkey;
         
-        // scaling calc
-        color_t *src = dataplus -> m_pbuffer, *dst = res_dataplus -> m_pbuffer;
-        double kx = double(size.x) / double(dataplus -> m_width);
-        double ky = double(size.y) / double(dataplus -> m_height);
+        // scaling calc. shrink from the nearest mip level if the surface keeps one
+        point2d_t lsize = { 0, 0 };
+        color_t*  level = dataplus -> mip_level (size, lflags, &lsize);
+        color_t *src = level ? level : dataplus -> m_pbuffer, *dst0 = res_dataplus -> m_pbuffer;
+        point1d_t sw = level ? lsize.x : dataplus -> m_width;
+        point1d_t sh = level ? lsize.y : dataplus -> m_height;
+        size_t    work = static_cast<size_t>(size.x) * static_cast<size_t>(size.y);
+        double kx = double(size.x) / double(sw);
+        double ky = double(size.y) / double(sh);
         
         if (smooth_ipt >= 2 && (size.x < 3 || size.y < 3))
             smooth_ipt = 1;
@@ -150,313 +282,324 @@ mcl {
         
         if (smooth_ipt <= 0) {
         // nearest neighbor
-            point1d_t i = 0, j = 0, y = 0;
-            for (; i != size.y; ++ i, dst += size.x) {
-                y = point1d_t(double(i) / ky + .5f);
-                src = dataplus -> m_pbuffer + y * dataplus -> m_width;
-                for (j = 0; j != size.x; ++ j)
-                    dst[j] = src[point1d_t(double(j) / kx + .5f)];
-            }
-        } else if (smooth_ipt == 1) {
-        // bilinear interpolation
-            // lerp ratio
-            point1d_t i = 0, j = 0;
-            point1d_t x1 = 0, y1 = 0, x2 = 0, y2 = 0;
-            double xm = 0.f, ym = 0.f;
-            double dx = 0.f, dy = 0.f, fdx = 0.f, fdy = 0.f;
-            // color value
-            color_t cs1 = 0, cs2 = 0, cs3 = 0, cs4 = 0;
-            double  fca = 1.f, fcr = 0.f, fcg = 0.f, fcb = 0.f;
-            double  a1 = 0.f, a2 = 0.f, a3 = 0.f, a4 = 0.f;
-
-            // start interpolation
-            for (; i != size.y; ++ i, dst += size.x) {
-                ym = double(i) / ky;
-                y1 = point1d_t(ym), y2 = y1 + 1;
-                dy = ym - double(y1), fdy = 1.f - dy;
-                if (y2 == dataplus -> m_height)
-                    y2 = dataplus -> m_height - 1;
-
-                for (j = 0; j != size.x; ++ j) {
-                    xm = double(j) / kx;
-                    x1 = point1d_t(xm), x2 = x1 + 1;
-                    dx = xm - double(x1), fdx = 1.f - dx;
-                    if (x2 == dataplus -> m_width)
-                        x2 = dataplus -> m_width - 1;
-                    
-                    // lerp pixel
-                    cs1 = src[y1 * dataplus -> m_width + x1];
-                    cs2 = src[y1 * dataplus -> m_width + x2];
-                    cs3 = src[y2 * dataplus -> m_width + x1];
-                    cs4 = src[y2 * dataplus -> m_width + x2];
-
-                    a1 = fdx * fdy, a2 = dx * fdy;
-                    a3 = fdx * dy,  a4 = dx * dy;
-
-                    // premult alpha
-                    if (b_sa) {
-                        a1 *= double(cs1 >> 24) / 255.f;
-                        a2 *= double(cs2 >> 24) / 255.f;
-                        a3 *= double(cs3 >> 24) / 255.f;
-                        a4 *= double(cs4 >> 24) / 255.f;
-                        fca = a1 + a2 + a3 + a4; // alpha test
-                        if (fca <= .0f) { dst[j] = 0; continue; }
-                    } else if (b_ck) {
-                        if ((cs1 & 0xffffff) == m_ck) a1 = 0;
-                        if ((cs2 & 0xffffff) == m_ck) a2 = 0;
-                        if ((cs3 & 0xffffff) == m_ck) a3 = 0;
-                        if ((cs4 & 0xffffff) == m_ck) a4 = 0;
-                        fca = a1 + a2 + a3 + a4; // alpha test
-                        if (fca < .5f) { dst[j] = m_ck; continue; }
+            mcl_parallel_obj.run (size.y, work, [=] (point1d_t ib, point1d_t ie) {
+                color_t* dst = dst0 + ib * size.x, *srcl = 0;
+                point1d_t x = 0, y = 0;
+                for (point1d_t i = ib; i != ie; ++ i, dst += size.x) {
+                    y = point1d_t(double(i) / ky + .5f);
+                    srcl = src + (y < sh ? y : sh - 1) * sw;
+                    for (point1d_t j = 0; j != size.x; ++ j) {
+                        x = point1d_t(double(j) / kx + .5f);
+                        dst[j] = srcl[x < sw ? x : sw - 1];
                     }
-
-                    // calc rgb value & unpremult alpha
-                    fcr = double((cs1 >> 16) & 0xff) * a1 +
-                          double((cs2 >> 16) & 0xff) * a2 +
-                          double((cs3 >> 16) & 0xff) * a3 +
-                          double((cs4 >> 16) & 0xff) * a4;
-                    fcg = double((cs1 >> 8)  & 0xff) * a1 +
-                          double((cs2 >> 8)  & 0xff) * a2 +
-                          double((cs3 >> 8)  & 0xff) * a3 +
-                          double((cs4 >> 8)  & 0xff) * a4;
-                    fcb = double( cs1        & 0xff) * a1 +
-                          double( cs2        & 0xff) * a2 +
-                          double( cs3        & 0xff) * a3 +
-                          double( cs4        & 0xff) * a4;
-                    fcr /= fca, fcg /= fca, fcb /= fca;
-
-                    // update rgba
-                    dst[j] = (b_sa ? color_t(fca * 255.f + .5f) : 255) << 24 |
-                        color_t(fcr + .5f) << 16 | color_t(fcg + .5f) << 8 | color_t(fcb + .5f);
                 }
-            }
-        } else {
-        // bicubic_interpolation
-            // lerp ratio
-            point1d_t i = 0, j = 0;
-            point1d_t x0 = 0, x1 = 0, x2 = 0, x3 = 0;
-            point1d_t y0 = 0, y1 = 0, y2 = 0, y3 = 0;
-            double xm = 0, ym = 0;
-            double dx0 = 0.f, dx1 = 0.f, dx2 = 0.f, dx3 = 0.f;
-            double dy0 = 0.f, dy1 = 0.f, dy2 = 0.f, dy3 = 0.f;
-            double dx = 0.f, fdx = 0.f, dy = 0.f, fdy = 0.f;
-            // color value
-            color_t *q0 = 0, *q1 = 0, *q2 = 0, *q3 = 0;
-            double fca = 1.f, fcr = 0.f, fcg = 0.f, fcb = 0.f;
-            color_t pa = 0, pr = 0, pg = 0, pb = 0;
-            double a01 = 0.f, a02 = 0.f, a03 = 0.f, a04 = 0.f;
-            double a05 = 0.f, a06 = 0.f, a07 = 0.f, a08 = 0.f;
-            double a09 = 0.f, a10 = 0.f, a11 = 0.f, a12 = 0.f;
-            double a13 = 0.f, a14 = 0.f, a15 = 0.f, a16 = 0.f;
-            
-            // interpolation function
-            auto fpBiCubicPoly = []
-            (double x) -> double {
-                double const abs_x = x > 0.f ? x : -x;
-                double constexpr a = -.5f;
-                return (abs_x <= 1.f) ? 
-                    (a + 2.f) * (abs_x * abs_x * abs_x) -
-                    (a + 3.f) * (abs_x * abs_x) + 1: (
-                       (abs_x <  2.f) ?
-                    (a) * (abs_x * abs_x * abs_x) - (5.f * a) * (abs_x * abs_x) +
-                    (8.f * a) * abs_x - 4.f * a : 0.f);
-            };
-
-            // start interpolation
-            for (; i != size.y; ++ i, dst += size.x) {
-                ym = double(i) / double(ky);
-                y0 = point1d_t(ym) - 1, y1 = point1d_t(ym);
-                y2 = point1d_t(ym) + 1, y3 = point1d_t(ym) + 2;
-
-                dy0 = fpBiCubicPoly (ym - double(y0));
-                dy1 = fpBiCubicPoly (ym - double(y1));
-                dy2 = fpBiCubicPoly (ym - double(y2));
-                dy3 = fpBiCubicPoly (ym - double(y3));
-
-                for (j = 0; j != size.x; ++ j) {
-                    xm = double(j) / double(kx);
-                    x0 = point1d_t(xm) - 1, x1 = point1d_t(xm);
-                    x2 = point1d_t(xm) + 1, x3 = point1d_t(xm) + 2;
-                    
-                    // test if pixels exist
-                    bool b_border = (x0 >= 0 && x3 < dataplus -> m_width
-                        && y0 >= 0 && y3 < dataplus -> m_height);
-                    if (b_border) {
-
-                        dx0 = fpBiCubicPoly (xm - double(x0));
-                        dx1 = fpBiCubicPoly (xm - double(x1));
-                        dx2 = fpBiCubicPoly (xm - double(x2));
-                        dx3 = fpBiCubicPoly (xm - double(x3));
-
-                        // lerp pixel
-                        q0 = src + y0 * dataplus -> m_width;
-                        q1 = src + y1 * dataplus -> m_width;
-                        q2 = src + y2 * dataplus -> m_width;
-                        q3 = src + y3 * dataplus -> m_width;
-                        
-                        a01 = dx0 * dy0, a02 = dx0 * dy1, a03 = dx0 * dy2, a04 = dx0 * dy3;
-                        a05 = dx1 * dy0, a06 = dx1 * dy1, a07 = dx1 * dy2, a08 = dx1 * dy3;
-                        a09 = dx2 * dy0, a10 = dx2 * dy1, a11 = dx2 * dy2, a12 = dx2 * dy3;
-                        a13 = dx3 * dy0, a14 = dx3 * dy1, a15 = dx3 * dy2, a16 = dx3 * dy3;
-                        
-                        // premult alpha
-                        if (b_sa) {
-                            a01 *= double(q0[x0] >> 24) / 255.f;
-                            a02 *= double(q1[x0] >> 24) / 255.f;
-                            a03 *= double(q2[x0] >> 24) / 255.f;
-                            a04 *= double(q3[x0] >> 24) / 255.f;
-                            a05 *= double(q0[x1] >> 24) / 255.f;
-                            a06 *= double(q1[x1] >> 24) / 255.f;
-                            a07 *= double(q2[x1] >> 24) / 255.f;
-                            a08 *= double(q3[x1] >> 24) / 255.f;
-                            a09 *= double(q0[x2] >> 24) / 255.f;
-                            a10 *= double(q1[x2] >> 24) / 255.f;
-                            a11 *= double(q2[x2] >> 24) / 255.f;
-                            a12 *= double(q3[x2] >> 24) / 255.f;
-                            a13 *= double(q0[x3] >> 24) / 255.f;
-                            a14 *= double(q1[x3] >> 24) / 255.f;
-                            a15 *= double(q2[x3] >> 24) / 255.f;
-                            a16 *= double(q3[x3] >> 24) / 255.f;
-                            fca = a01 + a02 + a03 + a04 + a05 + a06 + a07 + a08 + 
-                                  a09 + a10 + a11 + a12 + a13 + a14 + a15 + a16;
-                            if (fca <= .0f) { dst[j] = 0; continue; } // alpha test
-                        } else if (b_ck) {
-                            if ((q0[x0] & 0xffffff) == m_ck) a01 = 0;
-                            if ((q1[x0] & 0xffffff) == m_ck) a02 = 0;
-                            if ((q2[x0] & 0xffffff) == m_ck) a03 = 0;
-                            if ((q3[x0] & 0xffffff) == m_ck) a04 = 0;
-                            if ((q0[x1] & 0xffffff) == m_ck) a05 = 0;
-                            if ((q1[x1] & 0xffffff) == m_ck) a06 = 0;
-                            if ((q2[x1] & 0xffffff) == m_ck) a07 = 0;
-                            if ((q3[x1] & 0xffffff) == m_ck) a08 = 0;
-                            if ((q0[x2] & 0xffffff) == m_ck) a09 = 0;
-                            if ((q1[x2] & 0xffffff) == m_ck) a10 = 0;
-                            if ((q2[x2] & 0xffffff) == m_ck) a11 = 0;
-                            if ((q3[x2] & 0xffffff) == m_ck) a12 = 0;
-                            if ((q0[x3] & 0xffffff) == m_ck) a13 = 0;
-                            if ((q1[x3] & 0xffffff) == m_ck) a14 = 0;
-                            if ((q2[x3] & 0xffffff) == m_ck) a15 = 0;
-                            if ((q3[x3] & 0xffffff) == m_ck) a16 = 0;
-                            fca = a01 + a02 + a03 + a04 + a05 + a06 + a07 + a08 + 
-                                  a09 + a10 + a11 + a12 + a13 + a14 + a15 + a16;
-                            if (fca < .5f) { dst[j] = m_ck; continue; } // alpha test
-                        }
-
-                        // calc rgb value & unpremult alpha
-                        fcr = 
-                            double((q0[x0] >> 16) & 0xff) * a01 +
-                            double((q1[x0] >> 16) & 0xff) * a02 +
-                            double((q2[x0] >> 16) & 0xff) * a03 +
-                            double((q3[x0] >> 16) & 0xff) * a04 +
-                            double((q0[x1] >> 16) & 0xff) * a05 +
-                            double((q1[x1] >> 16) & 0xff) * a06 +
-                            double((q2[x1] >> 16) & 0xff) * a07 +
-                            double((q3[x1] >> 16) & 0xff) * a08 +
-                            double((q0[x2] >> 16) & 0xff) * a09 +
-                            double((q1[x2] >> 16) & 0xff) * a10 +
-                            double((q2[x2] >> 16) & 0xff) * a11 +
-                            double((q3[x2] >> 16) & 0xff) * a12 +
-                            double((q0[x3] >> 16) & 0xff) * a13 +
-                            double((q1[x3] >> 16) & 0xff) * a14 +
-                            double((q2[x3] >> 16) & 0xff) * a15 +
-                            double((q3[x3] >> 16) & 0xff) * a16;
-                        fcg = 
-                            double((q0[x0] >> 8) & 0xff) * a01 +
-                            double((q1[x0] >> 8) & 0xff) * a02 +
-                            double((q2[x0] >> 8) & 0xff) * a03 +
-                            double((q3[x0] >> 8) & 0xff) * a04 +
-                            double((q0[x1] >> 8) & 0xff) * a05 +
-                            double((q1[x1] >> 8) & 0xff) * a06 +
-                            double((q2[x1] >> 8) & 0xff) * a07 +
-                            double((q3[x1] >> 8) & 0xff) * a08 +
-                            double((q0[x2] >> 8) & 0xff) * a09 +
-                            double((q1[x2] >> 8) & 0xff) * a10 +
-                            double((q2[x2] >> 8) & 0xff) * a11 +
-                            double((q3[x2] >> 8) & 0xff) * a12 +
-                            double((q0[x3] >> 8) & 0xff) * a13 +
-                            double((q1[x3] >> 8) & 0xff) * a14 +
-                            double((q2[x3] >> 8) & 0xff) * a15 +
-                            double((q3[x3] >> 8) & 0xff) * a16;
-                        fcb = 
-                            double(q0[x0] & 0xff) * a01 +
-                            double(q1[x0] & 0xff) * a02 +
-                            double(q2[x0] & 0xff) * a03 +
-                            double(q3[x0] & 0xff) * a04 +
-                            double(q0[x1] & 0xff) * a05 +
-                            double(q1[x1] & 0xff) * a06 +
-                            double(q2[x1] & 0xff) * a07 +
-                            double(q3[x1] & 0xff) * a08 +
-                            double(q0[x2] & 0xff) * a09 +
-                            double(q1[x2] & 0xff) * a10 +
-                            double(q2[x2] & 0xff) * a11 +
-                            double(q3[x2] & 0xff) * a12 +
-                            double(q0[x3] & 0xff) * a13 +
-                            double(q1[x3] & 0xff) * a14 +
-                            double(q2[x3] & 0xff) * a15 +
-                            double(q3[x3] & 0xff) * a16;
-                        fcr /= fca, fcg /= fca, fcb /= fca;
-
-                        // update rgba
-                        pa = fca > 0.f ? color_t(fca * 255.f + .5f) : 0;
-                        pr = fcr > 0.f ? color_t(fcr + .5f) : 0;
-                        pg = fcg > 0.f ? color_t(fcg + .5f) : 0;
-                        pb = fcb > 0.f ? color_t(fcb + .5f) : 0;
-                        dst[j] = (pa < 255 ? pa : 255) << 24 | (pr < 255 ? pr : 255) << 16 |
-                                 (pg < 255 ? pg : 255) << 8  | (pb < 255 ? pb : 255);
-                    } else {
-                        if (x2 == dataplus -> m_width)  x2 = dataplus -> m_width  - 1;
-                        if (y2 == dataplus -> m_height) y2 = dataplus -> m_height - 1;
+            });
+        } else if (smooth_ipt == 1) {
+        // bilinear interpolation
+            mcl_parallel_obj.run (size.y, work, [=] (point1d_t ib, point1d_t ie) {
+                // lerp ratio
+                point1d_t i = ib, j = 0;
+                point1d_t x1 = 0, y1 = 0, x2 = 0, y2 = 0;
+                double xm = 0.f, ym = 0.f;
+                double dx = 0.f, dy = 0.f, fdx = 0.f, fdy = 0.f;
+                // color value
+                color_t cs1 = 0, cs2 = 0, cs3 = 0, cs4 = 0;
+                double  fca = 1.f, fcr = 0.f, fcg = 0.f, fcb = 0.f;
+                double  a1 = 0.f, a2 = 0.f, a3 = 0.f, a4 = 0.f;
+                color_t* dst = dst0 + ib * size.x;
+
+                // start interpolation
+                for (; i != ie; ++ i, dst += size.x) {
+                    ym = double(i) / ky;
+                    y1 = point1d_t(ym), y2 = y1 + 1;
+                    dy = ym - double(y1), fdy = 1.f - dy;
+                    if (y2 == sh)
+                        y2 = sh - 1;
+
+                    for (j = 0; j != size.x; ++ j) {
+                        xm = double(j) / kx;
+                        x1 = point1d_t(xm), x2 = x1 + 1;
                         dx = xm - double(x1), fdx = 1.f - dx;
-                        dy = ym - double(y1), fdy = 1.f - dy; 
-
+                        if (x2 == sw)
+                            x2 = sw - 1;
+                    
                         // lerp pixel
-                        q0 = src + (y1 * dataplus -> m_width + x1);
-                        q1 = src + (y1 * dataplus -> m_width + x2);
-                        q2 = src + (y2 * dataplus -> m_width + x1);
-                        q3 = src + (y2 * dataplus -> m_width + x2);
+                        cs1 = src[y1 * sw + x1];
+                        cs2 = src[y1 * sw + x2];
+                        cs3 = src[y2 * sw + x1];
+                        cs4 = src[y2 * sw + x2];
 
-                        a01 = fdx * fdy, a02 = dx * fdy;
-                        a03 = fdx * dy,  a04 = dx * dy;
+                        a1 = fdx * fdy, a2 = dx * fdy;
+                        a3 = fdx * dy,  a4 = dx * dy;
 
                         // premult alpha
                         if (b_sa) {
-                            a01 *= double(*q0 >> 24) / 255.f;
-                            a02 *= double(*q1 >> 24) / 255.f;
-                            a03 *= double(*q2 >> 24) / 255.f;
-                            a04 *= double(*q3 >> 24) / 255.f;
-                            fca = a01 + a02 + a03 + a04; // alpha test
+                            a1 *= double(cs1 >> 24) / 255.f;
+                            a2 *= double(cs2 >> 24) / 255.f;
+                            a3 *= double(cs3 >> 24) / 255.f;
+                            a4 *= double(cs4 >> 24) / 255.f;
+                            fca = a1 + a2 + a3 + a4; // alpha test
                             if (fca <= .0f) { dst[j] = 0; continue; }
                         } else if (b_ck) {
-                            if ((*q0 & 0xffffff) == m_ck) a01 = 0;
-                            if ((*q1 & 0xffffff) == m_ck) a02 = 0;
-                            if ((*q2 & 0xffffff) == m_ck) a03 = 0;
-                            if ((*q3 & 0xffffff) == m_ck) a04 = 0;
-                            fca = a01 + a02 + a03 + a04; // alpha test
+                            if ((cs1 & 0xffffff) == m_ck) a1 = 0;
+                            if ((cs2 & 0xffffff) == m_ck) a2 = 0;
+                            if ((cs3 & 0xffffff) == m_ck) a3 = 0;
+                            if ((cs4 & 0xffffff) == m_ck) a4 = 0;
+                            fca = a1 + a2 + a3 + a4; // alpha test
                             if (fca < .5f) { dst[j] = m_ck; continue; }
                         }
 
                         // calc rgb value & unpremult alpha
-                        fcr = double((*q0 >> 16) & 0xff) * a01 +
-                              double((*q1 >> 16) & 0xff) * a02 +
-                              double((*q2 >> 16) & 0xff) * a03 +
-                              double((*q3 >> 16) & 0xff) * a04;
-                        fcg = double((*q0 >> 8)  & 0xff) * a01 +
-                              double((*q1 >> 8)  & 0xff) * a02 +
-                              double((*q2 >> 8)  & 0xff) * a03 +
-                              double((*q3 >> 8)  & 0xff) * a04;
-                        fcb = double( *q0        & 0xff) * a01 +
-                              double( *q1        & 0xff) * a02 +
-                              double( *q2        & 0xff) * a03 +
-                              double( *q3        & 0xff) * a04;
+                        fcr = mcl_lin_dec (lin, cs1 >> 16) * a1 +
+                              mcl_lin_dec (lin, cs2 >> 16) * a2 +
+                              mcl_lin_dec (lin, cs3 >> 16) * a3 +
+                              mcl_lin_dec (lin, cs4 >> 16) * a4;
+                        fcg = mcl_lin_dec (lin, cs1 >> 8) * a1 +
+                              mcl_lin_dec (lin, cs2 >> 8) * a2 +
+                              mcl_lin_dec (lin, cs3 >> 8) * a3 +
+                              mcl_lin_dec (lin, cs4 >> 8) * a4;
+                        fcb = mcl_lin_dec (lin, cs1) * a1 +
+                              mcl_lin_dec (lin, cs2) * a2 +
+                              mcl_lin_dec (lin, cs3) * a3 +
+                              mcl_lin_dec (lin, cs4) * a4;
                         fcr /= fca, fcg /= fca, fcb /= fca;
 
                         // update rgba
                         dst[j] = (b_sa ? color_t(fca * 255.f + .5f) : 255) << 24 |
-                            color_t(fcr + .5f) << 16 | color_t(fcg + .5f) << 8 | color_t(fcb + .5f);
+                            mcl_lin_enc (lin, fcr) << 16 | mcl_lin_enc (lin, fcg) << 8 | mcl_lin_enc (lin, fcb);
                     }
                 }
-            }
+            });
+        } else {
+        // bicubic_interpolation
+            mcl_parallel_obj.run (size.y, work, [=] (point1d_t ib, point1d_t ie) {
+                // lerp ratio
+                point1d_t i = ib, j = 0;
+                point1d_t x0 = 0, x1 = 0, x2 = 0, x3 = 0;
+                point1d_t y0 = 0, y1 = 0, y2 = 0, y3 = 0;
+                double xm = 0, ym = 0;
+                double dx0 = 0.f, dx1 = 0.f, dx2 = 0.f, dx3 = 0.f;
+                double dy0 = 0.f, dy1 = 0.f, dy2 = 0.f, dy3 = 0.f;
+                double dx = 0.f, fdx = 0.f, dy = 0.f, fdy = 0.f;
+                // color value
+                color_t *q0 = 0, *q1 = 0, *q2 = 0, *q3 = 0;
+                double fca = 1.f, fcr = 0.f, fcg = 0.f, fcb = 0.f;
+                color_t pa = 0, pr = 0, pg = 0, pb = 0;
+                double a01 = 0.f, a02 = 0.f, a03 = 0.f, a04 = 0.f;
+                double a05 = 0.f, a06 = 0.f, a07 = 0.f, a08 = 0.f;
+                double a09 = 0.f, a10 = 0.f, a11 = 0.f, a12 = 0.f;
+                double a13 = 0.f, a14 = 0.f, a15 = 0.f, a16 = 0.f;
+                color_t* dst = dst0 + ib * size.x;
+            
+                // interpolation function
+                auto fpBiCubicPoly = []
+                (double x) -> double {
+                    double const abs_x = x > 0.f ? x : -x;
+                    double constexpr a = -.5f;
+                    return (abs_x <= 1.f) ? 
+                        (a + 2.f) * (abs_x * abs_x * abs_x) -
+                        (a + 3.f) * (abs_x * abs_x) + 1: (
+                           (abs_x <  2.f) ?
+                        (a) * (abs_x * abs_x * abs_x) - (5.f * a) * (abs_x * abs_x) +
+                        (8.f * a) * abs_x - 4.f * a : 0.f);
+                };
+
+                // start interpolation
+                for (; i != ie; ++ i, dst += size.x) {
+                    ym = double(i) / double(ky);
+                    y0 = point1d_t(ym) - 1, y1 = point1d_t(ym);
+                    y2 = point1d_t(ym) + 1, y3 = point1d_t(ym) + 2;
+
+                    dy0 = fpBiCubicPoly (ym - double(y0));
+                    dy1 = fpBiCubicPoly (ym - double(y1));
+                    dy2 = fpBiCubicPoly (ym - double(y2));
+                    dy3 = fpBiCubicPoly (ym - double(y3));
+
+                    for (j = 0; j != size.x; ++ j) {
+                        xm = double(j) / double(kx);
+                        x0 = point1d_t(xm) - 1, x1 = point1d_t(xm);
+                        x2 = point1d_t(xm) + 1, x3 = point1d_t(xm) + 2;
+                    
+                        // test if pixels exist
+                        bool b_border = (x0 >= 0 && x3 < sw && y0 >= 0 && y3 < sh);
+                        if (b_border) {
+
+                            dx0 = fpBiCubicPoly (xm - double(x0));
+                            dx1 = fpBiCubicPoly (xm - double(x1));
+                            dx2 = fpBiCubicPoly (xm - double(x2));
+                            dx3 = fpBiCubicPoly (xm - double(x3));
+
+                            // lerp pixel
+                            q0 = src + y0 * sw;
+                            q1 = src + y1 * sw;
+                            q2 = src + y2 * sw;
+                            q3 = src + y3 * sw;
+                        
+                            a01 = dx0 * dy0, a02 = dx0 * dy1, a03 = dx0 * dy2, a04 = dx0 * dy3;
+                            a05 = dx1 * dy0, a06 = dx1 * dy1, a07 = dx1 * dy2, a08 = dx1 * dy3;
+                            a09 = dx2 * dy0, a10 = dx2 * dy1, a11 = dx2 * dy2, a12 = dx2 * dy3;
+                            a13 = dx3 * dy0, a14 = dx3 * dy1, a15 = dx3 * dy2, a16 = dx3 * dy3;
+                        
+                            // premult alpha
+                            if (b_sa) {
+                                a01 *= double(q0[x0] >> 24) / 255.f;
+                                a02 *= double(q1[x0] >> 24) / 255.f;
+                                a03 *= double(q2[x0] >> 24) / 255.f;
+                                a04 *= double(q3[x0] >> 24) / 255.f;
+                                a05 *= double(q0[x1] >> 24) / 255.f;
+                                a06 *= double(q1[x1] >> 24) / 255.f;
+                                a07 *= double(q2[x1] >> 24) / 255.f;
+                                a08 *= double(q3[x1] >> 24) / 255.f;
+                                a09 *= double(q0[x2] >> 24) / 255.f;
+                                a10 *= double(q1[x2] >> 24) / 255.f;
+                                a11 *= double(q2[x2] >> 24) / 255.f;
+                                a12 *= double(q3[x2] >> 24) / 255.f;
+                                a13 *= double(q0[x3] >> 24) / 255.f;
+                                a14 *= double(q1[x3] >> 24) / 255.f;
+                                a15 *= double(q2[x3] >> 24) / 255.f;
+                                a16 *= double(q3[x3] >> 24) / 255.f;
+                                fca = a01 + a02 + a03 + a04 + a05 + a06 + a07 + a08 + 
+                                      a09 + a10 + a11 + a12 + a13 + a14 + a15 + a16;
+                                if (fca <= .0f) { dst[j] = 0; continue; } // alpha test
+                            } else if (b_ck) {
+                                if ((q0[x0] & 0xffffff) == m_ck) a01 = 0;
+                                if ((q1[x0] & 0xffffff) == m_ck) a02 = 0;
+                                if ((q2[x0] & 0xffffff) == m_ck) a03 = 0;
+                                if ((q3[x0] & 0xffffff) == m_ck) a04 = 0;
+                                if ((q0[x1] & 0xffffff) == m_ck) a05 = 0;
+                                if ((q1[x1] & 0xffffff) == m_ck) a06 = 0;
+                                if ((q2[x1] & 0xffffff) == m_ck) a07 = 0;
+                                if ((q3[x1] & 0xffffff) == m_ck) a08 = 0;
+                                if ((q0[x2] & 0xffffff) == m_ck) a09 = 0;
+                                if ((q1[x2] & 0xffffff) == m_ck) a10 = 0;
+                                if ((q2[x2] & 0xffffff) == m_ck) a11 = 0;
+                                if ((q3[x2] & 0xffffff) == m_ck) a12 = 0;
+                                if ((q0[x3] & 0xffffff) == m_ck) a13 = 0;
+                                if ((q1[x3] & 0xffffff) == m_ck) a14 = 0;
+                                if ((q2[x3] & 0xffffff) == m_ck) a15 = 0;
+                                if ((q3[x3] & 0xffffff) == m_ck) a16 = 0;
+                                fca = a01 + a02 + a03 + a04 + a05 + a06 + a07 + a08 + 
+                                      a09 + a10 + a11 + a12 + a13 + a14 + a15 + a16;
+                                if (fca < .5f) { dst[j] = m_ck; continue; } // alpha test
+                            }
+
+                            // calc rgb value & unpremult alpha
+                            fcr = 
+                                mcl_lin_dec (lin, q0[x0] >> 16) * a01 +
+                                mcl_lin_dec (lin, q1[x0] >> 16) * a02 +
+                                mcl_lin_dec (lin, q2[x0] >> 16) * a03 +
+                                mcl_lin_dec (lin, q3[x0] >> 16) * a04 +
+                                mcl_lin_dec (lin, q0[x1] >> 16) * a05 +
+                                mcl_lin_dec (lin, q1[x1] >> 16) * a06 +
+                                mcl_lin_dec (lin, q2[x1] >> 16) * a07 +
+                                mcl_lin_dec (lin, q3[x1] >> 16) * a08 +
+                                mcl_lin_dec (lin, q0[x2] >> 16) * a09 +
+                                mcl_lin_dec (lin, q1[x2] >> 16) * a10 +
+                                mcl_lin_dec (lin, q2[x2] >> 16) * a11 +
+                                mcl_lin_dec (lin, q3[x2] >> 16) * a12 +
+                                mcl_lin_dec (lin, q0[x3] >> 16) * a13 +
+                                mcl_lin_dec (lin, q1[x3] >> 16) * a14 +
+                                mcl_lin_dec (lin, q2[x3] >> 16) * a15 +
+                                mcl_lin_dec (lin, q3[x3] >> 16) * a16;
+                            fcg = 
+                                mcl_lin_dec (lin, q0[x0] >> 8) * a01 +
+                                mcl_lin_dec (lin, q1[x0] >> 8) * a02 +
+                                mcl_lin_dec (lin, q2[x0] >> 8) * a03 +
+                                mcl_lin_dec (lin, q3[x0] >> 8) * a04 +
+                                mcl_lin_dec (lin, q0[x1] >> 8) * a05 +
+                                mcl_lin_dec (lin, q1[x1] >> 8) * a06 +
+                                mcl_lin_dec (lin, q2[x1] >> 8) * a07 +
+                                mcl_lin_dec (lin, q3[x1] >> 8) * a08 +
+                                mcl_lin_dec (lin, q0[x2] >> 8) * a09 +
+                                mcl_lin_dec (lin, q1[x2] >> 8) * a10 +
+                                mcl_lin_dec (lin, q2[x2] >> 8) * a11 +
+                                mcl_lin_dec (lin, q3[x2] >> 8) * a12 +
+                                mcl_lin_dec (lin, q0[x3] >> 8) * a13 +
+                                mcl_lin_dec (lin, q1[x3] >> 8) * a14 +
+                                mcl_lin_dec (lin, q2[x3] >> 8) * a15 +
+                                mcl_lin_dec (lin, q3[x3] >> 8) * a16;
+                            fcb = 
+                                mcl_lin_dec (lin, q0[x0]) * a01 +
+                                mcl_lin_dec (lin, q1[x0]) * a02 +
+                                mcl_lin_dec (lin, q2[x0]) * a03 +
+                                mcl_lin_dec (lin, q3[x0]) * a04 +
+                                mcl_lin_dec (lin, q0[x1]) * a05 +
+                                mcl_lin_dec (lin, q1[x1]) * a06 +
+                                mcl_lin_dec (lin, q2[x1]) * a07 +
+                                mcl_lin_dec (lin, q3[x1]) * a08 +
+                                mcl_lin_dec (lin, q0[x2]) * a09 +
+                                mcl_lin_dec (lin, q1[x2]) * a10 +
+                                mcl_lin_dec (lin, q2[x2]) * a11 +
+                                mcl_lin_dec (lin, q3[x2]) * a12 +
+                                mcl_lin_dec (lin, q0[x3]) * a13 +
+                                mcl_lin_dec (lin, q1[x3]) * a14 +
+                                mcl_lin_dec (lin, q2[x3]) * a15 +
+                                mcl_lin_dec (lin, q3[x3]) * a16;
+                            fcr /= fca, fcg /= fca, fcb /= fca;
+
+                            // update rgba
+                            pa = fca > 0.f ? color_t(fca * 255.f + .5f) : 0;
+                            pr = mcl_lin_enc (lin, fcr);
+                            pg = mcl_lin_enc (lin, fcg);
+                            pb = mcl_lin_enc (lin, fcb);
+                            dst[j] = (pa < 255 ? pa : 255) << 24 | (pr < 255 ? pr : 255) << 16 |
+                                     (pg < 255 ? pg : 255) << 8  | (pb < 255 ? pb : 255);
+                        } else {
+                            if (x2 == sw) x2 = sw - 1;
+                            if (y2 == sh) y2 = sh - 1;
+                            dx = xm - double(x1), fdx = 1.f - dx;
+                            dy = ym - double(y1), fdy = 1.f - dy; 
+
+                            // lerp pixel
+                            q0 = src + (y1 * sw + x1);
+                            q1 = src + (y1 * sw + x2);
+                            q2 = src + (y2 * sw + x1);
+                            q3 = src + (y2 * sw + x2);
+
+                            a01 = fdx * fdy, a02 = dx * fdy;
+                            a03 = fdx * dy,  a04 = dx * dy;
+
+                            // premult alpha
+                            if (b_sa) {
+                                a01 *= double(*q0 >> 24) / 255.f;
+                                a02 *= double(*q1 >> 24) / 255.f;
+                                a03 *= double(*q2 >> 24) / 255.f;
+                                a04 *= double(*q3 >> 24) / 255.f;
+                                fca = a01 + a02 + a03 + a04; // alpha test
+                                if (fca <= .0f) { dst[j] = 0; continue; }
+                            } else if (b_ck) {
+                                if ((*q0 & 0xffffff) == m_ck) a01 = 0;
+                                if ((*q1 & 0xffffff) == m_ck) a02 = 0;
+                                if ((*q2 & 0xffffff) == m_ck) a03 = 0;
+                                if ((*q3 & 0xffffff) == m_ck) a04 = 0;
+                                fca = a01 + a02 + a03 + a04; // alpha test
+                                if (fca < .5f) { dst[j] = m_ck; continue; }
+                            }
+
+                            // calc rgb value & unpremult alpha
+                            fcr = mcl_lin_dec (lin, *q0 >> 16) * a01 +
+                                  mcl_lin_dec (lin, *q1 >> 16) * a02 +
+                                  mcl_lin_dec (lin, *q2 >> 16) * a03 +
+                                  mcl_lin_dec (lin, *q3 >> 16) * a04;
+                            fcg = mcl_lin_dec (lin, *q0 >> 8) * a01 +
+                                  mcl_lin_dec (lin, *q1 >> 8) * a02 +
+                                  mcl_lin_dec (lin, *q2 >> 8) * a03 +
+                                  mcl_lin_dec (lin, *q3 >> 8) * a04;
+                            fcb = mcl_lin_dec (lin, *q0) * a01 +
+                                  mcl_lin_dec (lin, *q1) * a02 +
+                                  mcl_lin_dec (lin, *q2) * a03 +
+                                  mcl_lin_dec (lin, *q3) * a04;
+                            fcr /= fca, fcg /= fca, fcb /= fca;
+
+                            // update rgba
+                            dst[j] = (b_sa ? color_t(fca * 255.f + .5f) : 255) << 24 |
+                                mcl_lin_enc (lin, fcr) << 16 | mcl_lin_enc (lin, fcg) << 8 | mcl_lin_enc (lin, fcb);
+                        }
+                    }
+                }
+            });
         }
+        mcl_tcache_obj.put (key, res, offset);
         return res;
     }
     surface_t mcl_transform_t::
@@ -498,17 +641,25 @@ mcl {
         mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::rotozoom");
         if (!dataplus -> m_width) return sf_nullptr;
 
+        // cached result. 0x40 marks linear light
+        mcl_srgb_t const* lin = mcl_transform_linear ? &mcl_get_srgb () : nullptr;
+        char lflags = char(data[0] | (lin ? 0x40 : 0));
+        mcl_tcache_key_t key = { dataplus, dataplus -> m_generation, 2, lflags,
+            { double(angle), double(fscale), 0. } };
+        surface_t cached;
+        if (mcl_tcache_obj.get (key, cached, offset)) return cached;
+
         // rotate info
         double constexpr pi = 3.1415926535897932384626433832795f;
         double const    rad = double(angle) * pi / 180.f;
         point2d_t size = {
             point1d_t(.5f + fscale * (
-                abs(double(dataplus -> m_width)  * cos(rad))
-              + abs(double(dataplus -> m_height) * sin(rad))
+                fabs(double(dataplus -> m_width)  * cos(rad))
+              + fabs(double(dataplus -> m_height) * sin(rad))
             )),
             point1d_t(.5f + fscale * (
-                abs(double(dataplus -> m_width)  * sin(rad))
-              + abs(double(dataplus -> m_height) * cos(rad))
+                fabs(double(dataplus -> m_width)  * sin(rad))
+              + fabs(double(dataplus -> m_height) * cos(rad))
             ))
         };
         
@@ -527,128 +678,357 @@ mcl {
         color_t m_ck = res_dataplus -> m_colorkey;
 
         // scaling calc
-        color_t* src = dataplus -> m_pbuffer;
-        color_t* dst = res_dataplus -> m_pbuffer;
-        double vx0 = double(dataplus -> m_width - 1) / 2.f;
-        double vy0 = double(dataplus -> m_height - 1) / 2.f;
+        color_t* src  = dataplus -> m_pbuffer;
+        color_t* dst0 = res_dataplus -> m_pbuffer;
+        point1d_t sw  = dataplus -> m_width, sh = dataplus -> m_height;
+        double vx0 = double(sw - 1) / 2.f;
+        double vy0 = double(sh - 1) / 2.f;
         double vx1 = double(size.x - 1) / 2.f;
         double vy1 = double(size.y - 1) / 2.f;
         if (offset) {
             offset -> x = point1d_t(vx0 - vx1 + .5f);
             offset -> y = point1d_t(vy0 - vy1 + .5f);
         }
-
-        // lerp ratio
-        double fx0 = 0.f, fy0 = 0.f, fx1 = 0.f, fy1 = 0.f;
-        double R = 0.f, sita = 0.f;
-        double p = 0.f, q = 0.f, fp = 0.f, fq = 0.f;
-        point1d_t x1 = 0, y1 = 0;
-        point1d_t ix0 = 0, iy0 = 0, ix1 = 0, iy1 = 0;
-        // color value
-        color_t *cs1 = 0, *cs2 = 0, *cs3 = 0, *cs4 = 0;
         color_t trans = res_data[0] ? 0 : dataplus -> m_pbuffer[0]; // 0xff00ff00
-        double  fca = 1.f, fcr = 0.f, fcg = 0.f, fcb = 0.f;
-        double  a1 = 0.f, a2 = 0.f, a3 = 0.f, a4 = 0.f;
-
-        // start interpolation
-        for (; y1 != size.y; ++ y1, dst += size.x) {
-            fy1 = (double(y1) - vy1) / fscale;
-            for (x1 = 0; x1 != size.x; ++ x1) {
-                fx1 = (double(x1) - vx1) / fscale;
-
-                // exchange between polar cos and ordinary cos
-                R = sqrt(fx1 * fx1 + fy1 * fy1);
-                sita = atan2(fy1, fx1) + rad;
-                fx0 = R * cos(sita) + vx0; 
-                fy0 = R * sin(sita) + vy0;
-                ix0 = point1d_t(fx0), ix1 = ix0 + 1;
-                iy0 = point1d_t(fy0), iy1 = iy0 + 1;
-                
-                // lerp ratio
-                p = fx0 - double(ix0), fp = 1 - p, fx0 += .5f;
-                q = fy0 - double(iy0), fq = 1 - q, fy0 += .5f;
-
-                // test if pixels exist
-                bool b_border = (fx0 >= 0.f && fx0 <= double(dataplus -> m_width)
-                    && fy0 >= 0.f && fy0 <= double(dataplus -> m_height));
-                if (b_border) {
-                    // test if pixel is partly out of rect
-                    if (fx0 < .5f)                                 ix0 = ix1;
-                    if (fx0 >= double(dataplus -> m_width) - .5f)  ix1 = ix0;
-                    if (fy0 < .5f)                                 iy0 = iy1;
-                    if (fy0 >= double(dataplus -> m_height) - .5f) iy1 = iy0;
-
-                    // lerp pixel
-                    cs1 = src + (iy0 * dataplus -> m_width + ix0);
-                    cs2 = src + (iy0 * dataplus -> m_width + ix1);
-                    cs3 = src + (iy1 * dataplus -> m_width + ix0);
-                    cs4 = src + (iy1 * dataplus -> m_width + ix1);
-                    
-                    a1 = fp * fq, a2 = p * fq;
-                    a3 = fp * q,  a4 = p * q;
 
-                    // premult alpha
-                    if (b_sa) {
-                        a1 *= double(*cs1 >> 24) / 255.f;
-                        a2 *= double(*cs2 >> 24) / 255.f;
-                        a3 *= double(*cs3 >> 24) / 255.f;
-                        a4 *= double(*cs4 >> 24) / 255.f;
-                        fca = a1 + a2 + a3 + a4; // alpha test
-                        if (fca <= .0f) { dst[x1] = 0; continue; }
-                    } else if (b_ck) {
-                        if ((*cs1 & 0xffffff) == m_ck) a1 = 0;
-                        if ((*cs2 & 0xffffff) == m_ck) a2 = 0;
-                        if ((*cs3 & 0xffffff) == m_ck) a3 = 0;
-                        if ((*cs4 & 0xffffff) == m_ck) a4 = 0;
-                        fca = a1 + a2 + a3 + a4; // alpha test
-                        if (fca < .5f) { dst[x1] = m_ck; continue; }
-                    }
+        // shrink from the nearest mip level if the surface keeps one.
+        // rx, ry map the rotated positions onto the level
+        double    rx = 1.f, ry = 1.f;
+        point2d_t lsize = { 0, 0 };
+        color_t*  level = fscale < 1.f ? dataplus -> mip_level ({
+            point1d_t(ceil(double(fscale) * double(sw))),
+            point1d_t(ceil(double(fscale) * double(sh)))
+        }, lflags, &lsize) : nullptr;
+        if (level) {
+            rx = double(lsize.x) / double(sw), ry = double(lsize.y) / double(sh);
+            src = level, sw = lsize.x, sh = lsize.y;
+            vx0 = double(sw - 1) / 2.f, vy0 = double(sh - 1) / 2.f;
+        }
+
+        mcl_parallel_obj.run (size.y, static_cast<size_t>(size.x) * static_cast<size_t>(size.y),
+        [=] (point1d_t ib, point1d_t ie) {
+            // lerp ratio
+            double fx0 = 0.f, fy0 = 0.f, fx1 = 0.f, fy1 = 0.f;
+            double R = 0.f, sita = 0.f;
+            double p = 0.f, q = 0.f, fp = 0.f, fq = 0.f;
+            point1d_t x1 = 0, y1 = ib;
+            point1d_t ix0 = 0, iy0 = 0, ix1 = 0, iy1 = 0;
+            // color value
+            color_t *cs1 = 0, *cs2 = 0, *cs3 = 0, *cs4 = 0;
+            double  fca = 1.f, fcr = 0.f, fcg = 0.f, fcb = 0.f;
+            double  a1 = 0.f, a2 = 0.f, a3 = 0.f, a4 = 0.f;
+            color_t* dst = dst0 + ib * size.x;
 
-                    // calc rgb value & unpremult alpha
-                    fcr = double((*cs1 >> 16) & 0xff) * a1 +
-                          double((*cs2 >> 16) & 0xff) * a2 +
-                          double((*cs3 >> 16) & 0xff) * a3 +
-                          double((*cs4 >> 16) & 0xff) * a4;
-                    fcg = double((*cs1 >> 8)  & 0xff) * a1 +
-                          double((*cs2 >> 8)  & 0xff) * a2 +
-                          double((*cs3 >> 8)  & 0xff) * a3 +
-                          double((*cs4 >> 8)  & 0xff) * a4;
-                    fcb = double( *cs1        & 0xff) * a1 +
-                          double( *cs2        & 0xff) * a2 +
-                          double( *cs3        & 0xff) * a3 +
-                          double( *cs4        & 0xff) * a4;
-                    fcr /= fca, fcg /= fca, fcb /= fca;
+            // start interpolation
+            for (; y1 != ie; ++ y1, dst += size.x) {
+                fy1 = (double(y1) - vy1) / fscale;
+                for (x1 = 0; x1 != size.x; ++ x1) {
+                    fx1 = (double(x1) - vx1) / fscale;
+
+                    // exchange between polar cos and ordinary cos
+                    R = sqrt(fx1 * fx1 + fy1 * fy1);
+                    sita = atan2(fy1, fx1) + rad;
+                    fx0 = R * cos(sita) * rx + vx0; 
+                    fy0 = R * sin(sita) * ry + vy0;
+                    ix0 = point1d_t(fx0), ix1 = ix0 + 1;
+                    iy0 = point1d_t(fy0), iy1 = iy0 + 1;
                     
-                    // update rgba
-                    dst[x1] = (b_sa ? color_t(fca * 255.f + .5f) : 255) << 24 |
-                        color_t(fcr + .5f) << 16 | color_t(fcg + .5f) << 8 | color_t(fcb + .5f);
-                } else
-                    dst[x1] = trans;
+                    // lerp ratio
+                    p = fx0 - double(ix0), fp = 1 - p, fx0 += .5f;
+                    q = fy0 - double(iy0), fq = 1 - q, fy0 += .5f;
+
+                    // test if pixels exist
+                    bool b_border = (fx0 >= 0.f && fx0 <= double(sw)
+                        && fy0 >= 0.f && fy0 <= double(sh));
+                    if (b_border) {
+                        // test if pixel is partly out of rect
+                        if (fx0 < .5f)                ix0 = ix1;
+                        if (fx0 >= double(sw) - .5f)  ix1 = ix0;
+                        if (fy0 < .5f)                iy0 = iy1;
+                        if (fy0 >= double(sh) - .5f)  iy1 = iy0;
+
+                        // lerp pixel
+                        cs1 = src + (iy0 * sw + ix0);
+                        cs2 = src + (iy0 * sw + ix1);
+                        cs3 = src + (iy1 * sw + ix0);
+                        cs4 = src + (iy1 * sw + ix1);
+                        
+                        a1 = fp * fq, a2 = p * fq;
+                        a3 = fp * q,  a4 = p * q;
+
+                        // premult alpha
+                        if (b_sa) {
+                            a1 *= double(*cs1 >> 24) / 255.f;
+                            a2 *= double(*cs2 >> 24) / 255.f;
+                            a3 *= double(*cs3 >> 24) / 255.f;
+                            a4 *= double(*cs4 >> 24) / 255.f;
+                            fca = a1 + a2 + a3 + a4; // alpha test
+                            if (fca <= .0f) { dst[x1] = 0; continue; }
+                        } else if (b_ck) {
+                            if ((*cs1 & 0xffffff) == m_ck) a1 = 0;
+                            if ((*cs2 & 0xffffff) == m_ck) a2 = 0;
+                            if ((*cs3 & 0xffffff) == m_ck) a3 = 0;
+                            if ((*cs4 & 0xffffff) == m_ck) a4 = 0;
+                            fca = a1 + a2 + a3 + a4; // alpha test
+                            if (fca < .5f) { dst[x1] = m_ck; continue; }
+                        }
+
+                        // calc rgb value & unpremult alpha
+                        fcr = mcl_lin_dec (lin, *cs1 >> 16) * a1 +
+                              mcl_lin_dec (lin, *cs2 >> 16) * a2 +
+                              mcl_lin_dec (lin, *cs3 >> 16) * a3 +
+                              mcl_lin_dec (lin, *cs4 >> 16) * a4;
+                        fcg = mcl_lin_dec (lin, *cs1 >> 8) * a1 +
+                              mcl_lin_dec (lin, *cs2 >> 8) * a2 +
+                              mcl_lin_dec (lin, *cs3 >> 8) * a3 +
+                              mcl_lin_dec (lin, *cs4 >> 8) * a4;
+                        fcb = mcl_lin_dec (lin, *cs1) * a1 +
+                              mcl_lin_dec (lin, *cs2) * a2 +
+                              mcl_lin_dec (lin, *cs3) * a3 +
+                              mcl_lin_dec (lin, *cs4) * a4;
+                        fcr /= fca, fcg /= fca, fcb /= fca;
+                        
+                        // update rgba
+                        dst[x1] = (b_sa ? color_t(fca * 255.f + .5f) : 255) << 24 |
+                            mcl_lin_enc (lin, fcr) << 16 | mcl_lin_enc (lin, fcg) << 8 | mcl_lin_enc (lin, fcb);
+                    } else
+                        dst[x1] = trans;
+                }
             }
-        }
+        });
+        mcl_tcache_obj.put (key, res, offset);
         return res;
     }
 
+#ifdef MCL_SSE2
+    // (m & a) | (~m & b)
+    static inline __m128i
+    mcl_sse2_select (__m128i m, __m128i a, __m128i b) noexcept{
+        return _mm_or_si128 (_mm_and_si128 (m, a), _mm_andnot_si128 (m, b));
+    }
+
+    // stores 4 pixels of each of o0, o1, o2 interleaved as o0 o1 o2 o0 o1 o2 ...
+    static inline void
+    mcl_sse2_store3 (color_t* d, __m128i o0, __m128i o1, __m128i o2) noexcept{
+        __m128i t0 = _mm_unpacklo_epi32 (o0, o1);                      // 00 10 01 11
+        __m128i t1 = _mm_unpackhi_epi32 (o0, o1);                      // 02 12 03 13
+        __m128i a  = _mm_unpacklo_epi32 (o2, _mm_srli_si128 (o0, 4));  // 20 01 21 02
+        __m128 v0 = _mm_shuffle_ps (_mm_castsi128_ps (t0), _mm_castsi128_ps (a), _MM_SHUFFLE(1, 0, 1, 0));
+        __m128 b  = _mm_shuffle_ps (_mm_castsi128_ps (t0), _mm_castsi128_ps (a), _MM_SHUFFLE(2, 2, 3, 3));
+        __m128 v1 = _mm_shuffle_ps (b, _mm_castsi128_ps (t1), _MM_SHUFFLE(1, 0, 2, 0));
+        __m128 c  = _mm_shuffle_ps (_mm_castsi128_ps (o2), _mm_castsi128_ps (t1), _MM_SHUFFLE(3, 2, 3, 2));
+        __m128i v2 = _mm_shuffle_epi32 (_mm_castps_si128 (c), _MM_SHUFFLE(1, 3, 2, 0));
+        _mm_storeu_si128 (reinterpret_cast<__m128i*>(d),     _mm_castps_si128 (v0));
+        _mm_storeu_si128 (reinterpret_cast<__m128i*>(d + 4), _mm_castps_si128 (v1));
+        _mm_storeu_si128 (reinterpret_cast<__m128i*>(d + 8), v2);
+    }
+
+    static inline __m128i
+    mcl_sse2_load (color_t const* p) noexcept{
+        return _mm_loadu_si128 (reinterpret_cast<__m128i const*>(p));
+    }
+#endif
+
     /**
-     * @function mcl_transform_t::scale2x <src/transform.cpp>
-     * @brief specialized image doubler
-     * @param[in] surface
+     * @function mcl_scale2x_row <cpp/transform.cpp>
+     * @brief AdvanceMAME Scale2X of one source row into two output rows.
+     *     s0 and s2 are the rows above and below, edges are repeated.
+     * @return void
+     */
+    static void
+    mcl_scale2x_row (color_t* d0, color_t* d1, color_t const* s0, color_t const* s1,
+      color_t const* s2, point1d_t sw) noexcept{
+        auto fpix = [=] (point1d_t x) {
+            color_t b = s0[x], h = s2[x], e = s1[x];
+            color_t d = s1[x ? x - 1 : 0], f = s1[x + 1 != sw ? x + 1 : x];
+            if (b != h && d != f) {
+                d0[x * 2] = d == b ? b : e, d0[x * 2 + 1] = f == b ? b : e;
+                d1[x * 2] = d == h ? h : e, d1[x * 2 + 1] = f == h ? h : e;
+            } else
+                d0[x * 2] = d0[x * 2 + 1] = d1[x * 2] = d1[x * 2 + 1] = e;
+        };
+        point1d_t x = 0;
+        fpix (x ++);
+#ifdef MCL_SSE2
+        // reads x - 1 to x + 4
+        for (point1d_t n = (sw - 2) >> 2; n > 0; -- n, x += 4) {
+            __m128i b = mcl_sse2_load (s0 + x), h = mcl_sse2_load (s2 + x);
+            __m128i e = mcl_sse2_load (s1 + x);
+            __m128i d = mcl_sse2_load (s1 + x - 1), f = mcl_sse2_load (s1 + x + 1);
+            __m128i no = _mm_or_si128 (_mm_cmpeq_epi32 (b, h), _mm_cmpeq_epi32 (d, f));
+            __m128i e0 = mcl_sse2_select (_mm_andnot_si128 (no, _mm_cmpeq_epi32 (d, b)), b, e);
+            __m128i e1 = mcl_sse2_select (_mm_andnot_si128 (no, _mm_cmpeq_epi32 (f, b)), b, e);
+            __m128i e2 = mcl_sse2_select (_mm_andnot_si128 (no, _mm_cmpeq_epi32 (d, h)), h, e);
+            __m128i e3 = mcl_sse2_select (_mm_andnot_si128 (no, _mm_cmpeq_epi32 (f, h)), h, e);
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(d0 + x * 2),     _mm_unpacklo_epi32 (e0, e1));
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(d0 + x * 2 + 4), _mm_unpackhi_epi32 (e0, e1));
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(d1 + x * 2),     _mm_unpacklo_epi32 (e2, e3));
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(d1 + x * 2 + 4), _mm_unpackhi_epi32 (e2, e3));
+        }
+#endif
+        for (; x < sw; ++ x) fpix (x);
+    }
+
+    /**
+     * @function mcl_scale3x_row <cpp/transform.cpp>
+     * @brief AdvanceMAME Scale3X of one source row into three output rows.
+     *     s0 and s2 are the rows above and below, edges are repeated.
+     * @return void
+     */
+    static void
+    mcl_scale3x_row (color_t* d0, color_t* d1, color_t* d2, color_t const* s0,
+      color_t const* s1, color_t const* s2, point1d_t sw) noexcept{
+        auto fpix = [=] (point1d_t x) {
+            point1d_t xl = x ? x - 1 : 0, xr = x + 1 != sw ? x + 1 : x;
+            color_t a = s0[xl], b = s0[x], c = s0[xr];
+            color_t d = s1[xl], e = s1[x], f = s1[xr];
+            color_t g = s2[xl], h = s2[x], i = s2[xr];
+            color_t* r0 = d0 + x * 3, *r1 = d1 + x * 3, *r2 = d2 + x * 3;
+            if (b != h && d != f) {
+                r0[0] = d == b ? d : e;
+                r0[1] = ((d == b && e != c) || (b == f && e != a)) ? b : e;
+                r0[2] = b == f ? f : e;
+                r1[0] = ((d == b && e != g) || (d == h && e != a)) ? d : e;
+                r1[1] = e;
+                r1[2] = ((b == f && e != i) || (h == f && e != c)) ? f : e;
+                r2[0] = d == h ? d : e;
+                r2[1] = ((d == h && e != i) || (h == f && e != g)) ? h : e;
+                r2[2] = h == f ? f : e;
+            } else
+                r0[0] = r0[1] = r0[2] = r1[0] = r1[1] = r1[2] = r2[0] = r2[1] = r2[2] = e;
+        };
+        point1d_t x = 0;
+        fpix (x ++);
+#ifdef MCL_SSE2
+        for (point1d_t n = (sw - 2) >> 2; n > 0; -- n, x += 4) {
+            __m128i a = mcl_sse2_load (s0 + x - 1), b = mcl_sse2_load (s0 + x), c = mcl_sse2_load (s0 + x + 1);
+            __m128i d = mcl_sse2_load (s1 + x - 1), e = mcl_sse2_load (s1 + x), f = mcl_sse2_load (s1 + x + 1);
+            __m128i g = mcl_sse2_load (s2 + x - 1), h = mcl_sse2_load (s2 + x), i = mcl_sse2_load (s2 + x + 1);
+            __m128i no = _mm_or_si128 (_mm_cmpeq_epi32 (b, h), _mm_cmpeq_epi32 (d, f));
+            __m128i db = _mm_andnot_si128 (no, _mm_cmpeq_epi32 (d, b));
+            __m128i bf = _mm_andnot_si128 (no, _mm_cmpeq_epi32 (b, f));
+            __m128i dh = _mm_andnot_si128 (no, _mm_cmpeq_epi32 (d, h));
+            __m128i hf = _mm_andnot_si128 (no, _mm_cmpeq_epi32 (h, f));
+            __m128i ea = _mm_cmpeq_epi32 (e, a), ec = _mm_cmpeq_epi32 (e, c);
+            __m128i eg = _mm_cmpeq_epi32 (e, g), ei = _mm_cmpeq_epi32 (e, i);
+            mcl_sse2_store3 (d0 + x * 3,
+                mcl_sse2_select (db, d, e),
+                mcl_sse2_select (_mm_or_si128 (_mm_andnot_si128 (ec, db), _mm_andnot_si128 (ea, bf)), b, e),
+                mcl_sse2_select (bf, f, e));
+            mcl_sse2_store3 (d1 + x * 3,
+                mcl_sse2_select (_mm_or_si128 (_mm_andnot_si128 (eg, db), _mm_andnot_si128 (ea, dh)), d, e),
+                e,
+                mcl_sse2_select (_mm_or_si128 (_mm_andnot_si128 (ei, bf), _mm_andnot_si128 (ec, hf)), f, e));
+            mcl_sse2_store3 (d2 + x * 3,
+                mcl_sse2_select (dh, d, e),
+                mcl_sse2_select (_mm_or_si128 (_mm_andnot_si128 (ei, dh), _mm_andnot_si128 (eg, hf)), h, e),
+                mcl_sse2_select (hf, f, e));
+        }
+#endif
+        for (; x < sw; ++ x) fpix (x);
+    }
+
+    /**
+     * @function mcl_scalen_row <cpp/transform.cpp>
+     * @brief repeats each pixel of a row n times.
+     * @return void
+     */
+    static void
+    mcl_scalen_row (color_t* d, color_t const* s, point1d_t sw, point1d_t n) noexcept{
+        point1d_t x = 0;
+#ifdef MCL_SSE2
+        if (n == 2 || n == 3) {
+            for (point1d_t k = sw >> 2; k > 0; -- k, x += 4, d += n * 4) {
+                __m128i v = mcl_sse2_load (s + x);
+                if (n == 3) { mcl_sse2_store3 (d, v, v, v); continue; }
+                _mm_storeu_si128 (reinterpret_cast<__m128i*>(d),     _mm_unpacklo_epi32 (v, v));
+                _mm_storeu_si128 (reinterpret_cast<__m128i*>(d + 4), _mm_unpackhi_epi32 (v, v));
+            }
+        } else if (n >= 4) {
+            for (; x != sw; ++ x) {
+                __m128i   v = _mm_set1_epi32 (static_cast<int>(s[x]));
+                point1d_t k = n;
+                for (; k >= 4; k -= 4, d += 4)
+                    _mm_storeu_si128 (reinterpret_cast<__m128i*>(d), v);
+                for (; k; -- k) *d ++ = s[x];
+            }
+        }
+#endif
+        for (; x != sw; ++ x)
+            for (point1d_t k = n; k; -- k) *d ++ = s[x];
+    }
+
+    /**
+     * @function mcl_upscale_rows <cpp/transform.cpp>
+     * @brief scale2x (kind 2), scale3x (kind 3) or nearest neighbor
+     *     (kind 0) of the sw x sh pixels at src0 into dst0.
+     * @return void
+     */
+    static void
+    mcl_upscale_rows (color_t* dst0, color_t const* src0, point1d_t sw, point1d_t sh,
+      point1d_t factor, int kind) noexcept{
+        point1d_t dstw = sw * factor;
+        size_t    step = static_cast<size_t>(dstw) * static_cast<size_t>(factor);
+        // each source row makes factor rows, using the rows above and below
+        mcl_parallel_obj.run (sh, step * static_cast<size_t>(sh), [=] (point1d_t ib, point1d_t ie) {
+            color_t* d = dst0 + static_cast<size_t>(ib) * step;
+            for (point1d_t i = ib; i != ie; ++ i, d += step) {
+                color_t const* s0 = src0 + (i ? i - 1 : 0) * sw;
+                color_t const* s1 = src0 + i * sw;
+                color_t const* s2 = src0 + (i + 1 != sh ? i + 1 : i) * sw;
+                if (kind == 2)
+                    mcl_scale2x_row (d, d + dstw, s0, s1, s2, sw);
+                else if (kind == 3)
+                    mcl_scale3x_row (d, d + dstw, d + dstw * 2, s0, s1, s2, sw);
+                else {
+                    mcl_scalen_row (d, s1, sw, factor);
+                    for (point1d_t k = 1; k < factor; ++ k)
+                        ::memcpy (d + k * dstw, d, static_cast<size_t>(dstw) * sizeof (color_t));
+                }
+            }
+        });
+    }
+
+    // mcl_upscale_rows, where kind 4 is scale2x twice
+    static bool
+    mcl_upscale_buf (color_t* dst, color_t const* src, point1d_t sw, point1d_t sh,
+      point1d_t factor, int kind) noexcept{
+        if (kind != 4) {
+            mcl_upscale_rows (dst, src, sw, sh, factor, kind);
+            return true;
+        }
+        mcl_simpletls_ns::mcl_auto_ptr_t<color_t> tmp (static_cast<size_t>(sw) * static_cast<size_t>(sh) * 4u);
+        if (!tmp) return false;
+        mcl_upscale_rows (tmp, src, sw, sh, 2, 2);
+        mcl_upscale_rows (dst, tmp, sw * 2, sh * 2, 2, 2);
+        return true;
+    }
+
+    /**
+     * @function mcl_upscale <cpp/transform.cpp>
+     * @brief scale2x (kind 2), scale3x (kind 3), scale2x twice (kind 4)
+     *     or nearest neighbor (kind 0) by an integer factor.
      * @return surface_t
      */
-    surface_t mcl_transform_t::
-    scale2x (surface_t const& surface, point2d_t* offset) noexcept{
+    static surface_t
+    mcl_upscale (surface_t const& surface, point1d_t factor, int kind, point2d_t* offset, wchar_t const* name) noexcept{
         mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
         char*           data     = mcl_get_surface_data (&const_cast<surface_t&>(surface));
-        if (!dataplus) return sf_nullptr;
+        if (!dataplus || factor < 1) return sf_nullptr;
 
         // lock
-        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::scale2x");
-        if (!dataplus -> m_width) return sf_nullptr;
+        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, name);
+        point1d_t sw = dataplus -> m_width, sh = dataplus -> m_height;
+        if (!sw || factor > 0x7fffffff / sw || factor > 0x7fffffff / sh) return sf_nullptr;
 
-        // create compatible surface
-        point1d_t dstw = dataplus -> m_width << 1;
-        point1d_t dsth = dataplus -> m_height << 1;
+        // cached result
+        mcl_tcache_key_t key = { dataplus, dataplus -> m_generation, 3, data[0],
+            { double(factor), double(kind), 0. } };
+        surface_t cached;
+        if (mcl_tcache_obj.get (key, cached, offset)) return cached;
 
+        // create compatible surface
+        point1d_t dstw = sw * factor, dsth = sh * factor;
         surface_t res ({dstw, dsth}, data[0]);
         mcl_imagebuf_t* res_dataplus = mcl_get_surface_dataplus (&res);
         char*           res_data     = mcl_get_surface_data (&res);
@@ -658,101 +1038,90 @@ mcl {
         res_data[0] = data[0];
         res_dataplus -> m_colorkey = dataplus -> m_colorkey;
         res_dataplus -> m_alpha = dataplus -> m_alpha;
-
-        // AdvanceMAME Scale2X algorithm
-        auto fp2x32 = []
-        (color_t* dst, color_t const* src0, color_t const* src1,
-            color_t const* src2, point1d_t count)
-        {
-            // first pixel
-            if (src0[0] != src2[0] && src1[0] != src1[1]) {
-                dst[0] = src1[0] == src0[0] ? src0[0] : src1[0];
-                dst[1] = src1[1] == src0[0] ? src0[0] : src1[0];
-            } else {
-                dst[0] = src1[0];
-                dst[1] = src1[0];
-            }
-            ++ src0, ++ src1, ++ src2;
-            dst += 2, count -= 2;;
-
-            // central pixels
-            while (count) {
-                if (src0[0] != src2[0] && src1[-1] != src1[1]) {
-                    dst[0] = src1[-1] == src0[0] ? src0[0] : src1[0];
-                    dst[1] = src1[1] == src0[0] ? src0[0] : src1[0];
-                } else {
-                    dst[0] = src1[0];
-                    dst[1] = src1[0];
-                }
-                ++ src0, ++ src1, ++ src2;
-                dst += 2, -- count;
-            }
-
-            // last pixel
-            if (src0[0] != src2[0] && src1[-1] != src1[0]) {
-                dst[0] = src1[-1] == src0[0] ? src0[0] : src1[0];
-                dst[1] = src1[0] == src0[0] ? src0[0] : src1[0];
-            } else {
-                dst[0] = src1[0];
-                dst[1] = src1[0];
-            }
-        };
-        
-        // scaling calc
-        color_t* dst0 = res_dataplus -> m_pbuffer;
-        color_t* dst1 = dst0 + dstw;
-        color_t* src0 = dataplus -> m_pbuffer;
-        color_t* src1 = src0 + dataplus -> m_width;
-        color_t* src2 = src1 + dataplus -> m_width;
-        color_t* srce = src0 + dataplus -> m_height * dataplus -> m_width;
-        
         if (offset) {
-            offset -> x = -(dataplus -> m_width >> 1);
-            offset -> y = -(dataplus -> m_height >> 1);
-        }
-        
-        // src with single pixel side
-        if (dstw == 2) {
-            do {
-                dst0 = src0; ++ dst0;
-                dst0 = src0; ++ dst0;
-                dst0 = src0; ++ dst0;
-                dst0 = src0; ++ dst0;
-            } while (++ src0 != srce);
-            return res;
-        }
-        if (dsth == 2) {
-            do {
-                dst0 = src0; ++ dst0;
-                dst0 = src0; ++ dst0;
-                dst1 = src0; ++ dst1;
-                dst1 = src0; ++ dst1;
-            } while (++ src0 != srce);
-            return res;
+            offset -> x = -(((factor - 1) * sw) >> 1);
+            offset -> y = -(((factor - 1) * sh) >> 1);
         }
 
-        // first line
-        point1d_t dstw2x = dstw << 1;
-        fp2x32 (dst0, src0, src0, src1, dstw);
-        fp2x32 (dst1, src1, src0, src0, dstw);
-        dst0 += dstw2x;
-        dst1 += dstw2x;
-        // central lines
-        while (src2 != srce) {
-            fp2x32 (dst0, src0, src1, src2, dstw);
-            fp2x32 (dst1, src2, src1, src0, dstw);
-            dst0 += dstw2x;
-            dst1 += dstw2x;
-            src0 += dataplus -> m_width;
-            src1 += dataplus -> m_width;
-            src2 += dataplus -> m_width;
-        }
-        // last line
-        fp2x32 (dst0, src0, src1, src1, dstw);
-        fp2x32 (dst1, src1, src1, src0, dstw);
+        if (!mcl_upscale_buf (res_dataplus -> m_pbuffer, dataplus -> m_pbuffer, sw, sh, factor, kind))
+            return sf_nullptr;
+        mcl_tcache_obj.put (key, res, offset);
         return res;
     }
 
+    /**
+     * @function mcl_transform_t::scale2x <src/transform.cpp>
+     * @brief specialized image doubler
+     * @param[in] surface
+     * @return surface_t
+     */
+    surface_t mcl_transform_t::
+    scale2x (surface_t const& surface, point2d_t* offset) noexcept{
+        return mcl_upscale (surface, 2, 2, offset, L"mcl_transform_t::scale2x");
+    }
+
+    /**
+     * @function mcl_transform_t::scale3x <src/transform.cpp>
+     * @brief specialized image tripler
+     * @param[in] surface
+     * @return surface_t
+     */
+    surface_t mcl_transform_t::
+    scale3x (surface_t const& surface, point2d_t* offset) noexcept{
+        return mcl_upscale (surface, 3, 3, offset, L"mcl_transform_t::scale3x");
+    }
+
+    /**
+     * @function mcl_transform_t::scalenx <src/transform.cpp>
+     * @brief pixel-art upscaler by an integer factor
+     * @param[in] surface
+     * @param[in] factor: 1 or more
+     * @param[in] b_smooth: use scale2x for 2 and 4, and scale3x for 3.
+     *     other factors are always nearest neighbor
+     * @return surface_t
+     */
+    surface_t mcl_transform_t::
+    scalenx (surface_t const& surface, point1d_t factor, bool b_smooth, point2d_t* offset) noexcept{
+        int kind = (b_smooth && factor >= 2 && factor <= 4) ? static_cast<int>(factor) : 0;
+        return mcl_upscale (surface, factor, kind, offset, L"mcl_transform_t::scalenx");
+    }
+
+    /**
+     * @function mcl_transform_t::scalenx <src/transform.cpp>
+     * @brief pixel-art upscaler by an integer factor, into an existing
+     *     surface so that a frame loop allocates nothing
+     * @param[out] dest_surface: factor times the size of surface
+     * @param[in] surface: not dest_surface itself
+     * @return bool
+     */
+    bool mcl_transform_t::
+    scalenx (surface_t& dest_surface, surface_t const& surface, point1d_t factor, bool b_smooth) noexcept{
+        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        char*           data     = mcl_get_surface_data (&const_cast<surface_t&>(surface));
+        mcl_imagebuf_t* res_dataplus = mcl_get_surface_dataplus (&dest_surface);
+        char*           res_data     = mcl_get_surface_data (&dest_surface);
+        if (!dataplus || !res_dataplus || dataplus == res_dataplus || factor < 1) return false;
+
+        // lock both, in address order so that two calls the other way round cannot deadlock
+        bool b_src_first = std::less<mcl_imagebuf_t*>() (dataplus, res_dataplus);
+        mcl_simpletls_ns::mcl_spinlock_t lk1((b_src_first ? dataplus : res_dataplus) -> m_nrtlock,
+            L"mcl_transform_t::scalenx");
+        mcl_simpletls_ns::mcl_spinlock_t lk2((b_src_first ? res_dataplus : dataplus) -> m_nrtlock,
+            L"mcl_transform_t::scalenx");
+        point1d_t sw = dataplus -> m_width, sh = dataplus -> m_height;
+        if (!sw || factor > 0x7fffffff / sw || factor > 0x7fffffff / sh
+            || res_dataplus -> m_width != sw * factor || res_dataplus -> m_height != sh * factor)
+            return false;
+
+        // copy alpha info
+        res_dataplus -> touch ();
+        res_data[0] = data[0];
+        res_dataplus -> m_colorkey = dataplus -> m_colorkey;
+        res_dataplus -> m_alpha = dataplus -> m_alpha;
+        int kind = (b_smooth && factor >= 2 && factor <= 4) ? static_cast<int>(factor) : 0;
+        return mcl_upscale_buf (res_dataplus -> m_pbuffer, dataplus -> m_pbuffer, sw, sh, factor, kind);
+    }
+
     /**
      * @function mcl_transform_t::chop <src/transform.cpp>
      * @brief gets a copy of an image with an interior area removed
@@ -794,34 +1163,16 @@ mcl {
         res_dataplus -> m_colorkey = dataplus -> m_colorkey;
         res_dataplus -> m_alpha = dataplus -> m_alpha;
         
-        // map direction
-        color_t *dst = res_dataplus -> m_pbuffer, *src = dataplus -> m_pbuffer;
-        color_t *srcey1 = src + ey1 * dataplus -> m_width, *srcex1 = 0;
-        color_t *srcsy2 = src + sy2 * dataplus -> m_width, *srcsx2 = 0;
-        color_t *srcey2 = src + ey2 * dataplus -> m_width, *srcex2 = 0;
-
-        // y in [0, ey1)
-        while (src != srcey1) {
-            srcex1 = src + ex1;
-            srcsx2 = src + sx2;
-            srcex2 = src + ex2;
-            while (src != srcex1)
-                *dst = *src, ++ dst, ++ src;
-            src = srcsx2;
-            while (src != srcex2)
-                *dst = *src, ++ dst, ++ src;
-        }
-        // y in [sy2, ey2)
-        src = srcsy2;
-        while (src != srcey2) {
-            srcex1 = src + ex1;
-            srcsx2 = src + sx2;
-            srcex2 = src + ex2;
-            while (src != srcex1)
-                *dst = *src, ++ dst, ++ src;
-            src = srcsx2;
-            while (src != srcex2)
-                *dst = *src, ++ dst, ++ src;
+        // rows y in [0, ey1) and [sy2, ey2), each as two spans
+        color_t*  dst = res_dataplus -> m_pbuffer;
+        size_t    n1 = static_cast<size_t>(ex1 - sx1) * sizeof (color_t);
+        size_t    n2 = static_cast<size_t>(ex2 - sx2) * sizeof (color_t);
+        point1d_t sw = dataplus -> m_width;
+        for (point1d_t i = 0; i != ey1 - sy1 + ey2 - sy2; ++ i) {
+            color_t const* src = dataplus -> m_pbuffer
+                + static_cast<size_t>(i < ey1 ? i : i - ey1 + sy2) * static_cast<size_t>(sw);
+            if (n1) ::memcpy (dst, src, n1), dst += ex1;
+            if (n2) ::memcpy (dst, src + sx2, n2), dst += ex2 - sx2;
         }
         return res;
     }
@@ -872,138 +1223,835 @@ mcl {
         tw = res_dataplus -> m_width - dx,  dw = (dw > tw ? tw : dw);
         th = res_dataplus -> m_height - dy, dh = (dh > th ? th : dh);
         
-        // start bliting
-        if (dx || dy || dw < rect.w || dh < rect.h) {
-            color_t* dj = res_dataplus -> m_pbuffer;
-            color_t* di = dj + static_cast<size_t>(dy) * res_dataplus -> m_width + dx;
-            color_t *si = dataplus -> m_pbuffer + static_cast<size_t>(sy) * dataplus -> m_width + sx, *sj = 0;
-            color_t *di0 = di + static_cast<size_t>(dh) * res_dataplus -> m_width, *dj0 = 0;
-            if (dw > 0 && dh > 0) {
-                for (; di != di0; di += res_dataplus -> m_width, si += dataplus -> m_width) {
-                    for (; dj != di; ++ dj) *dj = trans;
-                    for (sj = si, dj0 = di + dw; dj != dj0; ++ sj, ++ dj) *dj = *sj;
-                }
-            }
-            di = res_dataplus -> m_pbuffer + res_dataplus -> m_width * res_dataplus -> m_height;
-            for (; dj != di; ++ dj) *dj = trans;
+        // start bliting. the area outside the surface is set to trans
+        point1d_t rw = res_dataplus -> m_width, rh = res_dataplus -> m_height;
+        color_t*  dst = res_dataplus -> m_pbuffer;
+        if (dw <= 0 || dh <= 0) {
+            mcl_fill_row (dst, rw * rh, trans);
             return res;
         }
-        ::BitBlt (res_dataplus -> m_hdc, dx, dy, dw, dh, dataplus -> m_hdc, sx, sy, SRCCOPY);
+        color_t const* src = dataplus -> m_pbuffer + static_cast<size_t>(sy) * dataplus -> m_width + sx;
+        if (!dx && dw == rw && dw == dataplus -> m_width) {
+            // whole rows are contiguous on both sides
+            mcl_fill_row (dst, dy * rw, trans);
+            ::memcpy (dst + dy * rw, src, static_cast<size_t>(dw) * static_cast<size_t>(dh) * sizeof (color_t));
+        } else {
+            mcl_fill_row (dst, dy * rw, trans);
+            for (point1d_t i = dy; i != dy + dh; ++ i, src += dataplus -> m_width) {
+                color_t* d = dst + static_cast<size_t>(i) * static_cast<size_t>(rw);
+                mcl_fill_row (d, dx, trans);
+                ::memcpy (d + dx, src, static_cast<size_t>(dw) * sizeof (color_t));
+                mcl_fill_row (d + dx + dw, rw - dx - dw, trans);
+            }
+        }
+        mcl_fill_row (dst + (dy + dh) * rw, (rh - dy - dh) * rw, trans);
         return res;
     }
 
+    // luminance with 8-bit weights, within 1 of the 299/587/114 per mille ones
+    static inline color_t
+    mcl_luma (color_t c) noexcept{
+        return ((c >> 16 & 0xff) * 77 + (c >> 8 & 0xff) * 150 + (c & 0xff) * 29) >> 8;
+    }
+
     /**
-     * @function mcl_transform_t::laplacian <src/transform.cpp>
-     * @brief find edges in a surface using the laplacian algorithm
-     * @param[in] surface
-     * @return surface_t
+     * @function mcl_luma_row <cpp/transform.cpp>
+     * @brief writes the luminance of n pixels to every color channel,
+     *     keeping the bits of the source in keep. dst may be src.
+     * @return void
      */
-    surface_t mcl_transform_t::
-    laplacian (surface_t const& surface) noexcept{
-        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
-        if (!dataplus) return sf_nullptr;
-        
+    static void
+    mcl_luma_row (color_t* dst, color_t const* src, point1d_t n, color_t keep) noexcept{
+# ifdef MCL_SSE2
+        __m128i const wrb = _mm_set1_epi32 (77 << 16 | 29);
+        __m128i const wg  = _mm_set1_epi32 (150);
+        __m128i const m8  = _mm_set1_epi32 (0xff);
+        __m128i const m16 = _mm_set1_epi32 (0xff00ff);
+        __m128i const mk  = _mm_set1_epi32 (static_cast<int>(keep));
+        for (point1d_t n4 = n >> 2; n4; -- n4, src += 4, dst += 4) {
+            __m128i v = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(src));
+            __m128i y = _mm_add_epi32 (_mm_madd_epi16 (_mm_and_si128 (v, m16), wrb),
+                _mm_madd_epi16 (_mm_and_si128 (_mm_srli_epi32 (v, 8), m8), wg));
+            y = _mm_srli_epi32 (y, 8);
+            y = _mm_or_si128 (_mm_or_si128 (y, _mm_slli_epi32 (y, 8)),
+                _mm_or_si128 (_mm_slli_epi32 (y, 16), _mm_and_si128 (v, mk)));
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(dst), y);
+        }
+        n &= 3;
+# endif
+        for (; n; -- n, ++ src, ++ dst)
+            *dst = mcl_luma (*src) * 0x10101 | (*src & keep);
+    }
+
+    // x * a / 255 for one channel, rounded
+    static inline color_t
+    mcl_conv_premul (color_t x, color_t a) noexcept{
+        x = (x & 0xff) * a + 128;
+        return (x + (x >> 8)) >> 8;
+    }
+
+    // quantizes weights to 16-bit fixed-point so that the sums of inputs
+    // up to max_in fit in 32 bits. returns the number of fraction bits,
+    // or -1 if the weights are too large
+    static int
+    mcl_conv_quantize (short* q, float const* w, int n, float max_in) noexcept{
+        float wmax = 0.f, wsum = 0.f;
+        for (int i = 0; i != n; ++ i) {
+            float a = w[i] < 0.f ? -w[i] : w[i];
+            wsum += a;
+            if (a > wmax) wmax = a;
+        }
+        int bits = 14;
+        while (bits && (wmax * float(1 << bits) > 32767.f
+            || wsum * max_in * float(1 << bits) > 2147483647.f)) -- bits;
+        if (wmax > 32767.f || wsum * max_in > 2147483647.f) return -1;
+        for (int i = 0; i != n; ++ i)
+            q[i] = static_cast<short>(w[i] * float(1 << bits) + (w[i] < 0.f ? -.5f : .5f));
+        return bits;
+    }
+
+#   ifdef MCL_SSE2
+    // two 16-bit weights in each 32-bit lane for _mm_madd_epi16
+    static inline __m128i
+    mcl_conv_pair (short const* w) noexcept{
+        return _mm_set1_epi32 (static_cast<int>(static_cast<unsigned>(static_cast<unsigned short>(w[1])) << 16
+            | static_cast<unsigned short>(w[0])));
+    }
+#   endif
+
+    // acc[x] += sum of w[j] * src[x + j], four 8-bit channels each
+    static void
+    mcl_conv_hrow (int* acc, color_t const* src, short const* w, int kw, point1d_t count) noexcept{
+        // taps are padded to pairs with a zero weight
+        int pairs = (kw + 1) >> 1;
+#   ifdef MCL_SSE2
+        __m128i const zero = _mm_setzero_si128 ();
+        __m128i wp[32], px, sum;
+        int const maxp = static_cast<int>(sizeof (wp) / sizeof (wp[0]));
+        if (pairs <= maxp) {
+            for (int j = 0; j != pairs; ++ j)
+                wp[j] = mcl_conv_pair (w + 2 * j);
+            for (; count; -- count, ++ src, acc += 4) {
+                sum = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(acc));
+                for (int j = 0; j != pairs; ++ j) {
+                    // b0 g0 r0 a0 b1 g1 r1 a1 -> b0 b1 g0 g1 r0 r1 a0 a1
+                    px = _mm_unpacklo_epi8 (_mm_loadl_epi64 (reinterpret_cast<__m128i const*>(src + 2 * j)), zero);
+                    px = _mm_unpacklo_epi16 (px, _mm_srli_si128 (px, 8));
+                    sum = _mm_add_epi32 (sum, _mm_madd_epi16 (px, wp[j]));
+                }
+                _mm_storeu_si128 (reinterpret_cast<__m128i*>(acc), sum);
+            }
+            return ;
+        }
+#   endif
+        for (; count; -- count, ++ src, acc += 4)
+            for (int j = 0; j != pairs << 1; ++ j) {
+                acc[0] += w[j] * static_cast<int>( src[j]        & 0xff);
+                acc[1] += w[j] * static_cast<int>((src[j] >> 8)  & 0xff);
+                acc[2] += w[j] * static_cast<int>((src[j] >> 16) & 0xff);
+                acc[3] += w[j] * static_cast<int>( src[j] >> 24);
+            }
+    }
+
+    // acc[x] += sum of w[i] * rows[i][x], four 16-bit channels each
+    static void
+    mcl_conv_vrow (int* acc, short const* const* rows, short const* w, int kh, point1d_t count) noexcept{
+        int pairs = (kh + 1) >> 1;
+        point1d_t x = 0;
+#   ifdef MCL_SSE2
+        __m128i p0, p1, wp, s0, s1;
+        for (; count - x >= 2; x += 2) {
+            s0 = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(acc + 4 * x));
+            s1 = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(acc + 4 * x + 4));
+            for (int i = 0; i != pairs; ++ i) {
+                wp = mcl_conv_pair (w + 2 * i);
+                p0 = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(rows[2 * i] + 4 * x));
+                p1 = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(rows[2 * i + 1] + 4 * x));
+                s0 = _mm_add_epi32 (s0, _mm_madd_epi16 (_mm_unpacklo_epi16 (p0, p1), wp));
+                s1 = _mm_add_epi32 (s1, _mm_madd_epi16 (_mm_unpackhi_epi16 (p0, p1), wp));
+            }
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(acc + 4 * x), s0);
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(acc + 4 * x + 4), s1);
+        }
+#   endif
+        for (; x != count; ++ x)
+            for (int i = 0; i != pairs << 1; ++ i)
+                for (int c = 0; c != 4; ++ c)
+                    acc[4 * x + c] += w[i] * rows[i][4 * x + c];
+    }
+
+    // acc[x] += sum of w[j] * src[x + j] in float
+    static void
+    mcl_conv_hrowf (float* acc, color_t const* src, float const* w, int kw, point1d_t count) noexcept{
+#   ifdef MCL_SSE2
+        __m128i const zero = _mm_setzero_si128 ();
+        __m128 sum;
+        for (; count; -- count, ++ src, acc += 4) {
+            sum = _mm_loadu_ps (acc);
+            for (int j = 0; j != kw; ++ j)
+                sum = _mm_add_ps (sum, _mm_mul_ps (_mm_set1_ps (w[j]), _mm_cvtepi32_ps (_mm_unpacklo_epi16 (
+                    _mm_unpacklo_epi8 (_mm_cvtsi32_si128 (static_cast<int>(src[j])), zero), zero))));
+            _mm_storeu_ps (acc, sum);
+        }
+#   else
+        for (; count; -- count, ++ src, acc += 4)
+            for (int j = 0; j != kw; ++ j) {
+                acc[0] += w[j] * float( src[j]        & 0xff);
+                acc[1] += w[j] * float((src[j] >> 8)  & 0xff);
+                acc[2] += w[j] * float((src[j] >> 16) & 0xff);
+                acc[3] += w[j] * float( src[j] >> 24);
+            }
+#   endif
+    }
+
+    // acc[x] += sum of w[i] * rows[i][x] in float
+    static void
+    mcl_conv_vrowf (float* acc, float const* const* rows, float const* w, int kh, point1d_t count) noexcept{
+#   ifdef MCL_SSE2
+        __m128 sum;
+        for (point1d_t x = 0; x != count; ++ x, acc += 4) {
+            sum = _mm_loadu_ps (acc);
+            for (int i = 0; i != kh; ++ i)
+                sum = _mm_add_ps (sum, _mm_mul_ps (_mm_set1_ps (w[i]), _mm_loadu_ps (rows[i] + 4 * x)));
+            _mm_storeu_ps (acc, sum);
+        }
+#   else
+        for (point1d_t x = 0; x != count; ++ x, acc += 4)
+            for (int i = 0; i != kh; ++ i)
+                for (int c = 0; c != 4; ++ c)
+                    acc[c] += w[i] * rows[i][4 * x + c];
+#   endif
+    }
+
+    /**
+     * @function mcl_transform_t::convolve <src/transform.cpp>
+     * @brief convolve a surface with a kernel
+     * @param[in] surface
+     * @param[in] kernel: ksize.y rows of ksize.x weights
+     * @param[in] ksize: kernel size. the anchor is at (ksize.x / 2, ksize.y / 2)
+     * @param[in] flags: edge mode with conv.Float, conv.Abs, conv.Gray
+     * @param[in] bias: added to each channel of the result
+     * @return surface_t
+     */
+    surface_t mcl_transform_t::
+    convolve (surface_t const& surface, float const* kernel, point2d_t ksize,
+      conv_t flags, float bias) noexcept{
+        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        char*           data     = mcl_get_surface_data (&const_cast<surface_t&>(surface));
+        if (!(kernel && dataplus && ksize.x > 0 && ksize.y > 0)) return sf_nullptr;
+        if (ksize.x > 255 || ksize.y > 255) return sf_nullptr;
+        conv_t edge = flags & 0xf;
+        if (edge > mcl_conv_t::Zero) return sf_nullptr;
+
         // lock
-        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::laplacian");
-        char* data = mcl_get_surface_data (&const_cast<surface_t&>(surface));
+        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::convolve");
         if (!dataplus -> m_width) return sf_nullptr;
-        
+
         // create compatible surface
-        surface_t res ({dataplus -> m_width, dataplus -> m_height}, data[0]);
+        bool b_gray = flags & mcl_conv_t::Gray;
+        surface_t::type res_flags = b_gray ? surface_t::type(0) : data[0];
+        surface_t res ({dataplus -> m_width, dataplus -> m_height}, res_flags);
         mcl_imagebuf_t* res_dataplus = mcl_get_surface_dataplus (&res);
+        char*           res_data     = mcl_get_surface_data (&res);
         if (!(res_dataplus && res_dataplus -> m_width)) return sf_nullptr;
 
         // copy alpha info
-        color_t b_sa = color_t(data[0] & surface_t::SrcAlpha);
-        color_t b_ck = color_t(data[0] & surface_t::SrcColorKey);
+        res_data[0] = res_flags;
+        if (!b_gray) {
+            res_dataplus -> m_colorkey = dataplus -> m_colorkey;
+            res_dataplus -> m_alpha = dataplus -> m_alpha;
+        }
+        bool    b_sa = data[0] & surface_t::SrcAlpha;
+        bool    b_ck = data[0] & surface_t::SrcColorKey;
         color_t m_ck = dataplus -> m_colorkey;
-        res_dataplus -> m_alpha = dataplus -> m_alpha;
-        
-        // laplacian lines
-        auto h1gray = [b_sa, b_ck, m_ck] // grayscale
-        (color_t* dst, color_t* src, point1d_t count) {
-            do {
-                *dst = ((*src >> 16) & 0xff) * 299 +
-                       ((*src >> 8)  & 0xff) * 587 +
-                       ( *src        & 0xff) * 114;
-                if (b_sa) *dst = *dst * (*src >> 24) / 255000;
-                else if (b_ck && (*src & 0xffffff) == m_ck) *dst = 0;
-                else      *dst /= 1000;
-                ++ src; ++ dst;
-            } while (-- count);
+
+        point1d_t w = dataplus -> m_width, h = dataplus -> m_height;
+        int       kw = static_cast<int>(ksize.x), kh = static_cast<int>(ksize.y);
+        int       ax = kw >> 1, ay = kh >> 1;
+        point1d_t pw = w + kw;  // one spare pixel for pairs of taps
+        size_t    work = static_cast<size_t>(w) * static_cast<size_t>(h);
+        color_t*  src = dataplus -> m_pbuffer;
+        color_t*  dst = res_dataplus -> m_pbuffer;
+
+        // maps coordinates outside of the surface. -1 for zero
+        auto fedge = [edge] (point1d_t i, point1d_t n) -> point1d_t {
+            if (i >= 0 && i < n) return i;
+            if (edge == mcl_conv_t::Zero) return -1;
+            if (edge == mcl_conv_t::Wrap) return (i % n + n) % n;
+            return i < 0 ? 0 : n - 1;
+        };
+
+        // working rows: premultiplied or grayscale, padded for the kernel
+        mcl_simpletls_ns::mcl_auto_ptr_t<color_t> padded (static_cast<size_t>(pw) * static_cast<size_t>(h + 1));
+        color_t* ppad = padded;
+        if (!ppad) return sf_nullptr;
+        color_t* pzero = ppad + static_cast<size_t>(pw) * static_cast<size_t>(h);
+        for (point1d_t x = 0; x != pw; ++ x) pzero[x] = 0;
+        mcl_parallel_obj.run (h, work, [=] (point1d_t ib, point1d_t ie) {
+            color_t c = 0, a = 0;
+            for (point1d_t y = ib; y != ie; ++ y) {
+                color_t* s = src + y * w;
+                color_t* p = ppad + y * pw + ax;
+                for (point1d_t x = 0; x != w; ++ x) {
+                    c = s[x];
+                    if (b_sa) {
+                        a = c >> 24;
+                        c = a << 24 | mcl_conv_premul (c >> 16, a) << 16
+                            | mcl_conv_premul (c >> 8, a) << 8 | mcl_conv_premul (c, a);
+                    } else if (b_ck && (c & 0xffffff) == m_ck && b_gray)
+                        c = 0;
+                    p[x] = b_gray ? c | 0xff000000 : c;
+                }
+                if (b_gray) mcl_luma_row (p, p, w, 0xff000000);
+                for (point1d_t x = -ax; x != 0; ++ x) {
+                    point1d_t i = fedge (x, w);
+                    p[x] = i < 0 ? 0 : p[i];
+                }
+                for (point1d_t x = w; x != pw - ax; ++ x) {
+                    point1d_t i = fedge (x, w);
+                    p[x] = i < 0 ? 0 : p[i];
+                }
+            }
+        });
+        auto fprow = [=] (point1d_t y) -> color_t const* {
+            point1d_t i = fedge (y, h);
+            return i < 0 ? pzero : ppad + i * pw;
         };
-        auto h1laplacian = [] // laplacian
-        (color_t* dst, color_t* src0, color_t* src1, color_t* src2, point1d_t count) {
-            -- count;
-            while (-- count) {
-                ++ src0, ++ src1, ++ src2, ++ dst;
-                dst[0] = color_t(abs(long(src1[0] << 2) - long(src0[0] + src1[-1] + src1[1] + src2[0])));
+
+        // writes a row of sums back to pixels
+        bool  b_abs = flags & mcl_conv_t::Abs;
+        auto fstore = [=] (color_t* d, color_t const* s, float const* v, point1d_t count) {
+            float f = 0.f;
+            color_t ch[4] = { 0 };
+            for (; count; -- count, ++ d, ++ s, v += 4) {
+                for (int c = 0; c != 4; ++ c) {
+                    f = v[c] + bias;
+                    if (b_abs && f < 0.f) f = -f;
+                    ch[c] = f <= 0.f ? 0 : (f >= 255.f ? 255 : color_t(f + .5f));
+                }
+                if (b_gray) {
+                    *d = ch[0] << 16 | ch[0] << 8 | ch[0] | 0xff000000;
+                } else if (b_sa) {
+                    if (!ch[3]) { *d = 0; continue; }
+                    for (int c = 0; c != 3; ++ c)
+                        ch[c] = (ch[c] >= ch[3]) ? 255 : (ch[c] * 255 + (ch[3] >> 1)) / ch[3];
+                    *d = ch[3] << 24 | ch[2] << 16 | ch[1] << 8 | ch[0];
+                } else {
+                    *d = (*s & 0xff000000) | ch[2] << 16 | ch[1] << 8 | ch[0];
+                    if (b_ck) {
+                        if ((*s & 0xffffff) == m_ck) *d = *s;
+                        else if ((*d & 0xffffff) == m_ck) *d ^= 1;
+                    }
+                }
             }
         };
-        auto h1clear = [] // empty line
-        (color_t* dst, point1d_t count) {
-            do {
-                *dst = 0xff000000;
-                ++ dst;
-            } while (-- count);
+
+        // find out if the kernel is separable: k[i][j] = col[i] * row[j]
+        int   r0 = 0, c0 = 0;
+        float kmax = 0.f;
+        for (int i = 0; i != kh; ++ i)
+            for (int j = 0; j != kw; ++ j) {
+                float a = kernel[i * kw + j] < 0.f ? -kernel[i * kw + j] : kernel[i * kw + j];
+                if (a > kmax) kmax = a, r0 = i, c0 = j;
+            }
+        mcl_simpletls_ns::mcl_auto_ptr_t<float> sep (static_cast<size_t>(kw + kh + 2));
+        float* frow = sep, *fcol = frow ? frow + kw + 1 : nullptr;
+        if (!frow) return sf_nullptr;
+        bool b_sep = kw > 1 && kh > 1 && kmax > 0.f;
+        if (b_sep) {
+            float rsum = 0.f;
+            for (int j = 0; j != kw; ++ j)
+                frow[j] = kernel[r0 * kw + j], rsum += frow[j] < 0.f ? -frow[j] : frow[j];
+            for (int i = 0; i != kh; ++ i)
+                fcol[i] = kernel[i * kw + c0] / kernel[r0 * kw + c0] * rsum;
+            for (int j = 0; j != kw; ++ j)
+                frow[j] /= rsum;
+            for (int i = 0; i != kh && b_sep; ++ i)
+                for (int j = 0; j != kw && b_sep; ++ j) {
+                    float d = kernel[i * kw + j] - fcol[i] * frow[j];
+                    if ((d < 0.f ? -d : d) > kmax * 1e-5f) b_sep = false;
+                }
+            frow[kw] = fcol[kh] = 0.f;
+        }
+
+        // fall back to float if the weights do not fit in 16 bits
+        bool  b_float = flags & mcl_conv_t::Float;
+        short qrow[256] = { 0 }, qcol[256] = { 0 };
+        int   brow = 0, bcol = 0;
+        if (b_sep && !b_float) {
+            brow = mcl_conv_quantize (qrow, frow, kw, 255.f);
+            bcol = mcl_conv_quantize (qcol, fcol, kh, 4096.f);
+            if (brow < 4 || bcol < 0) b_float = true;
+        }
+        mcl_simpletls_ns::mcl_auto_ptr_t<short> qk (static_cast<size_t>(kh) * static_cast<size_t>(kw + 1));
+        mcl_simpletls_ns::mcl_auto_ptr_t<float> fk (static_cast<size_t>(kh) * static_cast<size_t>(kw + 1));
+        short* pqk = qk;
+        float* pfk = fk;
+        int    bits = 0;
+        if (!b_sep && !b_float) {
+            if (!pqk || !pfk) return sf_nullptr;
+            for (int i = 0; i != kh; ++ i) {
+                for (int j = 0; j != kw; ++ j) pfk[i * (kw + 1) + j] = kernel[i * kw + j];
+                pfk[i * (kw + 1) + kw] = 0.f;
+            }
+            bits = mcl_conv_quantize (pqk, pfk, kh * (kw + 1), 255.f);
+            if (bits < 0) b_float = true;
+        }
+
+        // cleared by a band that cannot get its buffers
+        LONG volatile b_ok = 1;
+        if (b_sep && !b_float) {
+        // separable, fixed-point: rows into 16-bit sums (4 fraction bits), then columns
+            point1d_t iw = static_cast<point1d_t>(w) << 2;
+            mcl_simpletls_ns::mcl_auto_ptr_t<short> inter (static_cast<size_t>(iw) * static_cast<size_t>(h + 1));
+            short* pinter = inter;
+            if (!pinter) return sf_nullptr;
+            short* izero = pinter + iw * h;
+            for (point1d_t x = 0; x != iw; ++ x) izero[x] = 0;
+            mcl_parallel_obj.run (h, work, [=, &qrow, &b_ok] (point1d_t ib, point1d_t ie) {
+                mcl_simpletls_ns::mcl_auto_ptr_t<int> acc (static_cast<size_t>(iw));
+                if (!acc) { ::InterlockedExchange (&b_ok, 0); return ; }
+                // with brow == 4 the sums are taken as they are and need no rounding
+                int round = brow > 4 ? 1 << (brow - 5) : 0, v = 0;
+                for (point1d_t y = ib; y != ie; ++ y) {
+                    for (point1d_t x = 0; x != iw; ++ x) acc[x] = 0;
+                    mcl_conv_hrow (acc, ppad + y * pw, qrow, kw, w);
+                    short* d = pinter + y * iw;
+                    for (point1d_t x = 0; x != iw; ++ x) {
+                        v = (acc[x] + round) >> (brow - 4);
+                        d[x] = static_cast<short>(v > 32767 ? 32767 : (v < -32768 ? -32768 : v));
+                    }
+                }
+            });
+            if (!b_ok) return sf_nullptr;
+            mcl_parallel_obj.run (h, work, [=, &qcol, &b_ok] (point1d_t ib, point1d_t ie) {
+                mcl_simpletls_ns::mcl_auto_ptr_t<int> acc (static_cast<size_t>(iw));
+                mcl_simpletls_ns::mcl_auto_ptr_t<float> val (static_cast<size_t>(iw));
+                if (!acc || !val) { ::InterlockedExchange (&b_ok, 0); return ; }
+                short const* rows[257] = { 0 };
+                float scale = 1.f / float(1 << (bcol + 4));
+                for (point1d_t y = ib; y != ie; ++ y) {
+                    for (int i = 0; i != kh; ++ i) {
+                        point1d_t r = fedge (y + i - ay, h);
+                        rows[i] = r < 0 ? izero : pinter + r * iw;
+                    }
+                    rows[kh] = izero;
+                    for (point1d_t x = 0; x != iw; ++ x) acc[x] = 0;
+                    mcl_conv_vrow (acc, rows, qcol, kh, w);
+                    for (point1d_t x = 0; x != iw; ++ x) val[x] = float(acc[x]) * scale;
+                    fstore (dst + y * w, src + y * w, val, w);
+                }
+            });
+        } else if (b_sep) {
+        // separable, float
+            point1d_t iw = static_cast<point1d_t>(w) << 2;
+            mcl_simpletls_ns::mcl_auto_ptr_t<float> inter (static_cast<size_t>(iw) * static_cast<size_t>(h + 1));
+            float* pinter = inter;
+            if (!pinter) return sf_nullptr;
+            float* izero = pinter + iw * h;
+            for (point1d_t x = 0; x != iw; ++ x) izero[x] = 0.f;
+            mcl_parallel_obj.run (h, work, [=] (point1d_t ib, point1d_t ie) {
+                for (point1d_t y = ib; y != ie; ++ y) {
+                    float* d = pinter + y * iw;
+                    for (point1d_t x = 0; x != iw; ++ x) d[x] = 0.f;
+                    mcl_conv_hrowf (d, ppad + y * pw, frow, kw, w);
+                }
+            });
+            mcl_parallel_obj.run (h, work, [=, &b_ok] (point1d_t ib, point1d_t ie) {
+                mcl_simpletls_ns::mcl_auto_ptr_t<float> val (static_cast<size_t>(iw));
+                if (!val) { ::InterlockedExchange (&b_ok, 0); return ; }
+                float const* rows[256] = { 0 };
+                for (point1d_t y = ib; y != ie; ++ y) {
+                    for (int i = 0; i != kh; ++ i) {
+                        point1d_t r = fedge (y + i - ay, h);
+                        rows[i] = r < 0 ? izero : pinter + r * iw;
+                    }
+                    for (point1d_t x = 0; x != iw; ++ x) val[x] = 0.f;
+                    mcl_conv_vrowf (val, rows, fcol, kh, w);
+                    fstore (dst + y * w, src + y * w, val, w);
+                }
+            });
+        } else if (!b_float) {
+        // general, fixed-point: one row pass per kernel row
+            mcl_parallel_obj.run (h, work, [=, &b_ok] (point1d_t ib, point1d_t ie) {
+                point1d_t iw = static_cast<point1d_t>(w) << 2;
+                mcl_simpletls_ns::mcl_auto_ptr_t<int> acc (static_cast<size_t>(iw));
+                mcl_simpletls_ns::mcl_auto_ptr_t<float> val (static_cast<size_t>(iw));
+                if (!acc || !val) { ::InterlockedExchange (&b_ok, 0); return ; }
+                float scale = 1.f / float(1 << bits);
+                for (point1d_t y = ib; y != ie; ++ y) {
+                    for (point1d_t x = 0; x != iw; ++ x) acc[x] = 0;
+                    for (int i = 0; i != kh; ++ i)
+                        mcl_conv_hrow (acc, fprow (y + i - ay), pqk + i * (kw + 1), kw, w);
+                    for (point1d_t x = 0; x != iw; ++ x) val[x] = float(acc[x]) * scale;
+                    fstore (dst + y * w, src + y * w, val, w);
+                }
+            });
+        } else {
+        // general, float
+            mcl_parallel_obj.run (h, work, [=, &b_ok] (point1d_t ib, point1d_t ie) {
+                point1d_t iw = static_cast<point1d_t>(w) << 2;
+                mcl_simpletls_ns::mcl_auto_ptr_t<float> val (static_cast<size_t>(iw));
+                if (!val) { ::InterlockedExchange (&b_ok, 0); return ; }
+                for (point1d_t y = ib; y != ie; ++ y) {
+                    for (point1d_t x = 0; x != iw; ++ x) val[x] = 0.f;
+                    for (int i = 0; i != kh; ++ i)
+                        mcl_conv_hrowf (val, fprow (y + i - ay), kernel + i * kw, kw, w);
+                    fstore (dst + y * w, src + y * w, val, w);
+                }
+            });
+        }
+        if (!b_ok) return sf_nullptr;
+        return res;
+    }
+
+    /**
+     * @function mcl_transform_t::laplacian <src/transform.cpp>
+     * @brief find edges in a surface using the laplacian algorithm
+     * @param[in] surface
+     * @return surface_t
+     */
+    surface_t mcl_transform_t::
+    laplacian (surface_t const& surface) noexcept{
+        float const kernel[9] = {
+             0.f, -1.f,  0.f,
+            -1.f,  4.f, -1.f,
+             0.f, -1.f,  0.f
+        };
+        return convolve (surface, kernel, {3, 3}, mcl_conv_t::Abs | mcl_conv_t::Gray);
+    }
+
+    /**
+     * @function mcl_transform_t::sharpen <src/transform.cpp>
+     * @brief sharpen a surface
+     * @param[in] surface
+     * @param[in] amount: strength of the effect
+     * @return surface_t
+     */
+    surface_t mcl_transform_t::
+    sharpen (surface_t const& surface, float amount) noexcept{
+        float const kernel[9] = {
+                0.f,      -amount,       0.f,
+            -amount, 1.f + 4.f * amount, -amount,
+                0.f,      -amount,       0.f
+        };
+        return convolve (surface, kernel, {3, 3});
+    }
+
+    /**
+     * @function mcl_transform_t::emboss <src/transform.cpp>
+     * @brief emboss a surface. lit from the top left
+     * @param[in] surface
+     * @param[in] strength: depth of the relief
+     * @return surface_t
+     */
+    surface_t mcl_transform_t::
+    emboss (surface_t const& surface, float strength) noexcept{
+        float const kernel[9] = {
+            -strength, -strength,      0.f,
+            -strength,       0.f, strength,
+                  0.f,  strength, strength
         };
-        auto h1copy = [] // grayscale to rgb
-        (color_t* dst, color_t* src, point1d_t count) {
-            count -= 2;
-            dst[0] = 0xff000000;
-            do {
-                ++ src, ++ dst;
-                dst[0] = (src[0] << 16) | (src[0] << 8) | (src[0]) | 0xff000000;
-            } while (-- count);
-            dst[1] = 0xff000000;
+        return convolve (surface, kernel, {3, 3}, mcl_conv_t::Gray, 128.f);
+    }
+
+    // running sums of the four channels, divided by the window with a
+    // 32-bit reciprocal: (sum * inv + 2^31) >> 32, inv = round(2^32 / n)
+    static inline color_t
+    mcl_blur_div (unsigned long long const* s, unsigned long long inv) noexcept{
+        return static_cast<color_t>(((s[3] * inv + 0x80000000ull) >> 32) << 24
+            | ((s[2] * inv + 0x80000000ull) >> 32) << 16
+            | ((s[1] * inv + 0x80000000ull) >> 32) << 8
+            |  ((s[0] * inv + 0x80000000ull) >> 32));
+    }
+
+    // s += k * c for each channel
+    static inline void
+    mcl_blur_add (unsigned long long* s, color_t c, unsigned long long k) noexcept{
+        s[0] += k * ( c        & 0xff);
+        s[1] += k * ((c >> 8)  & 0xff);
+        s[2] += k * ((c >> 16) & 0xff);
+        s[3] += k * ( c >> 24);
+    }
+
+    // box-filters a row of w pixels with a window of 2r+1 pixels
+    static void
+    mcl_blur_hrow (color_t* dst, color_t const* src, point1d_t w, point1d_t r, bool b_clamp) noexcept{
+        unsigned long long s[4] = { 0 };
+        unsigned long long inv = ((1ull << 32) + static_cast<unsigned long long>(r)) / static_cast<unsigned long long>(2 * r + 1);
+        color_t const lc = b_clamp ? src[0] : 0, rc = b_clamp ? src[w - 1] : 0;
+
+        // the first window, in O(min(r, w))
+        mcl_blur_add (s, lc, static_cast<unsigned long long>(r));
+        for (point1d_t x = 0; x <= r && x < w; ++ x)
+            mcl_blur_add (s, src[x], 1);
+        if (r >= w) mcl_blur_add (s, rc, static_cast<unsigned long long>(r - w + 1));
+
+        color_t cadd = 0, csub = 0;
+        for (point1d_t x = 0; x != w; ++ x) {
+            dst[x] = mcl_blur_div (s, inv);
+            cadd = x + r + 1 < w ? src[x + r + 1] : rc;
+            csub = x - r >= 0 ? src[x - r] : lc;
+            s[0] += ( cadd        & 0xff), s[0] -= ( csub        & 0xff);
+            s[1] += ((cadd >> 8)  & 0xff), s[1] -= ((csub >> 8)  & 0xff);
+            s[2] += ((cadd >> 16) & 0xff), s[2] -= ((csub >> 16) & 0xff);
+            s[3] += ( cadd >> 24),         s[3] -= ( csub >> 24);
+        }
+    }
+
+    // box-filters rows [ib, ie) of a w x h image vertically with a window of
+    // 2r+1 rows. fout receives each output row
+    template <typename fout_t>
+    static bool
+    mcl_blur_vrows (color_t const* src, point1d_t w, point1d_t h, point1d_t r, bool b_clamp,
+      point1d_t ib, point1d_t ie, fout_t fout) noexcept{
+        size_t n = static_cast<size_t>(w) * 4u;
+        mcl_simpletls_ns::mcl_auto_ptr_t<unsigned> acc (n);
+        mcl_simpletls_ns::mcl_auto_ptr_t<color_t> row (static_cast<size_t>(w));
+        unsigned* pacc = acc;
+        color_t*  prow = row;
+        if (!pacc || !prow) return false;
+        unsigned long long inv = ((1ull << 32) + static_cast<unsigned long long>(r)) / static_cast<unsigned long long>(2 * r + 1);
+
+        // the first window, in O(min(r, h)) rows. sums of up to 65535 * 255 fit
+        ::memset (pacc, 0, n * sizeof (unsigned));
+        auto fadd = [pacc, w] (color_t const* s, unsigned k) {
+            for (point1d_t x = 0; x != w; ++ x) {
+                pacc[4 * x]     += k * ( s[x]        & 0xff);
+                pacc[4 * x + 1] += k * ((s[x] >> 8)  & 0xff);
+                pacc[4 * x + 2] += k * ((s[x] >> 16) & 0xff);
+                pacc[4 * x + 3] += k * ( s[x] >> 24);
+            }
         };
+        point1d_t y0 = ib - r, y1 = ib + r;
+        if (y0 < 0 && b_clamp) fadd (src, static_cast<unsigned>(-y0));
+        for (point1d_t y = y0 < 0 ? 0 : y0; y <= y1 && y < h; ++ y)
+            fadd (src + y * w, 1u);
+        if (y1 >= h && b_clamp) fadd (src + (h - 1) * w, static_cast<unsigned>(y1 - h + 1));
+
+        color_t const* radd = nullptr, *rsub = nullptr;
+        for (point1d_t y = ib; y != ie; ++ y) {
+            point1d_t x = 0;
+#   ifdef MCL_SSE2
+            __m128i const vinv = _mm_set_epi32 (0, static_cast<int>(inv), 0, static_cast<int>(inv));
+            __m128i const half = _mm_set_epi32 (0, static_cast<int>(0x80000000u), 0, static_cast<int>(0x80000000u));
+            __m128i const hmsk = _mm_set_epi32 (-1, 0, -1, 0);
+            __m128i s, lo, hi;
+            // inv < 2^32 only when the window is not a single row
+            if (r) for (; x != w; ++ x) {
+                s  = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(pacc + 4 * x));
+                lo = _mm_srli_epi64 (_mm_add_epi64 (_mm_mul_epu32 (s, vinv), half), 32);
+                hi = _mm_and_si128 (_mm_add_epi64 (_mm_mul_epu32 (_mm_srli_epi64 (s, 32), vinv), half), hmsk);
+                s  = _mm_or_si128 (lo, hi);
+                s  = _mm_packs_epi32 (s, s);
+                prow[x] = static_cast<color_t>(_mm_cvtsi128_si32 (_mm_packus_epi16 (s, s)));
+            }
+#   endif
+            for (; x != w; ++ x) {
+                unsigned long long s4[4] = { pacc[4 * x], pacc[4 * x + 1], pacc[4 * x + 2], pacc[4 * x + 3] };
+                prow[x] = mcl_blur_div (s4, inv);
+            }
+            fout (y, static_cast<color_t const*>(prow));
+
+            // slide the window
+            if (y + 1 == ie) break;
+            point1d_t ya = y + r + 1, ys = y - r;
+            radd = ya < h ? src + ya * w : (b_clamp ? src + (h - 1) * w : nullptr);
+            rsub = ys >= 0 ? src + ys * w : (b_clamp ? src : nullptr);
+            if (radd == rsub) continue;
+            for (x = 0; x != w; ++ x) {
+                color_t ca = radd ? radd[x] : 0, cs = rsub ? rsub[x] : 0;
+                pacc[4 * x]     += ( ca        & 0xff) - ( cs        & 0xff);
+                pacc[4 * x + 1] += ((ca >> 8)  & 0xff) - ((cs >> 8)  & 0xff);
+                pacc[4 * x + 2] += ((ca >> 16) & 0xff) - ((cs >> 16) & 0xff);
+                pacc[4 * x + 3] += ( ca >> 24)         - ( cs >> 24);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @function mcl_blur <src/transform.cpp>
+     * @brief blurs surface into dest with box filters of the given radii,
+     *     first along rows then along columns. dest may be surface.
+     * @return bool
+     */
+    static bool
+    mcl_blur (surface_t& dest, surface_t const& surface, point1d_t const* radii,
+      int passes, bool b_clamp, wchar_t const* name) noexcept{
+        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        char*           data     = mcl_get_surface_data (&const_cast<surface_t&>(surface));
+        mcl_imagebuf_t* res_dataplus = mcl_get_surface_dataplus (&dest);
+        char*           res_data     = mcl_get_surface_data (&dest);
+        if (!dataplus || !res_dataplus) return false;
+
+        // lock both in address order, as scalenx does. dest may be surface,
+        // whose lock is then taken once
+        mcl_simpletls_ns::mcl_spinlock_t::lock_t lk_none = 0ul;
+        bool b_src_first = std::less<mcl_imagebuf_t*>() (dataplus, res_dataplus);
+        mcl_simpletls_ns::mcl_spinlock_t lk1((b_src_first ? dataplus : res_dataplus) -> m_nrtlock, name);
+        mcl_simpletls_ns::mcl_spinlock_t lk2(res_dataplus == dataplus ? lk_none
+            : (b_src_first ? res_dataplus : dataplus) -> m_nrtlock, name);
+        point1d_t w = dataplus -> m_width, h = dataplus -> m_height;
+        if (!w || res_dataplus -> m_width != w || res_dataplus -> m_height != h)
+            return false;
         
-        // map direction
-        color_t *src = dataplus -> m_pbuffer;
-        color_t *srce = src + (dataplus -> m_height - 1) * dataplus -> m_width;
-        color_t *dst0 = res_dataplus -> m_pbuffer;
-        color_t *dst1 = dst0 + res_dataplus -> m_width;
-        color_t *dst2 = dst0;
-
-        // too small
-        if (dataplus -> m_width <= 2 || dataplus -> m_height <= 2) {
-            dst2 += res_dataplus -> m_height * res_dataplus -> m_width;
-            while (dst0 != dst2)
-                *dst0 = 0xff000000, ++ dst0;
-            return res;
+        // copy alpha info
+        res_dataplus -> touch ();
+        if (res_dataplus != dataplus) {
+            res_data[0] = data[0];
+            res_dataplus -> m_colorkey = dataplus -> m_colorkey;
+            res_dataplus -> m_alpha = dataplus -> m_alpha;
+        }
+        bool    b_sa = data[0] & surface_t::SrcAlpha;
+        bool    b_ck = data[0] & surface_t::SrcColorKey;
+        color_t m_ck = dataplus -> m_colorkey;
+        color_t* src = dataplus -> m_pbuffer;
+        color_t* dst = res_dataplus -> m_pbuffer;
+        size_t  work = static_cast<size_t>(w) * static_cast<size_t>(h);
+
+        // premultiplied working images. colorkey pixels are transparent
+        mcl_simpletls_ns::mcl_auto_ptr_t<color_t> bufa (work), bufb (work);
+        color_t* pa = bufa, *pb = bufb;
+        if (!pa || !pb) return false;
+        // cleared by any band that fails, from any thread
+        LONG volatile b_ok = 1;
+        mcl_parallel_obj.run (h, work, [=, &b_ok] (point1d_t ib, point1d_t ie) {
+            mcl_simpletls_ns::mcl_auto_ptr_t<color_t> row (static_cast<size_t>(w) * 2u);
+            color_t* r1 = row, *r2 = r1 + w;
+            if (!r1) { ::InterlockedExchange (&b_ok, 0); return ; }
+            color_t c = 0, a = 0;
+            for (point1d_t y = ib; y != ie; ++ y) {
+                color_t const* s = src + y * w;
+                for (point1d_t x = 0; x != w; ++ x) {
+                    c = s[x];
+                    if (b_sa) {
+                        a = c >> 24;
+                        c = a << 24 | mcl_conv_premul (c >> 16, a) << 16
+                            | mcl_conv_premul (c >> 8, a) << 8 | mcl_conv_premul (c, a);
+                    } else if (b_ck)
+                        c = (c & 0xffffff) == m_ck ? 0 : (c | 0xff000000);
+                    r1[x] = c;
+                }
+                for (int p = 0; p != passes; ++ p) {
+                    mcl_blur_hrow (p + 1 == passes ? pa + y * w : r2, r1, w, radii[p], b_clamp);
+                    color_t* t = r1; r1 = r2, r2 = t;
+                }
+            }
+        });
+        if (!b_ok) return false;
+
+        // vertical passes. the last one writes the result
+        for (int p = 0; p + 1 < passes; ++ p) {
+            mcl_parallel_obj.run (h, work, [=, &b_ok] (point1d_t ib, point1d_t ie) {
+                if (!mcl_blur_vrows (pa, w, h, radii[p], b_clamp, ib, ie,
+                    [=] (point1d_t y, color_t const* row) {
+                        ::memcpy (pb + y * w, row, static_cast<size_t>(w) * sizeof (color_t));
+                    })) ::InterlockedExchange (&b_ok, 0);
+            });
+            color_t* t = pa; pa = pb, pb = t;
         }
+        if (!b_ok) return false;
+        mcl_parallel_obj.run (h, work, [=, &b_ok] (point1d_t ib, point1d_t ie) {
+            if (!mcl_blur_vrows (pa, w, h, radii[passes - 1], b_clamp, ib, ie,
+                [=] (point1d_t y, color_t const* row) {
+                    color_t* d = dst + y * w, a = 0, cr = 0, cg = 0, cb = 0;
+                    color_t const* s = src + y * w;
+                    for (point1d_t x = 0; x != w; ++ x) {
+                        if (!b_sa && !b_ck) {
+                            d[x] = (s[x] & 0xff000000) | (row[x] & 0xffffff);
+                            continue;
+                        }
+                        // unpremultiply. colorkey pixels less than half covered stay transparent
+                        a = row[x] >> 24;
+                        if (b_ck && a < 128) { d[x] = m_ck; continue; }
+                        if (!a) { d[x] = 0; continue; }
+                        cr = (row[x] >> 16) & 0xff, cg = (row[x] >> 8) & 0xff, cb = row[x] & 0xff;
+                        cr = cr >= a ? 255 : (cr * 255 + (a >> 1)) / a;
+                        cg = cg >= a ? 255 : (cg * 255 + (a >> 1)) / a;
+                        cb = cb >= a ? 255 : (cb * 255 + (a >> 1)) / a;
+                        d[x] = (b_sa ? a << 24 : 0xff000000) | cr << 16 | cg << 8 | cb;
+                        if (b_ck && (d[x] & 0xffffff) == m_ck) d[x] ^= 1;
+                    }
+                })) ::InterlockedExchange (&b_ok, 0);
+        });
+        return b_ok != 0;
+    }
+
+    /**
+     * @function mcl_transform_t::box_blur <src/transform.cpp>
+     * @brief blurs a surface using box blur. the cost does not depend on radius
+     * @param[in] surface
+     * @param[in] radius: pixels on each side of the box
+     * @param[in] repeat_edge_pixels: clamp edges, or take outside pixels as transparent
+     * @return surface_t
+     */
+    surface_t mcl_transform_t::
+    box_blur (surface_t const& surface, point1d_t radius, bool repeat_edge_pixels) noexcept{
+        surface_t res (surface.get_size (), surface.get_flags ());
+        if (!box_blur (res, surface, radius, repeat_edge_pixels)) return sf_nullptr;
+        return res;
+    }
+
+    /**
+     * @function mcl_transform_t::box_blur <src/transform.cpp>
+     * @brief blurs a surface into dest_surface using box blur
+     * @param[out] dest_surface: the same size as surface. may be surface itself
+     * @param[in] surface
+     * @param[in] radius: pixels on each side of the box
+     * @param[in] repeat_edge_pixels: clamp edges, or take outside pixels as transparent
+     * @return bool
+     */
+    bool mcl_transform_t::
+    box_blur (surface_t& dest_surface, surface_t const& surface, point1d_t radius,
+      bool repeat_edge_pixels) noexcept{
+        if (radius < 0 || radius > 32767) return false;
+        return mcl_blur (dest_surface, surface, &radius, 1, repeat_edge_pixels,
+            L"mcl_transform_t::box_blur");
+    }
 
-        // preload first two rows
-        h1gray (dst2, src, dataplus -> m_width); 
-        src += dataplus -> m_width;
-        dst2 += res_dataplus -> m_width;
-        h1gray (dst2, src, dataplus -> m_width);
-
-        // load and filter remaining rows
-        do {
-            src += dataplus -> m_width;
-            dst2 += res_dataplus -> m_width;
-            h1gray (dst2, src, dataplus -> m_width);
-            h1laplacian (dst0, dst0, dst1, dst2, dataplus -> m_width);
-            dst0 += res_dataplus -> m_width;
-            dst1 += res_dataplus -> m_width;
-        } while (src != srce);
-
-        // grayscale to rgb
-        src  = dst0;
-        srce = res_dataplus -> m_pbuffer;
-        h1clear (dst2, dataplus -> m_width);
-
-        do {
-            src -= dataplus -> m_width;
-            h1copy (dst0, src, dataplus -> m_width);
-            dst0 = src;
-        } while (src != srce);
-
-        h1clear (src, dataplus -> m_width);
+    /**
+     * @function mcl_transform_t::gaussian_blur <src/transform.cpp>
+     * @brief blurs a surface using gaussian blur, approximated with three box blurs
+     * @param[in] surface
+     * @param[in] radius: twice the standard deviation
+     * @param[in] repeat_edge_pixels: clamp edges, or take outside pixels as transparent
+     * @return surface_t
+     */
+    surface_t mcl_transform_t::
+    gaussian_blur (surface_t const& surface, point1d_t radius, bool repeat_edge_pixels) noexcept{
+        surface_t res (surface.get_size (), surface.get_flags ());
+        if (!gaussian_blur (res, surface, radius, repeat_edge_pixels)) return sf_nullptr;
         return res;
     }
 
+    /**
+     * @function mcl_transform_t::gaussian_blur <src/transform.cpp>
+     * @brief blurs a surface into dest_surface using gaussian blur
+     * @param[out] dest_surface: the same size as surface. may be surface itself
+     * @param[in] surface
+     * @param[in] radius: twice the standard deviation
+     * @param[in] repeat_edge_pixels: clamp edges, or take outside pixels as transparent
+     * @return bool
+     */
+    bool mcl_transform_t::
+    gaussian_blur (surface_t& dest_surface, surface_t const& surface, point1d_t radius,
+      bool repeat_edge_pixels) noexcept{
+        if (radius < 0 || radius > 32767) return false;
+
+        // boxes whose widths wl or wl + 2 give the variance of the gaussian
+        double    sigma = double(radius) / 2.;
+        point1d_t wl = static_cast<point1d_t>(std::sqrt (4. * sigma * sigma + 1.));
+        if (!(wl & 1)) -- wl;
+        double    m = (12. * sigma * sigma - 3. * double(wl * wl) - 12. * double(wl) - 9.)
+                        / (-4. * double(wl) - 4.);
+        point1d_t radii[3] = { 0 };
+        for (int i = 0; i != 3; ++ i)
+            radii[i] = (i < m - .5 ? wl : wl + 2) >> 1;
+        return mcl_blur (dest_surface, surface, radii, 3, repeat_edge_pixels,
+            L"mcl_transform_t::gaussian_blur");
+    }
+
     /**
      * @function mcl_transform_t::average_color <src/transform.cpp>
      * @brief finds the average color of a surface
@@ -1064,51 +2112,550 @@ mcl {
      */
     surface_t mcl_transform_t::
     grayscale (surface_t const& surface) noexcept{
+        surface_t res (surface.get_size (), surface.get_flags ());
+        if (!grayscale (res, surface)) return sf_nullptr;
+        return res;
+    }
+
+    /**
+     * @function mcl_transform_t::grayscale <src/transform.cpp>
+     * @brief grayscale a surface into dest_surface
+     * @param[out] dest_surface: the same size as surface. may be surface itself
+     * @param[in] surface
+     * @return bool
+     */
+    bool mcl_transform_t::
+    grayscale (surface_t& dest_surface, surface_t const& surface) noexcept{
         mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
-        if (!dataplus) return sf_nullptr;
+        char*           data     = mcl_get_surface_data (&const_cast<surface_t&>(surface));
+        mcl_imagebuf_t* res_dataplus = mcl_get_surface_dataplus (&dest_surface);
+        char*           res_data     = mcl_get_surface_data (&dest_surface);
+        if (!dataplus || !res_dataplus) return false;
         
+        // lock both in address order, and only once if they are the same
+        mcl_simpletls_ns::mcl_spinlock_t::lock_t lk_none = 0ul;
+        bool b_src_first = std::less<mcl_imagebuf_t*>() (dataplus, res_dataplus);
+        mcl_simpletls_ns::mcl_spinlock_t lk1((b_src_first ? dataplus : res_dataplus) -> m_nrtlock,
+            L"mcl_transform_t::grayscale");
+        mcl_simpletls_ns::mcl_spinlock_t lk2(res_dataplus == dataplus ? lk_none
+            : (b_src_first ? res_dataplus : dataplus) -> m_nrtlock, L"mcl_transform_t::grayscale");
+        point1d_t w = dataplus -> m_width, h = dataplus -> m_height;
+        if (!w || res_dataplus -> m_width != w || res_dataplus -> m_height != h)
+            return false;
+
+        // copy alpha info
+        res_dataplus -> touch ();
+        if (res_dataplus != dataplus) {
+            res_data[0] = data[0];
+            res_dataplus -> m_colorkey = dataplus -> m_colorkey;
+            res_dataplus -> m_alpha = dataplus -> m_alpha;
+        }
+        bool    b_ck = data[0] & surface_t::SrcColorKey;
+        color_t m_ck = dataplus -> m_colorkey;
+
+        // map direction
+        color_t *src0 = dataplus -> m_pbuffer, *dst0 = res_dataplus -> m_pbuffer;
+        // cleared by any band that fails, from any thread
+        LONG volatile b_ok = 1;
+        mcl_parallel_obj.run (h, static_cast<size_t>(w) * static_cast<size_t>(h),
+        [=, &b_ok] (point1d_t ib, point1d_t ie) {
+            if (!b_ck) {
+                // gray keeps the alpha channel
+                mcl_luma_row (dst0 + ib * w, src0 + ib * w, (ie - ib) * w, 0xff000000);
+                return ;
+            }
+            // colorkey pixels stay, and gray pixels must not become the colorkey
+            mcl_simpletls_ns::mcl_auto_ptr_t<color_t> row (static_cast<size_t>(w));
+            color_t* g = row;
+            if (!g) { ::InterlockedExchange (&b_ok, 0); return ; }
+            color_t c = 0;
+            for (point1d_t y = ib; y != ie; ++ y) {
+                color_t const* src = src0 + y * w;
+                color_t*       dst = dst0 + y * w;
+                mcl_luma_row (g, src, w, 0);
+                for (point1d_t x = 0; x != w; ++ x) {
+                    if ((src[x] & 0xffffff) == m_ck) { dst[x] = m_ck; continue; }
+                    c = g[x];
+                    if (c == m_ck) c = (c & 0xff) == 0xff ? 0xfefefe : c + 0x10101;
+                    dst[x] = c;
+                }
+            }
+        });
+        return b_ok != 0;
+    }
+    
+    // the tables of transform.apply_lut, shifted into place
+    struct mcl_lut_t {
+        color_t t[4][256]; // b, g, r, a
+    };
+
+    /**
+     * @function mcl_lut_rows <cpp/transform.cpp>
+     * @brief remaps h rows of w pixels. dst may be src. colorkey pixels
+     *     stay, and other pixels never become the colorkey
+     * @return void
+     */
+    static void
+    mcl_lut_rows (color_t* dst0, point1d_t dpitch, color_t const* src0, point1d_t spitch,
+      point1d_t w, point1d_t h, mcl_lut_t const* lt, bool b_ck, color_t m_ck) noexcept{
+        mcl_parallel_obj.run (h, static_cast<size_t>(w) * static_cast<size_t>(h),
+        [=] (point1d_t ib, point1d_t ie) {
+            color_t const *tb = lt -> t[0], *tg = lt -> t[1], *tr = lt -> t[2], *ta = lt -> t[3];
+            color_t c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+            for (point1d_t y = ib; y != ie; ++ y) {
+                color_t const* src = src0 + y * spitch;
+                color_t*       dst = dst0 + y * dpitch;
+                if (b_ck) {
+                    for (point1d_t x = 0; x != w; ++ x) {
+                        c0 = src[x];
+                        if ((c0 & 0xffffff) == m_ck) continue;
+                        c0 = ta[c0 >> 24] | tr[(c0 >> 16) & 0xff] | tg[(c0 >> 8) & 0xff] | tb[c0 & 0xff];
+                        dst[x] = (c0 & 0xffffff) == m_ck ? c0 ^ 1 : c0;
+                    }
+                    continue;
+                }
+                // four independent pixels per step
+                point1d_t x = 0;
+                for (point1d_t n = w >> 2; n; -- n, x += 4) {
+                    c0 = src[x], c1 = src[x + 1], c2 = src[x + 2], c3 = src[x + 3];
+                    dst[x]     = ta[c0 >> 24] | tr[(c0 >> 16) & 0xff] | tg[(c0 >> 8) & 0xff] | tb[c0 & 0xff];
+                    dst[x + 1] = ta[c1 >> 24] | tr[(c1 >> 16) & 0xff] | tg[(c1 >> 8) & 0xff] | tb[c1 & 0xff];
+                    dst[x + 2] = ta[c2 >> 24] | tr[(c2 >> 16) & 0xff] | tg[(c2 >> 8) & 0xff] | tb[c2 & 0xff];
+                    dst[x + 3] = ta[c3 >> 24] | tr[(c3 >> 16) & 0xff] | tg[(c3 >> 8) & 0xff] | tb[c3 & 0xff];
+                }
+                for (; x != w; ++ x) {
+                    c0 = src[x];
+                    dst[x] = ta[c0 >> 24] | tr[(c0 >> 16) & 0xff] | tg[(c0 >> 8) & 0xff] | tb[c0 & 0xff];
+                }
+            }
+        });
+    }
+
+    // builds mcl_lut_t. false if every table is missing or the identity
+    static bool
+    mcl_lut_build (mcl_lut_t& lt, unsigned char const* lut_b, unsigned char const* lut_g,
+      unsigned char const* lut_r, unsigned char const* lut_a) noexcept{
+        unsigned char const* luts[4] = { lut_b, lut_g, lut_r, lut_a };
+        bool b_any = false;
+        for (int k = 0; k != 4; ++ k)
+            for (color_t i = 0; i != 256; ++ i) {
+                color_t v = luts[k] ? luts[k][i] : i;
+                if (v != i) b_any = true;
+                lt.t[k][i] = v << (k * 8);
+            }
+        return b_any;
+    }
+
+    /**
+     * @function mcl_transform_t::apply_lut <src/transform.cpp>
+     * @brief remaps each channel through a 256-entry table
+     * @param[in] surface
+     * @param[in] lut_r: table for red. nullptr leaves the channel as it is
+     * @param[in] lut_g: table for green
+     * @param[in] lut_b: table for blue
+     * @param[in] lut_a: table for alpha
+     * @return surface_t
+     */
+    surface_t mcl_transform_t::
+    apply_lut (surface_t const& surface, unsigned char const* lut_r, unsigned char const* lut_g,
+      unsigned char const* lut_b, unsigned char const* lut_a) noexcept{
+        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        char*           data     = mcl_get_surface_data (&const_cast<surface_t&>(surface));
+        if (!dataplus) return sf_nullptr;
+        mcl_simpletls_ns::mcl_auto_ptr_t<mcl_lut_t> lt (1u);
+        if (!lt) return sf_nullptr;
+        bool b_any = mcl_lut_build (*lt, lut_b, lut_g, lut_r, lut_a);
+
         // lock
-        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::grayscale");
-        char* data = mcl_get_surface_data (&const_cast<surface_t&>(surface));
-        if (!dataplus -> m_width) return sf_nullptr;
-        
+        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::apply_lut");
+        point1d_t w = dataplus -> m_width, h = dataplus -> m_height;
+        if (!w) return sf_nullptr;
+
         // create compatible surface
-        surface_t res ({dataplus -> m_width, dataplus -> m_height}, data[0]);
-        char*           res_data     = mcl_get_surface_data (&res);
+        surface_t res ({ w, h }, data[0]);
         mcl_imagebuf_t* res_dataplus = mcl_get_surface_dataplus (&res);
+        char*           res_data     = mcl_get_surface_data (&res);
         if (!(res_dataplus && res_dataplus -> m_width)) return sf_nullptr;
 
         // copy alpha info
         res_data[0] = data[0];
         res_dataplus -> m_colorkey = dataplus -> m_colorkey;
         res_dataplus -> m_alpha = dataplus -> m_alpha;
-        color_t b_ck = color_t(data[0] & surface_t::SrcColorKey);
-        color_t m_ck = dataplus -> m_colorkey;
+        bool b_ck = data[0] & surface_t::SrcColorKey;
+
+        if (!b_any || b_ck)
+            memcpy (res_dataplus -> m_pbuffer, dataplus -> m_pbuffer,
+                static_cast<size_t>(w) * static_cast<size_t>(h) * sizeof (color_t));
+        if (b_any)
+            mcl_lut_rows (res_dataplus -> m_pbuffer, w, dataplus -> m_pbuffer, w, w, h,
+                lt, b_ck, dataplus -> m_colorkey);
+        return res;
+    }
 
-        // map direction
-        color_t *src = dataplus -> m_pbuffer, *dst = res_dataplus -> m_pbuffer;
-        color_t *se = src + dataplus -> m_height * dataplus -> m_width;
-
-        while (src != se) {
-            *dst = ( ((*src >> 16) & 0xff) * 299 +
-                     ((*src >> 8)  & 0xff) * 587 +
-                     ( *src        & 0xff) * 114 ) / 1000;
-            if (b_ck) {
-                if ((*src & 0xffffff) == m_ck) *dst = m_ck;
-                else {
-                    *dst |= (*dst << 16) | (*dst << 8);
-                    if (*dst == m_ck) {
-                        *dst &= 0xff;
-                        if (*dst == 0xff) *dst = 0xfefefe;
-                        else ++ *dst, *dst |= (*dst << 16) | (*dst << 8);
-                    }
+    /**
+     * @function mcl_transform_t::apply_lut <src/transform.cpp>
+     * @brief remaps each channel of an area of the surface in place
+     * @param[in|out] surface
+     * @param[in] area: clipped to the surface
+     * @param[in] lut_r: table for red. nullptr leaves the channel as it is
+     * @param[in] lut_g: table for green
+     * @param[in] lut_b: table for blue
+     * @param[in] lut_a: table for alpha
+     * @return bool
+     */
+    bool mcl_transform_t::
+    apply_lut (surface_t& surface, rect_t area, unsigned char const* lut_r,
+      unsigned char const* lut_g, unsigned char const* lut_b, unsigned char const* lut_a) noexcept{
+        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&surface);
+        char*           data     = mcl_get_surface_data (&surface);
+        if (!dataplus) return false;
+        if (area.w < 0) area.x += area.w + 1, area.w = -area.w;
+        if (area.h < 0) area.y += area.h + 1, area.h = -area.h;
+        mcl_simpletls_ns::mcl_auto_ptr_t<mcl_lut_t> lt (1u);
+        if (!lt) return false;
+        bool b_any = mcl_lut_build (*lt, lut_b, lut_g, lut_r, lut_a);
+
+        // lock
+        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::apply_lut");
+        point1d_t w = dataplus -> m_width, h = dataplus -> m_height;
+        if (!w) return false;
+
+        // restrict area within the surface
+        point1d_t x0 = area.x > 0 ? area.x : 0, y0 = area.y > 0 ? area.y : 0;
+        point1d_t x1 = area.x + area.w < w ? area.x + area.w : w;
+        point1d_t y1 = area.y + area.h < h ? area.y + area.h : h;
+        if (x0 >= x1 || y0 >= y1 || !b_any) return true;
+
+        dataplus -> touch ();
+        color_t* p = dataplus -> m_pbuffer + y0 * w + x0;
+        mcl_lut_rows (p, w, p, w, x1 - x0, y1 - y0, lt,
+            data[0] & surface_t::SrcColorKey, dataplus -> m_colorkey);
+        return true;
+    }
+
+    // the matrix of transform.color_matrix in fixed-point, in b, g, r, a order
+    struct mcl_cmat_t {
+        short q[4][4];
+        int   off[4]; // with rounding
+        int   bits;
+    };
+
+    // one pixel of transform.color_matrix
+    static inline color_t
+    mcl_cmat_pixel (mcl_cmat_t const& m, color_t c) noexcept{
+        int const in[4] = { int(c & 0xff), int((c >> 8) & 0xff), int((c >> 16) & 0xff), int(c >> 24) };
+        color_t res = 0;
+        for (int k = 0; k != 4; ++ k) {
+            int v = m.off[k] + m.q[k][0] * in[0] + m.q[k][1] * in[1] + m.q[k][2] * in[2] + m.q[k][3] * in[3];
+            v = v < 0 ? 0 : v >> m.bits;
+            res |= color_t(v < 255 ? v : 255) << (k * 8);
+        }
+        return res;
+    }
+
+    /**
+     * @function mcl_cmat_rows <cpp/transform.cpp>
+     * @brief mixes the channels of h rows of w pixels. dst may be src.
+     *     without per-pixel alpha, alpha reads as opaque and is kept.
+     *     colorkey pixels stay, and other pixels never become the colorkey
+     * @return void
+     */
+    static void
+    mcl_cmat_rows (color_t* dst0, point1d_t dpitch, color_t const* src0, point1d_t spitch,
+      point1d_t w, point1d_t h, mcl_cmat_t const* m, bool b_sa, bool b_ck, color_t m_ck) noexcept{
+        mcl_parallel_obj.run (h, static_cast<size_t>(w) * static_cast<size_t>(h),
+        [=] (point1d_t ib, point1d_t ie) {
+            color_t const opaque = b_sa ? 0 : 0xff000000;
+            color_t c = 0, d = 0;
+#   ifdef MCL_SSE2
+            // weights of b and r, then g and a, paired for _mm_madd_epi16
+            __m128i const m16  = _mm_set1_epi32 (0xff00ff);
+            __m128i const vop  = _mm_set1_epi32 (static_cast<int>(opaque));
+            __m128i const sh   = _mm_cvtsi32_si128 (m -> bits);
+            __m128i voff[4], wbr[4], wga[4];
+            for (int k = 0; k != 4; ++ k) {
+                short const pbr[2] = { m -> q[k][0], m -> q[k][2] }, pga[2] = { m -> q[k][1], m -> q[k][3] };
+                voff[k] = _mm_set1_epi32 (m -> off[k]);
+                wbr[k] = mcl_conv_pair (pbr), wga[k] = mcl_conv_pair (pga);
+            }
+#   endif
+            for (point1d_t y = ib; y != ie; ++ y) {
+                color_t const* src = src0 + y * spitch;
+                color_t*       dst = dst0 + y * dpitch;
+                point1d_t x = 0;
+#   ifdef MCL_SSE2
+                if (!b_ck) for (point1d_t n = w >> 2; n; -- n, x += 4) {
+                    __m128i s = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(src + x));
+                    __m128i v = _mm_or_si128 (s, vop);
+                    __m128i br = _mm_and_si128 (v, m16), ga = _mm_and_si128 (_mm_srli_epi32 (v, 8), m16);
+                    __m128i o[4];
+                    for (int k = 0; k != 4; ++ k)
+                        o[k] = _mm_sra_epi32 (_mm_add_epi32 (_mm_add_epi32 (_mm_madd_epi16 (br, wbr[k]),
+                            _mm_madd_epi16 (ga, wga[k])), voff[k]), sh);
+                    // bytes b0-b3, r0-r3, g0-g3, a0-a3, then back into pixels
+                    __m128i r = _mm_packus_epi16 (_mm_packs_epi32 (o[0], o[2]), _mm_packs_epi32 (o[1], o[3]));
+                    r = _mm_unpacklo_epi8 (r, _mm_srli_si128 (r, 8));
+                    r = _mm_unpacklo_epi16 (r, _mm_srli_si128 (r, 8));
+                    if (!b_sa) // keep alpha
+                        r = _mm_or_si128 (_mm_andnot_si128 (vop, r), _mm_and_si128 (vop, s));
+                    _mm_storeu_si128 (reinterpret_cast<__m128i*>(dst + x), r);
+                }
+#   endif
+                for (; x != w; ++ x) {
+                    c = src[x];
+                    if (b_ck && (c & 0xffffff) == m_ck) { dst[x] = c; continue; }
+                    d = mcl_cmat_pixel (*m, c | opaque);
+                    if (!b_sa) d = (d & 0xffffff) | (c & 0xff000000);
+                    if (b_ck && (d & 0xffffff) == m_ck) d ^= 1;
+                    dst[x] = d;
                 }
-            } else *dst |= (*dst << 16) | (*dst << 8) | (*src & 0xff000000);
-            ++ src, ++ dst;
+            }
+        });
+    }
+
+    // builds mcl_cmat_t from 20 floats. 0 for the identity, which needs no
+    // pass, -1 for weights or offsets that are not finite or do not quantize
+    static int
+    mcl_cmat_build (mcl_cmat_t& m, float const* matrix) noexcept{
+        static float const identity[20] = {
+            1.f, 0.f, 0.f, 0.f, 0.f,  0.f, 1.f, 0.f, 0.f, 0.f,
+            0.f, 0.f, 1.f, 0.f, 0.f,  0.f, 0.f, 0.f, 1.f, 0.f };
+        if (!memcmp (matrix, identity, sizeof (identity))) return 0;
+
+        // rows and columns are r, g, b, a. ours are b, g, r, a
+        int const perm[4] = { 2, 1, 0, 3 };
+        float w[16] = { 0.f }, wsum = 0.f;
+        for (int k = 0; k != 4; ++ k)
+            for (int j = 0; j != 4; ++ j) {
+                w[k * 4 + j] = matrix[perm[k] * 5 + perm[j]];
+                wsum += w[k * 4 + j] < 0.f ? -w[k * 4 + j] : w[k * 4 + j];
+            }
+        if (!(wsum < 1e6f)) return -1;
+        // leave room for offsets up to the largest sum plus a channel
+        m.bits = mcl_conv_quantize (&m.q[0][0], w, 16, 640.f);
+        if (m.bits < 0) return -1;
+        float omax = wsum * 255.f + 256.f;
+        for (int k = 0; k != 4; ++ k) {
+            float o = matrix[perm[k] * 5 + 4];
+            o = o > omax ? omax : (o < -omax ? -omax : o);
+            if (o != o) return -1;
+            o *= float(1 << m.bits);
+            m.off[k] = static_cast<int>(o + (o < 0.f ? -.5f : .5f)) + (m.bits ? 1 << (m.bits - 1) : 0);
         }
+        return 1;
+    }
+
+    /**
+     * @function mcl_transform_t::color_matrix <src/transform.cpp>
+     * @brief mixes the channels through a 4x5 matrix. r' = m[0] r + m[1] g
+     *     + m[2] b + m[3] a + m[4], and so on for g', b' and a', where
+     *     channels and offsets are in [0, 255]. without per-pixel alpha,
+     *     a reads as 255 and a' is not written
+     * @param[in] surface
+     * @param[in] matrix: 20 floats, row by row
+     * @return surface_t: sf_nullptr if the matrix is not finite
+     */
+    surface_t mcl_transform_t::
+    color_matrix (surface_t const& surface, float const* matrix) noexcept{
+        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        char*           data     = mcl_get_surface_data (&const_cast<surface_t&>(surface));
+        if (!(dataplus && matrix)) return sf_nullptr;
+        mcl_cmat_t m;
+        int kind = mcl_cmat_build (m, matrix);
+        if (kind < 0) return sf_nullptr;
+
+        // lock
+        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::color_matrix");
+        point1d_t w = dataplus -> m_width, h = dataplus -> m_height;
+        if (!w) return sf_nullptr;
+
+        // create compatible surface
+        surface_t res ({ w, h }, data[0]);
+        mcl_imagebuf_t* res_dataplus = mcl_get_surface_dataplus (&res);
+        char*           res_data     = mcl_get_surface_data (&res);
+        if (!(res_dataplus && res_dataplus -> m_width)) return sf_nullptr;
+
+        // copy alpha info
+        res_data[0] = data[0];
+        res_dataplus -> m_colorkey = dataplus -> m_colorkey;
+        res_dataplus -> m_alpha = dataplus -> m_alpha;
+
+        if (!kind)
+            memcpy (res_dataplus -> m_pbuffer, dataplus -> m_pbuffer,
+                static_cast<size_t>(w) * static_cast<size_t>(h) * sizeof (color_t));
+        else
+            mcl_cmat_rows (res_dataplus -> m_pbuffer, w, dataplus -> m_pbuffer, w, w, h, &m,
+                data[0] & surface_t::SrcAlpha, data[0] & surface_t::SrcColorKey, dataplus -> m_colorkey);
         return res;
     }
-    
+
+    /**
+     * @function mcl_transform_t::color_matrix <src/transform.cpp>
+     * @brief mixes the channels of an area of the surface in place
+     * @param[in|out] surface
+     * @param[in] area: clipped to the surface
+     * @param[in] matrix: 20 floats, row by row
+     * @return bool: false if the matrix is not finite
+     */
+    bool mcl_transform_t::
+    color_matrix (surface_t& surface, rect_t area, float const* matrix) noexcept{
+        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&surface);
+        char*           data     = mcl_get_surface_data (&surface);
+        if (!(dataplus && matrix)) return false;
+        if (area.w < 0) area.x += area.w + 1, area.w = -area.w;
+        if (area.h < 0) area.y += area.h + 1, area.h = -area.h;
+        mcl_cmat_t m;
+        int kind = mcl_cmat_build (m, matrix);
+        if (kind < 0) return false;
+
+        // lock
+        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::color_matrix");
+        point1d_t w = dataplus -> m_width, h = dataplus -> m_height;
+        if (!w) return false;
+
+        // restrict area within the surface
+        point1d_t x0 = area.x > 0 ? area.x : 0, y0 = area.y > 0 ? area.y : 0;
+        point1d_t x1 = area.x + area.w < w ? area.x + area.w : w;
+        point1d_t y1 = area.y + area.h < h ? area.y + area.h : h;
+        if (x0 >= x1 || y0 >= y1 || !kind) return true;
+
+        dataplus -> touch ();
+        color_t* p = dataplus -> m_pbuffer + y0 * w + x0;
+        mcl_cmat_rows (p, w, p, w, x1 - x0, y1 - y0, &m, data[0] & surface_t::SrcAlpha,
+            data[0] & surface_t::SrcColorKey, dataplus -> m_colorkey);
+        return true;
+    }
+
+    // maps a color to what transform.threshold compares or copies.
+    // 0: as is, 1: replace alpha (colorkey pixels become key_to), 2: scale alpha
+    struct mcl_thresh_norm_t {
+        int     mode;
+        bool    b_ck;
+        color_t m_ck, m_alpha, key_to;
+    };
+
+    // parameters of transform.threshold
+    struct mcl_thresh_t {
+        mcl_thresh_norm_t src, srch, blit;
+        color_t mn, mx, thr; // range of search_color, threshold for search_surf
+        color_t set_color;
+        bool    inverse_set;
+    };
+
+    static inline color_t
+    mcl_thresh_norm (mcl_thresh_norm_t const& nm, color_t c) noexcept{
+        if (nm.mode == 1) {
+            c &= 0xffffff;
+            return (nm.b_ck && c == nm.m_ck) ? nm.key_to : (c | nm.m_alpha);
+        }
+        if (nm.mode == 2)
+            return (c & 0xffffff) | ((c >> 24) * (nm.m_alpha >> 24) / 255) << 24;
+        return c;
+    }
+
+    // whether each channel of c is in [mn, mx]
+    static inline bool
+    mcl_thresh_in (color_t c, color_t mn, color_t mx) noexcept{
+        for (int s = 0; s != 32; s += 8)
+            if (((c >> s) & 0xff) < ((mn >> s) & 0xff) || ((c >> s) & 0xff) > ((mx >> s) & 0xff))
+                return false;
+        return true;
+    }
+
+    // [color - thr, color + thr], saturated in each channel
+    static inline void
+    mcl_thresh_range (color_t color, color_t thr, color_t& mn, color_t& mx) noexcept{
+        color_t c = 0, t = 0;
+        mn = mx = 0;
+        for (int s = 0; s != 32; s += 8) {
+            c = (color >> s) & 0xff, t = (thr >> s) & 0xff;
+            mn |= (c >= t ? c - t : 0) << s;
+            mx |= (c + t > 255 ? 255 : c + t) << s;
+        }
+    }
+
+#   ifdef MCL_SSE2
+    static inline __m128i
+    mcl_thresh_norm (mcl_thresh_norm_t const& nm, __m128i v) noexcept{
+        __m128i const rgb = _mm_set1_epi32 (0xffffff);
+        if (nm.mode == 1) {
+            v = _mm_and_si128 (v, rgb);
+            __m128i a = _mm_or_si128 (v, _mm_set1_epi32 (static_cast<int>(nm.m_alpha)));
+            if (!nm.b_ck) return a;
+            __m128i key = _mm_cmpeq_epi32 (v, _mm_set1_epi32 (static_cast<int>(nm.m_ck)));
+            return _mm_or_si128 (_mm_andnot_si128 (key, a),
+                _mm_and_si128 (key, _mm_set1_epi32 (static_cast<int>(nm.key_to))));
+        }
+        if (nm.mode == 2) {
+            // a * alpha / 255 as (x + 1 + (x >> 8)) >> 8, exact for x < 65536
+            __m128i x = _mm_mullo_epi16 (_mm_srli_epi32 (v, 24),
+                _mm_set1_epi32 (static_cast<int>(nm.m_alpha >> 24)));
+            x = _mm_srli_epi32 (_mm_add_epi32 (_mm_add_epi32 (x, _mm_set1_epi32 (1)), _mm_srli_epi32 (x, 8)), 8);
+            return _mm_or_si128 (_mm_and_si128 (v, rgb), _mm_slli_epi32 (x, 24));
+        }
+        return v;
+    }
+#   endif
+
+    /**
+     * @function mcl_thresh_row <src/transform.cpp>
+     * @brief tests count pixels of src against the range and sets those of dst
+     *     as set_behavior says. counts pixels only if behavior is 0.
+     * @return LONGLONG: pixels in range
+     */
+    template <int behavior, bool b_search>
+    static LONGLONG
+    mcl_thresh_row (mcl_thresh_t const& th, color_t* dst, color_t const* src,
+      color_t const* sch, point1d_t count) noexcept{
+        LONGLONG  n = 0;
+        point1d_t j = 0;
+        color_t   mn = th.mn, mx = th.mx;
+#   ifdef MCL_SSE2
+        __m128i const ones = _mm_set1_epi32 (-1);
+        __m128i const vthr = _mm_set1_epi32 (static_cast<int>(th.thr));
+        __m128i const vset = _mm_set1_epi32 (static_cast<int>(th.set_color));
+        __m128i vmn = _mm_set1_epi32 (static_cast<int>(mn));
+        __m128i vmx = _mm_set1_epi32 (static_cast<int>(mx));
+        __m128i raw, v, s, hit, sel;
+        int     nhit = 0;
+        for (; count - j >= 4; j += 4) {
+            raw = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(src + j));
+            v = mcl_thresh_norm (th.src, raw);
+            if (b_search) {
+                s = mcl_thresh_norm (th.srch, _mm_loadu_si128 (reinterpret_cast<__m128i const*>(sch + j)));
+                vmn = _mm_subs_epu8 (s, vthr);
+                vmx = _mm_adds_epu8 (s, vthr);
+            }
+            // all four channels in range
+            hit = _mm_and_si128 (_mm_cmpeq_epi8 (_mm_max_epu8 (v, vmn), v),
+                _mm_cmpeq_epi8 (_mm_min_epu8 (v, vmx), v));
+            hit = _mm_cmpeq_epi32 (hit, ones);
+            nhit = _mm_movemask_ps (_mm_castsi128_ps (hit));
+            nhit = (nhit & 5) + ((nhit >> 1) & 5);
+            n += (nhit & 3) + (nhit >> 2);
+            if (!behavior) continue;
+
+            // pixels to set
+            sel = th.inverse_set ? hit : _mm_xor_si128 (hit, ones);
+            if (!_mm_movemask_epi8 (sel)) continue;
+            v = behavior == 1 ? vset : mcl_thresh_norm (th.blit, raw);
+            s = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(dst + j));
+            _mm_storeu_si128 (reinterpret_cast<__m128i*>(dst + j),
+                _mm_or_si128 (_mm_and_si128 (sel, v), _mm_andnot_si128 (sel, s)));
+        }
+#   endif
+        bool fc = false;
+        for (; j != count; ++ j) {
+            if (b_search)
+                mcl_thresh_range (mcl_thresh_norm (th.srch, sch[j]), th.thr, mn, mx);
+            fc = mcl_thresh_in (mcl_thresh_norm (th.src, src[j]), mn, mx);
+            if (fc) ++ n;
+            if (!behavior || fc != th.inverse_set) continue;
+            dst[j] = behavior == 1 ? th.set_color : mcl_thresh_norm (th.blit, src[j]);
+        }
+        return n;
+    }
+
     /**
      * @function mcl_transform_t::threshold <src/transform.cpp>
      * @brief finds which, and how many pixels in a surface are within
@@ -1122,203 +2669,478 @@ mcl {
         char*           data     = mcl_get_surface_data (&const_cast<surface_t&>(surf));
         mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surf));
         if (!dataplus) return 0;
+        if (set_behavior < 0 || set_behavior > 2) return 0; // unknown behavior
         mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"mcl_transform_t::threshold");
         if (!dataplus -> m_width) return 0;
 
         // alpha info of src
-        color_t b_sa = color_t(data[0] & surface_t::SrcAlpha);
-        color_t b_ck = color_t(data[0] & surface_t::SrcColorKey);
+        bool    b_sa = data[0] & surface_t::SrcAlpha;
+        bool    b_ck = data[0] & surface_t::SrcColorKey;
         color_t m_ck = dataplus -> m_colorkey;
         color_t m_alpha = dataplus -> m_alpha << 24;
 
         // search_surf
         surface_t* sf_srch = reinterpret_cast<surface_t*>(const_cast<void*>(search_surf));
         mcl_imagebuf_t* srch_dataplus = sf_srch ? mcl_get_surface_dataplus(sf_srch) : 0;
+        if (sf_srch && (!srch_dataplus || !srch_dataplus -> m_width)) return 0;
 
         // dest_surf
         surface_t* sf_dst = reinterpret_cast<surface_t*>(dest_surf);
         mcl_imagebuf_t* dst_dataplus = sf_dst ? mcl_get_surface_dataplus(sf_dst) : 0;
         bool b_dst_na = (!dst_dataplus || !dst_dataplus -> m_width);
         if (set_behavior != 0 && b_dst_na) return 0;
-        // if (set_behavior == 0 && !b_dst_na) return 0;
-
-        // calc rgba ranges & test if in range
-        color_t ta =  nthreshold >> 24;
-        color_t tr = (nthreshold >> 16) & 0xff;
-        color_t tg = (nthreshold >> 8)  & 0xff;
-        color_t tb =  nthreshold        & 0xff;
-        color_t mina = 0, minr = 0, ming = 0, minb = 0;
-        color_t maxa = 0, maxr = 0, maxg = 0, maxb = 0;
-        auto fcalc = [&mina, &minr, &ming, &minb, &maxa, &maxr, &maxg, &maxb, ta, tr, tg, tb]
-        (color_t color) {
-            mina =  color >> 24;
-            minr = (color >> 16) & 0xff;
-            ming = (color >> 8)  & 0xff;
-            minb =  color        & 0xff;
-            maxa = mina + ta; if (maxa > 255) maxa = 255;
-            maxr = minr + tr; if (maxr > 255) maxr = 255;
-            maxg = ming + tg; if (maxg > 255) maxg = 255;
-            maxb = minb + tb; if (maxb > 255) maxb = 255;
-            mina = (mina >= ta ? mina - ta : 0);
-            minr = (minr >= tr ? minr - tr : 0);
-            ming = (ming >= tg ? ming - tg : 0);
-            minb = (minb >= tb ? minb - tb : 0);
-        };
-        auto fck = [&mina, &minr, &ming, &minb, &maxa, &maxr, &maxg, &maxb, b_ck, m_ck, b_sa, m_alpha]
-        (color_t color) -> bool {
-            if (!b_sa) {
-                color &= 0xffffff;
-                if (!b_ck || color != m_ck) color |= m_alpha;
-            } else if (m_alpha != 0xff000000) {
-                color = (color & 0xffffff) | ((color >> 24) * (m_alpha >> 24) / 255) << 24;
-            }
-            color_t a =  color >> 24;
-            color_t r = (color >> 16) & 0xff;
-            color_t g = (color >> 8)  & 0xff;
-            color_t b =  color        & 0xff;
-            return (a >= mina && a <= maxa && r >= minr && r <= maxr
-                 && g >= ming && g <= maxg && b >= minb && b <= maxb);
-        };
-        
-        // switch function behavior
-        size_t cnt = 0;
-        std::function<void(color_t&, color_t)> fblit;
-        std::function<void(color_t*, color_t*)> fcnt;
-        if (set_behavior == 0) {
-            // we do not change 'dest_surf', just count
-            fcnt = [&fck, &cnt]
-            (color_t*, color_t* src) {
-                if (fck(*src)) ++ cnt;
-            };
-        } else if (set_behavior == 1) {
-            // pixels in dest_surface will be changed to 'set_color'
-            color_t bis = color_t(inverse_set);
-            fcnt = [&fck, &cnt, bis, set_color]
-            (color_t* dst, color_t* src) {
-                bool fc = fck(*src), fis = bool(bis);
-                if (dst && fc == fis) *dst = set_color;
-                if (fc) ++ cnt;
-            };
-        } else if (set_behavior == 2) {
+
+        // colors of surf are compared with their alpha applied:
+        // alpha of colorkey pixels is 0
+        mcl_thresh_t th;
+        th.src.b_ck    = b_ck && !b_sa;
+        th.src.m_ck    = m_ck;
+        th.src.m_alpha = m_alpha;
+        th.src.key_to  = m_ck;
+        th.src.mode    = !b_sa ? 1 : (m_alpha != 0xff000000 ? 2 : 0);
+        th.thr         = nthreshold;
+        th.set_color   = set_color;
+        th.inverse_set = inverse_set;
+        mcl_thresh_range (search_color, nthreshold, th.mn, th.mx);
+        th.srch = th.blit = th.src;
+
+        if (set_behavior == 2) {
             // pixels set in 'dest_surf' will be from 'surf'
-            // so we need to switch blit functions
+            // so we need to convert them to its format
             char* dst_data = mcl_get_surface_data(sf_dst);
             bool dst_sa = dst_data[0] & surface_t::SrcAlpha;
-            color_t dst_ctrans = dst_sa ? 0 : (
+            th.blit.b_ck   = b_ck;
+            th.blit.key_to = dst_sa ? 0 : (
             (dst_data[0] & surface_t::SrcColorKey) ? 0xffffff |
                 dst_dataplus -> m_colorkey : (dst_dataplus -> m_pbuffer[0] & 0xffffff)
             );
-            if (b_ck) {
-                fblit = [m_ck, dst_ctrans, m_alpha](color_t& dst, color_t src)
-                { dst = ((src &= 0xffffff) == m_ck ? dst_ctrans : src | m_alpha); };
-            } else if (dst_sa && !b_sa) {
-                if (m_alpha == 0xff000000)
-                    fblit = [](color_t& dst, color_t src) { dst = src | 0xff000000; };
-                else
-                    fblit = [m_alpha](color_t& dst, color_t src) { dst = (src & 0xffffff) | m_alpha; };
-            } else if (dst_sa && b_sa && m_alpha != 0xff000000) {
-                fblit = [m_alpha](color_t& dst, color_t src) {
-                    dst = ((src >> 24) * (m_alpha >> 24) / 255) << 24;
-                    dst |= src & 0xffffff;
-                };
-            } else fblit = [](color_t& dst, color_t src) { dst = src; };
-
-            // then blit
-            long long bis = static_cast<long long>(inverse_set);
-            fcnt = [&fck, &fblit, &cnt, bis]
-            (color_t* dst, color_t* src) {
-                bool fc = fck(*src), fis = bool(bis);
-                if (dst && fc == fis) fblit(*dst, *src);
-                if (fc) ++ cnt;
-            };
-        } else {
-            // unknown behavior
-            return 0;
+            if (b_ck || (dst_sa && !b_sa))
+                th.blit.mode = 1;
+            else if (dst_sa && b_sa && m_alpha != 0xff000000)
+                th.blit.mode = 2;
+            else th.blit.mode = 0;
         }
         
         // map direction
-        color_t *src = dataplus -> m_pbuffer, *dst = 0, *ld = 0;
-        point1d_t i = 0, j = 0;
+        // pixels of 'surf' in [0, sw) x [0, sh) are counted,
+        // and those also in [0, dw) x [0, dh) may be set in 'dest_surf'
         point1d_t sw = dataplus -> m_width, sh = dataplus -> m_height;
-        point1d_t lw = 0, lh = 0;
+        point1d_t dw = 0, dh = 0;
+        color_t *dst0 = 0, *sch0 = 0;
         if (set_behavior) {
-            dst = dst_dataplus -> m_pbuffer;
-            if (sw > dst_dataplus -> m_width)
-                lw = sw - dst_dataplus -> m_width,  sw = dst_dataplus -> m_width;
-            if (sh > dst_dataplus -> m_height)
-                lh = sh - dst_dataplus -> m_height, sh = dst_dataplus -> m_height;
-        }
-
-        // do not use search_surf
-        if (!sf_srch) {
-            // start bliting
-            fcalc (search_color);
-            for (i = sh; i; -- i, dst = ld) {
-                if (set_behavior) ld = dst + dst_dataplus -> m_width;
-                for (j = sw; j; -- j, ++ src) fcnt (dst ++, src);
-                for (j = lw; j; -- j, ++ src) fcnt (0, src);
-            }
-            // out of dst. only count
-            for (i = lh * dataplus -> m_width; i; -- i, ++ src)
-                fcnt (0, src);
-            return cnt;
+            dst0 = dst_dataplus -> m_pbuffer;
+            dw = sw < dst_dataplus -> m_width  ? sw : dst_dataplus -> m_width;
+            dh = sh < dst_dataplus -> m_height ? sh : dst_dataplus -> m_height;
         }
 
         // use search_surf
         // get rgba from search_surf
-        if (!srch_dataplus || !srch_dataplus -> m_width) return 0;
-        std::function<color_t(color_t)> fcalc_color;
-        char* srch_data = mcl_get_surface_data(sf_srch);
-        color_t srch_b_sa = color_t(srch_data[0] & surface_t::SrcAlpha);
-        color_t srch_b_ck = color_t(srch_data[0] & surface_t::SrcColorKey);
-        color_t srch_m_ck = srch_dataplus -> m_colorkey;
-        color_t srch_m_alpha = srch_dataplus -> m_alpha << 24;
-        if (srch_b_ck) {
-            fcalc_color = [srch_m_ck, srch_m_alpha]
-            (color_t color) -> color_t {
-                return (color &= 0xffffff) == srch_m_ck ? color : color | srch_m_alpha;
-            };
-        } else if (!srch_b_sa) {
-            fcalc_color = [srch_m_alpha]
-            (color_t color) -> color_t {
-                return (color & 0xffffff) | srch_m_alpha;
-            };
-        } else if (srch_m_alpha != 0xff000000) {
-            fcalc_color = [srch_m_alpha]
-            (color_t color) -> color_t {
-                return (color & 0xffffff) | ((color >> 24) * (srch_m_alpha >> 24) / 255) << 24;
-            };
-        } else {
-            fcalc_color = []
-            (color_t color) -> color_t {
-                return color;
-            };
+        if (sf_srch) {
+            char* srch_data = mcl_get_surface_data(sf_srch);
+            bool    srch_b_sa = srch_data[0] & surface_t::SrcAlpha;
+            bool    srch_b_ck = srch_data[0] & surface_t::SrcColorKey;
+            color_t srch_m_alpha = srch_dataplus -> m_alpha << 24;
+            th.srch.b_ck    = srch_b_ck;
+            th.srch.m_ck    = srch_dataplus -> m_colorkey;
+            th.srch.m_alpha = srch_m_alpha;
+            th.srch.key_to  = th.srch.m_ck;
+            th.srch.mode    = (srch_b_ck || !srch_b_sa) ? 1 : (srch_m_alpha != 0xff000000 ? 2 : 0);
+            sch0 = srch_dataplus -> m_pbuffer;
+            if (sw > srch_dataplus -> m_width)  sw = srch_dataplus -> m_width;
+            if (sh > srch_dataplus -> m_height) sh = srch_dataplus -> m_height;
+            if (dw > sw) dw = sw;
         }
 
-        color_t *ls = 0, *sch = srch_dataplus -> m_pbuffer, *lsch = 0;
-        if (sh > srch_dataplus -> m_height) sh = srch_dataplus -> m_height;
+        // pick the kernels. pixels out of 'dest_surf' are only counted
+        using frow_t = LONGLONG (*) (mcl_thresh_t const&, color_t*, color_t const*, color_t const*, point1d_t);
+        frow_t fset = 0, fcnt = 0;
+        if (sch0) {
+            fcnt = mcl_thresh_row<0, true>;
+            fset = set_behavior == 1 ? mcl_thresh_row<1, true> : mcl_thresh_row<2, true>;
+        } else {
+            fcnt = mcl_thresh_row<0, false>;
+            fset = set_behavior == 1 ? mcl_thresh_row<1, false> : mcl_thresh_row<2, false>;
+        }
+        
         // start bliting
-        for (i = sh; i; -- i, dst = ld, src = ls, sch = lsch) {
-            if (set_behavior) ld = dst + dst_dataplus -> m_width;
-            ls = src + dataplus -> m_width;
-            lsch = sch + srch_dataplus -> m_width;
-            for (j = sw; j && sch != lsch; -- j, ++ src, ++ sch)
-                fcalc (fcalc_color (*sch)), fcnt (dst ++, src);
-            for (j = lw; j && sch != lsch; -- j, ++ src, ++ sch)
-                fcalc (fcalc_color (*sch)), fcnt (0, src);
+        if (set_behavior) dst_dataplus -> touch ();
+        LONGLONG volatile cnt = 0;
+        mcl_parallel_obj.run (sh, static_cast<size_t>(sw) * static_cast<size_t>(sh),
+        [&] (point1d_t ib, point1d_t ie) {
+            LONGLONG n = 0;
+            for (point1d_t i = ib; i != ie; ++ i) {
+                color_t* src = dataplus -> m_pbuffer + i * dataplus -> m_width;
+                color_t* sch = sch0 ? sch0 + i * srch_dataplus -> m_width : 0;
+                point1d_t j = 0;
+                if (set_behavior && i < dh) {
+                    n += fset (th, dst0 + i * dst_dataplus -> m_width, src, sch, dw);
+                    j = dw;
+                }
+                n += fcnt (th, 0, src + j, sch ? sch + j : 0, sw - j);
+            }
+            ::InterlockedExchangeAdd64 (&cnt, n);
+        });
+        return static_cast<size_t>(cnt);
+    }
+
+    /**
+     * @function mcl_transform_t::set_threads <src/transform.cpp>
+     * @brief sets the threads used by the transforms
+     * @param[in] threads: 0 for one per processor, 1 for serial
+     * @param[in] min_pixels: least output pixels worth splitting into row bands
+     * @return void
+     */
+    void mcl_transform_t::
+    set_threads (unsigned long threads, size_t min_pixels) noexcept{
+        mcl_parallel_obj.threads  = threads;
+        mcl_parallel_obj.min_work = min_pixels;
+    }
+
+    /**
+     * @function mcl_transform_t::get_threads <src/transform.cpp>
+     * @brief gets the number of threads a transform may use
+     * @return unsigned long
+     */
+    unsigned long mcl_transform_t::
+    get_threads () noexcept{
+        return mcl_parallel_obj.get_threads ();
+    }
+
+    /**
+     * @function mcl_transform_t::set_linear <src/transform.cpp>
+     * @brief makes scale, rotozoom and their mip levels weight colors in
+     *     linear light instead of sRGB values. see also blend.Linear
+     * @param[in] b_linear
+     * @return void
+     */
+    void mcl_transform_t::
+    set_linear (bool b_linear) noexcept{
+        mcl_transform_linear = b_linear;
+    }
+
+    /**
+     * @function mcl_transform_t::get_linear <src/transform.cpp>
+     * @brief test if scale and rotozoom work in linear light
+     * @return bool
+     */
+    bool mcl_transform_t::
+    get_linear () noexcept{
+        return mcl_transform_linear;
+    }
+
+    /**
+     * @function mcl_transform_t::set_cache <src/transform.cpp>
+     * @brief keeps results of scale, rotozoom, rotate and the upscalers, and
+     *     returns a copy when the same source (not written since) is
+     *     transformed the same way again
+     * @param[in] max_bytes: pixel bytes the results may use. 0 turns the
+     *     cache off and empties it
+     * @return void
+     */
+    void mcl_transform_t::
+    set_cache (size_t max_bytes) noexcept{
+        mcl_simpletls_ns::mcl_spinlock_t lk(mcl_tcache_obj.m_lock, L"mcl_transform_t::set_cache");
+        mcl_tcache_obj.m_budget = max_bytes;
+        mcl_tcache_obj.shrink (max_bytes);
+    }
+
+    /**
+     * @function mcl_transform_t::get_cache <src/transform.cpp>
+     * @brief gets the statistics of the transform cache
+     * @param[out] hits, misses: lookups since the last clear_cache
+     * @param[out] bytes: pixel bytes used by the results kept
+     * @param[out] entries: the number of results kept
+     * @return size_t: the byte budget. 0 if the cache is off
+     */
+    size_t mcl_transform_t::
+    get_cache (size_t* hits, size_t* misses, size_t* bytes, size_t* entries) noexcept{
+        mcl_simpletls_ns::mcl_spinlock_t lk(mcl_tcache_obj.m_lock, L"mcl_transform_t::get_cache");
+        if (hits)    *hits    = mcl_tcache_obj.m_hits;
+        if (misses)  *misses  = mcl_tcache_obj.m_misses;
+        if (bytes)   *bytes   = mcl_tcache_obj.m_bytes;
+        if (entries) *entries = mcl_tcache_obj.m_index.size ();
+        return mcl_tcache_obj.m_budget;
+    }
+
+    /**
+     * @function mcl_transform_t::clear_cache <src/transform.cpp>
+     * @brief empties the transform cache and resets its statistics
+     * @return void
+     */
+    void mcl_transform_t::
+    clear_cache () noexcept{
+        mcl_simpletls_ns::mcl_spinlock_t lk(mcl_tcache_obj.m_lock, L"mcl_transform_t::clear_cache");
+        mcl_tcache_obj.shrink (0);
+        mcl_tcache_obj.m_hits = mcl_tcache_obj.m_misses = 0;
+    }
+
+    /**
+     * @function mcl_transform_t::average_surfaces <src/transform.cpp>
+     * @brief find the average surface from many surfaces
+     * @param[in] surfaces: array of surfaces with the same size
+     * @param[in] count: number of surfaces
+     * @param[in] palette_colors: average colors rather than raw values
+     * @return surface_t
+     */
+    surface_t mcl_transform_t::
+    average_surfaces (surface_t const* surfaces, size_t count, bool palette_colors) noexcept{
+        if (!surfaces || !count) return sf_nullptr;
+        averager_t avg (palette_colors);
+        for (size_t i = 0; i != count; ++ i)
+            if (!avg.add (surfaces[i])) return sf_nullptr;
+        return avg.get_average ();
+    }
+
+    // accumulators of averager_t
+    struct mcl_avgbuf_t {
+        unsigned short* m_acc16;    // b, g, r, a of each pixel. at most 257 surfaces
+        unsigned long*  m_acc32;    // m_acc16 is folded here when it is full
+        point1d_t       m_width;
+        point1d_t       m_height;
+        size_t          m_count;
+        size_t          m_batch;    // surfaces in m_acc16
+        color_t         m_colorkey; // of the first surface
+        color_t         m_alpha;
+        char            m_flags;
+        bool            m_palette;
+        bool            m_trans;    // any transparent pixel seen
+        char : 8; char : 8; char : 8; char : 8; char : 8;
+    };
+
+    // 255 * 257 is the largest sum a 16-bit channel can hold
+    static size_t constexpr mcl_avg_batch_max = 257u;
+
+    static void
+    mcl_avg_add_row (unsigned short* acc, color_t const* src, point1d_t count,
+      int mode, color_t ck) noexcept{
+        // mode 0: raw, 1: opaque, 2: colorkey, 3: per-pixel alpha
+        point1d_t rest = count;
+#   ifdef MCL_SSE2
+        __m128i const zero = _mm_setzero_si128 ();
+        __m128i const opaque = _mm_set1_epi32 (static_cast<int>(0xff000000));
+        __m128i const rgb = _mm_set1_epi32 (0x00ffffff);
+        __m128i const key = _mm_set1_epi32 (static_cast<int>(ck));
+        __m128i const amask = _mm_set_epi16 (-1, 0, 0, 0, -1, 0, 0, 0);
+        __m128i const c128 = _mm_set1_epi16 (128);
+        __m128i px, lo, hi, alo, ahi;
+        for (; rest >= 4; rest -= 4, src += 4, acc += 16) {
+            px = _mm_loadu_si128 (reinterpret_cast<__m128i const*>(src));
+            if (mode == 1)
+                px = _mm_or_si128 (px, opaque);
+            else if (mode == 2)
+                px = _mm_andnot_si128 (_mm_cmpeq_epi32 (_mm_and_si128 (px, rgb), key),
+                    _mm_or_si128 (px, opaque));
+            lo = _mm_unpacklo_epi8 (px, zero);
+            hi = _mm_unpackhi_epi8 (px, zero);
+            if (mode == 3) {
+                // premultiply, rounding x / 255 as (x + 128 + ((x + 128) >> 8)) >> 8
+                alo = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (lo, 0xff), 0xff);
+                ahi = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (hi, 0xff), 0xff);
+                alo = _mm_add_epi16 (_mm_mullo_epi16 (lo, alo), c128);
+                ahi = _mm_add_epi16 (_mm_mullo_epi16 (hi, ahi), c128);
+                alo = _mm_srli_epi16 (_mm_add_epi16 (alo, _mm_srli_epi16 (alo, 8)), 8);
+                ahi = _mm_srli_epi16 (_mm_add_epi16 (ahi, _mm_srli_epi16 (ahi, 8)), 8);
+                lo = _mm_or_si128 (_mm_and_si128 (amask, lo), _mm_andnot_si128 (amask, alo));
+                hi = _mm_or_si128 (_mm_and_si128 (amask, hi), _mm_andnot_si128 (amask, ahi));
+            }
+            __m128i* pacc = reinterpret_cast<__m128i*>(acc);
+            _mm_storeu_si128 (pacc, _mm_add_epi16 (_mm_loadu_si128 (pacc), lo));
+            _mm_storeu_si128 (pacc + 1, _mm_add_epi16 (_mm_loadu_si128 (pacc + 1), hi));
+        }
+#   endif
+        color_t c = 0, a = 0, t = 0;
+        for (; rest; -- rest, ++ src, acc += 4) {
+            c = *src;
+            if (mode == 1) c |= 0xff000000;
+            else if (mode == 2) c = ((c & 0xffffff) == ck) ? 0 : (c | 0xff000000);
+            else if (mode == 3) {
+                a = c >> 24;
+                t = ( c        & 0xff) * a + 128; acc[0] = static_cast<unsigned short>(acc[0] + ((t + (t >> 8)) >> 8));
+                t = ((c >> 8)  & 0xff) * a + 128; acc[1] = static_cast<unsigned short>(acc[1] + ((t + (t >> 8)) >> 8));
+                t = ((c >> 16) & 0xff) * a + 128; acc[2] = static_cast<unsigned short>(acc[2] + ((t + (t >> 8)) >> 8));
+                acc[3] = static_cast<unsigned short>(acc[3] + a);
+                continue;
+            }
+            acc[0] = static_cast<unsigned short>(acc[0] + ( c        & 0xff));
+            acc[1] = static_cast<unsigned short>(acc[1] + ((c >> 8)  & 0xff));
+            acc[2] = static_cast<unsigned short>(acc[2] + ((c >> 16) & 0xff));
+            acc[3] = static_cast<unsigned short>(acc[3] + ( c >> 24));
         }
-        // out of dst. only count
-        if (lh && srch_dataplus -> m_height > dst_dataplus -> m_height) {
-            if (dataplus -> m_height > srch_dataplus -> m_height)
-                lh = srch_dataplus -> m_height - dst_dataplus -> m_height;
-            for (i = lh; i; -- i, src = ls, sch = lsch) {
-                ls = src + dataplus -> m_width;
-                lsch = sch + srch_dataplus -> m_width;
-                for (j = sw + lw; j && sch != lsch; -- j, ++ src, ++ sch)
-                    fcalc (fcalc_color (*sch)), fcnt (0, src);
+    }
+
+    /**
+     * @function averager_t::averager_t <src/transform.h>
+     * @brief constructor
+     * @param[in] palette_colors: average colors rather than raw values
+     */
+    averager_t::
+    averager_t (bool palette_colors) noexcept
+      : m_dataplus_ (new (std::nothrow) mcl_avgbuf_t ()), m_data_ {0} {
+        mcl_avgbuf_t* buf = static_cast<mcl_avgbuf_t*>(m_dataplus_);
+        if (buf) buf -> m_palette = palette_colors;
+    }
+
+    averager_t::
+    ~averager_t () noexcept{
+        if (m_dataplus_) {
+            clear ();
+            delete static_cast<mcl_avgbuf_t*>(m_dataplus_);
+            m_dataplus_ = nullptr;
+        }
+    }
+
+    averager_t::
+    operator void* () const noexcept{
+        return m_dataplus_ ? const_cast<averager_t*>(this) : nullptr;
+    }
+    
+    bool averager_t::
+    operator! () const noexcept{
+        return !m_dataplus_;
+    }
+
+    /**
+     * @function averager_t::clear <src/transform.h>
+     * @brief forget all surfaces added
+     * @return void
+     */
+    void averager_t::
+    clear () noexcept{
+        mcl_avgbuf_t* buf = static_cast<mcl_avgbuf_t*>(m_dataplus_);
+        if (!buf) return ;
+        delete[] buf -> m_acc16;
+        delete[] buf -> m_acc32;
+        bool palette = buf -> m_palette;
+        *buf = mcl_avgbuf_t ();
+        buf -> m_palette = palette;
+    }
+
+    /**
+     * @function averager_t::get_count <src/transform.h>
+     * @brief get the number of surfaces added
+     * @return size_t
+     */
+    size_t averager_t::
+    get_count () const noexcept{
+        mcl_avgbuf_t* buf = static_cast<mcl_avgbuf_t*>(m_dataplus_);
+        return buf ? buf -> m_count : 0;
+    }
+
+    /**
+     * @function averager_t::add <src/transform.h>
+     * @brief add a surface. all surfaces must have the size of the first one
+     * @param[in] surface
+     * @return bool: false if the surface was not added
+     */
+    bool averager_t::
+    add (surface_t const& surface) noexcept{
+        mcl_avgbuf_t*   buf      = static_cast<mcl_avgbuf_t*>(m_dataplus_);
+        mcl_imagebuf_t* dataplus = mcl_get_surface_dataplus (&const_cast<surface_t&>(surface));
+        char*           data     = mcl_get_surface_data (&const_cast<surface_t&>(surface));
+        if (!(buf && dataplus)) return false;
+
+        // lock
+        mcl_simpletls_ns::mcl_spinlock_t lk(dataplus -> m_nrtlock, L"averager_t::add");
+        if (!dataplus -> m_width) return false;
+
+        size_t pixels = static_cast<size_t>(dataplus -> m_width) * static_cast<size_t>(dataplus -> m_height);
+        if (!buf -> m_count) {
+            buf -> m_acc16 = new (std::nothrow) unsigned short[pixels << 2];
+            if (!buf -> m_acc16) return false;
+            ::memset (buf -> m_acc16, 0, (pixels << 2) * sizeof (unsigned short));
+            buf -> m_width    = dataplus -> m_width;
+            buf -> m_height   = dataplus -> m_height;
+            buf -> m_flags    = data[0];
+            buf -> m_colorkey = dataplus -> m_colorkey;
+            buf -> m_alpha    = dataplus -> m_alpha;
+        } else if (dataplus -> m_width != buf -> m_width || dataplus -> m_height != buf -> m_height)
+            return false;
+
+        // fold a full batch into 32-bit sums
+        if (buf -> m_batch == mcl_avg_batch_max) {
+            if (!buf -> m_acc32) {
+                buf -> m_acc32 = new (std::nothrow) unsigned long[pixels << 2];
+                if (!buf -> m_acc32) return false;
+                ::memset (buf -> m_acc32, 0, (pixels << 2) * sizeof (unsigned long));
             }
+            unsigned short* p16 = buf -> m_acc16;
+            unsigned long*  p32 = buf -> m_acc32;
+            for (size_t i = pixels << 2; i; -- i, ++ p16, ++ p32)
+                *p32 += *p16, *p16 = 0;
+            buf -> m_batch = 0;
+        }
+
+        int mode = 0;
+        if (buf -> m_palette) {
+            if (data[0] & surface_t::SrcAlpha)         mode = 3, buf -> m_trans = true;
+            else if (data[0] & surface_t::SrcColorKey) mode = 2, buf -> m_trans = true;
+            else                                       mode = 1;
+        }
+        unsigned short* acc = buf -> m_acc16;
+        color_t* src = dataplus -> m_pbuffer;
+        point1d_t w = dataplus -> m_width;
+        color_t ck = dataplus -> m_colorkey;
+        mcl_parallel_obj.run (dataplus -> m_height, pixels, [=] (point1d_t ib, point1d_t ie) {
+            for (point1d_t i = ib; i != ie; ++ i)
+                mcl_avg_add_row (acc + ((i * w) << 2), src + i * w, w, mode, ck);
+        });
+        ++ buf -> m_batch;
+        ++ buf -> m_count;
+        return true;
+    }
+
+    /**
+     * @function averager_t::get_average <src/transform.h>
+     * @brief get the average of surfaces added so far
+     * @return surface_t
+     */
+    surface_t averager_t::
+    get_average () const noexcept{
+        mcl_avgbuf_t* buf = static_cast<mcl_avgbuf_t*>(m_dataplus_);
+        if (!buf || !buf -> m_count) return sf_nullptr;
+
+        // create compatible surface
+        surface_t::type flags = buf -> m_palette ?
+            (buf -> m_trans ? surface_t::SrcAlpha : surface_t::type(0)) : buf -> m_flags;
+        surface_t res ({buf -> m_width, buf -> m_height}, flags);
+        mcl_imagebuf_t* res_dataplus = mcl_get_surface_dataplus (&res);
+        char*           res_data     = mcl_get_surface_data (&res);
+        if (!(res_dataplus && res_dataplus -> m_width)) return sf_nullptr;
+        res_data[0] = flags;
+        if (!buf -> m_palette) {
+            res_dataplus -> m_colorkey = buf -> m_colorkey;
+            res_dataplus -> m_alpha = buf -> m_alpha;
         }
-        return cnt;
+
+        unsigned short const* acc16 = buf -> m_acc16;
+        unsigned long const*  acc32 = buf -> m_acc32;
+        color_t* dst = res_dataplus -> m_pbuffer;
+        unsigned long n = static_cast<unsigned long>(buf -> m_count);
+        bool b_unpremul = buf -> m_palette && buf -> m_trans;
+        point1d_t w = buf -> m_width;
+        mcl_parallel_obj.run (buf -> m_height,
+            static_cast<size_t>(w) * static_cast<size_t>(buf -> m_height),
+        [=] (point1d_t ib, point1d_t ie) {
+            unsigned long s[4] = { 0 };
+            size_t k = static_cast<size_t>(ib * w) << 2, ke = static_cast<size_t>(ie * w) << 2;
+            for (color_t* p = dst + ib * w; k != ke; k += 4, ++ p) {
+                for (size_t c = 0; c != 4; ++ c)
+                    s[c] = acc16[k + c] + (acc32 ? acc32[k + c] : 0ul);
+                if (b_unpremul) {
+                    // sums of premultiplied channels over the sum of alpha
+                    if (!s[3]) { *p = 0; continue; }
+                    unsigned long long r = 0, g = 0, b = 0, sa = s[3];
+                    b = (s[0] * 255ull + (sa >> 1)) / sa; if (b > 255) b = 255;
+                    g = (s[1] * 255ull + (sa >> 1)) / sa; if (g > 255) g = 255;
+                    r = (s[2] * 255ull + (sa >> 1)) / sa; if (r > 255) r = 255;
+                    *p = ((s[3] + (n >> 1)) / n) << 24 | color_t(r << 16 | g << 8 | b);
+                } else {
+                    *p = ((s[3] + (n >> 1)) / n) << 24 | ((s[2] + (n >> 1)) / n) << 16 |
+                         ((s[1] + (n >> 1)) / n) << 8  | ((s[0] + (n >> 1)) / n);
+                }
+            }
+        });
+        return res;
     }
 
 }
@@ -230,6 +230,32 @@ mcl {
     // Convert the hslcolor to the rgbcolor.
     color_t cvthsl2rgb (color_t hslcolor);
 
+    // Convert count rgbcolors to hslcolors. hslcolors may be rgbcolors.
+    void cvtrgb2hsl (color_t const* rgbcolors, color_t* hslcolors, size_t count);
+    // Convert count hslcolors to hsvcolors. hsvcolors may be hslcolors.
+    void cvthsl2hsv (color_t const* hslcolors, color_t* hsvcolors, size_t count);
+    // Convert count hsvcolors to rgbcolors. rgbcolors may be hsvcolors.
+    void cvthsv2rgb (color_t const* hsvcolors, color_t* rgbcolors, size_t count);
+    // Convert count rgbcolors to hsvcolors. hsvcolors may be rgbcolors.
+    void cvtrgb2hsv (color_t const* rgbcolors, color_t* hsvcolors, size_t count);
+    // Convert count hsvcolors to hslcolors. hslcolors may be hsvcolors.
+    void cvthsv2hsl (color_t const* hsvcolors, color_t* hslcolors, size_t count);
+    // Convert count hslcolors to rgbcolors. rgbcolors may be hslcolors.
+    void cvthsl2rgb (color_t const* hslcolors, color_t* rgbcolors, size_t count);
+
+    // Convert the pixels of a surface from rgb to hsl in place.
+    bool cvtrgb2hsl (surface_t& surface);
+    // Convert the pixels of a surface from hsl to hsv in place.
+    bool cvthsl2hsv (surface_t& surface);
+    // Convert the pixels of a surface from hsv to rgb in place.
+    bool cvthsv2rgb (surface_t& surface);
+    // Convert the pixels of a surface from rgb to hsv in place.
+    bool cvtrgb2hsv (surface_t& surface);
+    // Convert the pixels of a surface from hsv to hsl in place.
+    bool cvthsv2hsl (surface_t& surface);
+    // Convert the pixels of a surface from hsl to rgb in place.
+    bool cvthsl2rgb (surface_t& surface);
+
     // Return the alpha value in the specified rgbcolor.
     constexpr color_t geta4rgb (color_t rgbcolor)
     { return rgbcolor >> 24;        }
@@ -41,23 +41,68 @@ namespace
 mcl {
 
    /**
-    * @todo
-    *     mcl::image.tobytes()
-    *     mcl::image.frombytes()
-    * 
     * @unimplemented
     *     pygame.image.get_extended()
     *     pygame.image.tostring()
-    *     pygame.image.tobytes()
     *     pygame.image.fromstring()
-    *     pygame.image.frombytes()
     * 
     * @unfinished
-    *    # extended type, mask, low-bit image 
+    *    # extended type, mask
     *     pygame.image.load()
     *     pygame.image.save()
+    * 
+    * @feature
+    *     mcl::image.save_png()
+    *     mcl::image.save_qoi()
+    *     mcl::image.load_async()
+    *     mcl::loadtask_t
+    *     mcl::assetpack_t
+    *     mcl::assetpacker_t
+    *     mcl::recorder_t
     */
 
+   /**
+    * @enum class mcl_bytefmt_t <src/image.h>
+    * @brief Byte layouts of pixels for image.tobytes and image.frombytes.
+    * 
+    * @ingroup images
+    * @ingroup mclib
+    */
+    class
+    mcl_bytefmt_t {
+    
+    public:
+        using type = unsigned long;
+
+        static type constexpr BGRA = 0x0;  // 4 bytes. the layout of surfaces in memory.
+        static type constexpr RGB  = 0x1;  // 3 bytes.
+        static type constexpr RGBX = 0x2;  // 4 bytes. the fourth one is 255.
+        static type constexpr RGBA = 0x3;  // 4 bytes.
+        static type constexpr ARGB = 0x4;  // 4 bytes.
+
+        static type constexpr Flipped = 0x10; // rows from bottom to top.
+    };
+    using bytefmt_t = mcl_bytefmt_t::type;
+
+   /**
+    * @enum class mcl_recfmt_t <src/image.h>
+    * @brief File formats of recorder_t.
+    * 
+    * @ingroup images
+    * @ingroup mclib
+    */
+    class
+    mcl_recfmt_t {
+    
+    public:
+        using type = unsigned long;
+
+        static type constexpr Raw   = 0x0;  // indexed BGRA frames. read them with recorder_t::load_frame.
+        static type constexpr Delta = 0x1;  // like Raw, but frames between key frames keep the changed pixels only.
+        static type constexpr Y4M   = 0x2;  // YUV4MPEG2 in 4:2:0, for video tools.
+    };
+    using recfmt_t = mcl_recfmt_t::type;
+
    /**
     * @class mcl_image_t <src/image.h>
     * @brief module for image transfer
@@ -75,8 +120,11 @@ mcl {
         operator      void*       () const noexcept;
         bool          operator!   () const noexcept;  
 
-        // load image only supports uncompressed BMP ICO CUR image
-        // (currently don't support 1, 2, 4, 8, 16, 24 bits image) 
+        // load image supports PNG QOI BMP ICO CUR image. PNG, QOI and
+        // uncompressed BMP are decoded by mclib from a view of the file.
+        // with a size, they are shrunk while decoding by averaging the
+        // area under each pixel, so the image is never held at full size
+        // (except for interlaced PNG). 0 keeps the width or height
 
         // load new image from a file
         surface_t     load        (char const* filename, void* = 0) noexcept;
@@ -86,22 +134,224 @@ mcl {
         surface_t     load        (char const* filename, point2d_t size) noexcept;
         // load new image from a file
         surface_t     load        (wchar_t const* filename, point2d_t size) noexcept;
+
+        // load_async loads on a few worker threads and returns at once.
+        // if eventtype is not 0, event_t{ eventtype, code } is posted
+        // to the event queue when the image is ready
+
+        // load new image from a file in the background
+        loadtask_t    load_async  (char const* filename, eventtype_t eventtype = 0, void* code = nullptr) noexcept;
+        // load new image from a file in the background
+        loadtask_t    load_async  (wchar_t const* filename, eventtype_t eventtype = 0, void* code = nullptr) noexcept;
         
-        // save image only supports uncompressed BMP image
-        // (currently don't support 1, 2, 4, 8, 16, 24 bits image) 
+        // save image writes uncompressed 24-bit BMP image, or 32-bit
+        // BMP image with pixels as they are stored if b_bgra is set.
+        // file names ending in .png or .qoi are written by save_png
+        // or save_qoi instead
 
         // save an image to file
-        bool          save        (surface_t const& surface, char const* filename) noexcept;
+        bool          save        (surface_t const& surface, char const* filename, bool b_bgra = false) noexcept;
         // save an image to file
-        bool          save        (surface_t const& surface, wchar_t const* filename) noexcept;
+        bool          save        (surface_t const& surface, wchar_t const* filename, bool b_bgra = false) noexcept;
         // save an image to file
-        bool          save        (surface_t const& surface, FILE* fileobj) noexcept;
+        bool          save        (surface_t const& surface, FILE* fileobj, bool b_bgra = false) noexcept;
+
+        // save_png writes RGB, or RGBA if the surface has SrcAlpha.
+        // level is 0 (stored) to 9 (smallest), like zlib
+
+        // save an image to a PNG file
+        bool          save_png    (surface_t const& surface, char const* filename, int level = 6) noexcept;
+        // save an image to a PNG file
+        bool          save_png    (surface_t const& surface, wchar_t const* filename, int level = 6) noexcept;
+        // save an image to a PNG file
+        bool          save_png    (surface_t const& surface, FILE* fileobj, int level = 6) noexcept;
+
+        // save_qoi writes RGB, or RGBA if the surface has SrcAlpha or a
+        // colorkey. it is larger than PNG, but much faster both ways
+
+        // save an image to a QOI file
+        bool          save_qoi    (surface_t const& surface, char const* filename) noexcept;
+        // save an image to a QOI file
+        bool          save_qoi    (surface_t const& surface, wchar_t const* filename) noexcept;
+        // save an image to a QOI file
+        bool          save_qoi    (surface_t const& surface, FILE* fileobj) noexcept;
+
+        // tobytes and frombytes use rows of width * 3 (RGB) or width * 4
+        // bytes without padding. tobytes of BGRA that is not flipped returns
+        // the surface memory itself and does not touch bytes. without
+        // SrcAlpha, alpha is 255 in bytes but undefined in that memory
 
+        // get the pixels in a byte layout. nullptr on failure
+        void const*   tobytes     (surface_t const& surface, bytefmt_t format, void* bytes = nullptr) noexcept;
+        // create a new surface from pixels in a byte layout
+        surface_t     frombytes   (void const* bytes, point2d_t size, bytefmt_t format) noexcept;
         // create a new surface that shares data inside a bytes buffer
         surface_t     frombuffer  (color_t* bytes, point2d_t size) noexcept;
     };
     extern mcl_image_t image; // Module for image transfer.
 
+   /**
+    * @class loadtask_t <src/image.h>
+    * @brief handle of an image loaded by image.load_async
+    * 
+    * @ingroup images
+    * @ingroup mclib
+    */
+    class
+    loadtask_t { public:
+        explicit    loadtask_t () noexcept;
+                   ~loadtask_t () noexcept;
+                    loadtask_t (loadtask_t const& rhs) = delete;
+                    loadtask_t (loadtask_t&& rhs) noexcept;
+        loadtask_t& operator=  (loadtask_t const& rhs) = delete;
+        loadtask_t& operator=  (loadtask_t&& rhs) noexcept;
+        operator    void*      () const noexcept;
+        bool        operator!  () const noexcept;
+
+        // test if the image is ready, without blocking
+        bool        ready      () const noexcept;
+        // wait until the image is ready. timeout in ms, -1 for ever
+        bool        wait       (long timeout = -1) const noexcept;
+        // wait for the image and take it. sf_nullptr if loading failed
+        surface_t   get        () noexcept;
+
+    private:
+        explicit    loadtask_t (void* task) noexcept;
+        friend class mcl_image_t;
+
+    private:
+        void* m_dataplus_;
+    };
+
+   /**
+    * @class assetpack_t <src/image.h>
+    * @brief read-only view of an asset pack written by assetpacker_t.
+    *     entries are found by name in the index and decoded on use
+    * 
+    * @ingroup images
+    * @ingroup mclib
+    */
+    class
+    assetpack_t { public:
+        explicit     assetpack_t () noexcept;
+        explicit     assetpack_t (char const* filename) noexcept;
+        explicit     assetpack_t (wchar_t const* filename) noexcept;
+                    ~assetpack_t () noexcept;
+                     assetpack_t (assetpack_t const& rhs) = delete;
+        assetpack_t& operator=   (assetpack_t const& rhs) = delete;
+        operator     void*       () const noexcept;
+        bool         operator!   () const noexcept;
+
+        // get the number of entries
+        size_t       size        () const noexcept;
+        // test if an entry is in the pack
+        bool         contains    (char const* name) const noexcept;
+        // test if an entry is in the pack
+        bool         contains    (wchar_t const* name) const noexcept;
+        // get the size of an entry without decoding it. {0, 0} if not found
+        point2d_t    get_size    (char const* name) const noexcept;
+        // get the size of an entry without decoding it. {0, 0} if not found
+        point2d_t    get_size    (wchar_t const* name) const noexcept;
+
+        // load decodes a new surface every time. get decodes an entry
+        // once and keeps it until clear_cache or the pack is destroyed
+
+        // decode an entry into a new surface
+        surface_t    load        (char const* name) noexcept;
+        // decode an entry into a new surface
+        surface_t    load        (wchar_t const* name) noexcept;
+        // get the cached surface of an entry. sf_nullptr if not found
+        surface_t const& get     (char const* name) noexcept;
+        // get the cached surface of an entry. sf_nullptr if not found
+        surface_t const& get     (wchar_t const* name) noexcept;
+        // drop all cached surfaces
+        void         clear_cache () noexcept;
+
+    private:
+        void* m_dataplus_;
+    };
+
+   /**
+    * @class assetpacker_t <src/image.h>
+    * @brief collects images and writes them into one asset pack
+    * 
+    * @ingroup images
+    * @ingroup mclib
+    */
+    class
+    assetpacker_t { public:
+        explicit       assetpacker_t () noexcept;
+                      ~assetpacker_t () noexcept;
+                       assetpacker_t (assetpacker_t const& rhs) = delete;
+        assetpacker_t& operator=     (assetpacker_t const& rhs) = delete;
+
+        // image files are stored as they are, so they must be PNG, QOI or
+        // BMP that image.load decodes by itself. surfaces are stored as
+        // QOI. names are unique and compared case-sensitively
+
+        // add an image file. it is read when the pack is saved
+        bool           add           (char const* name, char const* filename) noexcept;
+        // add an image file. it is read when the pack is saved
+        bool           add           (wchar_t const* name, wchar_t const* filename) noexcept;
+        // add a copy of a surface
+        bool           add           (char const* name, surface_t const& surface) noexcept;
+        // add a copy of a surface
+        bool           add           (wchar_t const* name, surface_t const& surface) noexcept;
+        // get the number of entries
+        size_t         size          () const noexcept;
+        // write the pack file
+        bool           save          (char const* filename) const noexcept;
+        // write the pack file
+        bool           save          (wchar_t const* filename) const noexcept;
+
+    private:
+        void* m_dataplus_;
+    };
+
+   /**
+    * @class recorder_t <src/image.h>
+    * @brief records frames into a video file on a background thread
+    * 
+    * @ingroup images
+    * @ingroup mclib
+    */
+    class
+    recorder_t { public:
+        explicit    recorder_t () noexcept;
+        explicit    recorder_t (char const* filename, point2d_t size, recfmt_t format = mcl_recfmt_t::Delta,
+                        long fps = 30, size_t buffers = 8) noexcept;
+        explicit    recorder_t (wchar_t const* filename, point2d_t size, recfmt_t format = mcl_recfmt_t::Delta,
+                        long fps = 30, size_t buffers = 8) noexcept;
+                   ~recorder_t () noexcept;
+                    recorder_t (recorder_t const& rhs) = delete;
+        recorder_t& operator=  (recorder_t const& rhs) = delete;
+        operator    void*      () const noexcept;
+        bool        operator!  () const noexcept;
+
+        // add_frame copies the surface into one of the buffers and returns.
+        // a thread writes the buffers in order. when all of them are still
+        // waiting for the disk, the frame is dropped and counted. call it
+        // from one thread only. the part of the surface that does not fit
+        // the size of the recorder is cut off, and a smaller one is padded
+
+        // queue a frame. false if it is dropped
+        bool        add_frame  (surface_t const& surface) noexcept;
+        // write the frames left and close the file. also done by the destructor
+        bool        close      () noexcept;
+        // get the number of frames written so far
+        size_t      get_frames () const noexcept;
+        // get the number of frames dropped so far
+        size_t      get_dropped () const noexcept;
+
+        // read a frame of a Raw or Delta file into a new surface
+        static surface_t load_frame (char const* filename, size_t index) noexcept;
+        // read a frame of a Raw or Delta file into a new surface
+        static surface_t load_frame (wchar_t const* filename, size_t index) noexcept;
+
+    private:
+        void* m_dataplus_;
+    };
+
 } // namespace
 
 #endif // MCL_IMAGE
@@ -0,0 +1,167 @@
+/*
+    mclib (Multi-Canvas Library)
+    Copyright (C) 2021-2022  Yukino Amamiya
+
+    This file is part of the mclib Library. This library is
+    a graphics library for desktop applications only and it's
+    only for windows.
+
+    This library is free software; you can redistribute it
+    and/or modify it under the terms of the GNU Lesser General
+    Public License as published by the Free Software Foundation;
+    either version 2.1 of the License, or (at your option) any
+    later version.
+
+    This library is distributed in the hope that it will be
+    useful, but WITHOUT ANY WARRANTY; without even the implied
+    warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+    PURPOSE.  See the GNU Lesser General Public License for
+    more details.
+
+    You should have received a copy of the GNU Lesser General
+    Public License along with this library; if not, write to
+    the Free Software Foundation,
+    Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+
+    Yukino Amamiya
+    iamyukino[at outlook.com]
+
+
+    @file src/mask.h
+    This is a C++11 header for image masks.
+*/
+
+
+#ifndef MCL_MASK
+# define MCL_MASK
+
+# include "mclfwd.h"
+
+# ifdef _MSC_VER
+#  pragma warning(push)
+#  pragma warning(disable: 4365)
+# endif
+
+# include <vector>
+
+# ifdef _MSC_VER
+#  pragma warning(pop)
+# endif
+
+namespace
+mcl {
+
+   /**
+    * @unimplemented
+    *     pygame.mask.from_threshold()
+    *     pygame.mask.Mask.scale()
+    *     pygame.mask.Mask.angle()
+    *     pygame.mask.Mask.convolve()
+    * 
+    * @feature
+    *     mcl::mask_t::get_bounding_rect()
+    *     mcl::mask_t::erode()
+    *     mcl::mask_t::dilate()
+    */
+
+   /**
+    * @class mcl_mask_t <src/mask.h>
+    * @brief module for image masks
+    * 
+    * @include mask
+    * @ingroup surface
+    * @ingroup mclib
+    * @{
+    */
+    class
+    mcl_mask_t { public:
+        explicit   mcl_mask_t ()                      = default;
+                  ~mcl_mask_t ()                      = default;
+                   mcl_mask_t (mcl_mask_t const& rhs) = delete;
+        mcl_mask_t& operator= (mcl_mask_t const& rhs) = delete;
+        operator   void*      () const noexcept;
+        bool       operator!  () const noexcept;
+
+        // creates a mask from the given surface. pixels with alpha above threshold
+        // (SrcAlpha) or not of the colorkey (SrcColorKey) are set, otherwise all are set
+        mask_t     from_surface (surface_t const& surface, color_t threshold = 127) noexcept;
+    };
+    extern mcl_mask_t mask; // Module for image masks.
+
+   /**
+    * @class mask_t <src/mask.h>
+    * @brief Class to represent a 2D bitmask. one bit per pixel,
+    *     stored in 64-bit words row by row.
+    * 
+    * @ingroup surface
+    * @ingroup mclib
+    */
+    class
+    mask_t { public:
+        explicit   mask_t     (point2d_t size = {0, 0}, bool fill = false) noexcept;
+                  ~mask_t     () noexcept;
+                   mask_t     (mask_t const& rhs) noexcept;
+                   mask_t     (mask_t&& rhs) noexcept;
+        mask_t&    operator=  (mask_t const& rhs) noexcept;
+        mask_t&    operator=  (mask_t&& rhs) noexcept;
+        operator   void*      () const noexcept;
+        bool       operator!  () const noexcept;
+
+        // get the dimensions of the mask
+        point2d_t  get_size   () const noexcept;
+        // get the rectangular area of the mask
+        rect_t     get_rect   () const noexcept;
+        // gets the bit at the given position
+        bool       get_at     (point2d_t pos) const noexcept;
+        // sets the bit at the given position
+        void       set_at     (point2d_t pos, bool value = true) noexcept;
+        // checks if other placed at offset overlaps this one. pos gets the first point
+        bool       overlap    (mask_t const& other, point2d_t offset, point2d_t* pos = nullptr) const noexcept;
+        // gets the number of overlapping set bits
+        size_t     overlap_area (mask_t const& other, point2d_t offset) const noexcept;
+        // gets a mask of the overlapping set bits
+        mask_t     overlap_mask (mask_t const& other, point2d_t offset) const noexcept;
+        // sets all bits to 1
+        void       fill       () noexcept;
+        // sets all bits to 0
+        void       clear      () noexcept;
+        // flips all the bits
+        void       invert     () noexcept;
+        // sets the bits set in other placed at offset
+        void       draw       (mask_t const& other, point2d_t offset) noexcept;
+        // clears the bits set in other placed at offset
+        void       erase      (mask_t const& other, point2d_t offset) noexcept;
+        // gets the number of set bits
+        size_t     count      () const noexcept;
+        // gets the centroid of the set bits
+        point2d_t  centroid   () const noexcept;
+        // gets the smallest rect containing all set bits
+        rect_t     get_bounding_rect () const noexcept;
+        // gets the outline of the first connected component, every n-th point
+        std::vector<point2d_t> outline (point1d_t every = 1) const noexcept;
+        // gets the largest connected component (8-connected)
+        mask_t     connected_component () const noexcept;
+        // gets the connected component containing pos
+        mask_t     connected_component (point2d_t pos) const noexcept;
+        // gets the connected components with at least minimum set bits
+        std::vector<mask_t> connected_components (size_t minimum = 0) const noexcept;
+        // gets the bounding rects of the connected components
+        std::vector<rect_t> get_bounding_rects () const noexcept;
+        // clears bits with an unset bit within radius (outside counts as unset)
+        mask_t     erode      (point1d_t radius = 1) const noexcept;
+        // sets bits with a set bit within radius
+        mask_t     dilate     (point1d_t radius = 1) const noexcept;
+        // returns a surface with set bits drawn in setcolor and unset bits in unsetcolor
+        surface_t  to_surface (color_t setcolor = 0xffffffff, color_t unsetcolor = 0xff000000) const noexcept;
+
+    private:
+        void* m_dataplus_;
+        char m_data_[1];
+
+        char : 8; char : 8; char : 8; char : 8;
+        char : 8; char : 8; char : 8;
+    };
+
+} // namespace
+
+#endif // MCL_MASK
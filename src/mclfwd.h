@@ -117,9 +117,18 @@ mcl {
 
     // module for image transfer.  see image.h
     class mcl_image_t;
+    class loadtask_t;
+    class assetpack_t;
+    class assetpacker_t;
+    class recorder_t;
 
     // module for surfaces transfer.  see transform.h
     class mcl_transform_t;
+    class averager_t;
+
+    // module for image masks.  see mask.h
+    class mcl_mask_t;
+    class mask_t;
 
     // module for drawing shapes.  see draw.h
     class mcl_draw_t;
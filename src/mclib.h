@@ -86,6 +86,9 @@
 //  This header is for surfaces transfer.
 #   include "transform.h"
 
+//  This header is for image masks.
+#   include "mask.h"
+
 //  This header is for loading and playing sounds.
 //  inline include music.h
 #   include "mixer.h"
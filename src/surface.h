@@ -70,6 +70,10 @@ mcl {
     * 
     * @unfinished
     *     pygame.Surface()
+    * 
+    * @feature
+    *     mcl::surface_t.set_mipmap()
+    *     mcl::surface_t.get_mipmap()
     */
 
    /**
@@ -95,6 +99,7 @@ mcl {
         static type constexpr Alpha = 0x7; // overlay.
 
         static type constexpr PreMultiplied = 0x10; // src has premultiplied Alpha
+        static type constexpr Linear        = 0x20; // Alpha blits blend in linear light
 
         static type constexpr Copy_rgb  = 0x100; // normal copy. ignore alpha.
         static type constexpr Add_rgb   = 0x101; // color dodge. ignore alpha.
@@ -183,6 +188,10 @@ mcl {
         void       set_alpha (color_t alpha) noexcept;
         // Get the current surface transparency value
         color_t    get_alpha () const noexcept;
+        // keep halved copies that transform.scale and rotozoom shrink from
+        void       set_mipmap (bool b_mipmap = true) noexcept;
+        // test if the surface keeps halved copies
+        bool       get_mipmap () const noexcept;
         // lock the Surface memory for pixel access
         surface_t& lock      () noexcept;
         // unlock the Surface memory for pixel access
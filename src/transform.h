@@ -43,12 +43,45 @@ mcl {
     * @unimplemented
     *     pygame.transform.get_smoothscale_backend()
     *     pygame.transform.set_smoothscale_backend()
-    *     pygame.transform.average_surfaces()
     * 
     * @feature
     *     mcl::transform.clip()
+    *     mcl::transform.convolve()
+    *     mcl::transform.sharpen()
+    *     mcl::transform.emboss()
+    *     mcl::averager_t
+    *     mcl::transform.set_cache()
+    *     mcl::transform.scale3x()
+    *     mcl::transform.scalenx()
+    *     mcl::transform.set_linear()
+    *     mcl::transform.apply_lut()
+    *     mcl::transform.color_matrix()
     */
 
+   /**
+    * @enum class mcl_conv_t <src/transform.h>
+    * @brief Flags that control how transform.convolve works.
+    * 
+    * @ingroup surface
+    * @ingroup mclib
+    */
+    class
+    mcl_conv_t {
+    
+    public:
+        using type = unsigned long;
+
+        static type constexpr Clamp = 0x0;  // repeat the edge pixels.
+        static type constexpr Wrap  = 0x1;  // tile the surface.
+        static type constexpr Zero  = 0x2;  // pixels outside are transparent black.
+
+        static type constexpr Float = 0x10; // accumulate in float instead of fixed-point.
+        static type constexpr Abs   = 0x20; // take the absolute value of the sums.
+        static type constexpr Gray  = 0x40; // convolve the luminance. result is opaque gray.
+    };
+    using conv_t = mcl_conv_t::type;
+    extern mcl_conv_t conv;
+
    /**
     * @class mcl_transform_t <src/transform.h>
     * @brief module for surfaces transfer
@@ -83,23 +116,123 @@ mcl {
                                 point2d_t* offset = nullptr) noexcept;
         // specialized image doubler
         surface_t  scale2x   (surface_t const& surface, point2d_t* offset = nullptr) noexcept;
+        // specialized image tripler
+        surface_t  scale3x   (surface_t const& surface, point2d_t* offset = nullptr) noexcept;
+        // pixel-art upscaler by an integer factor. b_smooth picks scale2x (2, 4) or scale3x (3)
+        surface_t  scalenx   (surface_t const& surface, point1d_t factor, bool b_smooth = false,
+                                point2d_t* offset = nullptr) noexcept;
+        // upscale into dest_surface, which is factor times the size of surface
+        bool       scalenx   (surface_t& dest_surface, surface_t const& surface, point1d_t factor,
+                                bool b_smooth = false) noexcept;
         // gets a copy of an image with an interior area removed
         surface_t  chop      (surface_t const& surface, rect_t rect) noexcept;
         // gets a copy of part of an image
         surface_t  clip      (surface_t const& surface, rect_t rect) noexcept;
         // find edges in a surface using the laplacian algorithm
         surface_t  laplacian (surface_t const& surface) noexcept;
+        // convolve with a kernel of ksize.y rows by ksize.x columns
+        surface_t  convolve  (surface_t const& surface, float const* kernel, point2d_t ksize,
+                                conv_t flags = 0, float bias = 0.f) noexcept;
+        // sharpen a surface
+        surface_t  sharpen   (surface_t const& surface, float amount = 1.f) noexcept;
+        // emboss a surface
+        surface_t  emboss    (surface_t const& surface, float strength = 1.f) noexcept;
+        // blur a surface using box blur
+        surface_t  box_blur  (surface_t const& surface, point1d_t radius,
+                                bool repeat_edge_pixels = true) noexcept;
+        // blur a surface into dest_surface, which may be the surface itself
+        bool       box_blur  (surface_t& dest_surface, surface_t const& surface, point1d_t radius,
+                                bool repeat_edge_pixels = true) noexcept;
+        // blur a surface using gaussian blur
+        surface_t  gaussian_blur (surface_t const& surface, point1d_t radius,
+                                bool repeat_edge_pixels = true) noexcept;
+        // blur a surface into dest_surface, which may be the surface itself
+        bool       gaussian_blur (surface_t& dest_surface, surface_t const& surface, point1d_t radius,
+                                bool repeat_edge_pixels = true) noexcept;
         // finds the average color of a surface
         color_t    average_color (surface_t const& surface) noexcept;
         // grayscale a surface
         surface_t  grayscale (surface_t const& surface) noexcept;
+        // grayscale a surface into dest_surface, which may be the surface itself
+        bool       grayscale (surface_t& dest_surface, surface_t const& surface) noexcept;
+        // remaps each channel through a 256-entry table. a null table leaves its channel
+        surface_t  apply_lut (surface_t const& surface, unsigned char const* lut_r, unsigned char const* lut_g,
+                                unsigned char const* lut_b, unsigned char const* lut_a = nullptr) noexcept;
+        // remaps each channel of an area of the surface in place
+        bool       apply_lut (surface_t& surface, rect_t area, unsigned char const* lut_r,
+                                unsigned char const* lut_g, unsigned char const* lut_b,
+                                unsigned char const* lut_a = nullptr) noexcept;
+        // mixes the channels through a 4x5 matrix of 20 floats: rows r, g, b, a of
+        // weights for r, g, b, a and an offset in [0, 255]
+        surface_t  color_matrix (surface_t const& surface, float const* matrix) noexcept;
+        // mixes the channels of an area of the surface in place
+        bool       color_matrix (surface_t& surface, rect_t area, float const* matrix) noexcept;
         // finds which, and how many pixels in a surface are within a threshold
         size_t     threshold (void* dest_surf, surface_t const& surf, color_t search_color,
                                 color_t threshold, color_t set_color, int set_behavior = 1,
                                 void const* search_surf = 0, bool inverse_set = false) noexcept;
+        // find the average surface from many surfaces
+        surface_t  average_surfaces (surface_t const* surfaces, size_t count,
+                                bool palette_colors = true) noexcept;
+
+        // sets the threads used by scale, rotozoom, convolve, blurs, grayscale, apply_lut,
+        // color_matrix, threshold and the upscalers (0: one per processor, 1: serial), and
+        // the least output pixels worth splitting into row bands. results do not depend on this
+        void       set_threads (unsigned long threads, size_t min_pixels = 65536u) noexcept;
+        // gets the number of threads a transform may use
+        unsigned long get_threads () noexcept;
+
+        // makes scale and rotozoom weight colors in linear light rather than sRGB values
+        void       set_linear (bool b_linear = true) noexcept;
+        // test if scale and rotozoom work in linear light
+        bool       get_linear () noexcept;
+
+        // keeps results of scale, rotozoom, rotate and the upscalers up to max_bytes of pixels, and
+        // returns copies while the source is not written. 0 (default) turns the cache off
+        void       set_cache (size_t max_bytes) noexcept;
+        // gets hit, miss, byte and entry counts of the transform cache. returns the byte budget
+        size_t     get_cache (size_t* hits = nullptr, size_t* misses = nullptr,
+                                size_t* bytes = nullptr, size_t* entries = nullptr) noexcept;
+        // empties the transform cache and resets its statistics
+        void       clear_cache () noexcept;
     };
     extern mcl_transform_t transform; // Module for surfaces transfer.
 
+   /**
+    * @class averager_t <src/transform.h>
+    * @brief averages surfaces added one at a time
+    * 
+    * @ingroup surface
+    * @ingroup mclib
+    */
+    class
+    averager_t { public:
+        // palette_colors: average the colors seen (alpha and colorkey aware),
+        // otherwise average the raw pixel values
+        explicit    averager_t (bool palette_colors = true) noexcept;
+                   ~averager_t () noexcept;
+                    averager_t (averager_t const& rhs) = delete;
+        averager_t& operator= (averager_t const& rhs) = delete;
+        operator    void*      () const noexcept;
+        bool        operator!  () const noexcept;
+
+        // add a surface. all surfaces must have the size of the first one
+        bool        add        (surface_t const& surface) noexcept;
+        // get the number of surfaces added
+        size_t      get_count  () const noexcept;
+        // get the average of surfaces added so far
+        surface_t   get_average () const noexcept;
+        // forget all surfaces added
+        void        clear      () noexcept;
+
+    private:
+        void* m_dataplus_;
+        char m_data_[1];
+
+        char : 8; char : 8; char : 8; char : 8;
+        char : 8; char : 8; char : 8;
+    };
+
 } // namespace
 
 #endif // MCL_TRANSFORM
@@ -24,7 +24,7 @@ Most useful stuff:
 
 Advanced stuff:
     cursors.h     =
-    mask.h        no
+    mask.h        =
     sprite.h      no
     transform.h   =
     bufferproxy.h =